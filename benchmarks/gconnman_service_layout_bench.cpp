@@ -0,0 +1,382 @@
+#include <benchmark/benchmark.h>
+#include <glib.h>
+#include <malloc.h>
+
+#include <amarula/dbus/connman/gservice.hpp>
+#include <amarula/dbus/gsmallvector.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "gconnman_private.hpp"
+#include "gdbus_private.hpp"
+#include "gproperty_table.hpp"
+#include "gvariant_codec.hpp"
+
+/*
+ * Live heap bytes of the process, to add what the decoded properties own to
+ * their sizeof.
+ */
+namespace {
+std::size_t live_bytes = 0;
+}  // namespace
+
+auto operator new(std::size_t size) -> void* {
+    void* ptr = std::malloc(size == 0U ? 1U : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    live_bytes += malloc_usable_size(ptr);
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    if (ptr != nullptr) {
+        live_bytes -= malloc_usable_size(ptr);
+    }
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t /*size*/) noexcept {
+    operator delete(ptr);
+}
+
+// SmallVector allocates its heap storage through these.
+auto operator new(std::size_t size, std::align_val_t alignment) -> void* {
+    const auto align = static_cast<std::size_t>(alignment);
+    void* ptr = std::aligned_alloc(align, (size + align - 1U) / align * align);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    live_bytes += malloc_usable_size(ptr);
+    return ptr;
+}
+
+void operator delete(void* ptr, std::align_val_t /*alignment*/) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::size_t /*size*/,
+                     std::align_val_t /*alignment*/) noexcept {
+    operator delete(ptr);
+}
+
+using Amarula::DBus::G::PropertyList;
+using Amarula::DBus::G::VariantPtr;
+using Amarula::DBus::G::Connman::ServProperties;
+
+namespace {
+
+struct PackedLayout;
+
+}  // namespace
+
+namespace Amarula::DBus::G::Connman {
+
+/*
+ * PropertyDescriptors specializations are friends of the Properties types:
+ * this one feeds ServProperties the way DBusProxy does.
+ */
+template <>
+struct PropertyDescriptors<PackedLayout> {
+    static void parse(ServProperties& properties, GVariant* dict) {
+        GVariantIter iter;
+        g_variant_iter_init(&iter, dict);
+        const gchar* key = nullptr;
+        GVariant* value = nullptr;
+        while (g_variant_iter_next(&iter, "{&sv}", &key, &value) != 0) {
+            properties.update(key, value);
+            g_variant_unref(value);
+        }
+    }
+};
+
+}  // namespace Amarula::DBus::G::Connman
+
+namespace {
+
+using namespace Amarula::DBus::G;
+using namespace Amarula::DBus::G::Connman;
+
+/*
+ * ServProperties as it was before the packed layout: addresses as text, a
+ * bool per flag and members in declaration order rather than by alignment.
+ * Enum values are not looked up, only the layout is compared.
+ */
+template <class Enum>
+struct AnyEnum {
+    using Type = Enum;
+    static constexpr Signature SIGNATURE{"s"};
+
+    static auto decode(GVariant* value) -> Type {
+        g_variant_get_string(value, nullptr);
+        return Enum::Unknown;
+    }
+};
+
+struct LegacyIPv4 {
+    IPv4::Method method_{};
+    std::string address_;
+    std::string netmask_;
+    std::string gateway_;
+    explicit LegacyIPv4(GVariant* variant);
+};
+
+struct LegacyIPv6 {
+    IPv6::Method method_{};
+    std::string address_;
+    std::string gateway_;
+    IPv6::Privacy privacy_{};
+    uint8_t prefix_length_{0U};
+    explicit LegacyIPv6(GVariant* variant);
+};
+
+struct LegacyEthernet {
+    Ethernet::Method method_{};
+    std::string interface_;
+    std::string address_;
+    uint16_t mtu_{0U};
+    explicit LegacyEthernet(GVariant* variant);
+};
+
+struct LegacyProvider {
+    std::string host_;
+    std::string domain_;
+    std::string name_;
+    std::string type_;
+    explicit LegacyProvider(GVariant* variant);
+};
+
+struct LegacyProxy {
+    Proxy::Method method_{};
+    std::string url_;
+    PropertyList<std::string> servers_;
+    PropertyList<std::string> excludes_;
+    explicit LegacyProxy(GVariant* variant);
+};
+
+struct LegacyServProperties {
+    using State = ServProperties::State;
+    using Error = ServProperties::Error;
+    using Type = ServProperties::Type;
+    using Security = ServProperties::Security;
+
+    State state_{};
+    Error error_{};
+    std::string name_;
+    Type type_{};
+    std::optional<PropertyList<Security>> security_;
+    std::optional<PropertyList<std::string>> name_servers_;
+    std::optional<PropertyList<std::string>> name_servers_conf_;
+    std::optional<PropertyList<std::string>> domains_;
+    std::optional<PropertyList<std::string>> time_servers_;
+    bool autoconnect_{false};
+    bool mdns_{false};
+    bool favorite_{false};
+    bool immutable_{false};
+    bool roaming_{false};
+    uint8_t strength_{0U};
+    std::optional<LegacyIPv4> ipv4_;
+    std::optional<LegacyIPv6> ipv6_;
+    std::optional<LegacyEthernet> ethernet_;
+    std::optional<LegacyProvider> provider_;
+    std::optional<LegacyProxy> proxy_;
+    std::shared_ptr<GVariant> source_;
+    uint32_t decoded_{0U};
+};
+
+template <class Nested>
+struct NestedCodec {
+    using Type = Nested;
+    static constexpr auto SIGNATURE = VariantDict::SIGNATURE;
+
+    static auto decode(GVariant* value) -> Type { return Nested(value); }
+};
+
+template <class Nested>
+using Dict = NonEmpty<NestedCodec<Nested>>;
+
+using Strings = Codec<PropertyList<std::string>>;
+
+constexpr PropertyTable LEGACY_IPV4_TABLE{
+    "IPv4",
+    std::array{
+        property<&LegacyIPv4::method_, AnyEnum<IPv4::Method>>(METHOD_STR),
+        property<&LegacyIPv4::address_, Codec<std::string>>(ADDRESS_STR),
+        property<&LegacyIPv4::netmask_, Codec<std::string>>(NETMASK_STR),
+        property<&LegacyIPv4::gateway_, Codec<std::string>>(GATEWAY_STR)}};
+
+constexpr PropertyTable LEGACY_IPV6_TABLE{
+    "IPv6",
+    std::array{
+        property<&LegacyIPv6::method_, AnyEnum<IPv6::Method>>(METHOD_STR),
+        property<&LegacyIPv6::address_, Codec<std::string>>(ADDRESS_STR),
+        property<&LegacyIPv6::gateway_, Codec<std::string>>(GATEWAY_STR),
+        property<&LegacyIPv6::privacy_, AnyEnum<IPv6::Privacy>>(PRIVACY_STR),
+        property<&LegacyIPv6::prefix_length_, Codec<uint8_t>>(
+            PREFIXLENGTH_STR)}};
+
+constexpr PropertyTable LEGACY_ETHERNET_TABLE{
+    "Ethernet",
+    std::array{
+        property<&LegacyEthernet::method_, AnyEnum<Ethernet::Method>>(
+            METHOD_STR),
+        property<&LegacyEthernet::interface_, Codec<std::string>>(
+            INTERFACE_STR),
+        property<&LegacyEthernet::address_, Codec<std::string>>(ADDRESS_STR),
+        property<&LegacyEthernet::mtu_, Codec<uint16_t>>(MTU_STR)}};
+
+constexpr PropertyTable LEGACY_PROVIDER_TABLE{
+    "Provider",
+    std::array{
+        property<&LegacyProvider::host_, Codec<std::string>>(HOST_STR),
+        property<&LegacyProvider::domain_, Codec<std::string>>(DOMAIN_STR),
+        property<&LegacyProvider::name_, Codec<std::string>>(NAME_STR),
+        property<&LegacyProvider::type_, Codec<std::string>>(TYPE_STR)}};
+
+constexpr PropertyTable LEGACY_PROXY_TABLE{
+    "Proxy",
+    std::array{
+        property<&LegacyProxy::method_, AnyEnum<Proxy::Method>>(METHOD_STR),
+        property<&LegacyProxy::url_, Codec<std::string>>(URL_STR),
+        property<&LegacyProxy::servers_, Strings>(SERVERS_STR),
+        property<&LegacyProxy::excludes_, Strings>(EXCLUDES_STR)}};
+
+LegacyIPv4::LegacyIPv4(GVariant* variant) {
+    LEGACY_IPV4_TABLE.parse(*this, variant);
+}
+
+LegacyIPv6::LegacyIPv6(GVariant* variant) {
+    LEGACY_IPV6_TABLE.parse(*this, variant);
+}
+
+LegacyEthernet::LegacyEthernet(GVariant* variant) {
+    LEGACY_ETHERNET_TABLE.parse(*this, variant);
+}
+
+LegacyProvider::LegacyProvider(GVariant* variant) {
+    LEGACY_PROVIDER_TABLE.parse(*this, variant);
+}
+
+LegacyProxy::LegacyProxy(GVariant* variant) {
+    LEGACY_PROXY_TABLE.parse(*this, variant);
+}
+
+using Legacy = LegacyServProperties;
+
+constexpr PropertyTable LEGACY_TABLE{
+    "Service",
+    std::array{
+        property<&Legacy::name_, Codec<std::string>>(NAME_STR),
+        property<&Legacy::type_, AnyEnum<Legacy::Type>>(TYPE_STR),
+        property<&Legacy::state_, AnyEnum<Legacy::State>>(STATE_STR),
+        property<&Legacy::error_, AnyEnum<Legacy::Error>>(ERROR_STR),
+        property<&Legacy::favorite_, Codec<bool>>(FAVORITE_STR),
+        property<&Legacy::immutable_, Codec<bool>>(IMMUTABLE_STR),
+        property<&Legacy::autoconnect_, Codec<bool>>(AUTOCONNECT_STR),
+        property<&Legacy::mdns_, Codec<bool>>(MDNS_STR),
+        property<&Legacy::strength_, Codec<uint8_t>>(STRENGTH_STR),
+        property<&Legacy::ipv4_, Dict<LegacyIPv4>>(IPV4_STR),
+        property<&Legacy::ipv6_, Dict<LegacyIPv6>>(IPV6_STR),
+        property<&Legacy::ethernet_, Dict<LegacyEthernet>>(ETHERNET_STR),
+        property<&Legacy::provider_, Dict<LegacyProvider>>(PROVIDER_STR),
+        property<&Legacy::proxy_, Dict<LegacyProxy>>(PROXY_STR),
+        property<&Legacy::security_,
+                 NonEmpty<ArrayCodec<AnyEnum<Legacy::Security>>>>(
+            SECURITY_STR),
+        property<&Legacy::name_servers_, NonEmpty<Strings>>(NAMESERVERS_STR),
+        property<&Legacy::name_servers_conf_, NonEmpty<Strings>>(
+            NAMESERVERS_CONFIGURATION_STR),
+        property<&Legacy::domains_, NonEmpty<Strings>>(DOMAINS_STR),
+        property<&Legacy::time_servers_, NonEmpty<Strings>>(TIMESERVERS_STR)}};
+
+/*
+ * ServicesChanged payload recorded on a busy access point scan: 300 services
+ * with their properties, the way a Manager caches them at start.
+ */
+auto service_dicts() -> const std::vector<VariantPtr>& {
+    static const std::vector<VariantPtr> dicts = [] {
+        std::vector<VariantPtr> result;
+        gchar* text = nullptr;
+        if (g_file_get_contents(SERVICES_CHANGED_PAYLOAD, &text, nullptr,
+                                nullptr) == 0) {
+            return result;
+        }
+        VariantPtr parsed{
+            g_variant_parse(G_VARIANT_TYPE("(a(oa{sv})ao)"), text, nullptr,
+                            nullptr, nullptr),
+            &g_variant_unref};
+        g_free(text);
+        if (!parsed) {
+            return result;
+        }
+        VariantPtr changed{g_variant_get_child_value(parsed.get(), 0),
+                           &g_variant_unref};
+        for (std::size_t i = 0; i < g_variant_n_children(changed.get());
+             ++i) {
+            VariantPtr item{g_variant_get_child_value(changed.get(), i),
+                            &g_variant_unref};
+            result.emplace_back(g_variant_get_child_value(item.get(), 1),
+                                &g_variant_unref);
+        }
+        return result;
+    }();
+    return dicts;
+}
+
+void parse(LegacyServProperties& properties, GVariant* dict) {
+    LEGACY_TABLE.parse(properties, dict);
+}
+
+void parse(ServProperties& properties, GVariant* dict) {
+    PropertyDescriptors<PackedLayout>::parse(properties, dict);
+}
+
+/*
+ * Decodes every service of the payload and reports what one service takes:
+ * its sizeof plus the heap it owns.
+ */
+template <class Properties>
+void decode_services(benchmark::State& state) {
+    const auto& dicts = service_dicts();
+    if (dicts.empty()) {
+        state.SkipWithError("Cannot load " SERVICES_CHANGED_PAYLOAD);
+        return;
+    }
+
+    std::size_t owned_bytes = 0;
+    for (auto _ : state) {
+        std::vector<Properties> services(dicts.size());
+        const auto before = live_bytes;
+        for (std::size_t i = 0; i < dicts.size(); ++i) {
+            parse(services[i], dicts[i].get());
+        }
+        owned_bytes = live_bytes - before;
+        benchmark::DoNotOptimize(services.data());
+    }
+
+    const auto services = static_cast<double>(dicts.size());
+    state.counters["sizeof"] = sizeof(Properties);
+    state.counters["bytes_per_service"] =
+        sizeof(Properties) + static_cast<double>(owned_bytes) / services;
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<int64_t>(dicts.size()));
+}
+
+void BM_ServicePropertiesLegacyLayout(benchmark::State& state) {
+    decode_services<LegacyServProperties>(state);
+}
+BENCHMARK(BM_ServicePropertiesLegacyLayout);
+
+void BM_ServicePropertiesPackedLayout(benchmark::State& state) {
+    decode_services<ServProperties>(state);
+}
+BENCHMARK(BM_ServicePropertiesPackedLayout);
+
+}  // namespace
@@ -0,0 +1,93 @@
+#include <benchmark/benchmark.h>
+
+#include <amarula/dbus/connman/gconnman.hpp>
+#include <amarula/dbus/connman/gservice.hpp>
+#include <amarula/dbus/connman/gservicetable.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+using Amarula::DBus::G::Connman::Connman;
+using Amarula::DBus::G::Connman::Manager;
+using Amarula::DBus::G::Connman::ServiceTable;
+using State = Amarula::DBus::G::Connman::ServProperties::State;
+
+namespace {
+
+constexpr int SERVICES_TIMEOUT_MS = 5000;
+constexpr uint8_t MIN_STRENGTH = 50U;
+
+/*
+ * Both benchmarks answer the same question, "how many services are online with
+ * a usable signal", over the service list of the running connmand.
+ */
+auto manager() -> std::shared_ptr<Manager> {
+    static std::mutex mtx;
+    static std::condition_variable services_cv;
+    static bool ready = false;
+    static const Connman connman;
+
+    static const auto shared_manager = [] {
+        auto mgr = connman.manager();
+        mgr->onServicesChanged([](const auto& /*services*/) {
+            {
+                std::lock_guard<std::mutex> const lock(mtx);
+                ready = true;
+            }
+            services_cv.notify_all();
+        });
+        std::unique_lock<std::mutex> lock(mtx);
+        services_cv.wait_for(lock,
+                             std::chrono::milliseconds(SERVICES_TIMEOUT_MS),
+                             [] { return ready; });
+        return mgr;
+    }();
+
+    return shared_manager;
+}
+
+void BM_ServicesPropertiesLoop(benchmark::State& state) {
+    const auto mgr = manager();
+    if (mgr->services().empty()) {
+        state.SkipWithError("No connman services available");
+        return;
+    }
+
+    for (auto _ : state) {
+        std::size_t online = 0;
+        for (const auto& service : mgr->services()) {
+            const auto props = service->properties();
+            if (props.getState() == State::Online &&
+                props.getStrength() >= MIN_STRENGTH) {
+                ++online;
+            }
+        }
+        benchmark::DoNotOptimize(online);
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<int64_t>(mgr->services().size()));
+}
+BENCHMARK(BM_ServicesPropertiesLoop);
+
+void BM_ServiceTableScan(benchmark::State& state) {
+    const auto mgr = manager();
+    if (mgr->services().empty()) {
+        state.SkipWithError("No connman services available");
+        return;
+    }
+
+    for (auto _ : state) {
+        const auto table = mgr->serviceTable();
+        const auto online = ServiceTable::count(
+            ServiceTable::all(table.matchState(State::Online),
+                              table.matchStrengthAtLeast(MIN_STRENGTH)));
+        benchmark::DoNotOptimize(online);
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<int64_t>(mgr->services().size()));
+}
+BENCHMARK(BM_ServiceTableScan);
+
+}  // namespace
@@ -0,0 +1,345 @@
+#include <benchmark/benchmark.h>
+#include <glib.h>
+
+#include <amarula/dbus/gvariant_view.hpp>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gconnman_services_changed.hpp"
+#include "gconnman_signal_arena.hpp"
+#include "gdbus_private.hpp"
+
+/*
+ * Counts every heap allocation of the decoders, GLib's included: malloc and
+ * friends are interposed here and forward to glibc. GLib before 2.76 keeps
+ * GVariants in GSlice magazines instead, so run with G_SLICE=always-malloc
+ * there for the counts to mean anything.
+ */
+namespace {
+std::atomic<std::size_t> allocations{0U};
+}  // namespace
+
+extern "C" {
+// NOLINTBEGIN(readability-identifier-naming)
+auto __libc_malloc(std::size_t size) -> void*;
+auto __libc_calloc(std::size_t count, std::size_t size) -> void*;
+auto __libc_realloc(void* ptr, std::size_t size) -> void*;
+auto __libc_memalign(std::size_t alignment, std::size_t size) -> void*;
+
+auto malloc(std::size_t size) -> void* {
+    allocations.fetch_add(1U, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+auto calloc(std::size_t count, std::size_t size) -> void* {
+    allocations.fetch_add(1U, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+auto realloc(void* ptr, std::size_t size) -> void* {
+    allocations.fetch_add(1U, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+// The aligned operator new and std::pmr::new_delete_resource() end up here.
+auto aligned_alloc(std::size_t alignment, std::size_t size) -> void* {
+    allocations.fetch_add(1U, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+auto posix_memalign(void** ptr, std::size_t alignment, std::size_t size)
+    -> int {
+    allocations.fetch_add(1U, std::memory_order_relaxed);
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr != nullptr ? 0 : ENOMEM;
+}
+// NOLINTEND(readability-identifier-naming)
+}
+
+using Amarula::DBus::G::VariantPtr;
+using Amarula::DBus::G::VariantView;
+using Amarula::DBus::G::Connman::decode_services_changed;
+using Amarula::DBus::G::Connman::decode_services_changed_in_place;
+using Amarula::DBus::G::Connman::SignalArena;
+
+namespace {
+
+void report_allocations(benchmark::State& state, std::size_t before) {
+    state.counters["allocs_per_signal"] = benchmark::Counter(
+        static_cast<double>(allocations.load() - before),
+        benchmark::Counter::kAvgIterations);
+}
+
+/*
+ * ServicesChanged payload recorded on a busy access point scan: 300 services,
+ * of which only a handful carry changed properties and the rest are listed
+ * only to give the new order.
+ */
+auto payload() -> GVariant* {
+    static GVariant* const signal = [] {
+        gchar* text = nullptr;
+        GError* error = nullptr;
+        if (g_file_get_contents(SERVICES_CHANGED_PAYLOAD, &text, nullptr,
+                                &error) == 0) {
+            g_error_free(error);
+            return static_cast<GVariant*>(nullptr);
+        }
+        VariantPtr parsed{
+            g_variant_parse(G_VARIANT_TYPE("(a(oa{sv})ao)"), text, nullptr,
+                            nullptr, nullptr),
+            &g_variant_unref};
+        g_free(text);
+        if (!parsed) {
+            return static_cast<GVariant*>(nullptr);
+        }
+        // Serialised, as DBus::setFlatSignals() leaves signal parameters.
+        GBytes* bytes = g_variant_get_data_as_bytes(parsed.get());
+        GVariant* flat = g_variant_ref_sink(g_variant_new_from_bytes(
+            G_VARIANT_TYPE("(a(oa{sv})ao)"), bytes, 1));
+        g_bytes_unref(bytes);
+        return flat;
+    }();
+    return signal;
+}
+
+/*
+ * value rebuilt the way GDBus parses a message body: containers made of
+ * their children, only basic values and byte arrays serialised. Returns a
+ * full reference.
+ */
+auto as_tree(GVariant* value) -> GVariant* {
+    const auto* type = g_variant_get_type(value);
+    if (g_variant_is_container(value) == 0 ||
+        g_variant_type_equal(type, G_VARIANT_TYPE_BYTESTRING) != 0) {
+        return g_variant_ref(value);
+    }
+    std::vector<GVariant*> children(g_variant_n_children(value));
+    for (std::size_t i = 0; i < children.size(); ++i) {
+        GVariant* child = g_variant_get_child_value(value, i);
+        children[i] = as_tree(child);
+        g_variant_unref(child);
+    }
+    GVariant* tree = nullptr;
+    if (g_variant_type_is_variant(type) != 0) {
+        tree = g_variant_new_variant(children[0]);
+    } else if (g_variant_type_is_array(type) != 0) {
+        tree = g_variant_new_array(g_variant_type_element(type),
+                                   children.data(), children.size());
+    } else if (g_variant_type_is_dict_entry(type) != 0) {
+        tree = g_variant_new_dict_entry(children[0], children[1]);
+    } else {
+        tree = g_variant_new_tuple(children.data(), children.size());
+    }
+    for (auto* child : children) {
+        g_variant_unref(child);
+    }
+    return g_variant_ref_sink(tree);
+}
+
+auto services_in(GVariant* parameters) -> int64_t {
+    GVariant* changed = g_variant_get_child_value(parameters, 0);
+    const auto services = static_cast<int64_t>(g_variant_n_children(changed));
+    g_variant_unref(changed);
+    return services;
+}
+
+/*
+ * Runs handle(parameters) on a fresh tree of the payload per iteration, as
+ * every signal arrives: serialising is done in place and would stick.
+ */
+template <class Handler>
+void on_fresh_trees(benchmark::State& state, Handler handle) {
+    auto* parameters = payload();
+    if (parameters == nullptr) {
+        state.SkipWithError("Cannot load " SERVICES_CHANGED_PAYLOAD);
+        return;
+    }
+
+    std::size_t handled = 0U;
+    for (auto _ : state) {
+        state.PauseTiming();
+        VariantPtr tree{as_tree(parameters), &g_variant_unref};
+        state.ResumeTiming();
+        const auto before = allocations.load();
+        handle(tree.get());
+        handled += allocations.load() - before;
+        state.PauseTiming();
+        tree.reset();
+        state.ResumeTiming();
+    }
+    report_allocations(state, allocations.load() - handled);
+    state.SetItemsProcessed(state.iterations() * services_in(parameters));
+}
+
+/*
+ * What Manager::on_services_changed_cb did before the fast path: a child
+ * variant, a path copy and a properties reference for every entry.
+ */
+auto decode_copying(GVariant* parameters)
+    -> std::pair<std::vector<std::pair<std::string, VariantPtr>>,
+                 std::vector<std::string>> {
+    std::vector<std::pair<std::string, VariantPtr>> services_changed;
+    std::vector<std::string> services_removed;
+
+    GVariant* changed = g_variant_get_child_value(parameters, 0);
+    GVariant* removed = g_variant_get_child_value(parameters, 1);
+
+    GVariantIter iter;
+    g_variant_iter_init(&iter, changed);
+    GVariant* item = nullptr;
+    while ((item = g_variant_iter_next_value(&iter)) != nullptr) {
+        GVariant* path_variant = g_variant_get_child_value(item, 0);
+        services_changed.emplace_back(
+            g_variant_get_string(path_variant, nullptr),
+            VariantPtr{g_variant_get_child_value(item, 1), &g_variant_unref});
+        g_variant_unref(path_variant);
+        g_variant_unref(item);
+    }
+    g_variant_unref(changed);
+
+    GVariantIter iter_removed;
+    g_variant_iter_init(&iter_removed, removed);
+    while ((item = g_variant_iter_next_value(&iter_removed)) != nullptr) {
+        services_removed.emplace_back(g_variant_get_string(item, nullptr));
+        g_variant_unref(item);
+    }
+    g_variant_unref(removed);
+
+    return {std::move(services_changed), std::move(services_removed)};
+}
+
+void BM_ServicesChangedCopying(benchmark::State& state) {
+    auto* parameters = payload();
+    if (parameters == nullptr) {
+        state.SkipWithError("Cannot load " SERVICES_CHANGED_PAYLOAD);
+        return;
+    }
+
+    std::size_t services = 0;
+    const auto before = allocations.load();
+    for (auto _ : state) {
+        auto decoded = decode_copying(parameters);
+        services = decoded.first.size();
+        benchmark::DoNotOptimize(decoded);
+    }
+    report_allocations(state, before);
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<int64_t>(services));
+}
+BENCHMARK(BM_ServicesChangedCopying);
+
+void BM_ServicesChangedBorrowing(benchmark::State& state) {
+    auto* parameters = payload();
+    if (parameters == nullptr) {
+        state.SkipWithError("Cannot load " SERVICES_CHANGED_PAYLOAD);
+        return;
+    }
+
+    std::size_t services = 0;
+    const auto before = allocations.load();
+    for (auto _ : state) {
+        auto decoded = decode_services_changed(parameters);
+        services = decoded.changed.size();
+        benchmark::DoNotOptimize(decoded);
+    }
+    report_allocations(state, before);
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<int64_t>(services));
+}
+BENCHMARK(BM_ServicesChangedBorrowing);
+
+// The Manager path: borrowed paths, lists in a SignalArena reused per signal.
+void BM_ServicesChangedArena(benchmark::State& state) {
+    auto* parameters = payload();
+    if (parameters == nullptr) {
+        state.SkipWithError("Cannot load " SERVICES_CHANGED_PAYLOAD);
+        return;
+    }
+
+    SignalArena arena;
+    std::size_t services = 0;
+    const auto before = allocations.load();
+    for (auto _ : state) {
+        const SignalArena::Scope scope(arena);
+        auto decoded = decode_services_changed(parameters, arena.resource());
+        services = decoded.changed.size();
+        benchmark::DoNotOptimize(decoded);
+    }
+    report_allocations(state, before);
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<int64_t>(services));
+}
+BENCHMARK(BM_ServicesChangedArena);
+
+// The Manager path on a tree, as GDBus hands over signals that are not flat.
+void BM_ServicesChangedArenaTree(benchmark::State& state) {
+    SignalArena arena;
+    on_fresh_trees(state, [&arena](GVariant* parameters) {
+        const SignalArena::Scope scope(arena);
+        auto decoded = decode_services_changed(parameters, arena.resource());
+        benchmark::DoNotOptimize(decoded);
+    });
+}
+BENCHMARK(BM_ServicesChangedArenaTree);
+
+/*
+ * The D-Bus thread share of a signal, with each dict looked at in place the
+ * way Service::applyProperties() starts. Without flat signals GDBus hands
+ * over a tree and every dict gets serialised on its own there.
+ */
+void BM_ServicesChangedTreeOnDBusThread(benchmark::State& state) {
+    SignalArena arena;
+    on_fresh_trees(state, [&arena](GVariant* parameters) {
+        const SignalArena::Scope scope(arena);
+        auto decoded = decode_services_changed(parameters, arena.resource());
+        for (const auto& entry : decoded.changed) {
+            if (entry.properties) {
+                benchmark::DoNotOptimize(
+                    VariantView::of(entry.properties.get()).size());
+            }
+        }
+    });
+}
+BENCHMARK(BM_ServicesChangedTreeOnDBusThread);
+
+// What the signal filter adds on the GDBus worker thread.
+void BM_ServicesChangedFlattenOnWorker(benchmark::State& state) {
+    on_fresh_trees(state, [](GVariant* parameters) {
+        benchmark::DoNotOptimize(g_variant_get_data(parameters));
+    });
+}
+BENCHMARK(BM_ServicesChangedFlattenOnWorker);
+
+// The D-Bus thread share once flattened: the dicts are already serialised.
+void BM_ServicesChangedInPlaceOnDBusThread(benchmark::State& state) {
+    auto* parameters = payload();
+    if (parameters == nullptr) {
+        state.SkipWithError("Cannot load " SERVICES_CHANGED_PAYLOAD);
+        return;
+    }
+
+    SignalArena arena;
+    const auto before = allocations.load();
+    for (auto _ : state) {
+        const SignalArena::Scope scope(arena);
+        auto decoded =
+            decode_services_changed_in_place(parameters, arena.resource());
+        for (const auto& entry : decoded->changed) {
+            if (entry.properties) {
+                benchmark::DoNotOptimize(
+                    VariantView::of(entry.properties.get()).size());
+            }
+        }
+    }
+    report_allocations(state, before);
+    state.SetItemsProcessed(state.iterations() * services_in(parameters));
+}
+BENCHMARK(BM_ServicesChangedInPlaceOnDBusThread);
+
+}  // namespace
@@ -0,0 +1,112 @@
+#include <benchmark/benchmark.h>
+
+#include <amarula/dbus/connman/gservice.hpp>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "gdbus_private.hpp"
+
+using Amarula::DBus::G::EnumStringMap;
+using Error = Amarula::DBus::G::Connman::ServProperties::Error;
+
+namespace {
+
+/*
+ * EnumStringMap::fromString() as it was before the perfect hash: a string
+ * comparison per entry, and an exception for strings it does not know.
+ */
+template <typename Enum, std::size_t N>
+class LinearEnumStringMap {
+   public:
+    using Pair = std::pair<Enum, std::string_view>;
+
+    constexpr explicit LinearEnumStringMap(const std::array<Pair, N>& init)
+        : data_{init} {}
+
+    [[nodiscard]] constexpr auto fromString(std::string_view str) const
+        -> Enum {
+        for (auto&& [e, s] : data_) {
+            if (s == str) {
+                return e;
+            }
+        }
+        throw std::runtime_error("Invalid string value");
+    }
+
+   private:
+    std::array<Pair, N> data_;
+};
+
+// The largest map of the library, with the same entries.
+constexpr std::array<std::pair<Error, std::string_view>, 10> ERROR_ENTRIES{
+    {{Error::None, ""},
+     {Error::OutOfRange, "out-of-range"},
+     {Error::PinMissing, "pin-missing"},
+     {Error::DhcpFailed, "dhcp-failed"},
+     {Error::ConnectFailed, "connect-failed"},
+     {Error::LoginFailed, "login-failed"},
+     {Error::AuthFailed, "auth-failed"},
+     {Error::InvalidKey, "invalid-key"},
+     {Error::Blocked, "blocked"},
+     {Error::OnlineCheckFailed, "online-check-failed"}}};
+
+constexpr LinearEnumStringMap<Error, 10> LINEAR_MAP{ERROR_ENTRIES};
+constexpr EnumStringMap<Error, 10> HASHED_MAP{ERROR_ENTRIES};
+
+// Every known string once, in table order, the way updates come in.
+void BM_EnumFromStringLinear(benchmark::State& state) {
+    for (auto _ : state) {
+        for (const auto& entry : ERROR_ENTRIES) {
+            auto name = entry.second;
+            benchmark::DoNotOptimize(name);
+            benchmark::DoNotOptimize(LINEAR_MAP.fromString(name));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<int64_t>(ERROR_ENTRIES.size()));
+}
+BENCHMARK(BM_EnumFromStringLinear);
+
+void BM_EnumFromStringHashed(benchmark::State& state) {
+    for (auto _ : state) {
+        for (const auto& entry : ERROR_ENTRIES) {
+            auto name = entry.second;
+            benchmark::DoNotOptimize(name);
+            benchmark::DoNotOptimize(HASHED_MAP.fromString(name));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<int64_t>(ERROR_ENTRIES.size()));
+}
+BENCHMARK(BM_EnumFromStringHashed);
+
+// A string newer connman versions send: the old map threw on every one.
+constexpr std::string_view UNKNOWN_ERROR = "captive-portal-failed";
+
+void BM_EnumFromStringUnknownLinear(benchmark::State& state) {
+    for (auto _ : state) {
+        auto name = UNKNOWN_ERROR;
+        benchmark::DoNotOptimize(name);
+        try {
+            benchmark::DoNotOptimize(LINEAR_MAP.fromString(name));
+        } catch (const std::runtime_error&) {
+            benchmark::DoNotOptimize(Error::Unknown);
+        }
+    }
+}
+BENCHMARK(BM_EnumFromStringUnknownLinear);
+
+void BM_EnumFromStringUnknownHashed(benchmark::State& state) {
+    for (auto _ : state) {
+        auto name = UNKNOWN_ERROR;
+        benchmark::DoNotOptimize(name);
+        benchmark::DoNotOptimize(
+            HASHED_MAP.fromString(name).value_or(Error::Unknown));
+    }
+}
+BENCHMARK(BM_EnumFromStringUnknownHashed);
+
+}  // namespace
@@ -0,0 +1,223 @@
+#include <benchmark/benchmark.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <malloc.h>
+
+#include <amarula/dbus/gdbus.hpp>
+#include <amarula/dbus/gproxy.hpp>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+/*
+ * Method calls and proxies of the message bus itself, so that no connman is
+ * needed: GetId is about the cheapest call there is, which leaves the client
+ * side path as the measured part. Needs a bus at DBUS_SYSTEM_BUS_ADDRESS,
+ * e.g. a private dbus-daemon:
+ *
+ *     DBUS_SYSTEM_BUS_ADDRESS=$(dbus-daemon --session --fork --print-address)
+ */
+
+using Amarula::DBus::G::DBus;
+using Amarula::DBus::G::DBusProxy;
+using Amarula::DBus::G::TransportKind;
+
+namespace {
+
+constexpr const char* BUS_NAME = "org.freedesktop.DBus";
+constexpr const char* BUS_PATH = "/org/freedesktop/DBus";
+constexpr const char* BUS_INTERFACE = "org.freedesktop.DBus";
+constexpr std::size_t PROXY_COUNT = 200;
+
+struct NoProperties {
+    void update(const gchar* /*key*/, GVariant* /*value*/) {}
+};
+
+// The library path: callMethod() on a DBusProxy.
+class BusProxy : public DBusProxy<NoProperties> {
+   public:
+    explicit BusProxy(DBus* dbus)
+        : DBusProxy(dbus, BUS_NAME, BUS_PATH, BUS_INTERFACE) {}
+
+    void getId(PropertiesSetCallback callback) {
+        auto data = prepareCallback(std::move(callback));
+        callMethod(nullptr, "GetId", nullptr, &BusProxy::finishAsyncCall,
+                   data.release());
+    }
+};
+
+auto bus() -> DBus* {
+    static const auto dbus = []() -> std::unique_ptr<DBus> {
+        // One arena, so that mallinfo2() sees the D-Bus thread too.
+        mallopt(M_ARENA_MAX, 1);
+        try {
+            // GDBus, for the GIO calls below to share its connection.
+            return std::make_unique<DBus>(BUS_NAME, BUS_PATH,
+                                          TransportKind::GDBus);
+        } catch (const std::runtime_error&) {
+            return nullptr;
+        }
+    }();
+    return dbus.get();
+}
+
+auto heap_in_use() -> std::size_t { return mallinfo2().uordblks; }
+
+// What every DBusProxy used to wrap: a GDBusProxy with default flags.
+auto new_gdbus_proxy(DBus* dbus) -> GDBusProxy* {
+    return g_dbus_proxy_new_sync(dbus->connection(), G_DBUS_PROXY_FLAGS_NONE,
+                                 nullptr, BUS_NAME, BUS_PATH, BUS_INTERFACE,
+                                 nullptr, nullptr);
+}
+
+struct PendingCall {
+    gpointer target;
+    std::promise<void> done;
+};
+
+/*
+ * One GetId from the D-Bus thread, as DBusProxy issues its calls, waiting
+ * for the reply. Call is the GAsyncReadyCallback-taking call function of
+ * target and Finish its finish function.
+ */
+template <auto Call, auto Finish>
+void call_get_id(DBus* dbus, gpointer target) {
+    PendingCall call{target, {}};
+    auto done = call.done.get_future();
+    g_main_context_invoke(
+        dbus->context(),
+        [](gpointer user_data) -> gboolean {
+            auto* call = static_cast<PendingCall*>(user_data);
+            Call(call->target,
+                 [](GObject* source, GAsyncResult* res, gpointer data) {
+                     GVariant* ret = Finish(source, res);
+                     if (ret != nullptr) {
+                         g_variant_unref(ret);
+                     }
+                     static_cast<PendingCall*>(data)->done.set_value();
+                 },
+                 call);
+            return G_SOURCE_REMOVE;
+        },
+        &call);
+    done.wait();
+}
+
+void proxy_call(gpointer proxy, GAsyncReadyCallback callback,
+                gpointer user_data) {
+    g_dbus_proxy_call(G_DBUS_PROXY(proxy), "GetId", nullptr,
+                      G_DBUS_CALL_FLAGS_NONE, -1, nullptr, callback,
+                      user_data);
+}
+
+auto proxy_finish(GObject* source, GAsyncResult* res) -> GVariant* {
+    return g_dbus_proxy_call_finish(G_DBUS_PROXY(source), res, nullptr);
+}
+
+void connection_call(gpointer connection, GAsyncReadyCallback callback,
+                     gpointer user_data) {
+    g_dbus_connection_call(G_DBUS_CONNECTION(connection), BUS_NAME, BUS_PATH,
+                           BUS_INTERFACE, "GetId", nullptr, nullptr,
+                           G_DBUS_CALL_FLAGS_NONE, -1, nullptr, callback,
+                           user_data);
+}
+
+auto connection_finish(GObject* source, GAsyncResult* res) -> GVariant* {
+    return g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res,
+                                         nullptr);
+}
+
+// The transport DBusProxy used to call through.
+void BM_GDBusProxyCall(benchmark::State& state) {
+    auto* dbus = bus();
+    if (dbus == nullptr) {
+        state.SkipWithError("No bus at DBUS_SYSTEM_BUS_ADDRESS");
+        return;
+    }
+    GDBusProxy* proxy = new_gdbus_proxy(dbus);
+    for (auto _ : state) {
+        call_get_id<proxy_call, proxy_finish>(dbus, proxy);
+    }
+    g_object_unref(proxy);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GDBusProxyCall)->UseRealTime();
+
+// The transport it calls through now.
+void BM_ConnectionCall(benchmark::State& state) {
+    auto* dbus = bus();
+    if (dbus == nullptr) {
+        state.SkipWithError("No bus at DBUS_SYSTEM_BUS_ADDRESS");
+        return;
+    }
+    for (auto _ : state) {
+        call_get_id<connection_call, connection_finish>(dbus,
+                                                        dbus->connection());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ConnectionCall)->UseRealTime();
+
+// The whole library path, callback bookkeeping included.
+void BM_DBusProxyCall(benchmark::State& state) {
+    auto* dbus = bus();
+    if (dbus == nullptr) {
+        state.SkipWithError("No bus at DBUS_SYSTEM_BUS_ADDRESS");
+        return;
+    }
+    auto proxy = std::make_shared<BusProxy>(dbus);
+
+    for (auto _ : state) {
+        std::promise<void> done;
+        auto finished = done.get_future();
+        proxy->getId([&done](bool /*success*/) { done.set_value(); });
+        finished.wait();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DBusProxyCall)->UseRealTime();
+
+// Creation time and heap bytes of PROXY_COUNT proxies of the same object.
+template <class Create, class Destroy>
+void create_proxies(benchmark::State& state, Create create, Destroy destroy) {
+    auto* dbus = bus();
+    if (dbus == nullptr) {
+        state.SkipWithError("No bus at DBUS_SYSTEM_BUS_ADDRESS");
+        return;
+    }
+
+    std::size_t bytes = 0;
+    for (auto _ : state) {
+        std::vector<decltype(create(dbus))> proxies;
+        proxies.reserve(PROXY_COUNT);
+        const auto before = heap_in_use();
+        for (std::size_t i = 0; i < PROXY_COUNT; ++i) {
+            proxies.push_back(create(dbus));
+        }
+        bytes = heap_in_use() - before;
+        for (auto& proxy : proxies) {
+            destroy(proxy);
+        }
+    }
+    state.counters["bytes_per_proxy"] =
+        static_cast<double>(bytes) / static_cast<double>(PROXY_COUNT);
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<int64_t>(PROXY_COUNT));
+}
+
+void BM_GDBusProxyCreate(benchmark::State& state) {
+    create_proxies(state, new_gdbus_proxy,
+                   [](GDBusProxy* proxy) { g_object_unref(proxy); });
+}
+BENCHMARK(BM_GDBusProxyCreate)->UseRealTime();
+
+void BM_DBusProxyCreate(benchmark::State& state) {
+    create_proxies(
+        state, [](DBus* dbus) { return std::make_shared<BusProxy>(dbus); },
+        [](std::shared_ptr<BusProxy>& proxy) { proxy.reset(); });
+}
+BENCHMARK(BM_DBusProxyCreate)->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,198 @@
+#include <benchmark/benchmark.h>
+#include <gio/gio.h>
+#include <glib.h>
+
+#include <amarula/dbus/gdbus.hpp>
+#include <amarula/dbus/gtransport.hpp>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <stdexcept>
+
+/*
+ * The GDBus and sd-bus transports side by side, on the message bus itself
+ * and on a peer connection of this process, so that no connman is needed.
+ * Needs a bus at DBUS_SYSTEM_BUS_ADDRESS, e.g. a private dbus-daemon:
+ *
+ *     DBUS_SYSTEM_BUS_ADDRESS=$(dbus-daemon --session --fork --print-address)
+ *
+ * The sd-bus cases are skipped unless built with DBUS_SD_BUS.
+ */
+
+using Amarula::DBus::G::DBus;
+using Amarula::DBus::G::Transport;
+using Amarula::DBus::G::TransportKind;
+
+namespace {
+
+constexpr const char* BUS_NAME = "org.freedesktop.DBus";
+constexpr const char* BUS_PATH = "/org/freedesktop/DBus";
+constexpr const char* PEER_PATH = "/net/connman";
+constexpr const char* PEER_INTERFACE = "net.connman.Manager";
+
+// One DBus per transport, made on first use.
+auto bus(TransportKind kind) -> DBus* {
+    static std::array<std::unique_ptr<DBus>, 2> buses;
+    auto& dbus = buses.at(static_cast<std::size_t>(kind));
+    if (!dbus && Transport::available(kind)) {
+        try {
+            dbus = std::make_unique<DBus>(BUS_NAME, BUS_PATH, kind);
+        } catch (const std::runtime_error&) {
+            return nullptr;
+        }
+    }
+    return dbus.get();
+}
+
+auto skip(benchmark::State& state, TransportKind kind) -> DBus* {
+    if (!Transport::available(kind)) {
+        state.SkipWithError("Transport not built in");
+        return nullptr;
+    }
+    auto* dbus = bus(kind);
+    if (dbus == nullptr) {
+        state.SkipWithError("No bus at DBUS_SYSTEM_BUS_ADDRESS");
+    }
+    return dbus;
+}
+
+// The connection connman would send from.
+auto peer() -> GDBusConnection* {
+    static GDBusConnection* const connection =
+        g_dbus_connection_new_for_address_sync(
+            g_getenv("DBUS_SYSTEM_BUS_ADDRESS"),
+            static_cast<GDBusConnectionFlags>(
+                G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+            nullptr, nullptr, nullptr);
+    return connection;
+}
+
+// The ServicesChanged payload recorded on a busy access point scan.
+auto payload() -> GVariant* {
+    static GVariant* const signal = [] {
+        gchar* text = nullptr;
+        if (g_file_get_contents(SERVICES_CHANGED_PAYLOAD, &text, nullptr,
+                                nullptr) == 0) {
+            return static_cast<GVariant*>(nullptr);
+        }
+        GVariant* parsed = g_variant_parse(G_VARIANT_TYPE("(a(oa{sv})ao)"),
+                                           text, nullptr, nullptr, nullptr);
+        g_free(text);
+        return parsed != nullptr ? g_variant_ref_sink(parsed) : nullptr;
+    }();
+    return signal;
+}
+
+// Runs function on the D-Bus thread of dbus and waits for it.
+template <class Function>
+void on_dbus_thread(DBus* dbus, Function function) {
+    struct Task {
+        Function function;
+        std::promise<void> done;
+    } task{function, {}};
+    auto finished = task.done.get_future();
+    g_main_context_invoke(
+        dbus->context(),
+        [](gpointer user_data) -> gboolean {
+            auto* task = static_cast<Task*>(user_data);
+            task->function();
+            task->done.set_value();
+            return G_SOURCE_REMOVE;
+        },
+        &task);
+    finished.wait();
+}
+
+// GetId from the D-Bus thread, waiting for the reply, as DBusProxy calls.
+void get_id(DBus* dbus) {
+    std::promise<void> replied;
+    auto reply = replied.get_future();
+    on_dbus_thread(dbus, [&]() {
+        dbus->transport().call(
+            BUS_NAME, BUS_PATH, BUS_NAME, "GetId", nullptr, nullptr,
+            [](GVariant* /*reply*/, const GError* /*error*/,
+               gpointer user_data) {
+                static_cast<std::promise<void>*>(user_data)->set_value();
+            },
+            &replied);
+    });
+    reply.wait();
+}
+
+void BM_Call(benchmark::State& state, TransportKind kind) {
+    auto* dbus = skip(state, kind);
+    if (dbus == nullptr) {
+        return;
+    }
+    for (auto _ : state) {
+        get_id(dbus);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_Call, gdbus, TransportKind::GDBus)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Call, sd_bus, TransportKind::SdBus)->UseRealTime();
+
+/*
+ * A 300 service ServicesChanged from the peer to its handler, decoding
+ * included, flat as the Manager asks for it.
+ */
+void BM_ServicesChangedSignal(benchmark::State& state, TransportKind kind) {
+    auto* dbus = skip(state, kind);
+    if (dbus == nullptr) {
+        return;
+    }
+    auto* connection = peer();
+    auto* parameters = payload();
+    if (connection == nullptr || parameters == nullptr) {
+        state.SkipWithError("No peer connection or payload");
+        return;
+    }
+
+    struct Received {
+        std::atomic<std::size_t> count{0U};
+        std::atomic<std::size_t> bytes{0U};
+    } received;
+    dbus->transport().setFlatSignals({"ServicesChanged"});
+    guint id = 0U;
+    on_dbus_thread(dbus, [&]() {
+        id = dbus->transport().subscribe(
+            g_dbus_connection_get_unique_name(connection), PEER_INTERFACE,
+            "ServicesChanged", PEER_PATH,
+            [](const gchar* /*signal_name*/, GVariant* parameters,
+               gpointer user_data) {
+                auto* received = static_cast<Received*>(user_data);
+                received->bytes = g_variant_get_size(parameters);
+                received->count.fetch_add(1U);
+                received->count.notify_one();
+            },
+            &received);
+    });
+    // The match is in place once a later call is answered.
+    get_id(dbus);
+
+    std::size_t sent = 0U;
+    for (auto _ : state) {
+        g_dbus_connection_emit_signal(connection, nullptr, PEER_PATH,
+                                      PEER_INTERFACE, "ServicesChanged",
+                                      parameters, nullptr);
+        ++sent;
+        for (auto count = received.count.load(); count < sent;
+             count = received.count.load()) {
+            received.count.wait(count);
+        }
+    }
+
+    dbus->transport().unsubscribe(id);
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() *
+                            static_cast<int64_t>(received.bytes.load()));
+}
+BENCHMARK_CAPTURE(BM_ServicesChangedSignal, gdbus, TransportKind::GDBus)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_ServicesChangedSignal, sd_bus, TransportKind::SdBus)
+    ->UseRealTime();
+
+}  // namespace
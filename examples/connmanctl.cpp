@@ -226,6 +226,9 @@ auto main() -> int {
         technologies_container.clear();
         for (const auto& tech : technologies) {
             const auto props = tech->properties();
+            if (props.getType() == TechnologyType::Unknown) {
+                continue;
+            }
             technologies_container.push_back(
                 tech_map.at(props.getType()).data());
         }
@@ -269,9 +272,13 @@ auto main() -> int {
         std::string cmd;
         std::string arg;
         iss >> cmd >> arg;
-        auto match_technology = [&arg](const auto& technology) {
-            const auto props = technology->properties();
-            return tech_map.at(props.getType()) == arg;
+        auto find_technology = [&manager, &arg]() {
+            const auto entry =
+                std::ranges::find_if(tech_map, [&arg](const auto& type_name) {
+                    return type_name.second == arg;
+                });
+            return entry != tech_map.end() ? manager->technology(entry->first)
+                                           : nullptr;
         };
         auto match_service = [&arg](const auto& service) {
             const auto props = service->properties();
@@ -369,13 +376,12 @@ auto main() -> int {
                     continue;
                 }
             }
-            const auto techs = manager->technologies();
-            auto iterator = std::ranges::find_if(techs, match_technology);
-            if (iterator != techs.end()) {
-                const auto props = (*iterator)->properties();
+            const auto technology = find_technology();
+            if (technology) {
+                const auto props = technology->properties();
                 const auto name = props.getName();
                 std::cout << "Scanning " << name << "...\n";
-                (*iterator)->scan([name](bool success) {
+                technology->scan([name](bool success) {
                     {
                         std::lock_guard<std::mutex> lock(message_mutex);
                         if (success) {
@@ -408,10 +414,9 @@ auto main() -> int {
             const bool enable = (cmd == enable_disable_container.at(0));
             std::cout << (enable ? "Enabling" : "Disabling")
                       << " technology: " << arg << "\n";
-            const auto techs = manager->technologies();
-            auto iterator = std::ranges::find_if(techs, match_technology);
-            if (iterator != techs.end()) {
-                const auto props = (*iterator)->properties();
+            const auto technology = find_technology();
+            if (technology) {
+                const auto props = technology->properties();
                 const auto name = props.getName();
                 if ((!props.isPowered() &&
                      cmd == enable_disable_container.at(0)) ||
@@ -419,8 +424,8 @@ auto main() -> int {
                      cmd == enable_disable_container.at(1))) {
                     std::cout << (enable ? "Enabling " : "Disabling ") << name
                               << "...\n";
-                    (*iterator)->setPowered(enable, [name,
-                                                     enable](bool success) {
+                    technology->setPowered(enable, [name,
+                                                    enable](bool success) {
                         {
                             std::lock_guard<std::mutex> lock(message_mutex);
                             if (success) {
@@ -467,18 +472,17 @@ auto main() -> int {
                     continue;
                 }
             }
-            const auto techs = manager->technologies();
-            auto iterator = std::ranges::find_if(techs, match_technology);
-            if (iterator != techs.end()) {
+            const auto technology = find_technology();
+            if (technology) {
                 if (arg == tech_map.at(TechnologyType::Wifi)) {
                     std::string arg3;
                     std::string arg4;
                     iss >> arg3 >> arg4;
-                    (*iterator)->setTetheringIdentifier(arg2);
+                    technology->setTetheringIdentifier(arg2);
 
                     if (!arg3.empty()) {
                         if (arg3.size() >= MIN_WIFI_PASSPHRASE_LENGTH) {
-                            (*iterator)->setTetheringPassphrase(arg3);
+                            technology->setTetheringPassphrase(arg3);
                         } else {
                             std::cout << "Error setting wifi passphrase\n"
                                       << "Passphrase must be at least "
@@ -490,14 +494,14 @@ auto main() -> int {
 
                     if (!arg4.empty() &&
                         std::all_of(arg4.begin(), arg4.end(), ::isdigit)) {
-                        (*iterator)->setTetheringFreq(std::stoi(arg4));
+                        technology->setTetheringFreq(std::stoi(arg4));
                     }
                 }
 
                 const auto enable = arg1 == on_off_container[0];
                 std::cout << (enable ? "Enabling" : "Disabling")
                           << " tethering on " << arg << "\n";
-                (*iterator)->setTethering(enable, [arg, enable](bool success) {
+                technology->setTethering(enable, [arg, enable](bool success) {
                     {
                         std::lock_guard<std::mutex> lock(message_mutex);
                         if (success) {
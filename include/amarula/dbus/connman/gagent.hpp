@@ -3,43 +3,146 @@
 #include <glib.h>
 
 #include <amarula/dbus/gdbus.hpp>
+#include <amarula/dbus/gtransport.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace Amarula::DBus::G::Connman {
 class Connman;
+class WorkerPool;
+struct DeferredReplies;
+
+/*
+ * What happens to a RequestInput that arrives while all the agent workers are
+ * busy and their queue is full. Either way the request that loses is answered
+ * net.connman.Agent.Error.Canceled, so connman aborts that connection attempt
+ * instead of waiting for its D-Bus timeout.
+ */
+enum class OverflowPolicy : std::uint8_t {
+    CancelNewest = 0,  // refuse the request that just arrived
+    CancelOldest,      // make room by dropping the longest queued request
+};
+
+/*
+ * A RequestInput that connman is waiting on. Copies share the same request,
+ * which is answered once: the first reply() or cancel() wins, from any
+ * thread, and the reply is sent from the D-Bus thread. When the last copy is
+ * dropped without an answer the request is canceled, so connman is never left
+ * waiting for its D-Bus timeout. So it is when the Agent goes away, after
+ * which reply() and cancel() do nothing.
+ */
+class RequestInputReply {
+   public:
+    /*
+     * fields is the a{sv} returned to connman; a floating reference is
+     * taken over.
+     */
+    void reply(GVariant *fields) const;
+    // Answers net.connman.Agent.Error.Canceled.
+    void cancel() const;
+    [[nodiscard]] auto pending() const -> bool;
+
+   private:
+    struct State;
+    std::shared_ptr<State> state_;
+
+    explicit RequestInputReply(std::shared_ptr<State> state)
+        : state_{std::move(state)} {}
+
+    friend class Agent;
+};
 
 class Agent {
-    GDBusNodeInfo *node_info_;
+    std::mutex export_mtx_;
     guint registration_id_{0};
     DBus *dbus_;
     std::string path_{"/net/amarula/gconnman/agent"};
 
+    static constexpr std::size_t DEFAULT_WORKERS = 2U;
+    static constexpr std::size_t DEFAULT_QUEUE_CAPACITY = 16U;
+    /*
+     * Well below the two minutes connman waits for input, so a request nobody
+     * answers frees the pending connection early.
+     */
+    static constexpr std::chrono::milliseconds DEFAULT_REQUEST_INPUT_TIMEOUT{
+        60000};
+
+    std::atomic<std::chrono::milliseconds::rep> request_input_timeout_ms_{
+        DEFAULT_REQUEST_INPUT_TIMEOUT.count()};
+
+    struct WorkersConfig {
+        std::size_t workers{DEFAULT_WORKERS};
+        std::size_t queue_capacity{DEFAULT_QUEUE_CAPACITY};
+        OverflowPolicy overflow{OverflowPolicy::CancelNewest};
+    };
+
+    std::mutex workers_mtx_;
+    WorkersConfig workers_config_;
+    // Started on the first RequestInput that needs it.
+    std::unique_ptr<WorkerPool> workers_;
+    // ReportError invocations waiting for their Retry reply to be due.
+    std::shared_ptr<DeferredReplies> deferred_replies_;
+    // RequestInputs handed out, canceled when the Agent goes away.
+    std::mutex requests_mtx_;
+    std::vector<std::weak_ptr<RequestInputReply::State>> requests_;
+
     explicit Agent(DBus *dbus, const std::string &path = std::string());
 
-    using RequestInputCallback =
-        std::function<GVariant *(const gchar *service, GVariant *fields)>;
+    /*
+     * Exports the agent object on the bus, once: nothing is exported until
+     * the agent is about to be used.
+     */
+    void export_object();
+
+    using RequestInputWork = std::function<GVariant *()>;
+    /*
+     * Runs on the D-Bus dispatch thread and must not block. Returns nothing
+     * once it answered the request, or kept a copy of reply to answer it
+     * later; otherwise the work that computes the answer, which runs on the
+     * worker pool as it may wait for the application. What the callback
+     * learnt from fields is kept in the work rather than parsed again.
+     */
+    using RequestInputCallback = std::function<RequestInputWork(
+        const gchar *service, GVariant *fields,
+        const RequestInputReply &reply)>;
+    // Called on the D-Bus thread once a RequestInput was canceled for taking
+    // longer than the request timeout.
+    using RequestInputTimeoutCallback =
+        std::function<void(const gchar *service)>;
     using CancelCallback = std::function<void()>;
     using ReleaseCallback = std::function<void()>;
     /*
-     * Returning true asks connman to retry the connection with the credentials
-     * it already has, by replying net.connman.Agent.Error.Retry. The callback
-     * runs on the D-Bus dispatch thread while connman waits for the reply, so
-     * it must not block.
-     *
-     * The retry budget belongs to this callback: connman reconnects
-     * immediately, with no backoff and no attempt limit of its own, so a
-     * callback that always returns true against a service that keeps failing
-     * retries forever. Count the attempts and return false once you give up.
+     * Returns after how long connman is asked to retry the connection with the
+     * credentials it already has, by replying net.connman.Agent.Error.Retry,
+     * or nothing to let the attempt fail. The callback runs on the D-Bus
+     * dispatch thread, so it must not block; a delayed reply is scheduled on
+     * the loop and leaves the thread free meanwhile.
      */
-    using ReportErrorCallback =
-        std::function<bool(const gchar *service, const gchar *error)>;
+    using ReportErrorCallback = std::function<std::optional<
+        std::chrono::milliseconds>(const gchar *service, const gchar *error)>;
 
     void set_request_input_handler(RequestInputCallback callback) {
         request_input_cb_ = std::move(callback);
     }
 
+    void set_request_input_timeout_handler(
+        RequestInputTimeoutCallback callback) {
+        request_input_timeout_cb_ = std::move(callback);
+    }
+
+    void set_request_input_timeout(std::chrono::milliseconds timeout) {
+        request_input_timeout_ms_ = timeout.count();
+    }
+
     void set_cancel_handler(CancelCallback callback) {
         cancel_cb_ = std::move(callback);
     }
@@ -52,23 +155,23 @@ class Agent {
         report_error_cb_ = std::move(callback);
     }
 
+    void set_workers(std::size_t workers, std::size_t queue_capacity,
+                     OverflowPolicy overflow);
+
     RequestInputCallback request_input_cb_;
+    RequestInputTimeoutCallback request_input_timeout_cb_;
     CancelCallback cancel_cb_;
     ReleaseCallback release_cb_;
     ReportErrorCallback report_error_cb_;
 
-    static void on_method_call(GDBusConnection *connection, const gchar *sender,
-                               const gchar *object_path,
-                               const gchar *interface_name,
-                               const gchar *method_name, GVariant *parameters,
-                               GDBusMethodInvocation *invocation,
+    static void on_method_call(const gchar *method_name, GVariant *parameters,
+                               Transport::Invocation *invocation,
                                gpointer user_data);
 
-    void dispatch_method_call(GDBusMethodInvocation *invocation,
+    void dispatch_method_call(Transport::Invocation *invocation,
                               const gchar *method_name, GVariant *parameters);
-
-    constexpr static const GDBusInterfaceVTable INTERFACE_VTABLE{
-        Agent::on_method_call, nullptr, nullptr, {nullptr}};
+    void reply_retry_after(Transport::Invocation *invocation,
+                           std::chrono::milliseconds delay);
 
    public:
     Agent(const Agent &) = delete;
@@ -3,8 +3,10 @@
 
 #include <amarula/dbus/gdbus.hpp>
 #include <amarula/dbus/gproxy.hpp>
+#include <amarula/dbus/gsmallvector.hpp>
 #include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace Amarula::DBus::G::Connman {
@@ -13,14 +15,18 @@ class Connman;
 
 struct ClockProperties {
    public:
-    enum class TimeUpdate : uint8_t { Manual = 0, Auto };
+    enum class TimeUpdate : uint8_t { Manual = 0, Auto, Unknown };
     using TimeZoneUpdate = TimeUpdate;
 
     [[nodiscard]] auto getTime() const { return time_; }
     [[nodiscard]] auto getTimeUpdates() const { return time_updates_; }
-    [[nodiscard]] auto getTimezone() const { return timezone_; }
+    [[nodiscard]] auto getTimezone() const& -> const auto& { return timezone_; }
+    [[nodiscard]] auto getTimezone() && { return std::move(timezone_); }
     [[nodiscard]] auto getTimezoneUpdates() const { return timezone_updates_; }
-    [[nodiscard]] auto getTimeServers() const { return time_servers_; }
+    [[nodiscard]] auto getTimeServers() const& -> const auto& {
+        return time_servers_;
+    }
+    [[nodiscard]] auto getTimeServers() && { return std::move(time_servers_); }
     [[nodiscard]] auto isTimeServerSynced() const {
         return time_server_synced_;
     }
@@ -33,13 +39,15 @@ struct ClockProperties {
     TimeUpdate time_updates_{};
     std::string timezone_;
     TimeZoneUpdate timezone_updates_{};
-    std::vector<std::string> time_servers_;
+    PropertyList<std::string> time_servers_;
     bool time_server_synced_{false};
 
     void update(const gchar* key, GVariant* value);
 
     friend class Clock;
     friend class DBusProxy<ClockProperties>;
+    template <class Properties>
+    friend struct PropertyDescriptors;
 };
 
 class Clock : public DBusProxy<ClockProperties> {
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace Amarula::DBus::G::Connman {
+
+/*
+ * Credentials known ahead of time, as answered to connman RequestInput.
+ * Empty members are not known; a request is only answered from the store
+ * when every field it needs is there.
+ */
+struct Credentials {
+    std::string passphrase;  // PSK, WEP, or the 802.1X password
+    std::string identity;    // 802.1X
+    std::string name;        // hidden network name
+    std::string username;    // WISPr
+    std::string password;    // WISPr
+};
+
+/*
+ * Credentials for pre-provisioned services, looked up by the agent before any
+ * RequestInput callback: a hit is answered right away on the D-Bus thread.
+ *
+ * Entries are keyed by service object path, by service name, or by SSID, and
+ * looked up in that order. The store is thread safe and can be filled while
+ * the Manager uses it.
+ */
+class CredentialStore {
+   public:
+    void setForService(const std::string& obj_path, Credentials credentials);
+    void setForName(const std::string& name, Credentials credentials);
+    // ssid holds the raw SSID bytes, not necessarily UTF-8.
+    void setForSSID(std::string_view ssid, Credentials credentials);
+    void clear();
+
+    [[nodiscard]] auto lookup(std::string_view obj_path,
+                              std::string_view name) const
+        -> std::optional<Credentials>;
+
+   private:
+    struct StringHash {
+        using is_transparent = void;
+        auto operator()(std::string_view str) const -> std::size_t {
+            return std::hash<std::string_view>{}(str);
+        }
+    };
+    using Map = std::unordered_map<std::string, Credentials, StringHash,
+                                   std::equal_to<>>;
+
+    mutable std::mutex mtx_;
+    Map by_path_;
+    Map by_name_;
+    Map by_ssid_;  // hex encoded, as in the wifi service object paths
+
+    static auto ssid_of(std::string_view obj_path) -> std::string_view;
+    static auto to_hex(std::string_view bytes) -> std::string;
+};
+
+}  // namespace Amarula::DBus::G::Connman
@@ -4,24 +4,36 @@
 #include <glib.h>
 
 #include <amarula/dbus/connman/gagent.hpp>
+#include <amarula/dbus/connman/gcredentials.hpp>
 #include <amarula/dbus/connman/gservice.hpp>
+#include <amarula/dbus/connman/gservicetable.hpp>
 #include <amarula/dbus/connman/gtechnology.hpp>
 #include <amarula/dbus/gdbus.hpp>
+#include <amarula/dbus/gmutex.hpp>
 #include <amarula/dbus/gproxy.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace Amarula::DBus::G::Connman {
 class Connman;
+struct ServicesChangedSignal;
+class SignalArena;
 
 struct ManaProperties {
    public:
-    enum class State : uint8_t { Offline = 0, Idle, Ready, Online };
+    enum class State : uint8_t { Offline = 0, Idle, Ready, Online, Unknown };
     [[nodiscard]] auto isOfflineMode() const { return offline_mode_; }
     [[nodiscard]] auto getState() const { return state_; }
 
@@ -33,6 +45,8 @@ struct ManaProperties {
 
     friend class Manager;
     friend class DBusProxy<ManaProperties>;
+    template <class Properties>
+    friend struct PropertyDescriptors;
 };
 
 class Manager : public DBusProxy<ManaProperties> {
@@ -46,6 +60,8 @@ class Manager : public DBusProxy<ManaProperties> {
     using OnTechListChangedCallback = OnProxyListChangedCallback<Technology>;
     using OnServListChangedCallback = OnProxyListChangedCallback<Service>;
 
+    ~Manager() override;
+
     /*
      * Should follow
      * https://git.kernel.org/pub/scm/network/connman/connman.git/tree/doc/agent-api.txt
@@ -75,18 +91,73 @@ class Manager : public DBusProxy<ManaProperties> {
     using OnRequestInputWISPrEnabledCallback =
         std::function<std::pair<std::string, std::string>(
             std::shared_ptr<Service>)>;
+
+    /*
+     * Handle given to the asynchronous RequestInput callbacks, taking the same
+     * credentials the synchronous callback would return. Keep a copy and call
+     * reply() or cancel() later from any thread; dropping every copy without
+     * answering cancels the request.
+     */
+    template <class Credentials>
+    class InputReply {
+       public:
+        void reply(const Credentials& credentials) const {
+            GVariantBuilder builder;
+            g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+            add_fields_(&builder, credentials);
+            reply_.reply(g_variant_builder_end(&builder));
+        }
+
+        void cancel() const { reply_.cancel(); }
+
+        [[nodiscard]] auto pending() const -> bool { return reply_.pending(); }
+
+       private:
+        using AddFields = void (*)(GVariantBuilder*, const Credentials&);
+
+        InputReply(RequestInputReply reply, AddFields add_fields)
+            : reply_{std::move(reply)}, add_fields_{add_fields} {}
+
+        RequestInputReply reply_;
+        AddFields add_fields_;
+
+        friend class Manager;
+    };
+
+    using PassphraseReply = InputReply<std::pair<bool, std::string>>;
+    using HiddenNetworkNameReply = PassphraseReply;
+    using WPAEnterpriseReply =
+        InputReply<std::pair<std::string, std::pair<bool, std::string>>>;
+    using WISPrReply = InputReply<std::pair<std::string, std::string>>;
+
+    /*
+     * Asynchronous variants of the callbacks above, preferred over them when
+     * both are set. They run on the D-Bus dispatch thread and must return
+     * right away; no thread waits while the request is pending.
+     */
+    using OnRequestInputPassphraseAsyncCallback =
+        std::function<void(std::shared_ptr<Service>, PassphraseReply)>;
+    using OnRequestInputHiddenNetworkNameAsyncCallback =
+        std::function<void(std::shared_ptr<Service>, HiddenNetworkNameReply)>;
+    using OnRequestInputWPAEnterpriseAsyncCallback =
+        std::function<void(std::shared_ptr<Service>, WPAEnterpriseReply)>;
+    using OnRequestInputWISPrEnabledAsyncCallback =
+        std::function<void(std::shared_ptr<Service>, WISPrReply)>;
+    /*
+     * Called on the D-Bus thread when a RequestInput went unanswered for
+     * longer than the request timeout and was canceled. A synchronous
+     * callback still running at that point keeps its worker busy until it
+     * returns, and its answer is dropped.
+     */
+    using OnRequestInputTimeoutCallback =
+        std::function<void(std::shared_ptr<Service>)>;
     /*
      * Called when connman reports that a connection attempt failed, with the
      * connman error string ("invalid-key", "connect-failed", ...). Return true
      * to have connman retry with the credentials it already has.
      *
-     * connman holds the pending Service.Connect() reply until this returns, so
-     * the callback runs on the D-Bus dispatch thread and must not block.
-     *
-     * The retry budget belongs to this callback: connman reconnects
-     * immediately, with no backoff and no attempt limit of its own, so a
-     * callback that always returns true against a service that keeps failing
-     * retries forever. Count the attempts and return false once you give up.
+     * The callback runs on the D-Bus dispatch thread and must not block. The
+     * retry itself is paced by the Manager, see setReportErrorBackoff().
      */
     using OnReportErrorCallback =
         std::function<bool(std::shared_ptr<Service>, const std::string& error)>;
@@ -96,43 +167,187 @@ class Manager : public DBusProxy<ManaProperties> {
         std::function<void(const Manager::ProxyList<Service>&)>;
 
     [[nodiscard]] auto services() {
-        std::lock_guard<std::mutex> const lock(mtx_);
+        std::lock_guard<StatsMutex> const lock(mtx_);
         return services_;
     }
 
     [[nodiscard]] auto technologies() {
-        std::lock_guard<std::mutex> const lock(mtx_);
+        std::lock_guard<StatsMutex> const lock(mtx_);
         return technologies_;
     }
 
+    /*
+     * Technology of the given type, or nullptr when connman does not expose
+     * it. Constant time: the Manager keeps the technologies indexed by type.
+     */
+    [[nodiscard]] auto technology(TechProperties::Type type)
+        -> std::shared_ptr<Technology> {
+        const auto index = static_cast<std::size_t>(type);
+        if (index >= TechProperties::TYPE_COUNT) {
+            return nullptr;
+        }
+        std::lock_guard<StatsMutex> const lock(mtx_);
+        return technology_by_type_[index];
+    }
+
+    /*
+     * Snapshot of the columnar service table, in the order of services().
+     * Rows are refreshed in place on every PropertyChanged signal, so scans
+     * over state, type, strength or flags do not need to copy properties().
+     */
+    [[nodiscard]] auto serviceTable() -> ServiceTable {
+        std::lock_guard<std::mutex> const lock(service_table_->mtx);
+        return service_table_->table;
+    }
+
+    [[nodiscard]] auto service(ServiceTable::Id service_id)
+        -> std::shared_ptr<Service>;
+
+    /*
+     * Services dropped from ServicesChanged (Wi-Fi access points fading in and
+     * out) are kept for up to ttl, at most capacity of them. When the same
+     * object path comes back the very same Service is reused: its signal
+     * subscription, id and onPropertyChanged() callback survive, the
+     * properties are decoded again. The callback is only dropped once the
+     * Service is evicted, past ttl or beyond capacity, as its path is not
+     * expected back. A capacity of 0 disables recycling.
+     */
+    void setServiceRecycling(std::size_t capacity, std::chrono::seconds ttl);
+
+    /*
+     * View mode for service properties. Off by default: every property
+     * connman sends is decoded on the D-Bus thread as it arrives. When on, a
+     * service keeps the a{sv} dict of GetServices and ServicesChanged and
+     * decodes a property the first time it is read through a getter, so
+     * properties nobody reads are never decoded. Each copy returned by
+     * Service::properties() caches what it decoded. The state, type, error,
+     * strength and flags the ServiceTable holds are the exception: they are
+     * cheap and always read, so they are decoded as the dict arrives.
+     * PropertyChanged signals are still applied right away. Applies to the
+     * current services too.
+     */
+    void setLazyServiceProperties(bool lazy);
+
+    /*
+     * In-place decoding of the signals every scan floods: ServicesChanged
+     * and the PropertyChanged of connman objects. Off by default. When on,
+     * their parameters are serialised on the GDBus worker thread that reads
+     * them, and the D-Bus thread walks that buffer instead of creating a
+     * GVariant for every path, key and value: a PropertyChanged repeating
+     * the last value creates none at all. Signals of any other shape still
+     * take the GVariant path.
+     */
+    void setInPlaceSignalDecoding(bool enabled);
+
+    /*
+     * The RequestInput callbacks run on a fixed pool of worker threads, two
+     * by default, started on the first request and fed by a queue of at most
+     * queue_capacity requests (16 by default). Requests that do not fit are
+     * answered Canceled, according to overflow. Requests already running on
+     * the previous pool complete, the ones still queued there are canceled.
+     */
+    void setAgentWorkers(
+        std::size_t workers, std::size_t queue_capacity,
+        OverflowPolicy overflow = OverflowPolicy::CancelNewest) {
+        agent_->set_workers(workers, queue_capacity, overflow);
+    }
+
     void onRequestInputPassphrase(OnRequestInputPassphraseCallback callback) {
-        std::lock_guard<std::mutex> const lock(mtx_);
+        std::lock_guard<StatsMutex> const lock(mtx_);
         request_input_passphrase_cb_ = std::move(callback);
     }
 
     void onRequestInputHiddenNetworkName(
         OnRequestInputHiddenNetworkNameCallback callback) {
-        std::lock_guard<std::mutex> const lock(mtx_);
+        std::lock_guard<StatsMutex> const lock(mtx_);
         request_input_hidden_network_name_cb_ = std::move(callback);
     }
 
     void onRequestInputInputWPAEnterprise(
         OnRequestInputWPAEnterpriseCallback callback) {
-        std::lock_guard<std::mutex> const lock(mtx_);
+        std::lock_guard<StatsMutex> const lock(mtx_);
         request_input_wpa_enterprise_cb_ = std::move(callback);
     }
 
     void onRequestInputInputWISPrEnabled(
         OnRequestInputWISPrEnabledCallback callback) {
-        std::lock_guard<std::mutex> const lock(mtx_);
+        std::lock_guard<StatsMutex> const lock(mtx_);
         request_input_wispr_enabled_cb_ = std::move(callback);
     }
 
+    void onRequestInputPassphraseAsync(
+        OnRequestInputPassphraseAsyncCallback callback) {
+        std::lock_guard<StatsMutex> const lock(mtx_);
+        request_input_passphrase_async_cb_ = std::move(callback);
+    }
+
+    void onRequestInputHiddenNetworkNameAsync(
+        OnRequestInputHiddenNetworkNameAsyncCallback callback) {
+        std::lock_guard<StatsMutex> const lock(mtx_);
+        request_input_hidden_network_name_async_cb_ = std::move(callback);
+    }
+
+    void onRequestInputInputWPAEnterpriseAsync(
+        OnRequestInputWPAEnterpriseAsyncCallback callback) {
+        std::lock_guard<StatsMutex> const lock(mtx_);
+        request_input_wpa_enterprise_async_cb_ = std::move(callback);
+    }
+
+    void onRequestInputWISPrEnabledAsync(
+        OnRequestInputWISPrEnabledAsyncCallback callback) {
+        std::lock_guard<StatsMutex> const lock(mtx_);
+        request_input_wispr_enabled_async_cb_ = std::move(callback);
+    }
+
+    /*
+     * Consulted before any RequestInput callback: when the store holds every
+     * field connman asks for, the request is answered on the D-Bus thread
+     * without reaching the application. Pass nullptr to stop using it.
+     */
+    void setCredentialStore(std::shared_ptr<const CredentialStore> store) {
+        std::lock_guard<StatsMutex> const lock(mtx_);
+        credential_store_ = std::move(store);
+    }
+
+    /*
+     * connman retries right away, with no limit of its own, whenever the agent
+     * asks for it. Retries requested through onReportError() are therefore
+     * delayed by initial_delay, doubled at each consecutive failure of the
+     * same service up to max_delay; the reply is deferred on the loop, no
+     * thread waits for it. After max_attempts retries the failure is let
+     * through. The count starts over once the service gets connected, or
+     * after giving up. Keep max_delay well below the connman agent timeout.
+     */
+    void setReportErrorBackoff(std::chrono::milliseconds initial_delay,
+                               std::chrono::milliseconds max_delay,
+                               std::size_t max_attempts) {
+        retry_backoff_->configure(initial_delay, max_delay, max_attempts);
+    }
+
+    void onRequestInputTimeout(OnRequestInputTimeoutCallback callback) {
+        std::lock_guard<StatsMutex> const lock(mtx_);
+        request_input_timeout_cb_ = std::move(callback);
+    }
+
+    /*
+     * How long a RequestInput may stay unanswered, one minute by default.
+     * After that it is answered Canceled, so connman fails the pending
+     * connection and moves on. Zero disables the deadline.
+     */
+    void setRequestInputTimeout(std::chrono::milliseconds timeout) {
+        agent_->set_request_input_timeout(timeout);
+    }
+
     void onReportError(OnReportErrorCallback callback) {
-        std::lock_guard<std::mutex> const lock(mtx_);
+        std::lock_guard<StatsMutex> const lock(mtx_);
         report_error_cb_ = std::move(callback);
     }
 
+    /*
+     * Registering internalAgentPath() exports the internal agent first, see
+     * exportAgent(). When that fails it throws std::runtime_error like
+     * exportAgent(), and connman is not called nor callback invoked.
+     */
     void registerAgent(const std::string& object_path,
                        PropertiesSetCallback callback = nullptr);
     void unregisterAgent(const std::string& object_path,
@@ -147,6 +362,26 @@ class Manager : public DBusProxy<ManaProperties> {
         return agent_->path_;
     };
 
+    /*
+     * Exports the internal agent object at internalAgentPath() without
+     * telling connman about it. Done on demand, so clients that never act as
+     * the agent do not export it at all. Throws std::runtime_error when the
+     * path is already taken on the bus.
+     */
+    void exportAgent() { agent_->export_object(); }
+
+#ifdef AMARULA_DBUS_LOCK_STATS
+    /*
+     * Hold times of the lock guarding the service and technology lists and
+     * the callbacks. Signal processing only takes it to publish results, so
+     * max_hold stays short even when a ServicesChanged brings new services.
+     * Only built with DBUS_LOCK_STATS.
+     */
+    [[nodiscard]] auto lockStats() const -> ProfiledMutex::Stats {
+        return mtx_.stats();
+    }
+#endif
+
    private:
     enum class InputType : std::uint8_t {
         InputUnknown = 0,
@@ -160,8 +395,67 @@ class Manager : public DBusProxy<ManaProperties> {
 
     ProxyList<Service> services_;
     ProxyList<Technology> technologies_;
+    using TechnologyIndex =
+        std::array<std::shared_ptr<Technology>, TechProperties::TYPE_COUNT>;
+    TechnologyIndex technology_by_type_;
+
+    /*
+     * Shared with the services, which update their row from the D-Bus thread
+     * and may outlive the Manager.
+     */
+    struct SharedServiceTable {
+        std::mutex mtx;
+        ServiceTable table;
+    };
+    std::shared_ptr<SharedServiceTable> service_table_{
+        std::make_shared<SharedServiceTable>()};
+    std::atomic<ServiceTable::Id> next_service_id_{0U};
+    std::atomic<bool> lazy_service_properties_{false};
+
+    static constexpr std::size_t DEFAULT_RECYCLED_SERVICES = 64U;
+    static constexpr std::chrono::seconds DEFAULT_RECYCLED_SERVICES_TTL{120};
+
+    std::unique_ptr<RecycledProxies<Service>> recycled_services_;
+
+    // Temporary state of the signal being dispatched, D-Bus thread only.
+    std::unique_ptr<SignalArena> signal_arena_;
+
+    static constexpr std::chrono::milliseconds DEFAULT_RETRY_DELAY{1000};
+    static constexpr std::chrono::milliseconds DEFAULT_MAX_RETRY_DELAY{16000};
+    static constexpr std::size_t DEFAULT_RETRY_ATTEMPTS = 5U;
+
+    class RetryBackoff {
+       public:
+        void configure(std::chrono::milliseconds initial_delay,
+                       std::chrono::milliseconds max_delay,
+                       std::size_t max_attempts);
+        // Nothing once the service has used up its attempts.
+        auto next_delay(std::string_view obj_path)
+            -> std::optional<std::chrono::milliseconds>;
+        void reset(std::string_view obj_path);
+
+       private:
+        struct StringHash {
+            using is_transparent = void;
+            auto operator()(std::string_view str) const -> std::size_t {
+                return std::hash<std::string_view>{}(str);
+            }
+        };
+
+        std::mutex mtx_;
+        std::chrono::milliseconds initial_delay_{DEFAULT_RETRY_DELAY};
+        std::chrono::milliseconds max_delay_{DEFAULT_MAX_RETRY_DELAY};
+        std::size_t max_attempts_{DEFAULT_RETRY_ATTEMPTS};
+        // Looked up by the paths services already hold, without a copy.
+        std::unordered_map<std::string, std::size_t, StringHash,
+                           std::equal_to<>>
+            attempts_;
+    };
+    // Shared with the services, which reset their count once connected.
+    std::shared_ptr<RetryBackoff> retry_backoff_{
+        std::make_shared<RetryBackoff>()};
 
-    std::mutex mtx_;
+    StatsMutex mtx_;
     std::unique_ptr<Agent> agent_{nullptr};
 
     using VariantPtr = std::unique_ptr<GVariant, decltype(&g_variant_unref)>;
@@ -171,7 +465,16 @@ class Manager : public DBusProxy<ManaProperties> {
         request_input_hidden_network_name_cb_;
     OnRequestInputWPAEnterpriseCallback request_input_wpa_enterprise_cb_;
     OnRequestInputWISPrEnabledCallback request_input_wispr_enabled_cb_;
+    OnRequestInputPassphraseAsyncCallback request_input_passphrase_async_cb_;
+    OnRequestInputHiddenNetworkNameAsyncCallback
+        request_input_hidden_network_name_async_cb_;
+    OnRequestInputWPAEnterpriseAsyncCallback
+        request_input_wpa_enterprise_async_cb_;
+    OnRequestInputWISPrEnabledAsyncCallback
+        request_input_wispr_enabled_async_cb_;
+    OnRequestInputTimeoutCallback request_input_timeout_cb_;
     OnReportErrorCallback report_error_cb_;
+    std::shared_ptr<const CredentialStore> credential_store_;
     OnTechnologiesChangedCallback technologies_changed_cb_{
         [](const Manager::ProxyList<Technology>&) {}};
     OnServicesChangedCallback services_changed_cb_{
@@ -182,18 +485,37 @@ class Manager : public DBusProxy<ManaProperties> {
     using DBusProxy::DBusProxy;
 
     template <class ProxyType>
-    static void get_proxies_cb(GObject* proxy, GAsyncResult* res,
+    static void get_proxies_cb(GVariant* reply, const GError* error,
                                gpointer user_data);
-    static void on_technology_added_removed_cb(GDBusProxy* proxy,
-                                               gchar* sender_name,
-                                               gchar* signal_name,
+    static void on_technology_added_removed_cb(const gchar* signal_name,
                                                GVariant* parameters,
                                                gpointer user_data);
-    static void on_services_changed_cb(GDBusProxy* proxy, gchar* sender_name,
-                                       gchar* signal_name, GVariant* parameters,
+    static void on_services_changed_cb(const gchar* signal_name,
+                                       GVariant* parameters,
                                        gpointer user_data);
-    static auto classify_input(GPtrArray* fields) -> InputType;
-    static auto parse_fields(GVariant* fields) -> GPtrArray*;
+    static auto classify_input(GVariant* fields) -> InputType;
+    static void add_passphrase(GVariantBuilder* builder,
+                               const std::pair<bool, std::string>& passphrase);
+    static void add_passphrase_or_wps(
+        GVariantBuilder* builder,
+        const std::pair<bool, std::string>& passphrase);
+    static void add_network_name(GVariantBuilder* builder,
+                                 const std::pair<bool, std::string>& name);
+    static void add_enterprise(
+        GVariantBuilder* builder,
+        const std::pair<std::string, std::pair<bool, std::string>>&
+            identity_password);
+    static void add_wispr(
+        GVariantBuilder* builder,
+        const std::pair<std::string, std::string>& user_password);
+    static auto credentials_to_fields(InputType input_requested,
+                                      const Credentials& credentials)
+        -> GVariant*;
+    auto request_input_async(const gchar* service_path, GVariant* fields,
+                             const RequestInputReply& reply)
+        -> Agent::RequestInputWork;
+    auto request_input(const std::shared_ptr<Service>& found_service,
+                       InputType input_requested) -> GVariant*;
     static auto dict_to_path_prop(GVariant* tuple)
         -> std::pair<std::string, VariantPtr>;
 
@@ -204,10 +526,19 @@ class Manager : public DBusProxy<ManaProperties> {
     void get_technologies();
     void get_services();
     void setup_agent();
-    void process_services_changed(
-        const std::vector<std::string>& services_removed,
-        const std::vector<std::pair<std::string, VariantPtr>>&
-            services_changed);
+    auto find_service(const gchar* obj_path) -> std::shared_ptr<Service>;
+    auto make_service(const gchar* obj_path) -> std::shared_ptr<Service>;
+    // On the D-Bus thread, which reads the properties of services in place.
+    static auto make_service_table(const ProxyList<Service>& services)
+        -> ServiceTable;
+    void publish_service_table(ServiceTable table);
+    // On the D-Bus thread too; technologies of Unknown type are left out.
+    static auto make_technology_index(
+        const ProxyList<Technology>& technologies) -> TechnologyIndex;
+    auto process_services_changed(const ProxyList<Service>& current_services,
+                                  const ServicesChangedSignal& signal)
+        -> ProxyList<Service>;
+    void reset_retries_if_connected(Service& service);
 
     friend class Connman;
 };
@@ -1,62 +1,65 @@
 #pragma once
 #include <glib.h>
+#include <netinet/in.h>
 
 #include <amarula/dbus/gdbus.hpp>
+#include <amarula/dbus/ginterned.hpp>
 #include <amarula/dbus/gproxy.hpp>
+#include <amarula/dbus/gsmallvector.hpp>
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace Amarula::DBus::G::Connman {
 class Manager;
+template <class Proxy>
+class RecycledProxies;
 struct ServProperties;
 
-class GVariantParser {
-   public:
-    GVariantParser() = default;
-    virtual ~GVariantParser() = default;
-
-    GVariantParser(const GVariantParser&) = default;
-    auto operator=(const GVariantParser&) -> GVariantParser& = default;
-    GVariantParser(GVariantParser&&) = default;
-    auto operator=(GVariantParser&&) -> GVariantParser& = default;
-
-   protected:
-    void parse(GVariant* variant);
-
-    virtual void update(const gchar* /*key*/, GVariant* /*value*/) {};
-};
-
-class IPv4 : public GVariantParser {
+class IPv4 {
    public:
     enum class Method : uint8_t {
         Off = 0,
         Dhcp,
         Manual,
         Auto,
+        Unknown,  // not known to this version of the library
     };
 
     friend auto operator<<(std::ostream& ostr,
                            const IPv4& object) -> std::ostream&;
 
     [[nodiscard]] auto getMethod() const { return method_; }
-    [[nodiscard]] auto getAddress() const { return address_; }
-    [[nodiscard]] auto getNetmask() const { return netmask_; }
-    [[nodiscard]] auto getGateway() const { return gateway_; }
+    // Dotted quads, empty when connman did not send the address.
+    [[nodiscard]] auto getAddress() const -> std::string;
+    [[nodiscard]] auto getNetmask() const -> std::string;
+    [[nodiscard]] auto getGateway() const -> std::string;
+    // The same addresses in network byte order.
+    [[nodiscard]] auto getAddressBinary() const { return address_; }
+    [[nodiscard]] auto getNetmaskBinary() const { return netmask_; }
+    [[nodiscard]] auto getGatewayBinary() const { return gateway_; }
+    // Bits set in the netmask, 0 without one.
+    [[nodiscard]] auto getPrefixLength() const -> uint8_t;
 
    private:
+    std::optional<in_addr> address_;
+    std::optional<in_addr> netmask_;
+    std::optional<in_addr> gateway_;
     Method method_{};
-    std::string address_;
-    std::string netmask_;
-    std::string gateway_;
-    explicit IPv4(GVariant* variant) { parse(variant); };
-    void update(const gchar* key, GVariant* value) override;
+    explicit IPv4(GVariant* variant);
 
     friend class ServProperties;
+    template <class Properties>
+    friend struct PropertyDescriptors;
 };
 
-struct IPv6 : public GVariantParser {
+struct IPv6 {
    public:
     enum class Method : uint8_t {
         Off = 0,
@@ -64,88 +67,106 @@ struct IPv6 : public GVariantParser {
         Manual,
         Fixed,
         Auto,
+        Unknown,
     };
-    enum class Privacy : uint8_t { Disabled = 0, Enabled, Preferred };
+    enum class Privacy : uint8_t { Disabled = 0, Enabled, Preferred, Unknown };
     friend auto operator<<(std::ostream& ostr,
                            const IPv6& object) -> std::ostream&;
     [[nodiscard]] auto getMethod() const { return method_; }
-    [[nodiscard]] auto getAddress() const { return address_; }
-    [[nodiscard]] auto getGateway() const { return gateway_; }
+    // Text form, empty when connman did not send the address.
+    [[nodiscard]] auto getAddress() const -> std::string;
+    [[nodiscard]] auto getGateway() const -> std::string;
+    [[nodiscard]] auto getAddressBinary() const { return address_; }
+    [[nodiscard]] auto getGatewayBinary() const { return gateway_; }
     [[nodiscard]] auto getPrivacy() const { return privacy_; }
     [[nodiscard]] auto getPrefixLength() const { return prefix_length_; }
 
    private:
+    std::optional<in6_addr> address_;
+    std::optional<in6_addr> gateway_;
     Method method_{};
-    std::string address_;
-    std::string gateway_;
     Privacy privacy_{};
     uint8_t prefix_length_{0U};
-    explicit IPv6(GVariant* variant) { parse(variant); };
-    void update(const gchar* key, GVariant* value) override;
+    explicit IPv6(GVariant* variant);
 
     friend class ServProperties;
+    template <class Properties>
+    friend struct PropertyDescriptors;
 };
 
-struct Ethernet : public GVariantParser {
+struct Ethernet {
    public:
-    enum class Method : uint8_t { Manual = 0, Auto };
+    enum class Method : uint8_t { Manual = 0, Auto, Unknown };
     friend auto operator<<(std::ostream& ostr,
                            const Ethernet& object) -> std::ostream&;
     [[nodiscard]] auto getMethod() const { return method_; }
-    [[nodiscard]] auto getInterface() const { return interface_; }
-    [[nodiscard]] auto getAddress() const { return address_; }
+    [[nodiscard]] auto getInterface() const -> const auto& {
+        return interface_.str();
+    }
+    [[nodiscard]] auto getAddress() const& -> const auto& { return address_; }
+    [[nodiscard]] auto getAddress() && { return std::move(address_); }
     [[nodiscard]] auto getMtu() const { return mtu_; }
 
    private:
     Method method_{};
-    std::string interface_;
+    InternedString interface_;
     std::string address_;
     uint16_t mtu_{0U};
-    explicit Ethernet(GVariant* variant) { parse(variant); };
-    void update(const gchar* key, GVariant* value) override;
+    explicit Ethernet(GVariant* variant);
 
     friend class ServProperties;
+    template <class Properties>
+    friend struct PropertyDescriptors;
 };
 
-struct Provider : public GVariantParser {
+struct Provider {
    public:
     friend auto operator<<(std::ostream& ostr,
                            const Provider& object) -> std::ostream&;
-    [[nodiscard]] auto getHost() const { return host_; }
-    [[nodiscard]] auto getDomain() const { return domain_; }
-    [[nodiscard]] auto getName() const { return name_; }
-    [[nodiscard]] auto getType() const { return type_; }
+    [[nodiscard]] auto getHost() const& -> const auto& { return host_; }
+    [[nodiscard]] auto getHost() && { return std::move(host_); }
+    [[nodiscard]] auto getDomain() const -> const auto& {
+        return domain_.str();
+    }
+    [[nodiscard]] auto getName() const& -> const auto& { return name_; }
+    [[nodiscard]] auto getName() && { return std::move(name_); }
+    [[nodiscard]] auto getType() const -> const auto& { return type_.str(); }
 
    private:
     std::string host_;
-    std::string domain_;
+    InternedString domain_;
     std::string name_;
-    std::string type_;
-    explicit Provider(GVariant* variant) { parse(variant); };
-    void update(const gchar* key, GVariant* value) override;
+    InternedString type_;
+    explicit Provider(GVariant* variant);
 
     friend class ServProperties;
+    template <class Properties>
+    friend struct PropertyDescriptors;
 };
 
-struct Proxy : public GVariantParser {
+struct Proxy {
    public:
-    enum class Method : uint8_t { Direct = 0, Auto, Manual };
+    enum class Method : uint8_t { Direct = 0, Auto, Manual, Unknown };
     friend auto operator<<(std::ostream& ostr,
                            const Proxy& object) -> std::ostream&;
     [[nodiscard]] auto getMethod() const { return method_; }
-    [[nodiscard]] auto getUrl() const { return url_; }
-    [[nodiscard]] auto getServers() const { return servers_; }
-    [[nodiscard]] auto getExcludes() const { return excludes_; }
+    [[nodiscard]] auto getUrl() const& -> const auto& { return url_; }
+    [[nodiscard]] auto getUrl() && { return std::move(url_); }
+    [[nodiscard]] auto getServers() const& -> const auto& { return servers_; }
+    [[nodiscard]] auto getServers() && { return std::move(servers_); }
+    [[nodiscard]] auto getExcludes() const& -> const auto& { return excludes_; }
+    [[nodiscard]] auto getExcludes() && { return std::move(excludes_); }
 
    private:
     Method method_{};
     std::string url_;
-    std::vector<std::string> servers_;
-    std::vector<std::string> excludes_;
-    explicit Proxy(GVariant* variant) { parse(variant); };
-    void update(const gchar* key, GVariant* value) override;
+    PropertyList<InternedString> servers_;
+    PropertyList<InternedString> excludes_;
+    explicit Proxy(GVariant* variant);
 
     friend class ServProperties;
+    template <class Properties>
+    friend struct PropertyDescriptors;
 };
 
 struct ServProperties {
@@ -157,7 +178,8 @@ struct ServProperties {
         Online,
         Disconnect,
         Association,
-        Configuration
+        Configuration,
+        Unknown
     };
     enum class Type : uint8_t {
         Ethernet = 0,
@@ -168,7 +190,8 @@ struct ServProperties {
         Wired,
         P2p,
         Gps,
-        Gadget
+        Gadget,
+        Unknown
     };
     enum class Security : uint8_t {
         None = 0,
@@ -176,7 +199,8 @@ struct ServProperties {
         Psk,
         Ieee8021x,
         Wps,
-        WpsAdvertising
+        WpsAdvertising,
+        Unknown
     };
     enum class Error : uint8_t {
         None = 0,
@@ -188,57 +212,208 @@ struct ServProperties {
         AuthFailed,
         InvalidKey,
         Blocked,
-        OnlineCheckFailed
+        OnlineCheckFailed,
+        Unknown
     };
 
     friend auto operator<<(std::ostream& ostr,
                            const ServProperties& object) -> std::ostream&;
-    [[nodiscard]] auto getState() const { return state_; }
-    [[nodiscard]] auto getType() const { return type_; }
-    [[nodiscard]] auto getSecurity() const { return security_; }
-    [[nodiscard]] auto getStrength() const { return strength_; }
-    [[nodiscard]] auto getError() const { return error_; }
-    [[nodiscard]] auto isAutoconnect() const { return autoconnect_; }
-    [[nodiscard]] auto isMDNSEnabled() const { return mdns_; }
-    [[nodiscard]] auto isFavorite() const { return favorite_; }
-    [[nodiscard]] auto isImmutable() const { return immutable_; }
-    [[nodiscard]] auto isRoaming() const { return roaming_; }
-    [[nodiscard]] auto getIPv4() const { return ipv4_; }
-    [[nodiscard]] auto getIPv6() const { return ipv6_; }
-    [[nodiscard]] auto getEthernet() const { return ethernet_; }
-    [[nodiscard]] auto getProvider() const { return provider_; }
-    [[nodiscard]] auto getProxy() const { return proxy_; }
-    [[nodiscard]] auto getName() const { return name_; }
-    [[nodiscard]] auto getNameservers() const { return name_servers_; }
-    [[nodiscard]] auto getDomains() const { return domains_; }
-    [[nodiscard]] auto getTimeservers() const { return time_servers_; }
+    [[nodiscard]] auto getState() const { return read(Field::State, state_); }
+    [[nodiscard]] auto getType() const { return read(Field::Type, type_); }
+    [[nodiscard]] auto getSecurity() const& -> const auto& {
+        return read(Field::Security, security_);
+    }
+    [[nodiscard]] auto getSecurity() && {
+        return take(Field::Security, security_);
+    }
+    [[nodiscard]] auto getStrength() const {
+        return read(Field::Strength, strength_);
+    }
+    [[nodiscard]] auto getError() const { return read(Field::Error, error_); }
+    [[nodiscard]] auto isAutoconnect() const {
+        return flag(Field::AutoConnect, AUTOCONNECT);
+    }
+    [[nodiscard]] auto isMDNSEnabled() const { return flag(Field::MDNS, MDNS); }
+    [[nodiscard]] auto isFavorite() const {
+        return flag(Field::Favorite, FAVORITE);
+    }
+    [[nodiscard]] auto isImmutable() const {
+        return flag(Field::Immutable, IMMUTABLE);
+    }
+    [[nodiscard]] auto isRoaming() const { return (flags_ & ROAMING) != 0U; }
+    [[nodiscard]] auto getIPv4() const& -> const auto& {
+        return read(Field::IPv4, ipv4_);
+    }
+    [[nodiscard]] auto getIPv4() && { return take(Field::IPv4, ipv4_); }
+    [[nodiscard]] auto getIPv6() const& -> const auto& {
+        return read(Field::IPv6, ipv6_);
+    }
+    [[nodiscard]] auto getIPv6() && { return take(Field::IPv6, ipv6_); }
+    [[nodiscard]] auto getEthernet() const& -> const auto& {
+        return read(Field::Ethernet, ethernet_);
+    }
+    [[nodiscard]] auto getEthernet() && {
+        return take(Field::Ethernet, ethernet_);
+    }
+    [[nodiscard]] auto getProvider() const& -> const auto& {
+        return read(Field::Provider, provider_);
+    }
+    [[nodiscard]] auto getProvider() && {
+        return take(Field::Provider, provider_);
+    }
+    [[nodiscard]] auto getProxy() const& -> const auto& {
+        return read(Field::Proxy, proxy_);
+    }
+    [[nodiscard]] auto getProxy() && { return take(Field::Proxy, proxy_); }
+    [[nodiscard]] auto getName() const& -> const auto& {
+        return read(Field::Name, name_);
+    }
+    [[nodiscard]] auto getName() && { return take(Field::Name, name_); }
+    [[nodiscard]] auto getNameservers() const& -> const auto& {
+        return read(Field::Nameservers, name_servers_);
+    }
+    [[nodiscard]] auto getNameservers() && {
+        return take(Field::Nameservers, name_servers_);
+    }
+    [[nodiscard]] auto getNameserversConfiguration() const& -> const auto& {
+        return read(Field::NameserversConfiguration, name_servers_conf_);
+    }
+    [[nodiscard]] auto getNameserversConfiguration() && {
+        return take(Field::NameserversConfiguration, name_servers_conf_);
+    }
+    [[nodiscard]] auto getDomains() const& -> const auto& {
+        return read(Field::Domains, domains_);
+    }
+    [[nodiscard]] auto getDomains() && {
+        return take(Field::Domains, domains_);
+    }
+    [[nodiscard]] auto getTimeservers() const& -> const auto& {
+        return read(Field::Timeservers, time_servers_);
+    }
+    [[nodiscard]] auto getTimeservers() && {
+        return take(Field::Timeservers, time_servers_);
+    }
 
    private:
-    State state_{};
-    Error error_{};
-    std::string name_;
-    Type type_{};
-    std::optional<std::vector<Security>> security_;
-    std::optional<std::vector<std::string>> name_servers_;
-    std::optional<std::vector<std::string>> name_servers_conf_;
-    std::optional<std::vector<std::string>> domains_;
-    std::optional<std::vector<std::string>> time_servers_;
-    bool autoconnect_{false};
-    bool mdns_{false};
-    bool favorite_{false};
-    bool immutable_{false};
-    bool roaming_{false};
-    uint8_t strength_{0U};
-    std::optional<IPv4> ipv4_{std::nullopt};
-    std::optional<IPv6> ipv6_{std::nullopt};
-    std::optional<Ethernet> ethernet_{std::nullopt};
-    std::optional<Provider> provider_{std::nullopt};
-    std::optional<Proxy> proxy_{std::nullopt};
+    // The D-Bus properties, in the order of the descriptor table.
+    enum class Field : uint8_t {
+        Name = 0,
+        Type,
+        State,
+        Error,
+        Favorite,
+        Immutable,
+        AutoConnect,
+        MDNS,
+        Strength,
+        IPv4,
+        IPv6,
+        Ethernet,
+        Provider,
+        Proxy,
+        Security,
+        Nameservers,
+        NameserversConfiguration,
+        Domains,
+        Timeservers,
+        Count
+    };
+
+    // Bits of flags_, one per boolean property.
+    static constexpr uint8_t AUTOCONNECT = 1U << 0U;
+    static constexpr uint8_t MDNS = 1U << 1U;
+    static constexpr uint8_t FAVORITE = 1U << 2U;
+    static constexpr uint8_t IMMUTABLE = 1U << 3U;
+    static constexpr uint8_t ROAMING = 1U << 4U;
+
+    /*
+     * The lock of the Service these properties belong to, the one
+     * properties() copies them under. Copies and assignments leave it alone:
+     * a snapshot has none, being read by a single thread.
+     */
+    class Guard {
+       public:
+        Guard() = default;
+        Guard(const Guard& /*other*/) {}
+        Guard(Guard&& /*other*/) noexcept {}
+        auto operator=(const Guard& /*other*/) -> Guard& { return *this; }
+        auto operator=(Guard&& /*other*/) noexcept -> Guard& { return *this; }
+        ~Guard() = default;
+
+        std::mutex* mtx{nullptr};
+    };
+
+    // The a{sv} dict the fields not decoded yet are read from, if any.
+    std::shared_ptr<GVariant> source_;
+    Guard guard_;
+
+    /*
+     * Decoded fields are mutable: in view mode (see
+     * Manager::setLazyServiceProperties()) a field is only decoded from
+     * source_ the first time it is read, and cached in this object. Copies
+     * share source_ and carry what was decoded so far. The scalar fields are
+     * the exception, decoded as soon as a dict is kept; see keep().
+     *
+     * Services are cached by the thousand, so the members are ordered by
+     * alignment and the small ones share the tail without padding.
+     */
+    mutable std::string name_;
+    mutable std::optional<PropertyList<Security>> security_;
+    mutable std::optional<PropertyList<InternedString>> name_servers_;
+    mutable std::optional<PropertyList<InternedString>> name_servers_conf_;
+    mutable std::optional<PropertyList<InternedString>> domains_;
+    mutable std::optional<PropertyList<InternedString>> time_servers_;
+    mutable std::optional<IPv4> ipv4_{std::nullopt};
+    mutable std::optional<IPv6> ipv6_{std::nullopt};
+    mutable std::optional<Ethernet> ethernet_{std::nullopt};
+    mutable std::optional<Provider> provider_{std::nullopt};
+    mutable std::optional<Proxy> proxy_{std::nullopt};
+    mutable uint32_t decoded_{0U};
+    mutable State state_{};
+    mutable Error error_{};
+    mutable Type type_{};
+    mutable uint8_t strength_{0U};
+    mutable uint8_t flags_{0U};
+
+    template <class Member>
+    auto read(Field field, const Member& member) const -> const Member& {
+        if (source_ && !decoded(field)) {
+            resolve(field);
+        }
+        return member;
+    }
+    // What read() returns, moved out of a temporary.
+    template <class Member>
+    auto take(Field field, Member& member) -> Member {
+        (void)read(field, member);
+        return std::move(member);
+    }
+    [[nodiscard]] auto flag(Field field, uint8_t bit) const -> bool {
+        return (read(field, flags_) & bit) != 0U;
+    }
+    [[nodiscard]] auto decoded(Field field) const -> bool {
+        return (decoded_ & (1U << static_cast<unsigned>(field))) != 0U;
+    }
+    void guard_with(std::mutex* mtx) { guard_.mtx = mtx; }
+    // Decodes field from source_, under guard_ if there is one.
+    void resolve(Field field) const;
+    // The same, for callers that hold guard_ or own a copy.
+    void resolve_unlocked(Field field) const;
+    void resolveAll() const;
+    /*
+     * View mode counterpart of parsing every entry of dict: keeps dict as
+     * source_ and only decodes the scalar fields, in place.
+     */
+    void keep(GVariant* dict);
 
     void update(const gchar* key, GVariant* value);
 
     friend class ConnmanService;
+    friend class Service;
     friend class DBusProxy<ServProperties>;
+    friend struct ServPropertiesDict;
+    template <class Properties>
+    friend struct PropertyDescriptors;
 };
 
 class Service : public DBusProxy<ServProperties> {
@@ -246,8 +421,38 @@ class Service : public DBusProxy<ServProperties> {
     using DBusProxy::DBusProxy;
     Service(DBus* dbus, const gchar* obj_path);
 
+    uint32_t id_{0U};
+    std::atomic<bool> lazy_properties_{false};
+    // Whether State was last seen ready or online; D-Bus thread only.
+    bool connected_{false};
+    /*
+     * Set by the Manager to keep its ServiceTable row in sync; connected
+     * tells that State just turned ready or online.
+     */
+    std::function<void(uint32_t id, const ServProperties& properties,
+                        bool connected)>
+        on_updated_;
+
+    // Whether State just turned ready or online, see connected_.
+    auto became_connected(const ServProperties& properties) -> bool {
+        const auto state = properties.getState();
+        const bool connected = state == ServProperties::State::Ready ||
+                               state == ServProperties::State::Online;
+        const bool was_connected = std::exchange(connected_, connected);
+        return connected && !was_connected;
+    }
+
+    // Given up on by the Manager's pool: its path is not expected back.
+    void retire() { clearPropertyChangedCallback(); }
+
+   protected:
+    void onPropertiesUpdated(const ServProperties& properties) override;
+    void applyProperties(ServProperties& properties, GVariant* dict) override;
+
    public:
     using Properties = ServProperties;
+    // Stable identifier assigned by the Manager, see ServiceTable::Id.
+    [[nodiscard]] auto id() const { return id_; }
     void connect(PropertiesSetCallback callback = nullptr);
     void disconnect(PropertiesSetCallback callback = nullptr);
     void remove(PropertiesSetCallback callback = nullptr);
@@ -256,6 +461,7 @@ class Service : public DBusProxy<ServProperties> {
     void setNameServers(const std::vector<std::string>& name_servers,
                         PropertiesSetCallback callback = nullptr);
     friend class Manager;
+    friend class RecycledProxies<Service>;
 };
 
 }  // namespace Amarula::DBus::G::Connman
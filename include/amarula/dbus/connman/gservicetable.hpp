@@ -0,0 +1,96 @@
+#pragma once
+
+#include <amarula/dbus/connman/gservice.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace Amarula::DBus::G::Connman {
+
+/*
+ * Column oriented copy of the scalar properties of every service known to the
+ * Manager, kept in the same order as Manager::services().
+ *
+ * Each column is a dense array, so scanning the state or the strength of
+ * hundreds of services touches a few cache lines instead of one heap object
+ * per service. The match*() primitives are branch-free loops over a single
+ * column that the compiler vectorizes; they produce a Mask (one byte per row)
+ * that can be combined with all()/any() and turned into rows with select().
+ */
+class ServiceTable {
+   public:
+    using Row = std::size_t;
+    using Id = uint32_t;
+    using Mask = std::vector<uint8_t>;
+    using State = ServProperties::State;
+    using Type = ServProperties::Type;
+
+    enum Flag : uint8_t {
+        Favorite = 1U << 0U,
+        AutoConnect = 1U << 1U,
+        Immutable = 1U << 2U,
+        Roaming = 1U << 3U,
+        MDNS = 1U << 4U,
+    };
+
+    [[nodiscard]] auto size() const { return ids_.size(); }
+    [[nodiscard]] auto empty() const { return ids_.empty(); }
+
+    [[nodiscard]] auto id(Row row) const { return ids_[row]; }
+    [[nodiscard]] auto state(Row row) const { return states_[row]; }
+    [[nodiscard]] auto type(Row row) const { return types_[row]; }
+    [[nodiscard]] auto strength(Row row) const { return strengths_[row]; }
+    [[nodiscard]] auto flags(Row row) const { return flags_[row]; }
+
+    [[nodiscard]] auto ids() const -> std::span<const Id> { return ids_; }
+    [[nodiscard]] auto states() const -> std::span<const State> {
+        return states_;
+    }
+    [[nodiscard]] auto types() const -> std::span<const Type> {
+        return types_;
+    }
+    [[nodiscard]] auto strengths() const -> std::span<const uint8_t> {
+        return strengths_;
+    }
+    [[nodiscard]] auto flags() const -> std::span<const uint8_t> {
+        return flags_;
+    }
+
+    [[nodiscard]] auto row(Id service_id) const -> std::optional<Row>;
+
+    [[nodiscard]] auto matchState(State state) const -> Mask;
+    [[nodiscard]] auto matchType(Type type) const -> Mask;
+    [[nodiscard]] auto matchStrengthAtLeast(uint8_t strength) const -> Mask;
+    // Rows having every flag of flag_mask set.
+    [[nodiscard]] auto matchFlags(uint8_t flag_mask) const -> Mask;
+
+    [[nodiscard]] static auto all(const Mask& lhs, const Mask& rhs) -> Mask;
+    [[nodiscard]] static auto any(const Mask& lhs, const Mask& rhs) -> Mask;
+    [[nodiscard]] static auto count(const Mask& mask) -> std::size_t;
+
+    [[nodiscard]] auto select(const Mask& mask) const -> std::vector<Row>;
+    // Row with the highest strength among the selected ones.
+    [[nodiscard]] auto strongest(const Mask& mask) const -> std::optional<Row>;
+
+   private:
+    std::vector<Id> ids_;
+    std::vector<State> states_;
+    std::vector<Type> types_;
+    std::vector<uint8_t> strengths_;
+    std::vector<uint8_t> flags_;
+    std::unordered_map<Id, Row> rows_;
+
+    void clear();
+    void reserve(std::size_t size);
+    void append(Id service_id, const ServProperties& properties);
+    void update(Id service_id, const ServProperties& properties);
+
+    static auto to_flags(const ServProperties& properties) -> uint8_t;
+
+    friend class Manager;
+};
+
+}  // namespace Amarula::DBus::G::Connman
@@ -3,8 +3,10 @@
 
 #include <amarula/dbus/gdbus.hpp>
 #include <amarula/dbus/gproxy.hpp>
+#include <cstddef>
 #include <cstdint>
 #include <string>
+#include <utility>
 
 namespace Amarula::DBus::G::Connman {
 class Manager;
@@ -20,21 +22,31 @@ struct TechProperties {
         Wired,
         P2p,
         Gps,
-        Gadget
+        Gadget,
+        Unknown  // not counted in TYPE_COUNT
     };
+    static constexpr auto TYPE_COUNT =
+        static_cast<std::size_t>(Type::Gadget) + 1U;
 
-    [[nodiscard]] auto getName() const { return name_; }
+    [[nodiscard]] auto getName() const& -> const auto& { return name_; }
+    [[nodiscard]] auto getName() && { return std::move(name_); }
     [[nodiscard]] auto getType() const { return type_; }
     [[nodiscard]] auto isPowered() const { return powered_; }
     [[nodiscard]] auto isConnected() const { return connected_; }
     [[nodiscard]] auto isTethering() const { return tethering_; }
     [[nodiscard]] auto getTetheringFreq() const { return tethering_freq_; }
-    [[nodiscard]] auto getTetheringIdentifier() const {
+    [[nodiscard]] auto getTetheringIdentifier() const& -> const auto& {
         return tethering_identifier_;
     }
-    [[nodiscard]] auto getTetheringPassphrase() const {
+    [[nodiscard]] auto getTetheringIdentifier() && {
+        return std::move(tethering_identifier_);
+    }
+    [[nodiscard]] auto getTetheringPassphrase() const& -> const auto& {
         return tethering_passphrase_;
     }
+    [[nodiscard]] auto getTetheringPassphrase() && {
+        return std::move(tethering_passphrase_);
+    }
     friend auto operator<<(std::ostream& ostr,
                            const TechProperties& object) -> std::ostream&;
 
@@ -45,13 +57,15 @@ struct TechProperties {
     std::string name_;
     std::string tethering_identifier_;
     std::string tethering_passphrase_;
-    Type type_;
+    Type type_{Type::Unknown};
     int tethering_freq_{0};
 
     void update(const gchar* key, GVariant* value);
 
     friend class ConnmanTechnology;
     friend class DBusProxy<TechProperties>;
+    template <class Properties>
+    friend struct PropertyDescriptors;
 };
 
 class Technology : public DBusProxy<TechProperties> {
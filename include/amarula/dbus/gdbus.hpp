@@ -3,10 +3,14 @@
 #include <gio/gio.h>
 #include <glib.h>
 
+#include <amarula/dbus/gtransport.hpp>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <vector>
 
 namespace Amarula::DBus::G {
 
@@ -16,14 +20,20 @@ class DBus {
     bool running_{false};
     std::thread glib_thread_;
     unsigned int pending_calls_{0};
-    GDBusConnection* connection_ = nullptr;
     GMainLoop* loop_{nullptr};
     GMainContext* ctx_{nullptr};
+    std::unique_ptr<Transport> transport_;
 
     static auto on_loop_started(gpointer user_data) -> gboolean;
 
    public:
+    /*
+     * Connects to the system bus with kind, which is Transport::defaultKind()
+     * unless given, and checks that object_path of bus_name is there.
+     */
     DBus(const std::string& bus_name, const std::string& object_path);
+    DBus(const std::string& bus_name, const std::string& object_path,
+         TransportKind kind);
 
     DBus(const DBus&) = delete;
     auto operator=(const DBus&) -> DBus& = delete;
@@ -36,7 +46,20 @@ class DBus {
     void onAnyAsyncStart();
     void stop();
 
-    [[nodiscard]] auto connection() const { return connection_; }
+    /*
+     * GDBus parses every message into a tree of GVariants, one per element.
+     * The bodies of the incoming signals named one of members are serialised
+     * into a single buffer right there, on the GDBus worker thread, so that
+     * their handlers on the D-Bus thread can walk them in place with
+     * VariantView; the sd-bus transport serialises them once converted.
+     * Replaces the members of an earlier call; none by default.
+     */
+    void setFlatSignals(std::vector<std::string> members);
+    [[nodiscard]] auto flatSignal(std::string_view member) const -> bool;
+
+    [[nodiscard]] auto transport() const -> Transport& { return *transport_; }
+    // Null unless the transport is GDBus.
+    [[nodiscard]] auto connection() const { return transport_->connection(); }
     [[nodiscard]] auto context() const { return ctx_; }
 };
 
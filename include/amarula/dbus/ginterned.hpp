@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace Amarula::DBus::G {
+
+/*
+ * String kept once per process in a shared pool: equal strings share their
+ * storage and compare by pointer.
+ *
+ * Meant for values hundreds of services repeat, such as nameservers, domains
+ * and timeservers. The pool only grows, so it must not be fed values without
+ * a small bound, like service names. Interning takes a lock; copying and
+ * comparing do not.
+ */
+class InternedString {
+   public:
+    InternedString() = default;
+    explicit InternedString(std::string_view str);
+
+    [[nodiscard]] auto str() const -> const std::string& {
+        return str_ != nullptr ? *str_ : empty_string();
+    }
+    [[nodiscard]] auto empty() const -> bool { return str_ == nullptr; }
+
+    // For code written against the std::string members these replace.
+    // NOLINTNEXTLINE(google-explicit-constructor)
+    operator const std::string&() const { return str(); }
+    // NOLINTNEXTLINE(google-explicit-constructor)
+    operator std::string_view() const { return str(); }
+
+    friend auto operator==(InternedString lhs, InternedString rhs) -> bool {
+        return lhs.str_ == rhs.str_;
+    }
+    friend auto operator==(InternedString lhs, std::string_view rhs) -> bool {
+        return lhs.str() == rhs;
+    }
+    friend auto operator<<(std::ostream& ostr, InternedString object)
+        -> std::ostream& {
+        return ostr << object.str();
+    }
+
+    // Distinct strings in the pool, for diagnostics.
+    [[nodiscard]] static auto poolSize() -> std::size_t;
+
+   private:
+    // nullptr for the empty string, so that it needs no pool entry.
+    const std::string* str_{nullptr};
+
+    [[nodiscard]] static auto empty_string() -> const std::string& {
+        static const std::string EMPTY;
+        return EMPTY;
+    }
+};
+
+}  // namespace Amarula::DBus::G
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace Amarula::DBus::G {
+
+/*
+ * Drop-in replacement for std::mutex that records how long it is held.
+ *
+ * The hold time is measured between acquiring and releasing the lock, so it
+ * reflects the length of the critical sections and not the time spent waiting
+ * for them. Two steady_clock reads per lock; the statistics are atomics so
+ * they can be read without taking the lock.
+ */
+class ProfiledMutex {
+   public:
+    struct Stats {
+        uint64_t acquisitions{0U};
+        std::chrono::nanoseconds total_hold{0};
+        std::chrono::nanoseconds max_hold{0};
+    };
+
+    void lock() {
+        mtx_.lock();
+        locked_at_ = Clock::now();
+    }
+
+    auto try_lock() -> bool {  // NOLINT(readability-identifier-naming)
+        if (!mtx_.try_lock()) {
+            return false;
+        }
+        locked_at_ = Clock::now();
+        return true;
+    }
+
+    void unlock() {
+        const auto held = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              Clock::now() - locked_at_)
+                              .count();
+        // Only the owner of the lock writes, so no read-modify-write loop is
+        // needed for the maximum.
+        acquisitions_.fetch_add(1U, std::memory_order_relaxed);
+        total_hold_ns_.fetch_add(held, std::memory_order_relaxed);
+        if (held > max_hold_ns_.load(std::memory_order_relaxed)) {
+            max_hold_ns_.store(held, std::memory_order_relaxed);
+        }
+        mtx_.unlock();
+    }
+
+    [[nodiscard]] auto stats() const -> Stats {
+        return {acquisitions_.load(std::memory_order_relaxed),
+                std::chrono::nanoseconds(
+                    total_hold_ns_.load(std::memory_order_relaxed)),
+                std::chrono::nanoseconds(
+                    max_hold_ns_.load(std::memory_order_relaxed))};
+    }
+
+    void resetStats() {
+        acquisitions_.store(0U, std::memory_order_relaxed);
+        total_hold_ns_.store(0, std::memory_order_relaxed);
+        max_hold_ns_.store(0, std::memory_order_relaxed);
+    }
+
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    std::mutex mtx_;
+    Clock::time_point locked_at_;
+    std::atomic<uint64_t> acquisitions_{0U};
+    std::atomic<int64_t> total_hold_ns_{0};
+    std::atomic<int64_t> max_hold_ns_{0};
+};
+
+/*
+ * Mutex of the objects whose lock hold times can be looked at: a
+ * ProfiledMutex when built with DBUS_LOCK_STATS, a plain std::mutex
+ * otherwise, so that release builds do not read the clock on every lock.
+ */
+#ifdef AMARULA_DBUS_LOCK_STATS
+using StatsMutex = ProfiledMutex;
+#else
+using StatsMutex = std::mutex;
+#endif
+
+}  // namespace Amarula::DBus::G
@@ -5,10 +5,14 @@
 #include <glib.h>
 
 #include <amarula/dbus/gdbus.hpp>
+#include <amarula/dbus/ginterned.hpp>
+#include <amarula/dbus/gtransport.hpp>
+#include <amarula/dbus/gvariant_view.hpp>
 #include <amarula/log.hpp>
 #include <any>
 #include <array>
 #include <cstddef>
+#include <cstring>
 #include <functional>
 #include <map>
 #include <memory>
@@ -16,9 +20,18 @@
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace Amarula::DBus::G {
 
+/*
+ * Remote object of a D-Bus service, its properties and their signals.
+ *
+ * Calls and signal subscriptions go straight to the Transport of the DBus: no
+ * GDBusProxy, whose name owner tracking and property cache connman objects do
+ * not use, stands behind each object.
+ */
 template <class Properties>
 class DBusProxy : public std::enable_shared_from_this<DBusProxy<Properties>> {
    public:
@@ -30,80 +43,189 @@ class DBusProxy : public std::enable_shared_from_this<DBusProxy<Properties>> {
     std::mutex mtx_;
     std::mutex cb_mtx_;
     size_t callback_counter_{0U};
-    GDBusProxy* proxy_;
     DBus* dbus_;
+    // Shared by every object of a service, e.g. net.connman.Service.
+    InternedString name_;
+    InternedString interface_;
+    std::string obj_path_;
+    // Signal subscriptions on the transport, dropped with this object.
+    std::vector<guint> subscriptions_;
     std::map<size_t, std::any> callbacks_;
     Properties props_;
     PropertiesCallback on_property_changed_user_cb_{nullptr};
+    /*
+     * Value of the last PropertyChanged per key, referenced rather than
+     * copied. connman re-emits unchanged values, such as Strength or State
+     * while scanning, and those are dropped before anything is decoded.
+     * Only touched on the D-Bus thread.
+     */
+    std::map<std::string, GVariant*, std::less<>> last_values_;
+
+    // Whether value repeats the last one for key; records it otherwise.
+    auto repeats_last_value(const gchar* key, GVariant* value) -> bool {
+        const auto last = last_values_.find(std::string_view(key));
+        if (last == last_values_.end()) {
+            last_values_.emplace(key, g_variant_ref(value));
+            return false;
+        }
+        // Compares the serialised bytes: no decoding, and unlike
+        // g_variant_hash() it also takes the a{sv} of IPv4 and the like.
+        if (g_variant_equal(last->second, value) != 0) {
+            return true;
+        }
+        g_variant_unref(last->second);
+        last->second = g_variant_ref(value);
+        return false;
+    }
+
+    // The same for a value read in place, without a GVariant for it.
+    [[nodiscard]] auto repeats_last_value(
+        std::string_view key, const VariantView::Boxed& value) const -> bool {
+        const auto last = last_values_.find(key);
+        if (last == last_values_.end()) {
+            return false;
+        }
+        // What g_variant_equal() compares for values GLib serialised.
+        GVariant* known = last->second;
+        const auto size = value.value.size();
+        return value.type == g_variant_get_type_string(known) &&
+               size == g_variant_get_size(known) &&
+               (size == 0U || std::memcmp(value.value.data(),
+                                          g_variant_get_data(known),
+                                          size) == 0);
+    }
+
+    void forget_last_values() {
+        for (auto& [key, value] : last_values_) {
+            g_variant_unref(value);
+        }
+        last_values_.clear();
+    }
 
-    void update_property(GVariant* prop) {
+    // false when the value was the same as last time and nothing changed.
+    auto update_property(GVariant* prop) -> bool {
         GVariant* key_variant = g_variant_get_child_value(prop, 0);
-        const gchar* key = g_variant_get_string(key_variant, nullptr);
+        const bool changed = update_property(
+            prop, g_variant_get_string(key_variant, nullptr));
+        g_variant_unref(key_variant);
+        return changed;
+    }
+
+    // The same with the key of prop already at hand.
+    auto update_property(GVariant* prop, const gchar* key) -> bool {
         GVariant* value = g_variant_get_child_value(prop, 1);
         GVariant* variant = g_variant_get_variant(value);
-        props_.update(key, variant);
-        g_variant_unref(key_variant);
+        const bool changed = !repeats_last_value(key, variant);
+        if (changed) {
+            std::lock_guard<std::mutex> const lock(mtx_);
+            props_.update(key, variant);
+        }
         g_variant_unref(variant);
         g_variant_unref(value);
+        return changed;
+    }
+
+    /*
+     * update_property() for parameters DBus::setFlatSignals() serialised: a
+     * value that repeats the last one is dropped without creating a single
+     * GVariant. Nothing when parameters are not a (sv).
+     */
+    auto update_property_in_place(GVariant* parameters) -> std::optional<bool> {
+        if (g_variant_is_of_type(parameters, G_VARIANT_TYPE("(sv)")) == 0) {
+            return std::nullopt;
+        }
+        const auto members =
+            VariantView::of(parameters).pair(VariantView::VARIANT_ALIGNMENT);
+        if (!members) {
+            return std::nullopt;
+        }
+        const auto key = members->first.asString();
+        const auto boxed = members->second.asVariant();
+        if (!key || !boxed) {
+            return std::nullopt;
+        }
+        if (repeats_last_value(*key, *boxed)) {
+            return false;
+        }
+        // The nul ending the key is part of the data.
+        return update_property(parameters, key->data());
     }
 
     static void on_properties_changed_cb(
-        GDBusProxy* /*proxy*/, gchar* /*sender_name*/, gchar* /*signal_name*/,
+        const gchar* signal_name,
         GVariant* parameters /*string name, variant value*/,
         gpointer user_data) {
         auto self = static_cast<DBusProxy*>(user_data);
-        self->update_property(parameters);
+        const auto in_place = self->dbus_->flatSignal(signal_name)
+                                  ? self->update_property_in_place(parameters)
+                                  : std::nullopt;
+        if (!(in_place ? *in_place : self->update_property(parameters))) {
+            return;
+        }
+        self->onPropertiesUpdated(self->props_);
         if (self->on_property_changed_user_cb_) {
             std::lock_guard<std::mutex> const lock(self->cb_mtx_);
             self->on_property_changed_user_cb_(self->props_);
         }
     }
 
-    static void get_property_cb(GObject* proxy, GAsyncResult* res,
+    static void get_property_cb(GVariant* reply, const GError* error,
                                 gpointer user_data) {
-        GError* error = nullptr;
-        GVariant* out_properties = nullptr;
         std::unique_ptr<CallbackData> data(
             static_cast<CallbackData*>(user_data));
         auto self = data->getSelf();
         const auto counter = data->getCounter();
-        const auto success =
-            finish(G_DBUS_PROXY(proxy), res, &error, &out_properties);
 
-        if (success) {
+        if (reply != nullptr) {
+            GVariant* out_properties = g_variant_get_child_value(reply, 0);
             self->updateProperties(out_properties);
             g_variant_unref(out_properties);
         } else {
             LCM_LOG(error->message << '\n');
-            g_error_free(error);
         }
         self->template executeCallBack<PropertiesCallback>(counter,
                                                            self->props_);
     }
 
    protected:
-    template <typename Callback>
-    void connectSignal(const std::string& signal_name, Callback callback,
+    /*
+     * Runs on the D-Bus thread once a PropertyChanged signal has been applied
+     * to the properties, before the user callback is invoked.
+     */
+    virtual void onPropertiesUpdated(const Properties& /*properties*/) {}
+
+    /*
+     * Subscribes callback to signal_name of this object. The subscription is
+     * made on the D-Bus thread, so that is where callback runs.
+     */
+    void connectSignal(const std::string& signal_name,
+                       Transport::SignalCallback callback,
                        gpointer user_data) {
         struct Data {
-            GDBusProxy* proxy;
+            DBusProxy* proxy;
             std::string signal_name;
-            Callback callback;
+            Transport::SignalCallback callback;
             gpointer user_data;
             std::mutex mtx;
             std::condition_variable cv;
             bool done{false};
         };
 
-        Data data{proxy_, signal_name, callback, user_data};
+        Data data{this, signal_name, callback, user_data};
 
         g_main_context_invoke_full(
             dbus_->context(), G_PRIORITY_DEFAULT,
             [](gpointer user_data) -> gboolean {
                 auto* data = static_cast<Data*>(user_data);
-
-                g_signal_connect(data->proxy, data->signal_name.c_str(),
-                                 G_CALLBACK(data->callback), data->user_data);
+                auto* proxy = data->proxy;
+
+                const auto subscription = proxy->dbus_->transport().subscribe(
+                    proxy->name_.str().c_str(),
+                    proxy->interface_.str().c_str(), data->signal_name.c_str(),
+                    proxy->obj_path_.c_str(), data->callback, data->user_data);
+                if (subscription != 0U) {
+                    proxy->subscriptions_.push_back(subscription);
+                }
 
                 return G_SOURCE_REMOVE;
             },
@@ -123,29 +245,41 @@ class DBusProxy : public std::enable_shared_from_this<DBusProxy<Properties>> {
         }
     }
 
-    void updateProperties(GVariant* properties) {
-        GVariantIter* iter = g_variant_iter_new(properties);
-        GVariant* prop = nullptr;
+    void resetProperties() {
+        std::lock_guard<std::mutex> const lock(mtx_);
+        props_ = Properties{};
+        forget_last_values();
+    }
 
-        while ((prop = g_variant_iter_next_value(iter)) != nullptr) {
-            update_property(prop);
-            g_variant_unref(prop);
+    /*
+     * Applies a whole a{sv} dict, as answered to GetProperties or carried by
+     * a list signal, to properties. Decodes every entry unless overridden.
+     * Runs with the lock of properties() held.
+     */
+    virtual void applyProperties(Properties& properties, GVariant* dict) {
+        GVariantIter iter;
+        g_variant_iter_init(&iter, dict);
+        const gchar* key = nullptr;
+        GVariant* value = nullptr;
+        while (g_variant_iter_next(&iter, "{&sv}", &key, &value) != 0) {
+            properties.update(key, value);
+            g_variant_unref(value);
         }
-        g_variant_iter_free(iter);
     }
 
-    static auto finish(GDBusProxy* proxy, GAsyncResult* res, GError** error,
-                       GVariant** out_properties = nullptr) {
-        GVariant* ret = nullptr;
-        ret = g_dbus_proxy_call_finish(proxy, res, error);
-        if (ret != nullptr) {
-            if (out_properties != nullptr) {
-                *out_properties = g_variant_get_child_value(ret, 0);
-            }
-            g_variant_unref(ret);
-            return true;
-        }
-        return false;
+    // Values from a whole dict supersede the ones PropertyChanged carried.
+    void updateProperties(GVariant* properties) {
+        forget_last_values();
+        std::lock_guard<std::mutex> const lock(mtx_);
+        applyProperties(props_, properties);
+    }
+
+    /*
+     * The properties themselves rather than a snapshot, for the D-Bus thread:
+     * it is the only one to change them, so it reads them without the lock.
+     */
+    [[nodiscard]] auto currentProperties() const -> const Properties& {
+        return props_;
     }
 
    public:
@@ -154,23 +288,29 @@ class DBusProxy : public std::enable_shared_from_this<DBusProxy<Properties>> {
     DBusProxy(DBusProxy&&) = delete;
     auto operator=(DBusProxy&&) = delete;
     virtual ~DBusProxy() {
-        if (proxy_ != nullptr) {
-            g_signal_handlers_disconnect_matched(proxy_, G_SIGNAL_MATCH_FUNC, 0,
-                                                 0, nullptr, nullptr, nullptr);
-            g_object_unref(proxy_);
+        for (const auto subscription : subscriptions_) {
+            dbus_->transport().unsubscribe(subscription);
         }
+        forget_last_values();
     }
 
+    /*
+     * Snapshot of the properties. Their getters return references into it
+     * rather than copies, so keep the snapshot itself while using them.
+     * Called on the temporary, as in properties().getName(), they return
+     * the value instead. A range-for over *properties().getNameservers()
+     * still reads a destroyed list until C++23: name the snapshot first.
+     */
     [[nodiscard]] auto properties() {
         std::lock_guard<std::mutex> lock(mtx_);
         return props_;
     }
 
-    [[nodiscard]] auto proxy() const { return proxy_; }
     [[nodiscard]] auto dbus() const { return dbus_; }
-    [[nodiscard]] auto objPath() const {
-        const auto* path = g_dbus_proxy_get_object_path(proxy_);
-        return path != nullptr ? std::string(path) : std::string();
+    [[nodiscard]] auto objPath() const { return obj_path_; }
+    // Valid as long as this object.
+    [[nodiscard]] auto objPathView() const -> std::string_view {
+        return obj_path_;
     }
 
     void getProperties(PropertiesCallback callback = nullptr) {
@@ -187,6 +327,12 @@ class DBusProxy : public std::enable_shared_from_this<DBusProxy<Properties>> {
     }
 
    protected:
+    // Drops the onPropertyChanged() callback, e.g. once the object is gone.
+    void clearPropertyChangedCallback() {
+        std::lock_guard<std::mutex> const lock(cb_mtx_);
+        on_property_changed_user_cb_ = nullptr;
+    }
+
     struct CallbackData {
        private:
         std::shared_ptr<DBusProxy> self_;
@@ -219,62 +365,25 @@ class DBusProxy : public std::enable_shared_from_this<DBusProxy<Properties>> {
     explicit DBusProxy(DBus* dbus, const std::string& name,
                        const std::string& obj_path,
                        const std::string& interface_name)
-        : dbus_{dbus} {
-        struct Data {
-            DBusProxy* proxy;
-            std::string name;
-            std::string obj_path;
-            std::string interface_name;
-            std::mutex mtx;
-            std::condition_variable cv;
-            bool done{false};
-            std::string error;
-        };
-
-        auto data = Data{this, name, obj_path, interface_name};
-
-        g_main_context_invoke_full(
-            dbus_->context(), G_PRIORITY_HIGH,
-            [](gpointer user_data) -> gboolean {
-                auto* data = static_cast<Data*>(user_data);
-
-                GError* err = nullptr;
-
-                data->proxy->proxy_ = g_dbus_proxy_new_sync(
-                    data->proxy->dbus_->connection(), G_DBUS_PROXY_FLAGS_NONE,
-                    nullptr, data->name.c_str(), data->obj_path.c_str(),
-                    data->interface_name.c_str(), nullptr, &err);
-
-                if (data->proxy->proxy_ == nullptr) {
-                    data->error =
-                        "Failed to create proxy: " + std::string(err->message);
-                    g_error_free(err);
-                } else {
-                    g_signal_connect(
-                        data->proxy->proxy_, "g-signal::PropertyChanged",
-                        G_CALLBACK(&DBusProxy::on_properties_changed_cb),
-                        data->proxy);
-                }
-
-                return G_SOURCE_REMOVE;
-            },
-            &data,
-            [](gpointer user_data) {
-                auto* data = static_cast<Data*>(user_data);
-                {
-                    std::lock_guard<std::mutex> const lock(data->mtx);
-                    data->done = true;
-                }
-                data->cv.notify_all();
-            });
-        {
-            std::unique_lock<std::mutex> lock(data.mtx);
-            data.cv.wait(lock, [&] { return data.done; });
+        : dbus_{dbus},
+          name_{name},
+          interface_{interface_name},
+          obj_path_{obj_path} {
+        if (g_dbus_is_name(name.c_str()) == 0 ||
+            g_variant_is_object_path(obj_path.c_str()) == 0 ||
+            g_dbus_is_interface_name(interface_name.c_str()) == 0) {
+            throw std::runtime_error("Failed to create proxy: invalid " + name +
+                                     " " + obj_path + " " + interface_name);
         }
-
-        if (!data.error.empty()) {
-            throw std::runtime_error(data.error);
+        // Properties decoded on first read decode under the lock properties()
+        // copies them with.
+        if constexpr (requires(Properties& props, std::mutex* mtx) {
+                          props.guard_with(mtx);
+                      }) {
+            props_.guard_with(&mtx_);
         }
+        connectSignal("PropertyChanged", &DBusProxy::on_properties_changed_cb,
+                      this);
     }
 
     template <typename T>
@@ -291,14 +400,11 @@ class DBusProxy : public std::enable_shared_from_this<DBusProxy<Properties>> {
         return std::make_unique<CallbackData>(self, counter);
     }
 
-    static void finishAsyncCall(GObject* proxy, GAsyncResult* res,
+    static void finishAsyncCall(GVariant* reply, const GError* error,
                                 gpointer user_data) {
-        GError* error = nullptr;
-
-        const auto success = finish(G_DBUS_PROXY(proxy), res, &error);
+        const auto success = reply != nullptr;
         if (!success) {
             LCM_LOG(error->message << '\n');
-            g_error_free(error);
         }
 
         std::unique_ptr<CallbackData> data(
@@ -309,8 +415,8 @@ class DBusProxy : public std::enable_shared_from_this<DBusProxy<Properties>> {
     }
 
     void setProperty(const gchar* arg_name, GVariant* arg_value,
-                     GCancellable* cancellable, GAsyncReadyCallback callback,
-                     gpointer user_data
+                     GCancellable* cancellable,
+                     Transport::ReplyCallback callback, gpointer user_data
 
     ) {
         std::array<GVariant*, 2> tuple_elements{
@@ -321,19 +427,25 @@ class DBusProxy : public std::enable_shared_from_this<DBusProxy<Properties>> {
     }
 
     void callMethod(GCancellable* cancellable, const std::string& arg_name,
-                    GVariant* parameters, GAsyncReadyCallback callback,
+                    GVariant* parameters, Transport::ReplyCallback callback,
                     gpointer user_data) {
         struct Data {
-            GDBusProxy* proxy;
+            Transport* transport;
+            const gchar* name;
+            std::string obj_path;
+            const gchar* interface_name;
             std::string arg_name;
             GVariant* parameters;
             GCancellable* cancellable;
-            GAsyncReadyCallback callback;
+            Transport::ReplyCallback callback;
             gpointer user_data;
         };
 
+        // Interned strings stay valid even if this object is gone by the
+        // time the call is made; the path is copied.
         auto data = std::make_unique<Data>(
-            Data{proxy_, arg_name,
+            Data{&dbus_->transport(), name_.str().c_str(), obj_path_,
+                 interface_.str().c_str(), arg_name,
                  (parameters != nullptr)
                      ? g_variant_ref_sink(parameters)
                      : g_variant_ref_sink(g_variant_new_tuple(nullptr, 0)),
@@ -347,10 +459,10 @@ class DBusProxy : public std::enable_shared_from_this<DBusProxy<Properties>> {
             [](gpointer user_data) -> gboolean {
                 auto* data = static_cast<Data*>(user_data);
 
-                g_dbus_proxy_call(data->proxy, data->arg_name.c_str(),
-                                  data->parameters, G_DBUS_CALL_FLAGS_NONE, -1,
-                                  data->cancellable, data->callback,
-                                  data->user_data);
+                data->transport->call(
+                    data->name, data->obj_path.c_str(), data->interface_name,
+                    data->arg_name.c_str(), data->parameters,
+                    data->cancellable, data->callback, data->user_data);
 
                 return G_SOURCE_REMOVE;
             },
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace Amarula::DBus::G {
+
+/*
+ * Vector that keeps up to N elements inline and only moves them to the heap
+ * beyond that. Property lists such as nameservers or security methods nearly
+ * always have one to four entries, so decoding them no longer allocates the
+ * list itself.
+ *
+ * The interface is the subset of std::vector the library and its users need,
+ * with the same names so that range-for and std algorithms work unchanged.
+ * The property getters used to return std::vector<std::string> and the like;
+ * a SmallVector converts to a std::vector of anything its elements convert
+ * to, so code that stored them in one still compiles.
+ */
+// NOLINTBEGIN(readability-identifier-naming)
+template <class T, std::size_t N>
+class SmallVector {
+   public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using reference = T&;
+    using const_reference = const T&;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    SmallVector() = default;
+
+    SmallVector(std::initializer_list<T> init) {
+        reserve(init.size());
+        for (const auto& item : init) {
+            push_back(item);
+        }
+    }
+
+    SmallVector(const SmallVector& other) {
+        try {
+            copy_from(other);
+        } catch (...) {
+            // No destructor runs for a constructor that throws.
+            free_heap();
+            throw;
+        }
+    }
+
+    SmallVector(SmallVector&& other) noexcept { take(std::move(other)); }
+
+    auto operator=(const SmallVector& other) -> SmallVector& {
+        if (this != &other) {
+            clear();
+            copy_from(other);
+        }
+        return *this;
+    }
+
+    auto operator=(SmallVector&& other) noexcept -> SmallVector& {
+        if (this != &other) {
+            release();
+            take(std::move(other));
+        }
+        return *this;
+    }
+
+    ~SmallVector() { release(); }
+
+    [[nodiscard]] auto size() const { return size_; }
+    [[nodiscard]] auto capacity() const { return capacity_; }
+    [[nodiscard]] auto empty() const { return size_ == 0U; }
+    // Whether the elements still live in the inline storage.
+    [[nodiscard]] auto isInline() const { return data_ == inline_data(); }
+
+    [[nodiscard]] auto data() -> T* { return data_; }
+    [[nodiscard]] auto data() const -> const T* { return data_; }
+    [[nodiscard]] auto begin() -> iterator { return data_; }
+    [[nodiscard]] auto end() -> iterator { return data_ + size_; }
+    [[nodiscard]] auto begin() const -> const_iterator { return data_; }
+    [[nodiscard]] auto end() const -> const_iterator { return data_ + size_; }
+
+    auto operator[](size_type pos) -> reference { return data_[pos]; }
+    auto operator[](size_type pos) const -> const_reference {
+        return data_[pos];
+    }
+    [[nodiscard]] auto at(size_type pos) -> reference {
+        check(pos);
+        return data_[pos];
+    }
+    [[nodiscard]] auto at(size_type pos) const -> const_reference {
+        check(pos);
+        return data_[pos];
+    }
+    [[nodiscard]] auto front() -> reference { return data_[0]; }
+    [[nodiscard]] auto front() const -> const_reference { return data_[0]; }
+    [[nodiscard]] auto back() -> reference { return data_[size_ - 1U]; }
+    [[nodiscard]] auto back() const -> const_reference {
+        return data_[size_ - 1U];
+    }
+
+    void reserve(size_type capacity) {
+        if (capacity <= capacity_) {
+            return;
+        }
+        auto* heap = allocate(capacity);
+        try {
+            std::uninitialized_move(begin(), end(), heap);
+        } catch (...) {
+            deallocate(heap);
+            throw;
+        }
+        std::destroy(begin(), end());
+        free_heap();
+        data_ = heap;
+        capacity_ = capacity;
+    }
+
+    template <class... Args>
+    auto emplace_back(Args&&... args) -> reference {
+        if (size_ == capacity_) {
+            return grow_and_emplace_back(std::forward<Args>(args)...);
+        }
+        auto* item = std::construct_at(data_ + size_,
+                                       std::forward<Args>(args)...);
+        ++size_;
+        return *item;
+    }
+
+    void push_back(const T& value) { emplace_back(value); }
+    void push_back(T&& value) { emplace_back(std::move(value)); }
+
+    void clear() {
+        std::destroy(begin(), end());
+        size_ = 0U;
+    }
+
+    friend auto operator==(const SmallVector& lhs, const SmallVector& rhs)
+        -> bool {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+
+    template <class U>
+        requires std::constructible_from<U, const T&>
+    // NOLINTNEXTLINE(google-explicit-constructor)
+    operator std::vector<U>() const {
+        return std::vector<U>(begin(), end());
+    }
+
+   private:
+    static_assert(N > 0U, "use std::vector without inline storage");
+
+    alignas(T) std::byte inline_[N * sizeof(T)];
+    T* data_{inline_data()};
+    size_type size_{0U};
+    size_type capacity_{N};
+
+    /*
+     * Where the inline elements go. Not laundered: there may be no element
+     * there yet, and the elements are created through this pointer with
+     * construct_at(), as std::vector does in the storage it allocates.
+     */
+    [[nodiscard]] auto inline_data() const -> T* {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+        return reinterpret_cast<T*>(
+            const_cast<std::byte*>(static_cast<const std::byte*>(inline_)));
+    }
+
+    static auto allocate(size_type capacity) -> T* {
+        return static_cast<T*>(::operator new(capacity * sizeof(T),
+                                              std::align_val_t{alignof(T)}));
+    }
+
+    static void deallocate(T* heap) {
+        ::operator delete(heap, std::align_val_t{alignof(T)});
+    }
+
+    // this must be empty; left empty if an element copy throws.
+    void copy_from(const SmallVector& other) {
+        reserve(other.size_);
+        std::uninitialized_copy(other.begin(), other.end(), data_);
+        size_ = other.size_;
+    }
+
+    /*
+     * The new element is made in the new storage before the old ones move
+     * there, as args may refer to one of them, e.g. v.push_back(v[0]).
+     */
+    template <class... Args>
+    auto grow_and_emplace_back(Args&&... args) -> reference {
+        const auto capacity = capacity_ * 2U;
+        auto* heap = allocate(capacity);
+        T* item = nullptr;
+        try {
+            item = std::construct_at(heap + size_, std::forward<Args>(args)...);
+            std::uninitialized_move(begin(), end(), heap);
+        } catch (...) {
+            if (item != nullptr) {
+                std::destroy_at(item);
+            }
+            deallocate(heap);
+            throw;
+        }
+        std::destroy(begin(), end());
+        free_heap();
+        data_ = heap;
+        capacity_ = capacity;
+        ++size_;
+        return *item;
+    }
+
+    void check(size_type pos) const {
+        if (pos >= size_) {
+            throw std::out_of_range("SmallVector::at");
+        }
+    }
+
+    void free_heap() {
+        if (!isInline()) {
+            deallocate(data_);
+        }
+    }
+
+    void release() {
+        clear();
+        free_heap();
+        data_ = inline_data();
+        capacity_ = N;
+    }
+
+    // Leaves other empty; this must be empty and inline.
+    void take(SmallVector&& other) noexcept {
+        if (other.isInline()) {
+            std::uninitialized_move(other.begin(), other.end(), data_);
+            size_ = other.size_;
+            other.clear();
+            return;
+        }
+        data_ = std::exchange(other.data_, other.inline_data());
+        size_ = std::exchange(other.size_, 0U);
+        capacity_ = std::exchange(other.capacity_, N);
+    }
+};
+// NOLINTEND(readability-identifier-naming)
+
+/*
+ * Lists of connman properties: nameservers, domains, timeservers, proxy
+ * servers and security methods. Their getters returned std::vector before;
+ * assigning the result to one still works, through the conversion above.
+ */
+template <class T>
+using PropertyList = SmallVector<T, 4>;
+
+}  // namespace Amarula::DBus::G
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <gio/gio.h>
+#include <glib.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Amarula::DBus::G {
+
+// Library a Transport talks to the bus with.
+enum class TransportKind : std::uint8_t {
+    GDBus = 0,  // GIO's GDBusConnection
+    SdBus,      // systemd's sd-bus, when built with DBUS_SD_BUS
+};
+
+/*
+ * The message path under DBus and DBusProxy: method calls, signal matches and
+ * exported objects on the system bus. Bodies go in and come out as GVariant
+ * tuples whatever the library, as GDBus hands them over.
+ *
+ * Unless noted otherwise every function must be called on the D-Bus thread,
+ * the one iterating the GMainContext the transport was created with, and
+ * every callback runs there.
+ */
+class Transport {
+   public:
+    // Reply of call(): its body, or null and why; both borrowed.
+    using ReplyCallback = void (*)(GVariant* reply, const GError* error,
+                                   gpointer user_data);
+    using SignalCallback = void (*)(const gchar* signal_name,
+                                    GVariant* parameters, gpointer user_data);
+    /*
+     * An incoming method call, to be completed exactly once with
+     * returnValue() or returnError() of the transport that received it.
+     */
+    struct Invocation;
+    using MethodCallback = void (*)(const gchar* method_name,
+                                    GVariant* parameters,
+                                    Invocation* invocation, gpointer user_data);
+
+    /*
+     * Connects to the system bus, dispatching on context. Throws
+     * std::runtime_error when kind is not available or the bus is not.
+     */
+    static auto create(TransportKind kind, GMainContext* context)
+        -> std::unique_ptr<Transport>;
+    // Whether this build has kind.
+    static auto available(TransportKind kind) -> bool;
+    // The one DBus uses when not told: sd-bus when built with it.
+    static auto defaultKind() -> TransportKind;
+
+    Transport() = default;
+    Transport(const Transport&) = delete;
+    auto operator=(const Transport&) -> Transport& = delete;
+    Transport(Transport&&) = delete;
+    auto operator=(Transport&&) -> Transport& = delete;
+    virtual ~Transport() = default;
+
+    [[nodiscard]] virtual auto kind() const -> TransportKind = 0;
+
+    /*
+     * Blocking call, only before the D-Bus thread runs. Returns the reply
+     * body, or null with error set.
+     */
+    virtual auto callSync(const gchar* name, const gchar* path,
+                          const gchar* interface_name, const gchar* method,
+                          GVariant* parameters, GError** error)
+        -> GVariant* = 0;
+
+    /*
+     * parameters is a tuple, or null for none; a floating reference is taken
+     * over. A cancelled call still gets its callback, with an error.
+     */
+    virtual void call(const gchar* name, const gchar* path,
+                      const gchar* interface_name, const gchar* method,
+                      GVariant* parameters, GCancellable* cancellable,
+                      ReplyCallback callback, gpointer user_data) = 0;
+
+    /*
+     * Returns the id unsubscribe() takes, or 0 when the subscription could
+     * not be made; the reason is logged.
+     */
+    virtual auto subscribe(const gchar* sender, const gchar* interface_name,
+                           const gchar* member, const gchar* path,
+                           SignalCallback callback, gpointer user_data)
+        -> guint = 0;
+    /*
+     * From any thread, without waiting for the D-Bus thread: no signal is
+     * dispatched to user_data once it returns, but a callback already
+     * running there may still be finishing.
+     */
+    virtual void unsubscribe(guint id) = 0;
+
+    /*
+     * Serves the methods of interface at path with callback. Returns the id
+     * unexportObject() takes, or 0 with error set.
+     */
+    virtual auto exportObject(const gchar* path,
+                              GDBusInterfaceInfo* interface,
+                              MethodCallback callback, gpointer user_data,
+                              GError** error) -> guint = 0;
+    // From any thread, like unsubscribe().
+    virtual void unexportObject(guint id) = 0;
+
+    /*
+     * From any thread: the reply is sent from the D-Bus thread. value is a
+     * tuple or null for an empty reply; a floating reference is taken over.
+     */
+    virtual void returnValue(Invocation* invocation, GVariant* value) = 0;
+    virtual void returnError(Invocation* invocation, const gchar* error_name,
+                             const gchar* message) = 0;
+
+    /*
+     * The bodies of the incoming signals named one of members reach their
+     * handlers serialised, so that they can be walked in place with
+     * VariantView; see DBus::setFlatSignals(). From any thread.
+     */
+    virtual void setFlatSignals(std::vector<std::string> members) = 0;
+    [[nodiscard]] virtual auto flatSignal(std::string_view member) const
+        -> bool = 0;
+
+    // The GIO connection behind the GDBus transport, null for the others.
+    [[nodiscard]] virtual auto connection() const -> GDBusConnection* {
+        return nullptr;
+    }
+};
+
+}  // namespace Amarula::DBus::G
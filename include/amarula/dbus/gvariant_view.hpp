@@ -0,0 +1,240 @@
+#pragma once
+
+#include <glib.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+namespace Amarula::DBus::G {
+
+/*
+ * Read-only view over serialised GVariant data, for the hot paths where even
+ * the child references created by g_variant_get_child_value() and the
+ * iterators are too much: it walks the bytes in place and never allocates.
+ *
+ * Only the shapes needed so far are supported. Malformed or unexpected data
+ * is reported, never trusted: every offset is checked against the bounds.
+ */
+class VariantView {
+   public:
+    // Alignment of a{sv}, (oa{sv}) and of anything holding a v.
+    static constexpr std::size_t VARIANT_ALIGNMENT = 8U;
+
+    // The contents of a "v": the type string of the value and its data.
+    struct Boxed;
+
+    constexpr VariantView() = default;
+    constexpr VariantView(const guint8* data, std::size_t size)
+        : data_{data}, size_{size} {}
+
+    /*
+     * value must stay alive while the view is used. Serialises value if it
+     * is not yet, which allocates once: GDBus hands signal parameters over
+     * as a tree of GVariants unless DBus::setFlatSignals() flattened them.
+     */
+    static auto of(GVariant* value) -> VariantView {
+        const auto size = g_variant_get_size(value);
+        return {size != 0U
+                    ? static_cast<const guint8*>(g_variant_get_data(value))
+                    : nullptr,
+                size};
+    }
+
+    [[nodiscard]] constexpr auto data() const { return data_; }
+    [[nodiscard]] constexpr auto size() const { return size_; }
+
+    /*
+     * The contents of an "s" or "o" value, without the trailing nul, or
+     * nothing when the data is not a string. The nul is part of the data, so
+     * the result can be passed on as a C string.
+     */
+    [[nodiscard]] auto asString() const -> std::optional<std::string_view> {
+        if (size_ == 0U || data_[size_ - 1U] != 0U) {
+            return std::nullopt;
+        }
+        return std::string_view(reinterpret_cast<const char*>(data_),
+                                size_ - 1U);
+    }
+
+    /*
+     * The contents of a "v": its value, a nul and the type string of the
+     * value. Nothing when the data is not a variant.
+     */
+    [[nodiscard]] auto asVariant() const -> std::optional<Boxed>;
+
+    /*
+     * The two members of a tuple or dict entry whose members both have a
+     * variable size, such as "(sv)", "{sv}" or "(a(oa{sv})ao)": the end of
+     * the first is stored in the last bytes, the second starts at the next
+     * multiple of second_alignment. Nothing when the data is not such a pair.
+     */
+    [[nodiscard]] auto pair(std::size_t second_alignment) const
+        -> std::optional<std::pair<VariantView, VariantView>> {
+        const auto offset_size = offset_size_for(size_);
+        if (size_ < offset_size) {
+            return std::nullopt;
+        }
+        const auto second_end = size_ - offset_size;
+        const auto first_end = read_offset(second_end, offset_size);
+        if (first_end > second_end) {
+            return std::nullopt;
+        }
+        const auto second_start = align(first_end, second_alignment);
+        if (second_start > second_end) {
+            return std::nullopt;
+        }
+        return std::pair{sub(0U, first_end), sub(second_start, second_end)};
+    }
+
+    /*
+     * Number of elements of an array whose elements have a variable size,
+     * such as "ao" or "a{sv}", or nothing when the data is not one.
+     */
+    [[nodiscard]] auto elementCount() const -> std::optional<std::size_t> {
+        const auto table = offset_table();
+        if (!table) {
+            return std::nullopt;
+        }
+        return (size_ - *table) / offset_size_for(size_);
+    }
+
+    /*
+     * Calls visit(VariantView element) for every element of an array whose
+     * elements have a variable size, each starting at a multiple of
+     * alignment. visit returns false to reject an element. Returns false,
+     * possibly after some elements were visited, when the data is not such
+     * an array or an element was rejected.
+     */
+    template <class Visitor>
+    [[nodiscard]] auto forEachElement(std::size_t alignment,
+                                      Visitor&& visit) const -> bool {
+        const auto table = offset_table();
+        if (!table) {
+            return false;
+        }
+        const auto offset_size = offset_size_for(size_);
+        std::size_t start = 0U;
+        for (auto slot = *table; slot < size_; slot += offset_size) {
+            const auto end = read_offset(slot, offset_size);
+            if (end < start || end > *table) {
+                return false;
+            }
+            if (!visit(sub(start, end))) {
+                return false;
+            }
+            start = align(end, alignment);
+        }
+        return true;
+    }
+
+    /*
+     * Calls visit(std::string_view key, std::string_view type, VariantView
+     * value) for every entry of an "a{sv}", where type is the type string of
+     * the boxed value and value its data. Returns false, possibly after some
+     * entries were visited, when the data is not a valid a{sv}.
+     */
+    template <class Visitor>
+    [[nodiscard]] auto forEachEntry(Visitor&& visit) const -> bool;
+
+   private:
+    static constexpr std::size_t BYTE_BITS = 8U;
+
+    const guint8* data_{nullptr};
+    std::size_t size_{0U};
+
+    [[nodiscard]] constexpr auto sub(std::size_t start, std::size_t end) const
+        -> VariantView {
+        return {data_ + start, end - start};
+    }
+
+    [[nodiscard]] constexpr auto read_offset(std::size_t pos,
+                                             std::size_t offset_size) const
+        -> std::size_t {
+        // Framing offsets are little endian whatever the host.
+        std::size_t offset = 0U;
+        for (std::size_t i = 0; i < offset_size; ++i) {
+            offset |= static_cast<std::size_t>(data_[pos + i])
+                      << (BYTE_BITS * i);
+        }
+        return offset;
+    }
+
+    /*
+     * Start of the framing offsets of an array of variable sized elements,
+     * one per element at the end of the data. The last one tells where the
+     * table starts. An empty array has no data at all.
+     */
+    [[nodiscard]] auto offset_table() const -> std::optional<std::size_t> {
+        if (size_ == 0U) {
+            return size_;
+        }
+        const auto offset_size = offset_size_for(size_);
+        if (size_ < offset_size) {
+            return std::nullopt;
+        }
+        const auto table = read_offset(size_ - offset_size, offset_size);
+        if (table > size_ || (size_ - table) % offset_size != 0U) {
+            return std::nullopt;
+        }
+        return table;
+    }
+
+    static constexpr auto offset_size_for(std::size_t size) -> std::size_t {
+        if (size <= UINT8_MAX) {
+            return 1U;
+        }
+        if (size <= UINT16_MAX) {
+            return 2U;
+        }
+        if (size <= UINT32_MAX) {
+            return 4U;
+        }
+        return 8U;
+    }
+
+    static constexpr auto align(std::size_t pos, std::size_t alignment)
+        -> std::size_t {
+        return (pos + alignment - 1U) & ~(alignment - 1U);
+    }
+};
+
+struct VariantView::Boxed {
+    std::string_view type;
+    VariantView value;
+};
+
+inline auto VariantView::asVariant() const -> std::optional<Boxed> {
+    auto type_start = size_;
+    while (type_start > 0U && data_[type_start - 1U] != 0U) {
+        --type_start;
+    }
+    if (type_start == 0U || type_start == size_) {
+        return std::nullopt;
+    }
+    return Boxed{
+        std::string_view(reinterpret_cast<const char*>(data_ + type_start),
+                         size_ - type_start),
+        sub(0U, type_start - 1U)};
+}
+
+template <class Visitor>
+auto VariantView::forEachEntry(Visitor&& visit) const -> bool {
+    return forEachElement(VARIANT_ALIGNMENT, [&visit](VariantView entry) {
+        const auto members = entry.pair(VARIANT_ALIGNMENT);
+        if (!members) {
+            return false;
+        }
+        const auto key = members->first.asString();
+        const auto boxed = members->second.asVariant();
+        if (!key || !boxed) {
+            return false;
+        }
+        visit(*key, boxed->type, boxed->value);
+        return true;
+    });
+}
+
+}  // namespace Amarula::DBus::G
@@ -4,41 +4,246 @@
 
 #include <amarula/dbus/connman/gagent.hpp>
 #include <amarula/log.hpp>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "gconnman_private.hpp"
+#include "gconnman_worker_pool.hpp"
 
 namespace Amarula::DBus::G::Connman {
-static constexpr const char *INTROSPECTION_XML =
-    "<node>"
-    "  <interface name='net.connman.Agent'>"
-    "    <method name='Release'/>"
-    "    <method name='RequestInput'>"
-    "      <arg name='service' type='o' direction='in'/>"
-    "      <arg name='fields' type='a{sv}' direction='in'/>"
-    "      <arg name='return' type='a{sv}' direction='out'/>"
-    "    </method>"
-    "    <method name='ReportError'>"
-    "      <arg name='service' type='o' direction='in'/>"
-    "      <arg name='error' type='s' direction='in'/>"
-    "    </method>"
-    "    <method name='Cancel'/>"
-    "  </interface>"
-    "</node>";
-
-Agent::Agent(DBus *dbus, const std::string &path) : dbus_{dbus} {
+/*
+ * Introspection data of net.connman.Agent, laid out statically instead of
+ * being parsed from XML for every Agent. A ref_count of -1 tells GDBus it is
+ * static: it is never reference counted nor freed. The sd-bus transport checks
+ * calls against it as well.
+ */
+namespace {
+namespace Introspection {
+
+constexpr auto str(const char *literal) -> gchar * {
+    return const_cast<gchar *>(literal);  // NOLINT(*-const-cast)
+}
+
+GDBusArgInfo service_arg{-1, str("service"), str("o"), nullptr};
+GDBusArgInfo fields_arg{-1, str("fields"), str("a{sv}"), nullptr};
+GDBusArgInfo return_arg{-1, str("return"), str("a{sv}"), nullptr};
+GDBusArgInfo error_arg{-1, str("error"), str("s"), nullptr};
+
+GDBusArgInfo *request_input_in[] = {&service_arg, &fields_arg, nullptr};
+GDBusArgInfo *request_input_out[] = {&return_arg, nullptr};
+GDBusArgInfo *report_error_in[] = {&service_arg, &error_arg, nullptr};
+
+GDBusMethodInfo release{-1, str("Release"), nullptr, nullptr, nullptr};
+GDBusMethodInfo request_input{-1, str("RequestInput"), request_input_in,
+                              request_input_out, nullptr};
+GDBusMethodInfo report_error{-1, str("ReportError"), report_error_in, nullptr,
+                             nullptr};
+GDBusMethodInfo cancel{-1, str("Cancel"), nullptr, nullptr, nullptr};
+
+GDBusMethodInfo *methods[] = {&release, &request_input, &report_error,
+                              &cancel, nullptr};
+
+GDBusInterfaceInfo agent_interface{-1,      str("net.connman.Agent"),
+                                   methods, nullptr,
+                                   nullptr, nullptr};
+
+}  // namespace Introspection
+}  // namespace
+
+struct RequestInputReply::State {
+    GMainContext *ctx;
+    Transport *transport;
+    Transport::Invocation *invocation;  // owned until answered
+    std::atomic<bool> answered{false};
+    GSource *deadline{nullptr};
+    // Held while the deadline reports an expiry, see detach().
+    std::mutex detach_mtx;
+    bool detached{false};
+
+    State(DBus *dbus, Transport::Invocation *method_invocation)
+        : ctx{g_main_context_ref(dbus->context())},
+          transport{&dbus->transport()},
+          invocation{method_invocation} {}
+    State(const State &) = delete;
+    auto operator=(const State &) -> State & = delete;
+    State(State &&) = delete;
+    auto operator=(State &&) -> State & = delete;
+
+    ~State() {
+        answer(nullptr);
+        if (deadline != nullptr) {
+            g_source_unref(deadline);
+        }
+        g_main_context_unref(ctx);
+    }
+
+    /*
+     * Cancels the request if it is still pending after timeout, and then
+     * calls on_expired on the D-Bus thread. Must be armed before the state is
+     * shared.
+     */
+    static void arm_deadline(const std::shared_ptr<State> &state,
+                             std::chrono::milliseconds timeout,
+                             std::function<void()> on_expired) {
+        struct Data {
+            std::weak_ptr<State> state;
+            std::function<void()> on_expired;
+        };
+
+        state->deadline =
+            g_timeout_source_new(static_cast<guint>(timeout.count()));
+        g_source_set_callback(
+            state->deadline,
+            [](gpointer user_data) -> gboolean {
+                auto *data = static_cast<Data *>(user_data);
+                auto expired = data->state.lock();
+                if (!expired) {
+                    return G_SOURCE_REMOVE;
+                }
+                std::lock_guard<std::mutex> const lock(expired->detach_mtx);
+                if (!expired->detached && expired->answer(nullptr) &&
+                    data->on_expired) {
+                    data->on_expired();
+                }
+                return G_SOURCE_REMOVE;
+            },
+            new Data{.state = state, .on_expired = std::move(on_expired)},
+            [](gpointer user_data) { delete static_cast<Data *>(user_data); });
+        g_source_attach(state->deadline, state->ctx);
+    }
+
+    /*
+     * For the Agent going away: the request is canceled while the transport
+     * is still there, and replies coming later are ignored. Waits for an
+     * expiry being reported, whose callback belongs to the Agent's owner,
+     * and keeps the ones to come from being reported.
+     */
+    void detach() {
+        {
+            std::lock_guard<std::mutex> const lock(detach_mtx);
+            detached = true;
+        }
+        static_cast<void>(answer(nullptr));
+    }
+
+    /*
+     * Hands the invocation over to the D-Bus thread, where it is completed
+     * with fields, or with Canceled when fields is null. Returns false when
+     * the request had already been answered.
+     */
+    auto answer(GVariant *fields) -> bool {
+        if (answered.exchange(true)) {
+            if (fields != nullptr) {
+                g_variant_unref(g_variant_ref_sink(fields));
+            }
+            return false;
+        }
+        if (deadline != nullptr) {
+            g_source_destroy(deadline);
+        }
+
+        struct Data {
+            Transport *transport;
+            Transport::Invocation *invocation;
+            GVariant *fields;
+        };
+
+        auto data = std::make_unique<Data>(Data{
+            .transport = transport,
+            .invocation = invocation,
+            .fields = fields != nullptr ? g_variant_ref_sink(fields)
+                                        : nullptr});
+        invocation = nullptr;
+
+        g_main_context_invoke_full(
+            ctx, G_PRIORITY_DEFAULT,
+            [](gpointer user_data) -> gboolean {
+                auto *data = static_cast<Data *>(user_data);
+
+                // Completing the invocation releases it.
+                if (data->fields != nullptr) {
+                    data->transport->returnValue(
+                        data->invocation,
+                        g_variant_new_tuple(&data->fields, 1));
+                } else {
+                    data->transport->returnError(
+                        data->invocation, "net.connman.Agent.Error.Canceled",
+                        "Canceled");
+                }
+
+                return G_SOURCE_REMOVE;
+            },
+            data.release(),
+            [](gpointer user_data) {
+                std::unique_ptr<Data> data(static_cast<Data *>(user_data));
+                if (data->fields != nullptr) {
+                    g_variant_unref(data->fields);
+                }
+            });
+        return true;
+    }
+};
+
+void RequestInputReply::reply(GVariant *fields) const {
+    static_cast<void>(state_->answer(fields));
+}
+
+void RequestInputReply::cancel() const {
+    static_cast<void>(state_->answer(nullptr));
+}
+
+auto RequestInputReply::pending() const -> bool {
+    return !state_->answered.load();
+}
+
+/*
+ * Shared with the timeout sources, whose callbacks may still run while the
+ * Agent is being destroyed. Whoever removes an invocation from pending
+ * answers it and drops the reference pending holds on its source: the source
+ * when the delay is over, the Agent when it goes away.
+ */
+struct DeferredReplies {
+    std::mutex mtx;
+    std::unordered_map<GSource *, Transport::Invocation *> pending;
+};
+
+namespace {
+
+void reply_retry(Transport &transport, Transport::Invocation *invocation) {
+    transport.returnError(invocation, "net.connman.Agent.Error.Retry",
+                          "Retry");
+}
+
+struct PendingRequest {
+    std::function<GVariant *()> work;
+    RequestInputReply reply;
+};
+
+}  // namespace
+
+Agent::Agent(DBus *dbus, const std::string &path)
+    : dbus_{dbus},
+      deferred_replies_{std::make_shared<DeferredReplies>()} {
     if (!path.empty()) {
         path_ = path;
     }
-    GError *err = nullptr;
-    node_info_ = g_dbus_node_info_new_for_xml(INTROSPECTION_XML, &err);
-    if (node_info_ == nullptr) {
-        std::string const msg =
-            "Failed to parse introspection XML: " + std::string(err->message);
-        g_error_free(err);
-        throw std::runtime_error(msg);
+}
+
+void Agent::export_object() {
+    std::lock_guard<std::mutex> const export_lock(export_mtx_);
+    if (registration_id_ != 0) {
+        return;
     }
 
     struct Data {
@@ -51,17 +256,18 @@ Agent::Agent(DBus *dbus, const std::string &path) : dbus_{dbus} {
 
     auto data = Data{this};
 
+    // The transport is only used from the D-Bus thread.
     g_main_context_invoke_full(
-        dbus->context(), G_PRIORITY_HIGH,
+        dbus_->context(), G_PRIORITY_HIGH,
         [](gpointer user_data) -> gboolean {
             auto *data = static_cast<Data *>(user_data);
 
             GError *err = nullptr;
 
-            data->self->registration_id_ = g_dbus_connection_register_object(
-                data->self->dbus_->connection(), data->self->path_.c_str(),
-                *(data->self->node_info_->interfaces), &INTERFACE_VTABLE,
-                data->self, nullptr, &err);
+            data->self->registration_id_ =
+                data->self->dbus_->transport().exportObject(
+                    data->self->path_.c_str(), &Introspection::agent_interface,
+                    &Agent::on_method_call, data->self, &err);
 
             if (data->self->registration_id_ == 0) {
                 data->error =
@@ -87,88 +293,198 @@ Agent::Agent(DBus *dbus, const std::string &path) : dbus_{dbus} {
     }
 
     if (!data.error.empty()) {
-        g_dbus_node_info_unref(node_info_);
         throw std::runtime_error(data.error);
     }
 }
+
 Agent::~Agent() {
-    g_dbus_connection_unregister_object(dbus_->connection(), registration_id_);
-    g_dbus_node_info_unref(node_info_);
+    if (registration_id_ != 0) {
+        dbus_->transport().unexportObject(registration_id_);
+    }
+
+    // Retries still waiting are given up: connman gets its answer now.
+    std::unordered_map<GSource *, Transport::Invocation *> pending;
+    {
+        std::lock_guard<std::mutex> const lock(deferred_replies_->mtx);
+        pending.swap(deferred_replies_->pending);
+    }
+    for (auto &[source, invocation] : pending) {
+        g_source_destroy(source);
+        g_source_unref(source);
+        dbus_->transport().returnValue(invocation, nullptr);
+    }
+    /*
+     * So are the RequestInputs not answered yet, including the ones the
+     * application kept a RequestInputReply for: answering those later must
+     * not reach a transport, nor a timeout callback, that may be gone.
+     */
+    std::vector<std::weak_ptr<RequestInputReply::State>> requests;
+    {
+        std::lock_guard<std::mutex> const lock(requests_mtx_);
+        requests.swap(requests_);
+    }
+    for (const auto &request : requests) {
+        if (auto state = request.lock()) {
+            state->detach();
+        }
+    }
+    // Waits for the callbacks already running, cancels the queued requests.
+    workers_.reset();
 }
 
-void Agent::on_method_call(GDBusConnection * /*connection*/,
-                           const gchar * /*sender*/,
-                           const gchar * /*object_path*/,
-                           const gchar * /*interface_name*/,
-                           const gchar *method_name, GVariant *parameters,
-                           GDBusMethodInvocation *invocation,
+void Agent::set_workers(std::size_t workers, std::size_t queue_capacity,
+                        OverflowPolicy overflow) {
+    std::unique_ptr<WorkerPool> pool;
+    {
+        std::lock_guard<std::mutex> const lock(workers_mtx_);
+        workers_config_ = WorkersConfig{.workers = workers,
+                                        .queue_capacity = queue_capacity,
+                                        .overflow = overflow};
+        // Not started yet: the first RequestInput starts it as configured.
+        if (!workers_) {
+            return;
+        }
+        pool = std::make_unique<WorkerPool>(workers, queue_capacity, overflow);
+        workers_.swap(pool);
+    }
+    // The previous pool finishes its running requests and cancels the queued
+    // ones outside the lock, so new requests are not held up meanwhile.
+}
+
+void Agent::reply_retry_after(Transport::Invocation *invocation,
+                              std::chrono::milliseconds delay) {
+    struct Data {
+        std::shared_ptr<DeferredReplies> replies;
+        Transport *transport;
+        GSource *source;
+    };
+
+    GSource *source = g_timeout_source_new(static_cast<guint>(delay.count()));
+    {
+        std::lock_guard<std::mutex> const lock(deferred_replies_->mtx);
+        deferred_replies_->pending.emplace(g_source_ref(source), invocation);
+    }
+
+    g_source_set_callback(
+        source,
+        [](gpointer user_data) -> gboolean {
+            auto *data = static_cast<Data *>(user_data);
+
+            Transport::Invocation *invocation = nullptr;
+            {
+                std::lock_guard<std::mutex> const lock(data->replies->mtx);
+                auto pending_it = data->replies->pending.find(data->source);
+                if (pending_it != data->replies->pending.end()) {
+                    invocation = pending_it->second;
+                    data->replies->pending.erase(pending_it);
+                }
+            }
+            if (invocation != nullptr) {
+                reply_retry(*data->transport, invocation);
+                // The context keeps the source alive while it dispatches.
+                g_source_unref(data->source);
+            }
+
+            return G_SOURCE_REMOVE;
+        },
+        new Data{.replies = deferred_replies_,
+                 .transport = &dbus_->transport(),
+                 .source = source},
+        [](gpointer user_data) { delete static_cast<Data *>(user_data); });
+    g_source_attach(source, dbus_->context());
+    g_source_unref(source);
+}
+
+void Agent::on_method_call(const gchar *method_name, GVariant *parameters,
+                           Transport::Invocation *invocation,
                            gpointer user_data) {
     auto *self = static_cast<Agent *>(user_data);
     self->dispatch_method_call(invocation, method_name, parameters);
 }
 
-void Agent::dispatch_method_call(GDBusMethodInvocation *invocation,
+void Agent::dispatch_method_call(Transport::Invocation *invocation,
                                  const gchar *method_name,
                                  GVariant *parameters) {
-    if (g_strcmp0(method_name, "RequestInput") == 0 && request_input_cb_) {
+    if (g_strcmp0(method_name, "RequestInput") == 0) {
         const gchar *service = nullptr;
         GVariant *fields = nullptr;
-
-        GVariant *child_service = g_variant_get_child_value(parameters, 0);
-        GVariant *child_fields = g_variant_get_child_value(parameters, 1);
-
-        service = g_variant_get_string(child_service, nullptr);
-        std::string service_str(service);
-        fields = g_variant_ref(child_fields);
-
-        g_variant_unref(child_service);
-        g_variant_unref(child_fields);
-
-        g_object_ref(invocation);
-
-        auto fields_ptr = std::unique_ptr<GVariant, decltype(&g_variant_unref)>(
-            fields, g_variant_unref);
-        auto invocation_ptr =
-            std::unique_ptr<GDBusMethodInvocation, decltype(&g_object_unref)>(
-                invocation, g_object_unref);
-
-        std::thread([ctx = dbus_->context(), callback = request_input_cb_,
-                     invocation = std::move(invocation_ptr),
-                     service_str = std::move(service_str),
-                     fields = std::move(fields_ptr)]() mutable {
+        g_variant_get(parameters, "(&o@a{sv})", &service, &fields);
+
+        auto state =
+            std::make_shared<RequestInputReply::State>(dbus_, invocation);
+        const auto timeout =
+            std::chrono::milliseconds(request_input_timeout_ms_.load());
+        if (timeout.count() > 0) {
+            RequestInputReply::State::arm_deadline(
+                state, timeout,
+                [callback = request_input_timeout_cb_,
+                 service_path = std::string(service)]() {
+                    LCM_LOG("RequestInput timed out: " << service_path
+                                                       << '\n');
+                    if (callback) {
+                        callback(service_path.c_str());
+                    }
+                });
+        }
+        {
+            std::lock_guard<std::mutex> const lock(requests_mtx_);
+            std::erase_if(requests_, [](const auto &request) {
+                return request.expired();
+            });
+            requests_.push_back(state);
+        }
+        RequestInputReply reply(std::move(state));
+        RequestInputWork work;
+        if (request_input_cb_) {
             try {
-                GVariant *result = callback(service_str.c_str(), fields.get());
-
-                struct Data {
-                    std::unique_ptr<GDBusMethodInvocation,
-                                    decltype(&g_object_unref)>
-                        invocation;
-                    GVariant *result;
-                };
-
-                auto data = std::make_unique<Data>(Data{
-                    .invocation = std::move(invocation), .result = result});
-
-                g_main_context_invoke_full(
-                    ctx, G_PRIORITY_DEFAULT,
-                    [](gpointer user_data) -> gboolean {
-                        auto *data = static_cast<Data *>(user_data);
-
-                        GVariant *tuple = g_variant_new_tuple(&data->result, 1);
-                        g_dbus_method_invocation_return_value(
-                            data->invocation.get(), tuple);
-
-                        return G_SOURCE_REMOVE;
-                    },
-                    data.release(),
-                    [](gpointer user_data) {
-                        std::unique_ptr<Data> data(
-                            static_cast<Data *>(user_data));
-                    });
+                work = request_input_cb_(service, fields, reply);
             } catch (...) {
                 LCM_LOG("Exception in RequestInput callback");
+                reply.cancel();
             }
-        }).detach();
+        } else {
+            reply.cancel();
+        }
+        g_variant_unref(fields);
+        if (!work || !reply.pending()) {
+            return;
+        }
+
+        auto request = std::make_shared<PendingRequest>(PendingRequest{
+            .work = std::move(work), .reply = std::move(reply)});
+
+        /*
+         * The callback waits for the application, so it runs on one of the
+         * agent workers and the reply is handed back to the D-Bus thread.
+         */
+        WorkerPool::Job job{
+            .run =
+                [request]() {
+                    // Timed out, or canceled, while queued.
+                    if (!request->reply.pending()) {
+                        return;
+                    }
+                    try {
+                        request->reply.reply(request->work());
+                    } catch (...) {
+                        LCM_LOG("Exception in RequestInput callback");
+                        request->reply.cancel();
+                    }
+                },
+            .cancel =
+                [request]() {
+                    LCM_LOG("RequestInput canceled by the agent worker pool\n");
+                    request->reply.cancel();
+                }};
+
+        std::lock_guard<std::mutex> const lock(workers_mtx_);
+        // No threads for an agent that is never asked for input.
+        if (!workers_) {
+            workers_ = std::make_unique<WorkerPool>(
+                workers_config_.workers, workers_config_.queue_capacity,
+                workers_config_.overflow);
+        }
+        workers_->submit(std::move(job));
         return;
     }
 
@@ -176,7 +492,7 @@ void Agent::dispatch_method_call(GDBusMethodInvocation *invocation,
         if (cancel_cb_) {
             cancel_cb_();
         }
-        g_dbus_method_invocation_return_value(invocation, nullptr);
+        dbus_->transport().returnValue(invocation, nullptr);
         return;
     }
 
@@ -184,7 +500,7 @@ void Agent::dispatch_method_call(GDBusMethodInvocation *invocation,
         if (release_cb_) {
             release_cb_();
         }
-        g_dbus_method_invocation_return_value(invocation, nullptr);
+        dbus_->transport().returnValue(invocation, nullptr);
         return;
     }
 
@@ -207,26 +523,29 @@ void Agent::dispatch_method_call(GDBusMethodInvocation *invocation,
          * Replying net.connman.Agent.Error.Retry makes connman reconnect using
          * the credentials it already has, without asking for them again.
          */
-        bool retry = false;
+        std::optional<std::chrono::milliseconds> retry_after;
         if (report_error_cb_) {
             try {
-                retry = report_error_cb_(service.c_str(), error_str.c_str());
+                retry_after =
+                    report_error_cb_(service.c_str(), error_str.c_str());
             } catch (...) {
                 LCM_LOG("Exception in ReportError callback");
             }
         }
 
-        if (retry) {
-            g_dbus_method_invocation_return_dbus_error(
-                invocation, "net.connman.Agent.Error.Retry", "Retry");
+        if (!retry_after) {
+            dbus_->transport().returnValue(invocation, nullptr);
+        } else if (retry_after->count() <= 0) {
+            reply_retry(dbus_->transport(), invocation);
         } else {
-            g_dbus_method_invocation_return_value(invocation, nullptr);
+            reply_retry_after(invocation, *retry_after);
         }
 
         return;
     }
 
-    g_dbus_method_invocation_return_error_literal(
-        invocation, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Unknown method");
+    dbus_->transport().returnError(invocation,
+                                   "org.freedesktop.DBus.Error.UnknownMethod",
+                                   "Unknown method");
 }
 }  // namespace Amarula::DBus::G::Connman
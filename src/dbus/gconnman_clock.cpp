@@ -12,6 +12,8 @@
 
 #include "gconnman_private.hpp"
 #include "gdbus_private.hpp"
+#include "gproperty_table.hpp"
+#include "gvariant_codec.hpp"
 
 namespace Amarula::DBus::G::Connman {
 
@@ -26,24 +28,26 @@ static constexpr EnumStringMap<TimeZoneUpdate, 2> TIME_ZONE_UPDATE_MAP{
     {{{ClockProperties::TimeZoneUpdate::Manual, "manual"},
       {ClockProperties::TimeZoneUpdate::Auto, "auto"}}}};
 
+template <>
+struct PropertyDescriptors<ClockProperties> {
+    using Props = ClockProperties;
+    static constexpr PropertyTable TABLE{
+        "Clock",
+        std::array{
+            property<&Props::time_, Codec<uint64_t>>(TIME_STR),
+            property<&Props::time_updates_, EnumCodec<TIME_UPDATE_MAP>>(
+                TIMEUPDATES_STR),
+            property<&Props::timezone_, Codec<std::string>>(TIMEZONE_STR),
+            property<&Props::timezone_updates_,
+                     EnumCodec<TIME_ZONE_UPDATE_MAP>>(TIMEZONEUPDATES_STR),
+            property<&Props::time_servers_, Codec<PropertyList<std::string>>>(
+                TIMESERVERS_STR),
+            property<&Props::time_server_synced_, Codec<bool>>(
+                TIMESERVERSYNCED_STR)}};
+};
+
 void ClockProperties::update(const gchar* key, GVariant* value) {
-    if (g_strcmp0(key, TIME_STR) == 0) {
-        time_ = g_variant_get_uint64(value);
-    } else if (g_strcmp0(key, TIMEUPDATES_STR) == 0U) {
-        time_updates_ =
-            TIME_UPDATE_MAP.fromString(g_variant_get_string(value, nullptr));
-    } else if (g_strcmp0(key, TIMEZONE_STR) == 0U) {
-        timezone_ = g_variant_get_string(value, nullptr);
-    } else if (g_strcmp0(key, TIMEZONEUPDATES_STR) == 0U) {
-        timezone_updates_ = TIME_ZONE_UPDATE_MAP.fromString(
-            g_variant_get_string(value, nullptr));
-    } else if (g_strcmp0(key, TIMESERVERS_STR) == 0U) {
-        time_servers_ = as_to_vector(value);
-    } else if (g_strcmp0(key, TIMESERVERSYNCED_STR) == 0U) {
-        time_server_synced_ = g_variant_get_boolean(value) == 1U;
-    } else {
-        LCM_LOG("Unknown property for Clock: " << key << '\n');
-    }
+    PropertyDescriptors<ClockProperties>::TABLE.update(*this, key, value);
 }
 
 Clock::Clock(DBus* dbus)
@@ -51,24 +55,23 @@ Clock::Clock(DBus* dbus)
 
 void Clock::setTime(uint64_t time, PropertiesSetCallback callback) {
     auto data = prepareCallback(std::move(callback));
-    setProperty(TIME_STR, g_variant_new_uint64(time), nullptr,
-                &Clock::finishAsyncCall, data.release());
+    setProperty(TIME_STR, to_variant(time), nullptr, &Clock::finishAsyncCall,
+                data.release());
 }
 
 void Clock::setTimeZone(const std::string& timezone,
                         PropertiesSetCallback callback) {
     auto data = prepareCallback(std::move(callback));
-    setProperty(TIMEZONE_STR, g_variant_new_string(timezone.c_str()), nullptr,
+    setProperty(TIMEZONE_STR, to_variant(timezone), nullptr,
                 &Clock::finishAsyncCall, data.release());
 }
 
 void Clock::setTimeUpdates(const Properties::TimeUpdate time_updates,
                            PropertiesSetCallback callback) {
     auto data = prepareCallback(std::move(callback));
-    setProperty(
-        TIMEUPDATES_STR,
-        g_variant_new_string((TIME_UPDATE_MAP.toString(time_updates)).data()),
-        nullptr, &Clock::finishAsyncCall, data.release());
+    setProperty(TIMEUPDATES_STR,
+                EnumCodec<TIME_UPDATE_MAP>::encode(time_updates), nullptr,
+                &Clock::finishAsyncCall, data.release());
 }
 
 void Clock::setTimeZoneUpdates(
@@ -76,24 +79,15 @@ void Clock::setTimeZoneUpdates(
     PropertiesSetCallback callback) {
     auto data = prepareCallback(std::move(callback));
     setProperty(TIMEZONEUPDATES_STR,
-                g_variant_new_string(
-                    (TIME_ZONE_UPDATE_MAP.toString(time_zone_updates)).data()),
+                EnumCodec<TIME_ZONE_UPDATE_MAP>::encode(time_zone_updates),
                 nullptr, &Clock::finishAsyncCall, data.release());
 }
 
 void Clock::setTimeServers(const std::vector<std::string>& servers,
                            PropertiesSetCallback callback) {
     auto data = prepareCallback(std::move(callback));
-    GVariantBuilder builder;
-    g_variant_builder_init(&builder, G_VARIANT_TYPE("as"));
-    for (const auto& server : servers) {
-        GVariant* str_variant = g_variant_new_string(server.c_str());
-        g_variant_builder_add_value(&builder, str_variant);
-    }
-    GVariant* servers_variant = g_variant_builder_end(&builder);
-    setProperty(TIMESERVERS_STR, servers_variant, nullptr,
+    setProperty(TIMESERVERS_STR, to_variant(servers), nullptr,
                 &Clock::finishAsyncCall, data.release());
-    g_variant_builder_clear(&builder);
 }
 
 auto operator<<(std::ostream& ost,
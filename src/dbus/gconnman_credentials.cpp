@@ -0,0 +1,95 @@
+#include <amarula/dbus/connman/gcredentials.hpp>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace Amarula::DBus::G::Connman {
+
+void CredentialStore::setForService(const std::string& obj_path,
+                                    Credentials credentials) {
+    std::lock_guard<std::mutex> const lock(mtx_);
+    by_path_.insert_or_assign(obj_path, std::move(credentials));
+}
+
+void CredentialStore::setForName(const std::string& name,
+                                 Credentials credentials) {
+    std::lock_guard<std::mutex> const lock(mtx_);
+    by_name_.insert_or_assign(name, std::move(credentials));
+}
+
+void CredentialStore::setForSSID(std::string_view ssid,
+                                 Credentials credentials) {
+    auto key = to_hex(ssid);
+    std::lock_guard<std::mutex> const lock(mtx_);
+    by_ssid_.insert_or_assign(std::move(key), std::move(credentials));
+}
+
+void CredentialStore::clear() {
+    std::lock_guard<std::mutex> const lock(mtx_);
+    by_path_.clear();
+    by_name_.clear();
+    by_ssid_.clear();
+}
+
+auto CredentialStore::lookup(std::string_view obj_path,
+                             std::string_view name) const
+    -> std::optional<Credentials> {
+    std::lock_guard<std::mutex> const lock(mtx_);
+    if (auto entry = by_path_.find(obj_path); entry != by_path_.end()) {
+        return entry->second;
+    }
+    if (!name.empty()) {
+        if (auto entry = by_name_.find(name); entry != by_name_.end()) {
+            return entry->second;
+        }
+    }
+    const auto ssid = ssid_of(obj_path);
+    if (!ssid.empty()) {
+        if (auto entry = by_ssid_.find(ssid); entry != by_ssid_.end()) {
+            return entry->second;
+        }
+    }
+    return std::nullopt;
+}
+
+/*
+ * connman names wifi services wifi_<address>_<ssid>_<mode>_<security>, with
+ * the SSID in lowercase hex, or "hidden" when it is not broadcast.
+ */
+auto CredentialStore::ssid_of(std::string_view obj_path) -> std::string_view {
+    auto service = obj_path.substr(obj_path.rfind('/') + 1);
+    constexpr std::string_view WIFI_PREFIX = "wifi_";
+    if (!service.starts_with(WIFI_PREFIX)) {
+        return {};
+    }
+    service.remove_prefix(WIFI_PREFIX.size());
+
+    const auto address_end = service.find('_');
+    if (address_end == std::string_view::npos) {
+        return {};
+    }
+    service.remove_prefix(address_end + 1);
+
+    const auto ssid = service.substr(0, service.find('_'));
+    return ssid == "hidden" ? std::string_view{} : ssid;
+}
+
+auto CredentialStore::to_hex(std::string_view bytes) -> std::string {
+    constexpr std::string_view DIGITS = "0123456789abcdef";
+    constexpr unsigned NIBBLE_BITS = 4U;
+    constexpr unsigned NIBBLE_MASK = 0x0FU;
+
+    std::string hex;
+    hex.reserve(bytes.size() * 2U);
+    for (const auto byte : bytes) {
+        const auto value = static_cast<unsigned char>(byte);
+        hex.push_back(DIGITS[value >> NIBBLE_BITS]);
+        hex.push_back(DIGITS[value & NIBBLE_MASK]);
+    }
+    return hex;
+}
+
+}  // namespace Amarula::DBus::G::Connman
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glib.h>
+
+#include <amarula/dbus/gvariant_view.hpp>
+#include <cstdint>
+#include <string_view>
+
+namespace Amarula::DBus::G::Connman {
+
+/*
+ * The RequestInput fields that decide which kind of input connman wants.
+ */
+enum InputField : uint8_t {
+    FieldMandatoryPassphrase = 1U << 0U,
+    FieldWPS = 1U << 1U,
+    FieldName = 1U << 2U,
+    FieldIdentity = 1U << 3U,
+    FieldUsername = 1U << 4U,
+    FieldPassword = 1U << 5U,
+    FieldPassphraseResponse = 1U << 6U,
+};
+
+/*
+ * Reduces the RequestInput fields argument, a{sv} of field name to a{sv}
+ * description, to InputField bits in a single pass over its serialised data:
+ * names and descriptions are compared in place, nothing is copied or
+ * allocated. Malformed entries are ignored.
+ */
+inline auto input_fields(GVariant* fields) -> uint8_t {
+    uint8_t found = 0U;
+
+    static_cast<void>(VariantView::of(fields).forEachEntry(
+        [&found](std::string_view field, std::string_view type,
+                 VariantView description) {
+            if (type != "a{sv}") {
+                return;
+            }
+
+            bool mandatory = false;
+            bool response = false;
+            static_cast<void>(description.forEachEntry(
+                [&mandatory, &response](std::string_view key,
+                                        std::string_view value_type,
+                                        VariantView value) {
+                    if (value_type != "s") {
+                        return;
+                    }
+                    const auto str = value.asString();
+                    if (key == "Requirement") {
+                        mandatory = str == "mandatory";
+                    } else if (key == "Type") {
+                        response = str == "response";
+                    }
+                }));
+
+            if (field == "Passphrase") {
+                found |= mandatory ? FieldMandatoryPassphrase : 0U;
+                found |= response ? FieldPassphraseResponse : 0U;
+            } else if (field == "WPS") {
+                found |= FieldWPS;
+            } else if (field == "Name") {
+                found |= FieldName;
+            } else if (field == "Identity") {
+                found |= FieldIdentity;
+            } else if (field == "Username") {
+                found |= FieldUsername;
+            } else if (field == "Password") {
+                found |= FieldPassword;
+            }
+        }));
+
+    return found;
+}
+
+}  // namespace Amarula::DBus::G::Connman
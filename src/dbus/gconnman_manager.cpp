@@ -8,19 +8,32 @@
 #include <amarula/dbus/connman/gagent.hpp>
 #include <amarula/dbus/connman/gmanager.hpp>
 #include <amarula/dbus/connman/gservice.hpp>
+#include <amarula/dbus/connman/gservicetable.hpp>
 #include <amarula/dbus/connman/gtechnology.hpp>
 #include <amarula/dbus/gdbus.hpp>
 #include <amarula/dbus/gproxy.hpp>
 #include <amarula/log.hpp>
+#include <chrono>
+#include <cstddef>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <optional>
 #include <ranges>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "gconnman_input_fields.hpp"
 #include "gconnman_private.hpp"
+#include "gconnman_recycled_proxies.hpp"
+#include "gconnman_services_changed.hpp"
+#include "gconnman_signal_arena.hpp"
 #include "gdbus_private.hpp"
+#include "gproperty_table.hpp"
+#include "gvariant_codec.hpp"
 
 namespace Amarula::DBus::G::Connman {
 
@@ -31,223 +44,539 @@ static constexpr EnumStringMap<State, 4> STATE_MAP{
       {State::Ready, "ready"},
       {State::Online, "online"}}}};
 
+template <>
+struct PropertyDescriptors<ManaProperties> {
+    using Props = ManaProperties;
+    static constexpr PropertyTable TABLE{
+        "Manager",
+        std::array{
+            property<&Props::offline_mode_, Codec<bool>>(OFFLINEMODE_STR),
+            property<&Props::state_, EnumCodec<STATE_MAP>>(STATE_STR)}};
+};
+
 void ManaProperties::update(const gchar* key, GVariant* value) {
-    if (g_strcmp0(key, OFFLINEMODE_STR) == 0) {
-        offline_mode_ = (g_variant_get_boolean(value) == 1U);
-    } else if (g_strcmp0(key, STATE_STR) == 0U) {
-        state_ = STATE_MAP.fromString(g_variant_get_string(value, nullptr));
-    } else {
-        LCM_LOG("Unknown property for Manager: " << key << '\n');
-    }
+    PropertyDescriptors<ManaProperties>::TABLE.update(*this, key, value);
 }
 
 Manager::Manager(DBus* dbus, const std::string& agent_path)
     : DBusProxy(dbus, SERVICE, MANAGER_PATH, MANAGER_INTERFACE),
+      recycled_services_{std::make_unique<RecycledProxies<Service>>(
+          DEFAULT_RECYCLED_SERVICES, DEFAULT_RECYCLED_SERVICES_TTL)},
+      signal_arena_{std::make_unique<SignalArena>()},
       agent_{std::unique_ptr<Agent>(new Agent(dbus, agent_path))} {
     setup_agent();
     get_technologies();
     get_services();
 
-    connectSignal("g-signal::TechnologyRemoved",
-                  &Manager::on_technology_added_removed_cb, this);
-    connectSignal("g-signal::TechnologyAdded",
-                  &Manager::on_technology_added_removed_cb, this);
-    connectSignal("g-signal::ServicesChanged", &Manager::on_services_changed_cb,
+    connectSignal("TechnologyRemoved", &Manager::on_technology_added_removed_cb,
+                  this);
+    connectSignal("TechnologyAdded", &Manager::on_technology_added_removed_cb,
                   this);
+    connectSignal("ServicesChanged", &Manager::on_services_changed_cb, this);
 }
 
-void Manager::process_services_changed(
-    const std::vector<std::string>& services_removed,
-    const std::vector<std::pair<std::string, VariantPtr>>& services_changed) {
-    for (const auto& object_path : services_removed) {
-        services_.erase(std::remove_if(services_.begin(), services_.end(),
-                                       [&object_path](const auto service) {
-                                           return service->objPath() ==
-                                                  object_path;
-                                       }),
-                        services_.end());
+Manager::~Manager() {
+    /*
+     * The agent workers and deadlines call back into the members declared
+     * after agent_, which would otherwise be destroyed first: a RequestInput
+     * callback still running is waited for while they are there.
+     */
+    agent_.reset();
+}
+
+/*
+ * Runs without holding mtx_: the service list only changes on the D-Bus thread,
+ * which is also the one running this, so current_services cannot go stale
+ * before the result is published. Building the new proxies is the expensive
+ * part (each one is a D-Bus round trip plus a signal subscription), and readers
+ * of services() or the agent must not wait for it.
+ */
+auto Manager::process_services_changed(
+    const ProxyList<Service>& current_services,
+    const ServicesChangedSignal& signal) -> ProxyList<Service> {
+    // Keyed by the path owned by each proxy, so building the map copies no
+    // strings, and allocated from the arena of the signal.
+    std::pmr::unordered_map<std::string_view, std::shared_ptr<Service>>
+        known_services{signal_arena_->resource()};
+    known_services.reserve(current_services.size());
+    for (const auto& service : current_services) {
+        known_services.emplace(service->objPathView(), service);
+    }
+    for (const auto& object_path : signal.removed) {
+        auto service_it = known_services.find(object_path);
+        if (service_it != known_services.end()) {
+            recycled_services_->put(std::move(service_it->second));
+            known_services.erase(service_it);
+        }
     }
+
     Manager::ProxyList<Service> new_order_of_services;
-    for (const auto& [path, prop] : services_changed) {
-        auto service_it = std::find_if(
-            services_.begin(), services_.end(),
-            [&path](const auto service) { return service->objPath() == path; });
-        if (service_it != services_.end()) {
-            new_order_of_services.push_back(*service_it);
-            (*service_it)->updateProperties(prop.get());
+    new_order_of_services.reserve(signal.changed.size());
+    for (const auto& [path, properties] : signal.changed) {
+        auto service_it = known_services.find(path);
+        if (service_it != known_services.end()) {
+            // Order-only entries carry no properties: nothing to decode.
+            if (properties) {
+                service_it->second->updateProperties(properties.get());
+                reset_retries_if_connected(*service_it->second);
+            }
+            new_order_of_services.push_back(std::move(service_it->second));
+            known_services.erase(service_it);
+            continue;
+        }
+
+        auto proxy = recycled_services_->take(path);
+        if (proxy) {
+            proxy->lazy_properties_ = lazy_service_properties_.load();
         } else {
-            auto proxy =
-                std::shared_ptr<Service>(new Service(dbus(), path.c_str()));
-            proxy->updateProperties(prop.get());
-            new_order_of_services.push_back(proxy);
+            // Nul terminated, see ServicesChangedSignal.
+            proxy = make_service(path.data());
+        }
+        if (properties) {
+            proxy->updateProperties(properties.get());
+            reset_retries_if_connected(*proxy);
         }
+        new_order_of_services.push_back(std::move(proxy));
+    }
+
+    // Whatever is left silently dropped out of the list.
+    for (auto& [path, service] : known_services) {
+        recycled_services_->put(std::move(service));
     }
-    services_ = new_order_of_services;
+    return new_order_of_services;
 }
 
-void Manager::setup_agent() {
-    agent_->set_request_input_handler([this](const gchar* service_path,
-                                             GVariant* fields) -> GVariant* {
-        GVariantBuilder builder;
-        g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
-
-        std::shared_ptr<Service> found_service;
-        {
-            std::lock_guard<std::mutex> const lock(mtx_);
-            auto service_it = std::ranges::find_if(
-                services_, [&service_path](const auto& service) {
-                    return service->objPath() == service_path;
-                });
-            if (service_it != services_.end()) {
-                found_service = *service_it;
+/*
+ * The ServicesChanged counterpart of the reset in on_updated_: connman may
+ * report a service connected in the list rather than by PropertyChanged. The
+ * State is the one updateProperties() already decoded.
+ */
+void Manager::reset_retries_if_connected(Service& service) {
+    if (service.became_connected(service.currentProperties())) {
+        retry_backoff_->reset(service.objPathView());
+    }
+}
+
+void Manager::setServiceRecycling(std::size_t capacity,
+                                  std::chrono::seconds ttl) {
+    recycled_services_->configure(capacity, ttl);
+}
+
+void Manager::setLazyServiceProperties(bool lazy) {
+    lazy_service_properties_ = lazy;
+    std::lock_guard<StatsMutex> const lock(mtx_);
+    for (const auto& service : services_) {
+        service->lazy_properties_ = lazy;
+    }
+}
+
+void Manager::setInPlaceSignalDecoding(bool enabled) {
+    if (enabled) {
+        dbus()->setFlatSignals({"PropertyChanged", "ServicesChanged"});
+    } else {
+        dbus()->setFlatSignals({});
+    }
+}
+
+auto Manager::make_service(const gchar* obj_path) -> std::shared_ptr<Service> {
+    auto service = std::shared_ptr<Service>(new Service(dbus(), obj_path));
+    service->id_ = ++next_service_id_;
+    service->lazy_properties_ = lazy_service_properties_.load();
+    service->on_updated_ =
+        [table = std::weak_ptr<SharedServiceTable>(service_table_),
+         backoff = std::weak_ptr<RetryBackoff>(retry_backoff_),
+         path = std::string(obj_path)](ServiceTable::Id service_id,
+                                       const ServProperties& properties,
+                                       bool connected) {
+            if (auto shared = table.lock()) {
+                std::lock_guard<std::mutex> const lock(shared->mtx);
+                shared->table.update(service_id, properties);
             }
+            if (connected) {
+                if (auto retries = backoff.lock()) {
+                    retries->reset(path);
+                }
+            }
+        };
+    return service;
+}
+
+void Manager::RetryBackoff::configure(std::chrono::milliseconds initial_delay,
+                                      std::chrono::milliseconds max_delay,
+                                      std::size_t max_attempts) {
+    std::lock_guard<std::mutex> const lock(mtx_);
+    initial_delay_ = initial_delay;
+    max_delay_ = std::max(max_delay, initial_delay);
+    max_attempts_ = max_attempts;
+}
+
+auto Manager::RetryBackoff::next_delay(std::string_view obj_path)
+    -> std::optional<std::chrono::milliseconds> {
+    std::lock_guard<std::mutex> const lock(mtx_);
+    auto attempts_it = attempts_.find(obj_path);
+    if (attempts_it == attempts_.end()) {
+        attempts_it = attempts_.emplace(std::string(obj_path), 0U).first;
+    }
+    auto& attempts = attempts_it->second;
+    if (attempts >= max_attempts_) {
+        attempts_.erase(attempts_it);
+        return std::nullopt;
+    }
+
+    auto delay = initial_delay_;
+    for (std::size_t i = 0; i < attempts && delay < max_delay_; ++i) {
+        delay *= 2;
+    }
+    ++attempts;
+    return std::min(delay, max_delay_);
+}
+
+void Manager::RetryBackoff::reset(std::string_view obj_path) {
+    std::lock_guard<std::mutex> const lock(mtx_);
+    // Most services connect without ever having been retried.
+    const auto attempts_it = attempts_.find(obj_path);
+    if (attempts_it != attempts_.end()) {
+        attempts_.erase(attempts_it);
+    }
+}
+
+auto Manager::make_service_table(const ProxyList<Service>& services)
+    -> ServiceTable {
+    ServiceTable table;
+    table.reserve(services.size());
+    for (const auto& service : services) {
+        table.append(service->id(), service->currentProperties());
+    }
+    return table;
+}
+
+void Manager::publish_service_table(ServiceTable table) {
+    std::lock_guard<std::mutex> const lock(service_table_->mtx);
+    service_table_->table = std::move(table);
+}
+
+auto Manager::make_technology_index(const ProxyList<Technology>& technologies)
+    -> TechnologyIndex {
+    TechnologyIndex index;
+    for (const auto& technology : technologies) {
+        // On the D-Bus thread: no snapshot needed to read an enum.
+        const auto type = technology->currentProperties().getType();
+        if (type != TechProperties::Type::Unknown) {
+            index[static_cast<std::size_t>(type)] = technology;
         }
+    }
+    return index;
+}
 
-        if (found_service) {
-            auto* parsed_fields = parse_fields(fields);
-            auto input_requested = classify_input(parsed_fields);
-            g_ptr_array_unref(parsed_fields);
-            switch (input_requested) {
-                case InputType::InputWpA2Passphrase:
-                    if (request_input_passphrase_cb_ != nullptr) {
-                        const auto passphrase =
-                            request_input_passphrase_cb_(found_service);
-                        g_variant_builder_add(
-                            &builder, "{sv}", "Passphrase",
-                            g_variant_new_string(passphrase.second.c_str()));
-                    }
-                    break;
-                case InputType::InputWpA2PassphraseWpsAlternative:
-                    if (request_input_passphrase_cb_ != nullptr) {
-                        const auto passphrase =
-                            request_input_passphrase_cb_(found_service);
-
-                        g_variant_builder_add(
-                            &builder, "{sv}",
-                            passphrase.first ? "Passphrase" : "WPS",
-                            g_variant_new_string(passphrase.second.c_str()));
-                    }
-                    break;
-                case InputType::InputHiddenNetworkName:
-                    if (request_input_hidden_network_name_cb_ != nullptr) {
-                        const auto name = request_input_hidden_network_name_cb_(
-                            found_service);
-
-                        GVariant* value = nullptr;
-                        if (name.first) {
-                            value = g_variant_new_string(name.second.c_str());
-                        } else {
-                            value = g_variant_new_fixed_array(
-                                G_VARIANT_TYPE_BYTE, name.second.data(),
-                                name.second.size(), sizeof(guchar));
-                        }
-                        g_variant_builder_add(&builder, "{sv}",
-                                              name.first ? "Name" : "SSID",
-                                              value);
-                    }
-
-                    break;
-                case InputType::InputChallengeResponse:
-                case InputType::InputWpaEnterprise:
-                    if (request_input_wpa_enterprise_cb_ != nullptr) {
-                        const auto identity_password =
-                            request_input_wpa_enterprise_cb_(found_service);
-
-                        g_variant_builder_add(
-                            &builder, "{sv}", "Identity",
-                            g_variant_new_string(
-                                identity_password.first.c_str()));
-
-                        GVariant* value_string = nullptr;
-                        if (identity_password.second.first) {
-                            value_string = g_variant_new_string(
-                                identity_password.second.second.c_str());
-                        } else {
-                            value_string = g_variant_new_fixed_array(
-                                G_VARIANT_TYPE_BYTE,
-                                identity_password.second.second.data(),
-                                identity_password.second.second.size(),
-                                sizeof(guchar));
-                        }
-                        g_variant_builder_add(&builder, "{sv}",
-                                              identity_password.second.first
-                                                  ? "Passphrase"
-                                                  : "WPS",
-                                              value_string);
-                    }
-
-                    break;
-                case InputType::InputWispr:
-                    if (request_input_wispr_enabled_cb_ != nullptr) {
-                        const auto user_password =
-                            request_input_wispr_enabled_cb_(found_service);
-
-                        g_variant_builder_add(
-                            &builder, "{sv}", "Username",
-                            g_variant_new_string(user_password.first.c_str()));
-
-                        g_variant_builder_add(
-                            &builder, "{sv}", "Password",
-                            g_variant_new_string(user_password.second.c_str()));
-                    }
-
-                    break;
-                default:
-                    break;
+auto Manager::service(ServiceTable::Id service_id) -> std::shared_ptr<Service> {
+    std::lock_guard<StatsMutex> const lock(mtx_);
+    auto service_it =
+        std::ranges::find_if(services_, [service_id](const auto& service) {
+            return service->id() == service_id;
+        });
+    return service_it != services_.end() ? *service_it : nullptr;
+}
+
+auto Manager::find_service(const gchar* obj_path) -> std::shared_ptr<Service> {
+    std::lock_guard<StatsMutex> const lock(mtx_);
+    auto service_it =
+        std::ranges::find_if(services_, [&obj_path](const auto& service) {
+            return service->objPathView() == obj_path;
+        });
+    return service_it != services_.end() ? *service_it : nullptr;
+}
+
+void Manager::add_passphrase(GVariantBuilder* builder,
+                             const std::pair<bool, std::string>& passphrase) {
+    VariantDict::add<Codec<std::string>>(builder, "Passphrase",
+                                         passphrase.second);
+}
+
+void Manager::add_passphrase_or_wps(
+    GVariantBuilder* builder, const std::pair<bool, std::string>& passphrase) {
+    VariantDict::add<Codec<std::string>>(
+        builder, passphrase.first ? "Passphrase" : "WPS", passphrase.second);
+}
+
+void Manager::add_network_name(GVariantBuilder* builder,
+                               const std::pair<bool, std::string>& name) {
+    if (name.first) {
+        VariantDict::add<Codec<std::string>>(builder, "Name", name.second);
+    } else {
+        VariantDict::add<ByteString>(builder, "SSID", name.second);
+    }
+}
+
+void Manager::add_enterprise(
+    GVariantBuilder* builder,
+    const std::pair<std::string, std::pair<bool, std::string>>&
+        identity_password) {
+    VariantDict::add<Codec<std::string>>(builder, "Identity",
+                                         identity_password.first);
+
+    const auto& [is_passphrase, secret] = identity_password.second;
+    if (is_passphrase) {
+        VariantDict::add<Codec<std::string>>(builder, "Passphrase", secret);
+    } else {
+        VariantDict::add<ByteString>(builder, "WPS", secret);
+    }
+}
+
+void Manager::add_wispr(
+    GVariantBuilder* builder,
+    const std::pair<std::string, std::string>& user_password) {
+    VariantDict::add<Codec<std::string>>(builder, "Username",
+                                         user_password.first);
+    VariantDict::add<Codec<std::string>>(builder, "Password",
+                                         user_password.second);
+}
+
+/*
+ * The a{sv} answering input_requested from credentials, or nullptr when some
+ * of the fields it needs are not known.
+ */
+auto Manager::credentials_to_fields(InputType input_requested,
+                                    const Credentials& credentials)
+    -> GVariant* {
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, VariantDict::SIGNATURE.type());
+
+    bool complete = false;
+    switch (input_requested) {
+        case InputType::InputWpA2Passphrase:
+        case InputType::InputWpA2PassphraseWpsAlternative:
+            complete = !credentials.passphrase.empty();
+            add_passphrase(&builder, {true, credentials.passphrase});
+            break;
+        case InputType::InputHiddenNetworkName:
+            complete = !credentials.name.empty();
+            add_network_name(&builder, {true, credentials.name});
+            if (!credentials.passphrase.empty()) {
+                add_passphrase(&builder, {true, credentials.passphrase});
             }
+            break;
+        case InputType::InputChallengeResponse:
+        case InputType::InputWpaEnterprise:
+            complete = !credentials.identity.empty() &&
+                       !credentials.passphrase.empty();
+            add_enterprise(&builder,
+                           {credentials.identity,
+                            {true, credentials.passphrase}});
+            break;
+        case InputType::InputWispr:
+            complete = !credentials.username.empty() &&
+                       !credentials.password.empty();
+            add_wispr(&builder, {credentials.username, credentials.password});
+            break;
+        default:
+            break;
+    }
+
+    GVariant* fields = g_variant_builder_end(&builder);
+    if (!complete) {
+        g_variant_unref(g_variant_ref_sink(fields));
+        return nullptr;
+    }
+    return fields;
+}
+
+/*
+ * Answers the request from the credential store when it can, or hands it to
+ * the asynchronous callback set for the kind of input asked for; otherwise it
+ * leaves it to the synchronous callbacks on the agent worker pool, with the
+ * service and the kind of input already looked up.
+ */
+auto Manager::request_input_async(const gchar* service_path, GVariant* fields,
+                                  const RequestInputReply& reply)
+    -> Agent::RequestInputWork {
+    auto found_service = find_service(service_path);
+    if (!found_service) {
+        return [] {
+            GVariantBuilder builder;
+            g_variant_builder_init(&builder, VariantDict::SIGNATURE.type());
+            return g_variant_builder_end(&builder);
+        };
+    }
+
+    const auto input_requested = classify_input(fields);
+
+    std::shared_ptr<const CredentialStore> store;
+    {
+        std::lock_guard<StatsMutex> const lock(mtx_);
+        store = credential_store_;
+    }
+    if (store) {
+        // On the D-Bus thread: the name is read without copying a snapshot.
+        const auto credentials =
+            store->lookup(found_service->objPathView(),
+                          found_service->currentProperties().getName());
+        GVariant* answer =
+            credentials ? credentials_to_fields(input_requested, *credentials)
+                        : nullptr;
+        if (answer != nullptr) {
+            // Already on the D-Bus thread: the reply is sent right away.
+            reply.reply(answer);
+            return {};
         }
-        return g_variant_builder_end(&builder);
-    });
+    }
+
+    std::unique_lock<StatsMutex> lock(mtx_);
+    switch (input_requested) {
+        case InputType::InputWpA2Passphrase:
+        case InputType::InputWpA2PassphraseWpsAlternative:
+            if (auto callback = request_input_passphrase_async_cb_) {
+                lock.unlock();
+                auto* add_fields =
+                    input_requested == InputType::InputWpA2Passphrase
+                        ? &Manager::add_passphrase
+                        : &Manager::add_passphrase_or_wps;
+                callback(found_service, PassphraseReply(reply, add_fields));
+                return {};
+            }
+            break;
+        case InputType::InputHiddenNetworkName:
+            if (auto callback = request_input_hidden_network_name_async_cb_) {
+                lock.unlock();
+                callback(found_service,
+                         HiddenNetworkNameReply(reply,
+                                                &Manager::add_network_name));
+                return {};
+            }
+            break;
+        case InputType::InputChallengeResponse:
+        case InputType::InputWpaEnterprise:
+            if (auto callback = request_input_wpa_enterprise_async_cb_) {
+                lock.unlock();
+                callback(found_service,
+                         WPAEnterpriseReply(reply, &Manager::add_enterprise));
+                return {};
+            }
+            break;
+        case InputType::InputWispr:
+            if (auto callback = request_input_wispr_enabled_async_cb_) {
+                lock.unlock();
+                callback(found_service, WISPrReply(reply, &Manager::add_wispr));
+                return {};
+            }
+            break;
+        default:
+            break;
+    }
+    return [this, found_service, input_requested] {
+        return request_input(found_service, input_requested);
+    };
+}
+
+auto Manager::request_input(const std::shared_ptr<Service>& found_service,
+                            InputType input_requested) -> GVariant* {
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, VariantDict::SIGNATURE.type());
+
+    switch (input_requested) {
+        case InputType::InputWpA2Passphrase:
+            if (request_input_passphrase_cb_ != nullptr) {
+                add_passphrase(&builder,
+                               request_input_passphrase_cb_(found_service));
+            }
+            break;
+        case InputType::InputWpA2PassphraseWpsAlternative:
+            if (request_input_passphrase_cb_ != nullptr) {
+                add_passphrase_or_wps(
+                    &builder, request_input_passphrase_cb_(found_service));
+            }
+            break;
+        case InputType::InputHiddenNetworkName:
+            if (request_input_hidden_network_name_cb_ != nullptr) {
+                add_network_name(
+                    &builder,
+                    request_input_hidden_network_name_cb_(found_service));
+            }
+            break;
+        case InputType::InputChallengeResponse:
+        case InputType::InputWpaEnterprise:
+            if (request_input_wpa_enterprise_cb_ != nullptr) {
+                add_enterprise(&builder,
+                               request_input_wpa_enterprise_cb_(found_service));
+            }
+            break;
+        case InputType::InputWispr:
+            if (request_input_wispr_enabled_cb_ != nullptr) {
+                add_wispr(&builder,
+                          request_input_wispr_enabled_cb_(found_service));
+            }
+            break;
+        default:
+            break;
+    }
+    return g_variant_builder_end(&builder);
+}
+
+void Manager::setup_agent() {
+    agent_->set_request_input_handler(
+        [this](const gchar* service_path, GVariant* fields,
+               const RequestInputReply& reply) -> Agent::RequestInputWork {
+            return request_input_async(service_path, fields, reply);
+        });
+
+    agent_->set_request_input_timeout_handler(
+        [this](const gchar* service_path) {
+            auto found_service = find_service(service_path);
+            OnRequestInputTimeoutCallback callback;
+            {
+                std::lock_guard<StatsMutex> const lock(mtx_);
+                callback = request_input_timeout_cb_;
+            }
+            if (found_service && callback) {
+                callback(found_service);
+            }
+        });
 
     agent_->set_report_error_handler(
-        [this](const gchar* service_path, const gchar* error) -> bool {
-            std::shared_ptr<Service> found_service;
+        [this](const gchar* service_path, const gchar* error)
+            -> std::optional<std::chrono::milliseconds> {
+            auto found_service = find_service(service_path);
             OnReportErrorCallback callback;
             {
-                std::lock_guard<std::mutex> const lock(mtx_);
-                auto service_it = std::ranges::find_if(
-                    services_, [&service_path](const auto& service) {
-                        return service->objPath() == service_path;
-                    });
-                if (service_it != services_.end()) {
-                    found_service = *service_it;
-                }
+                std::lock_guard<StatsMutex> const lock(mtx_);
                 callback = report_error_cb_;
             }
 
-            if (!found_service || callback == nullptr) {
-                return false;
+            if (!found_service || callback == nullptr ||
+                !callback(found_service, error)) {
+                return std::nullopt;
             }
 
-            return callback(found_service, error);
+            return retry_backoff_->next_delay(found_service->objPathView());
         });
 }
 
 void Manager::setOfflineMode(bool offline_mode,
                              PropertiesSetCallback callback) {
     auto data = prepareCallback(std::move(callback));
-    setProperty(OFFLINEMODE_STR,
-                g_variant_new_boolean(static_cast<gboolean>(offline_mode)),
-                nullptr, &Manager::finishAsyncCall, data.release());
+    setProperty(OFFLINEMODE_STR, to_variant(offline_mode), nullptr,
+                &Manager::finishAsyncCall, data.release());
 }
 
 auto Manager::dict_to_path_prop(GVariant* tuple)
     -> std::pair<std::string, VariantPtr> {
-    const gchar* object_path = nullptr;
-
     GVariant* object_path_variant = g_variant_get_child_value(tuple, 0);
-    object_path = g_variant_get_string(object_path_variant, nullptr);
+    auto object_path = ObjectPath::decode(object_path_variant);
+    g_variant_unref(object_path_variant);
 
     VariantPtr properties_dict{g_variant_get_child_value(tuple, 1),
                                &g_variant_unref};
-    g_variant_unref(object_path_variant);
-    return {std::string(object_path), std::move(properties_dict)};
+    return {std::move(object_path), std::move(properties_dict)};
 }
 template <class ProxyType>
 auto Manager::dict_to_proxy(GVariant* tuple) -> std::shared_ptr<ProxyType> {
     const auto [path, properties] = dict_to_path_prop(tuple);
-    auto proxy =
-        std::shared_ptr<ProxyType>(new ProxyType(dbus(), path.c_str()));
+    std::shared_ptr<ProxyType> proxy;
+    if constexpr (std::is_same_v<ProxyType, Service>) {
+        proxy = make_service(path.c_str());
+    } else {
+        proxy =
+            std::shared_ptr<ProxyType>(new ProxyType(dbus(), path.c_str()));
+    }
     proxy->updateProperties(properties.get());
 
     return proxy;
@@ -257,7 +586,9 @@ template <class ProxyType>
 auto Manager::arrays_to_proxies(GVariant* array_od) -> ProxyList<ProxyType> {
     ProxyList<ProxyType> proxies;
 
-    if (g_variant_is_of_type(array_od, G_VARIANT_TYPE("a(oa{sv})")) != 0U) {
+    static constexpr auto SIGNATURE = Signature{"a("} + ObjectPath::SIGNATURE +
+                                      VariantDict::SIGNATURE + Signature{")"};
+    if (SIGNATURE.matches(array_od)) {
         GVariantIter iter;
         g_variant_iter_init(&iter, array_od);
         GVariant* item = nullptr;
@@ -271,23 +602,22 @@ auto Manager::arrays_to_proxies(GVariant* array_od) -> ProxyList<ProxyType> {
 }
 
 template <class ProxyType>
-void Manager::get_proxies_cb(GObject* proxy, GAsyncResult* res,
+void Manager::get_proxies_cb(GVariant* reply, const GError* error,
                              gpointer user_data) {
-    GError* error = nullptr;
-    GVariant* out_properties = nullptr;
     auto* self = static_cast<Manager*>(user_data);
 
-    const auto success =
-        finish(G_DBUS_PROXY(proxy), res, &error, &out_properties);
     ProxyList<ProxyType> proxies;
-    if (success) {
+    if (reply != nullptr) {
+        GVariant* out_properties = g_variant_get_child_value(reply, 0);
         proxies = self->template arrays_to_proxies<ProxyType>(out_properties);
         g_variant_unref(out_properties);
         if constexpr (std::is_same_v<ProxyType, Service>) {
+            auto table = make_service_table(proxies);
             OnServListChangedCallback callback;
             {
-                std::lock_guard<std::mutex> const lock(self->mtx_);
+                std::lock_guard<StatsMutex> const lock(self->mtx_);
                 self->services_ = proxies;
+                self->publish_service_table(std::move(table));
                 if (!self->services_.empty()) {
                     callback = self->services_changed_cb_;
                 }
@@ -296,10 +626,12 @@ void Manager::get_proxies_cb(GObject* proxy, GAsyncResult* res,
                 callback(proxies);
             }
         } else {
+            auto index = make_technology_index(proxies);
             OnTechListChangedCallback callback;
             {
-                std::lock_guard<std::mutex> const lock(self->mtx_);
+                std::lock_guard<StatsMutex> const lock(self->mtx_);
                 self->technologies_ = proxies;
+                self->technology_by_type_ = std::move(index);
                 if (!self->technologies_.empty()) {
                     callback = self->technologies_changed_cb_;
                 }
@@ -311,7 +643,6 @@ void Manager::get_proxies_cb(GObject* proxy, GAsyncResult* res,
 
     } else {
         LCM_LOG(error->message << '\n');
-        g_error_free(error);
     }
 }
 
@@ -327,8 +658,11 @@ void Manager::get_services() {
 
 void Manager::registerAgent(const std::string& object_path,
                             PropertiesSetCallback callback) {
+    if (object_path == agent_->path_) {
+        agent_->export_object();
+    }
     auto data = prepareCallback(std::move(callback));
-    GVariant* child = g_variant_new_object_path(object_path.c_str());
+    GVariant* child = ObjectPath::encode(object_path);
     GVariant* parameters = g_variant_new_tuple(&child, 1);
     callMethod(nullptr, REGISTERAGENT_STR, parameters,
                &Manager::finishAsyncCall, data.release());
@@ -337,41 +671,46 @@ void Manager::registerAgent(const std::string& object_path,
 void Manager::unregisterAgent(const std::string& object_path,
                               PropertiesSetCallback callback) {
     auto data = prepareCallback(std::move(callback));
-    GVariant* child = g_variant_new_object_path(object_path.c_str());
+    GVariant* child = ObjectPath::encode(object_path);
     GVariant* parameters = g_variant_new_tuple(&child, 1);
     callMethod(nullptr, UNREGISTERAGENT_STR, parameters,
                &Manager::finishAsyncCall, data.release());
 }
 
-void Manager::on_technology_added_removed_cb(GDBusProxy* /*proxy*/,
-                                             gchar* /*sender_name*/,
-                                             gchar* signal_name,
+void Manager::on_technology_added_removed_cb(const gchar* signal_name,
                                              GVariant* parameters,
                                              gpointer user_data) {
     auto* self = static_cast<Manager*>(user_data);
+
+    // Same two phases as ServicesChanged: the new list is built outside mtx_
+    // and only published under it.
     Manager::ProxyList<Technology> updated_technologies;
-    OnTechListChangedCallback callback;
     {
-        std::lock_guard<std::mutex> const lock(self->mtx_);
-        if (g_strcmp0(signal_name, "g-signal::TechnologyAdded") == 0U) {
-            const auto technology =
-                self->template dict_to_proxy<Technology>(parameters);
-            self->technologies_.push_back(technology);
-
-        } else if (g_strcmp0(signal_name, "g-signal::TechnologyRemoved") ==
-                   0U) {
-            const auto object_path =
-                std::string(g_variant_get_string(parameters, nullptr));
-
-            self->technologies_.erase(
-                std::remove_if(self->technologies_.begin(),
-                               self->technologies_.end(),
-                               [&object_path](const auto& technology) {
-                                   return technology->objPath() == object_path;
-                               }),
-                self->technologies_.end());
-        }
+        std::lock_guard<StatsMutex> const lock(self->mtx_);
         updated_technologies = self->technologies_;
+    }
+
+    // Both signals share this callback, told apart by their name.
+    if (g_strcmp0(signal_name, "TechnologyAdded") == 0U) {
+        updated_technologies.push_back(
+            self->template dict_to_proxy<Technology>(parameters));
+    } else if (g_strcmp0(signal_name, "TechnologyRemoved") == 0U) {
+        const gchar* removed_path = nullptr;
+        g_variant_get(parameters, "(&o)", &removed_path);
+        const std::string_view object_path(removed_path);
+
+        std::erase_if(updated_technologies,
+                      [&object_path](const auto& technology) {
+                          return technology->objPathView() == object_path;
+                      });
+    }
+    auto index = make_technology_index(updated_technologies);
+
+    OnTechListChangedCallback callback;
+    {
+        std::lock_guard<StatsMutex> const lock(self->mtx_);
+        self->technologies_ = updated_technologies;
+        self->technology_by_type_ = std::move(index);
         callback = self->technologies_changed_cb_;
     }
     if (callback) {
@@ -379,50 +718,67 @@ void Manager::on_technology_added_removed_cb(GDBusProxy* /*proxy*/,
     }
 }
 
-void Manager::on_services_changed_cb(GDBusProxy* /*proxy*/,
-                                     gchar* /*sender_name*/,
-                                     gchar* /*signal_name*/,
-                                     GVariant* parameters, gpointer user_data) {
+void Manager::on_services_changed_cb(const gchar* signal_name,
+                                     GVariant* parameters,
+                                     gpointer user_data) {
     auto* self = static_cast<Manager*>(user_data);
 
-    GVariant* changed = nullptr;
-    GVariant* removed = nullptr;
-
-    changed = g_variant_get_child_value(parameters, 0);
-    removed = g_variant_get_child_value(parameters, 1);
-
-    std::vector<std::pair<std::string, VariantPtr>> services_changed;
-    std::vector<std::string> services_removed;
-
-    GVariantIter iter;
-    g_variant_iter_init(&iter, changed);
-    GVariant* item = nullptr;
-
-    while ((item = g_variant_iter_next_value(&iter)) != nullptr) {
-        services_changed.push_back(dict_to_path_prop(item));
-        g_variant_unref(item);
+    // Outlives signal, which is allocated from the arena.
+    const SignalArena::Scope arena_scope(*self->signal_arena_);
+    auto* resource = self->signal_arena_->resource();
+    auto in_place =
+        self->dbus()->flatSignal(signal_name)
+            ? decode_services_changed_in_place(parameters, resource)
+            : std::nullopt;
+    const auto signal =
+        in_place ? std::move(*in_place)
+                 : decode_services_changed(parameters, resource);
+
+    Manager::ProxyList<Service> current_services;
+    OnServListChangedCallback callback;
+    {
+        std::lock_guard<StatsMutex> const lock(self->mtx_);
+        current_services = self->services_;
+        callback = self->services_changed_cb_;
     }
-    g_variant_unref(changed);
 
-    GVariantIter iter_removed;
-    g_variant_iter_init(&iter_removed, removed);
-    GVariant* removed_item = nullptr;
-    while ((removed_item = g_variant_iter_next_value(&iter_removed)) !=
-           nullptr) {
-        const gchar* removed_path = g_variant_get_string(removed_item, nullptr);
-        services_removed.emplace_back(removed_path);
-        g_variant_unref(removed_item);
+    /*
+     * A rescan typically repeats the whole list with nothing changed: the
+     * list, the table and the proxies are then already up to date.
+     */
+    const auto same_order = std::ranges::equal(
+        signal.changed, current_services,
+        [](const auto& entry, const auto& service) {
+            return entry.path == service->objPathView();
+        });
+    if (same_order && signal.orderOnly()) {
+        if (callback) {
+            callback(current_services);
+        }
+        return;
     }
-    g_variant_unref(removed);
 
-    Manager::ProxyList<Service> updated_services;
-    OnServListChangedCallback callback;
-    {
-        std::lock_guard<std::mutex> const lock(self->mtx_);
-        self->process_services_changed(services_removed, services_changed);
-        updated_services = self->services_;
+    auto updated_services =
+        self->process_services_changed(current_services, signal);
+
+    if (same_order && signal.removed.empty()) {
+        // Same services in the same order: refresh the changed rows in place.
+        std::lock_guard<std::mutex> const lock(self->service_table_->mtx);
+        for (std::size_t i = 0; i < signal.changed.size(); ++i) {
+            if (signal.changed[i].properties) {
+                const auto& service = updated_services[i];
+                self->service_table_->table.update(
+                    service->id(), service->currentProperties());
+            }
+        }
+    } else {
+        auto table = make_service_table(updated_services);
+        std::lock_guard<StatsMutex> const lock(self->mtx_);
+        self->services_ = updated_services;
+        self->publish_service_table(std::move(table));
         callback = self->services_changed_cb_;
     }
+
     if (callback) {
         callback(updated_services);
     }
@@ -430,108 +786,27 @@ void Manager::on_services_changed_cb(GDBusProxy* /*proxy*/,
 
 void Manager::onTechnologiesChanged(OnTechListChangedCallback callback) {
     if (callback != nullptr) {
-        std::lock_guard<std::mutex> const lock(mtx_);
+        std::lock_guard<StatsMutex> const lock(mtx_);
         technologies_changed_cb_ = std::move(callback);
     }
 }
 
 void Manager::onServicesChanged(OnServListChangedCallback callback) {
     if (callback != nullptr) {
-        std::lock_guard<std::mutex> const lock(mtx_);
+        std::lock_guard<StatsMutex> const lock(mtx_);
         services_changed_cb_ = std::move(callback);
     }
 }
 
-using FieldDescription = struct {
-    gchar* field_name;
-    gchar* type;
-    gchar* requirement;
-};
-
-static void field_description_free(gpointer data) {
-    auto* desc = static_cast<FieldDescription*>(data);
-    if (desc == nullptr) {
-        return;
-    }
-
-    g_free(desc->field_name);
-    g_free(desc->type);
-    g_free(desc->requirement);
-    g_free(desc);
-}
-
-auto Manager::parse_fields(GVariant* fields) -> GPtrArray* {
-    GPtrArray* array = g_ptr_array_new_with_free_func(field_description_free);
-
-    GVariantIter iter;
-    const gchar* field_name = nullptr;
-    GVariant* inner_dict = nullptr;
-
-    g_variant_iter_init(&iter, fields);
-
-    while (g_variant_iter_next(&iter, "{&sv}", &field_name, &inner_dict) != 0) {
-        FieldDescription* desc = g_new0(FieldDescription, 1);
-        desc->field_name = g_strdup(field_name);
-
-        GVariantIter inner_iter;
-        const gchar* prop_name = nullptr;
-        GVariant* prop_value_variant = nullptr;
-
-        g_variant_iter_init(&inner_iter, inner_dict);
-        while (g_variant_iter_next(&inner_iter, "{&s@v}", &prop_name,
-                                   &prop_value_variant) != 0) {
-            auto* prop_value = g_variant_get_variant(prop_value_variant);
-            if (g_strcmp0(prop_name, "Type") == 0) {
-                desc->type = g_variant_dup_string(prop_value, nullptr);
-            } else if (g_strcmp0(prop_name, "Requirement") == 0) {
-                desc->requirement = g_variant_dup_string(prop_value, nullptr);
-            }
-            g_variant_unref(prop_value);
-            g_variant_unref(prop_value_variant);
-        }
-        g_variant_unref(inner_dict);
-
-        g_ptr_array_add(array, desc);
-    }
-    return array;
-}
-
-auto Manager::classify_input(GPtrArray* fields) -> InputType {
-    bool has_passphrase{false};
-    bool has_wps{false};
-    bool has_name{false};
-    bool has_identity{false};
-    bool has_username{false};
-    bool has_password{false};
-    bool has_challenge{false};
-
-    for (guint i = 0; i < fields->len; ++i) {
-        auto* desc =
-            static_cast<FieldDescription*>(g_ptr_array_index(fields, i));
-        if (g_strcmp0(desc->field_name, "Passphrase") == 0 &&
-            g_strcmp0(desc->requirement, "mandatory") == 0) {
-            has_passphrase = TRUE;
-        }
-        if (g_strcmp0(desc->field_name, "WPS") == 0) {
-            has_wps = TRUE;
-        }
-        if (g_strcmp0(desc->field_name, "Name") == 0) {
-            has_name = TRUE;
-        }
-        if (g_strcmp0(desc->field_name, "Identity") == 0) {
-            has_identity = TRUE;
-        }
-        if (g_strcmp0(desc->field_name, "Username") == 0) {
-            has_username = TRUE;
-        }
-        if (g_strcmp0(desc->field_name, "Password") == 0) {
-            has_password = TRUE;
-        }
-        if (g_strcmp0(desc->field_name, "Passphrase") == 0 &&
-            g_strcmp0(desc->type, "response") == 0) {
-            has_challenge = TRUE;
-        }
-    }
+auto Manager::classify_input(GVariant* fields) -> InputType {
+    const auto found = input_fields(fields);
+    const bool has_passphrase = (found & FieldMandatoryPassphrase) != 0U;
+    const bool has_wps = (found & FieldWPS) != 0U;
+    const bool has_name = (found & FieldName) != 0U;
+    const bool has_identity = (found & FieldIdentity) != 0U;
+    const bool has_username = (found & FieldUsername) != 0U;
+    const bool has_password = (found & FieldPassword) != 0U;
+    const bool has_challenge = (found & FieldPassphraseResponse) != 0U;
 
     if (has_passphrase && !has_wps && !has_identity) {
         return InputType::InputWpA2Passphrase;
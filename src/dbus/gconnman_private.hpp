@@ -1,6 +1,27 @@
+#pragma once
+
+#include <glib.h>
 
 namespace Amarula::DBus::G::Connman {
 
+/*
+ * Specialised in the translation unit of every Properties type with the
+ * PropertyTable of its D-Bus properties. Properties types befriend it so the
+ * table can name their private members.
+ */
+template <class Properties>
+struct PropertyDescriptors;
+
+struct ServProperties;
+
+/*
+ * Applies a whole a{sv} dict of service properties: decodes every entry, or
+ * in view mode keeps the dict for the getters to decode from.
+ */
+struct ServPropertiesDict {
+    static void apply(ServProperties& properties, GVariant* dict, bool lazy);
+};
+
 constexpr auto SERVICE = "net.connman";
 constexpr auto OBJECT_PATH = "/net/connman";
 constexpr auto MANAGER_PATH = "/";
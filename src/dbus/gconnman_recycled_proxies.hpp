@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Amarula::DBus::G::Connman {
+
+/*
+ * Proxies dropped from a list signal (Wi-Fi access points fading in and out),
+ * kept for up to ttl and at most capacity of them, so that an object path
+ * coming back gets the very same proxy, user callbacks included. One coming
+ * out loses its properties through resetProperties(); one given up on, past
+ * its ttl or beyond capacity, its user callbacks through retire(). A capacity
+ * of 0 disables the pool.
+ */
+template <class Proxy>
+class RecycledProxies {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    RecycledProxies(std::size_t capacity, std::chrono::seconds ttl)
+        : capacity_{capacity}, ttl_{ttl} {}
+
+    void configure(std::size_t capacity, std::chrono::seconds ttl) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        capacity_ = capacity;
+        ttl_ = ttl;
+        auto expired = expire(Clock::now());
+        lock.unlock();
+        retire(expired);
+    }
+
+    void put(std::shared_ptr<Proxy> proxy,
+             Clock::time_point now = Clock::now()) {
+        auto obj_path = proxy->objPath();
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (capacity_ == 0U) {
+            lock.unlock();
+            proxy->retire();
+            return;
+        }
+        entries_.push_back(Entry{std::move(obj_path), std::move(proxy), now});
+        auto expired = expire(now);
+        lock.unlock();
+        retire(expired);
+    }
+
+    // The proxy last put for obj_path, without properties, or nullptr.
+    auto take(std::string_view obj_path, Clock::time_point now = Clock::now())
+        -> std::shared_ptr<Proxy> {
+        std::unique_lock<std::mutex> lock(mtx_);
+        auto expired = expire(now);
+        auto entry_it =
+            std::ranges::find_if(entries_, [obj_path](const auto& entry) {
+                return entry.obj_path == obj_path;
+            });
+        std::shared_ptr<Proxy> proxy;
+        if (entry_it != entries_.end()) {
+            proxy = std::move(entry_it->proxy);
+            entries_.erase(entry_it);
+        }
+        lock.unlock();
+        retire(expired);
+        if (!proxy) {
+            return nullptr;
+        }
+
+        // Properties left over from the previous life must not leak into the
+        // new one: connman sends the full set for a returning object.
+        proxy->resetProperties();
+        return proxy;
+    }
+
+    [[nodiscard]] auto size() -> std::size_t {
+        std::lock_guard<std::mutex> const lock(mtx_);
+        return entries_.size();
+    }
+
+   private:
+    struct Entry {
+        std::string obj_path;
+        std::shared_ptr<Proxy> proxy;
+        Clock::time_point removed_at;
+    };
+
+    std::mutex mtx_;
+    std::size_t capacity_;
+    std::chrono::seconds ttl_;
+    std::deque<Entry> entries_;  // oldest first
+
+    // The proxies given up on, to be retired once the lock is released.
+    auto expire(Clock::time_point now) -> std::vector<std::shared_ptr<Proxy>> {
+        std::vector<std::shared_ptr<Proxy>> expired;
+        while (!entries_.empty() &&
+               (entries_.size() > capacity_ ||
+                now - entries_.front().removed_at > ttl_)) {
+            expired.push_back(std::move(entries_.front().proxy));
+            entries_.pop_front();
+        }
+        return expired;
+    }
+
+    /*
+     * Their object is not expected back: nobody is to be told about it, and
+     * the callbacks may hold what their owner wants released. Dropping the
+     * proxies may run the callbacks' destructors too, hence outside the lock.
+     */
+    static void retire(const std::vector<std::shared_ptr<Proxy>>& expired) {
+        for (const auto& proxy : expired) {
+            proxy->retire();
+        }
+    }
+};
+
+}  // namespace Amarula::DBus::G::Connman
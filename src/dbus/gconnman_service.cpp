@@ -1,15 +1,25 @@
+#include <arpa/inet.h>
 #include <glib.h>
 
 #include <amarula/dbus/connman/gservice.hpp>
 #include <amarula/dbus/gdbus.hpp>
 #include <amarula/dbus/gproxy.hpp>
+#include <amarula/dbus/gvariant_view.hpp>
 #include <amarula/log.hpp>
+#include <array>
+#include <bit>
+#include <cstddef>
 #include <cstdint>
+#include <mutex>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <utility>
 
 #include "gconnman_private.hpp"
 #include "gdbus_private.hpp"
+#include "gproperty_table.hpp"
+#include "gvariant_codec.hpp"
 
 namespace Amarula::DBus::G::Connman {
 
@@ -84,9 +94,73 @@ static constexpr EnumStringMap<IPv6::Privacy, 4> IPV6_PRIVACY_MAP{
       {IPv6::Privacy::Preferred, "preferred"},
       {IPv6::Privacy::Preferred, "prefered"}}}};
 
+/*
+ * Addresses are kept in binary, as inet_pton() reads them: a malformed one is
+ * logged and dropped rather than stored as text.
+ */
+template <class Address, int Family>
+struct AddressCodec {
+    using Type = std::optional<Address>;
+    static constexpr Signature SIGNATURE{"s"};
+
+    static auto decode(GVariant* value) -> Type {
+        const gchar* text = g_variant_get_string(value, nullptr);
+        Address address{};
+        if (inet_pton(Family, text, &address) != 1) {
+            LCM_LOG("Malformed address: " << text << '\n');
+            return std::nullopt;
+        }
+        return address;
+    }
+};
+
+template <int Family, std::size_t Length, class Address>
+static auto format_address(const std::optional<Address>& address)
+    -> std::string {
+    if (!address) {
+        return {};
+    }
+    std::array<char, Length> text{};
+    inet_ntop(Family, &*address, text.data(), text.size());
+    return text.data();
+}
+
+auto IPv4::getAddress() const -> std::string {
+    return format_address<AF_INET, INET_ADDRSTRLEN>(address_);
+}
+
+auto IPv4::getNetmask() const -> std::string {
+    return format_address<AF_INET, INET_ADDRSTRLEN>(netmask_);
+}
+
+auto IPv4::getGateway() const -> std::string {
+    return format_address<AF_INET, INET_ADDRSTRLEN>(gateway_);
+}
+
+auto IPv4::getPrefixLength() const -> uint8_t {
+    if (!netmask_) {
+        return 0U;
+    }
+    return static_cast<uint8_t>(std::popcount(ntohl(netmask_->s_addr)));
+}
+
+auto IPv6::getAddress() const -> std::string {
+    return format_address<AF_INET6, INET6_ADDRSTRLEN>(address_);
+}
+
+auto IPv6::getGateway() const -> std::string {
+    return format_address<AF_INET6, INET6_ADDRSTRLEN>(gateway_);
+}
+
 Service::Service(DBus* dbus, const gchar* obj_path)
     : DBusProxy(dbus, SERVICE, obj_path, SERVICE_INTERFACE) {}
 
+void Service::onPropertiesUpdated(const ServProperties& properties) {
+    if (on_updated_) {
+        on_updated_(id_, properties, became_connected(properties));
+    }
+}
+
 void Service::connect(PropertiesSetCallback callback) {
     auto data = prepareCallback(std::move(callback));
     callMethod(nullptr, CONNECT_STR, nullptr, &Service::finishAsyncCall,
@@ -108,186 +182,375 @@ void Service::remove(PropertiesSetCallback callback) {
 void Service::setAutoconnect(const bool autoconnect,
                              PropertiesSetCallback callback) {
     auto data = prepareCallback(std::move(callback));
-    setProperty(AUTOCONNECT_STR,
-                g_variant_new_boolean(static_cast<gboolean>(autoconnect)),
-                nullptr, &Service::finishAsyncCall, data.release());
+    setProperty(AUTOCONNECT_STR, to_variant(autoconnect), nullptr,
+                &Service::finishAsyncCall, data.release());
 }
 
 void Service::setNameServers(const std::vector<std::string>& name_servers,
                              PropertiesSetCallback callback) {
     auto data = prepareCallback(std::move(callback));
-    auto variant = vector_to_as(name_servers);
-    setProperty(NAMESERVERS_CONFIGURATION_STR, variant.get(), nullptr,
-                &Service::finishAsyncCall, data.release());
+    setProperty(NAMESERVERS_CONFIGURATION_STR, to_variant(name_servers),
+                nullptr, &Service::finishAsyncCall, data.release());
 }
 
-void IPv4::update(const gchar* key, GVariant* value) {
-    if (g_strcmp0(key, METHOD_STR) == 0U) {
-        method_ =
-            IPV4_METHOD_MAP.fromString(g_variant_get_string(value, nullptr));
-    } else if (g_strcmp0(key, ADDRESS_STR) == 0U) {
-        address_ = g_variant_get_string(value, nullptr);
-    } else if (g_strcmp0(key, NETMASK_STR) == 0U) {
-        netmask_ = g_variant_get_string(value, nullptr);
-    } else if (g_strcmp0(key, GATEWAY_STR) == 0U) {
-        gateway_ = g_variant_get_string(value, nullptr);
-    } else {
-        LCM_LOG("Unknown property for IPv4: " << key << '\n');
-    }
+template <>
+struct PropertyDescriptors<IPv4> {
+    using Address = AddressCodec<in_addr, AF_INET>;
+
+    static constexpr PropertyTable TABLE{
+        "IPv4",
+        std::array{
+            property<&IPv4::method_, EnumCodec<IPV4_METHOD_MAP>>(METHOD_STR),
+            property<&IPv4::address_, Address>(ADDRESS_STR),
+            property<&IPv4::netmask_, Address>(NETMASK_STR),
+            property<&IPv4::gateway_, Address>(GATEWAY_STR)}};
+};
+
+template <>
+struct PropertyDescriptors<IPv6> {
+    using Address = AddressCodec<in6_addr, AF_INET6>;
+
+    static constexpr PropertyTable TABLE{
+        "IPv6",
+        std::array{
+            property<&IPv6::method_, EnumCodec<IPV6_METHOD_MAP>>(METHOD_STR),
+            property<&IPv6::address_, Address>(ADDRESS_STR),
+            property<&IPv6::gateway_, Address>(GATEWAY_STR),
+            property<&IPv6::privacy_, EnumCodec<IPV6_PRIVACY_MAP>>(PRIVACY_STR),
+            property<&IPv6::prefix_length_, Codec<uint8_t>>(PREFIXLENGTH_STR)}};
+};
+
+template <>
+struct PropertyDescriptors<Ethernet> {
+    static constexpr PropertyTable TABLE{
+        "Ethernet",
+        std::array{
+            property<&Ethernet::method_, EnumCodec<ETHERNET_METHOD_MAP>>(
+                METHOD_STR),
+            property<&Ethernet::interface_, Codec<InternedString>>(
+                INTERFACE_STR),
+            property<&Ethernet::address_, Codec<std::string>>(ADDRESS_STR),
+            property<&Ethernet::mtu_, Codec<uint16_t>>(MTU_STR)}};
+};
+
+template <>
+struct PropertyDescriptors<Provider> {
+    static constexpr PropertyTable TABLE{
+        "Provider",
+        std::array{
+            property<&Provider::host_, Codec<std::string>>(HOST_STR),
+            property<&Provider::domain_, Codec<InternedString>>(DOMAIN_STR),
+            property<&Provider::name_, Codec<std::string>>(NAME_STR),
+            property<&Provider::type_, Codec<InternedString>>(TYPE_STR)}};
+};
+
+template <>
+struct PropertyDescriptors<Proxy> {
+    static constexpr PropertyTable TABLE{
+        "Proxy",
+        std::array{
+            property<&Proxy::method_, EnumCodec<PROXY_METHOD_MAP>>(METHOD_STR),
+            property<&Proxy::url_, Codec<std::string>>(URL_STR),
+            property<&Proxy::servers_, Codec<PropertyList<InternedString>>>(
+                SERVERS_STR),
+            property<&Proxy::excludes_, Codec<PropertyList<InternedString>>>(
+                EXCLUDES_STR)}};
+};
+
+IPv4::IPv4(GVariant* variant) {
+    PropertyDescriptors<IPv4>::TABLE.parse(*this, variant);
 }
 
-void IPv6::update(const gchar* key, GVariant* value) {
-    if (g_strcmp0(key, METHOD_STR) == 0U) {
-        method_ =
-            IPV6_METHOD_MAP.fromString(g_variant_get_string(value, nullptr));
-    } else if (g_strcmp0(key, ADDRESS_STR) == 0U) {
-        address_ = g_variant_get_string(value, nullptr);
-    } else if (g_strcmp0(key, GATEWAY_STR) == 0U) {
-        gateway_ = g_variant_get_string(value, nullptr);
-    } else if (g_strcmp0(key, PRIVACY_STR) == 0U) {
-        privacy_ =
-            IPV6_PRIVACY_MAP.fromString(g_variant_get_string(value, nullptr));
-    } else if (g_strcmp0(key, PREFIXLENGTH_STR) == 0U) {
-        prefix_length_ = static_cast<uint8_t>(g_variant_get_byte(value));
-    } else {
-        LCM_LOG("Unknown property for IPv6: " << key << '\n');
-    }
+IPv6::IPv6(GVariant* variant) {
+    PropertyDescriptors<IPv6>::TABLE.parse(*this, variant);
 }
 
-void GVariantParser::parse(GVariant* variant) {
-    GVariantIter* iter = g_variant_iter_new(variant);
-    GVariant* prop = nullptr;
+Ethernet::Ethernet(GVariant* variant) {
+    PropertyDescriptors<Ethernet>::TABLE.parse(*this, variant);
+}
 
-    while ((prop = g_variant_iter_next_value(iter)) != nullptr) {
-        GVariant* key_variant = g_variant_get_child_value(prop, 0);
-        const gchar* key = g_variant_get_string(key_variant, nullptr);
-        GVariant* wrapped = g_variant_get_child_value(prop, 1);
-        GVariant* value = g_variant_get_variant(wrapped);
+Provider::Provider(GVariant* variant) {
+    PropertyDescriptors<Provider>::TABLE.parse(*this, variant);
+}
 
-        update(key, value);
+Proxy::Proxy(GVariant* variant) {
+    PropertyDescriptors<Proxy>::TABLE.parse(*this, variant);
+}
 
-        g_variant_unref(key_variant);
-        g_variant_unref(wrapped);
-        g_variant_unref(value);
-        g_variant_unref(prop);
+template <>
+struct PropertyDescriptors<ServProperties> {
+    // The a{sv} of IPv4, Ethernet and the others, unset when empty.
+    template <class Nested>
+    struct NestedCodec {
+        using Type = Nested;
+        static constexpr auto SIGNATURE = VariantDict::SIGNATURE;
+
+        static auto decode(GVariant* value) -> Type { return Nested(value); }
+    };
+    template <class Nested>
+    using Dict = NonEmpty<NestedCodec<Nested>>;
+
+    // Lists of addresses and domains most services share.
+    using List = NonEmpty<Codec<PropertyList<InternedString>>>;
+
+    using Props = ServProperties;
+    using Field = ServProperties::Field;
+
+    // Laid out by Field, which the lazy getters index the table with.
+    static constexpr PropertyTable TABLE{"Service", [] {
+        const auto at = [](Field field) {
+            return static_cast<std::size_t>(field);
+        };
+        std::array<Property<Props>, at(Field::Count)> entries{};
+        entries[at(Field::Name)] =
+            property<&Props::name_, Codec<std::string>>(NAME_STR);
+        entries[at(Field::Type)] =
+            property<&Props::type_, EnumCodec<TYPE_MAP>>(TYPE_STR);
+        entries[at(Field::State)] =
+            property<&Props::state_, EnumCodec<STATE_MAP>>(STATE_STR);
+        entries[at(Field::Error)] =
+            property<&Props::error_, EnumCodec<ERROR_MAP>>(ERROR_STR);
+        entries[at(Field::Favorite)] =
+            flag_property<&Props::flags_, Props::FAVORITE>(FAVORITE_STR);
+        entries[at(Field::Immutable)] =
+            flag_property<&Props::flags_, Props::IMMUTABLE>(IMMUTABLE_STR);
+        entries[at(Field::AutoConnect)] =
+            flag_property<&Props::flags_, Props::AUTOCONNECT>(
+                AUTOCONNECT_STR);
+        entries[at(Field::MDNS)] =
+            flag_property<&Props::flags_, Props::MDNS>(MDNS_STR);
+        entries[at(Field::Strength)] =
+            property<&Props::strength_, Codec<uint8_t>>(STRENGTH_STR);
+        entries[at(Field::IPv4)] =
+            property<&Props::ipv4_, Dict<IPv4>>(IPV4_STR);
+        entries[at(Field::IPv6)] =
+            property<&Props::ipv6_, Dict<IPv6>>(IPV6_STR);
+        entries[at(Field::Ethernet)] =
+            property<&Props::ethernet_, Dict<Ethernet>>(ETHERNET_STR);
+        entries[at(Field::Provider)] =
+            property<&Props::provider_, Dict<Provider>>(PROVIDER_STR);
+        entries[at(Field::Proxy)] =
+            property<&Props::proxy_, Dict<Proxy>>(PROXY_STR);
+        entries[at(Field::Security)] =
+            property<&Props::security_,
+                     NonEmpty<ArrayCodec<EnumCodec<SECURITY_MAP>>>>(
+                SECURITY_STR);
+        entries[at(Field::Nameservers)] =
+            property<&Props::name_servers_, List>(NAMESERVERS_STR);
+        entries[at(Field::NameserversConfiguration)] =
+            property<&Props::name_servers_conf_, List>(
+                NAMESERVERS_CONFIGURATION_STR);
+        entries[at(Field::Domains)] =
+            property<&Props::domains_, List>(DOMAINS_STR);
+        entries[at(Field::Timeservers)] =
+            property<&Props::time_servers_, List>(TIMESERVERS_STR);
+        return entries;
+    }()};
+
+    static constexpr auto bit(std::size_t entry) -> uint32_t {
+        return 1U << entry;
+    }
+    static_assert(TABLE.size() <= 32U, "decoded_ has a bit per property");
+
+    // Bits of the table entries dict has a value for.
+    static auto entries_in(GVariant* dict) -> std::optional<uint32_t> {
+        uint32_t entries = 0U;
+        const auto valid = VariantView::of(dict).forEachEntry(
+            [&entries](std::string_view key, std::string_view /*type*/,
+                       VariantView /*value*/) {
+                if (const auto entry = TABLE.find(key)) {
+                    entries |= bit(*entry);
+                }
+            });
+        if (!valid) {
+            return std::nullopt;
+        }
+        return entries;
+    }
+
+    /*
+     * What the ServiceTable and the Manager read of every service. In view
+     * mode they are decoded as soon as a dict is kept, in place and without
+     * allocating, so that reading them never goes back to the dict.
+     */
+    static constexpr uint32_t SCALARS = [] {
+        uint32_t bits = 0U;
+        for (const auto field :
+             {Field::Type, Field::State, Field::Error, Field::Favorite,
+              Field::Immutable, Field::AutoConnect, Field::MDNS,
+              Field::Strength}) {
+            bits |= 1U << static_cast<unsigned>(field);
+        }
+        return bits;
+    }();
+
+    template <const auto& Map, class Enum>
+    static auto decode_enum(Enum& member, std::string_view type,
+                            VariantView value) -> bool {
+        const auto str = value.asString();
+        if (type != "s" || !str) {
+            return false;
+        }
+        member = Map.fromString(*str).value_or(Enum::Unknown);
+        return true;
+    }
+
+    static auto decode_flag(Props& properties, uint8_t flag,
+                            std::string_view type, VariantView value) -> bool {
+        if (type != "b" || value.size() != 1U) {
+            return false;
+        }
+        auto& flags = properties.flags_;
+        flags = *value.data() != 0U ? static_cast<uint8_t>(flags | flag)
+                                    : static_cast<uint8_t>(flags & ~flag);
+        return true;
     }
-    g_variant_iter_free(iter);
-}
 
-void Ethernet::update(const gchar* key, GVariant* value) {
-    if (g_strcmp0(key, METHOD_STR) == 0U) {
-        method_ = ETHERNET_METHOD_MAP.fromString(
-            g_variant_get_string(value, nullptr));
-    } else if (g_strcmp0(key, INTERFACE_STR) == 0U) {
-        interface_ = g_variant_get_string(value, nullptr);
-    } else if (g_strcmp0(key, ADDRESS_STR) == 0U) {
-        address_ = g_variant_get_string(value, nullptr);
-    } else if (g_strcmp0(key, MTU_STR) == 0U) {
-        mtu_ = static_cast<uint16_t>(g_variant_get_uint16(value));
+    // false when value is not of the type of field, or field no scalar.
+    static auto decode_scalar(Props& properties, Field field,
+                              std::string_view type, VariantView value)
+        -> bool {
+        switch (field) {
+            case Field::Type:
+                return decode_enum<TYPE_MAP>(properties.type_, type, value);
+            case Field::State:
+                return decode_enum<STATE_MAP>(properties.state_, type, value);
+            case Field::Error:
+                return decode_enum<ERROR_MAP>(properties.error_, type, value);
+            case Field::Favorite:
+                return decode_flag(properties, Props::FAVORITE, type, value);
+            case Field::Immutable:
+                return decode_flag(properties, Props::IMMUTABLE, type, value);
+            case Field::AutoConnect:
+                return decode_flag(properties, Props::AUTOCONNECT, type,
+                                   value);
+            case Field::MDNS:
+                return decode_flag(properties, Props::MDNS, type, value);
+            case Field::Strength:
+                if (type != "y" || value.size() != 1U) {
+                    return false;
+                }
+                properties.strength_ = *value.data();
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /*
+     * Decodes the SCALARS entries of the kept dict. Those it lacks keep what
+     * they had, which keep() resolved from the previous dict, if any.
+     */
+    static void decode_scalars(Props& properties) {
+        const auto decode = [&properties](std::string_view key,
+                                          std::string_view type,
+                                          VariantView value) {
+            const auto entry = TABLE.find(key);
+            if (!entry || (SCALARS & bit(*entry)) == 0U) {
+                return;
+            }
+            if (!decode_scalar(properties, static_cast<Field>(*entry), type,
+                               value)) {
+                LCM_LOG("Unexpected type for Service." << key << ": " << type
+                                                        << '\n');
+            }
+        };
+        static_cast<void>(
+            VariantView::of(properties.source_.get()).forEachEntry(decode));
+        properties.decoded_ |= SCALARS;
+    }
+};
+
+void ServProperties::update(const gchar* key, GVariant* value) {
+    const auto& table = PropertyDescriptors<ServProperties>::TABLE;
+    if (const auto entry = table.find(key)) {
+        table.decode(*this, *entry, value);
+        decoded_ |= PropertyDescriptors<ServProperties>::bit(*entry);
     } else {
-        LCM_LOG("Unknown property for Ethernet: " << key << '\n');
+        LCM_LOG("Unknown property for Service: " << key << '\n');
     }
 }
 
-void Provider::update(const gchar* key, GVariant* value) {
-    if (g_strcmp0(key, HOST_STR) == 0U) {
-        host_ = g_variant_get_string(value, nullptr);
-    } else if (g_strcmp0(key, DOMAIN_STR) == 0U) {
-        domain_ = g_variant_get_string(value, nullptr);
-    } else if (g_strcmp0(key, NAME_STR) == 0U) {
-        name_ = g_variant_get_string(value, nullptr);
-    } else if (g_strcmp0(key, TYPE_STR) == 0U) {
-        type_ = g_variant_get_string(value, nullptr);
-    } else {
-        LCM_LOG("Unknown property for Provider: " << key << '\n');
+void ServProperties::resolve(Field field) const {
+    if (guard_.mtx == nullptr) {
+        resolve_unlocked(field);
+        return;
     }
+    // The D-Bus thread reading a field in a callback, while other threads
+    // may be copying these properties.
+    std::lock_guard<std::mutex> const lock(*guard_.mtx);
+    resolve_unlocked(field);
 }
 
-void Proxy::update(const gchar* key, GVariant* value) {
-    if (g_strcmp0(key, METHOD_STR) == 0U) {
-        method_ =
-            PROXY_METHOD_MAP.fromString(g_variant_get_string(value, nullptr));
-    } else if (g_strcmp0(key, URL_STR) == 0U) {
-        url_ = g_variant_get_string(value, nullptr);
-    } else if (g_strcmp0(key, SERVERS_STR) == 0U) {
-        servers_ = as_to_vector(value);
-    } else if (g_strcmp0(key, EXCLUDES_STR) == 0U) {
-        excludes_ = as_to_vector(value);
-    } else {
-        LCM_LOG("Unknown property for Proxy: " << key << '\n');
+void ServProperties::resolve_unlocked(Field field) const {
+    using Descriptors = PropertyDescriptors<ServProperties>;
+    const auto entry = static_cast<std::size_t>(field);
+    if ((decoded_ & Descriptors::bit(entry)) != 0U) {
+        return;
+    }
+    decoded_ |= Descriptors::bit(entry);
+
+    GVariant* value = g_variant_lookup_value(
+        source_.get(), Descriptors::TABLE.key(entry).data(), nullptr);
+    if (value != nullptr) {
+        // Only the mutable field of entry is written.
+        Descriptors::TABLE.decode(const_cast<ServProperties&>(*this), entry,
+                                  value);
+        g_variant_unref(value);
     }
 }
 
-void ServProperties::update(const gchar* key, GVariant* value) {
-    if (g_strcmp0(key, NAME_STR) == 0) {
-        name_ = g_variant_get_string(value, nullptr);
-    } else if (g_strcmp0(key, TYPE_STR) == 0U) {
-        type_ = TYPE_MAP.fromString(g_variant_get_string(value, nullptr));
-    } else if (g_strcmp0(key, STATE_STR) == 0U) {
-        state_ = STATE_MAP.fromString(g_variant_get_string(value, nullptr));
-    } else if (g_strcmp0(key, ERROR_STR) == 0U) {
-        error_ = ERROR_MAP.fromString(g_variant_get_string(value, nullptr));
-    } else if (g_strcmp0(key, FAVORITE_STR) == 0U) {
-        favorite_ = g_variant_get_boolean(value) == 1U;
-    } else if (g_strcmp0(key, IMMUTABLE_STR) == 0U) {
-        immutable_ = g_variant_get_boolean(value) == 1U;
-    } else if (g_strcmp0(key, AUTOCONNECT_STR) == 0U) {
-        autoconnect_ = g_variant_get_boolean(value) == 1U;
-    } else if (g_strcmp0(key, MDNS_STR) == 0U) {
-        mdns_ = g_variant_get_boolean(value) == 1U;
-    } else if (g_strcmp0(key, STRENGTH_STR) == 0U) {
-        strength_ = g_variant_get_byte(value);
-    } else if (g_strcmp0(key, IPV4_STR) == 0U) {
-        ipv4_ = (g_variant_n_children(value) != 0)
-                    ? std::optional<IPv4>(IPv4(value))
-                    : std::nullopt;
-    } else if (g_strcmp0(key, IPV6_STR) == 0U) {
-        ipv6_ = (g_variant_n_children(value) != 0)
-                    ? std::optional<IPv6>(IPv6(value))
-                    : std::nullopt;
-    } else if (g_strcmp0(key, ETHERNET_STR) == 0U) {
-        ethernet_ = (g_variant_n_children(value) != 0)
-                        ? std::optional<Ethernet>(Ethernet(value))
-                        : std::nullopt;
-    } else if (g_strcmp0(key, PROVIDER_STR) == 0U) {
-        provider_ = (g_variant_n_children(value) != 0)
-                        ? std::optional<Provider>(Provider(value))
-                        : std::nullopt;
-    } else if (g_strcmp0(key, PROXY_STR) == 0U) {
-        proxy_ = (g_variant_n_children(value) != 0)
-                     ? std::optional<Proxy>(Proxy(value))
-                     : std::nullopt;
-    } else if (g_strcmp0(key, SECURITY_STR) == 0U) {
-        security_ = (g_variant_n_children(value) != 0)
-                        ? std::optional<std::vector<Security>>(
-                              as_to_vector<Security>(value, &SECURITY_MAP))
-                        : std::nullopt;
-    } else if (g_strcmp0(key, NAMESERVERS_STR) == 0U) {
-        name_servers_ =
-            (g_variant_n_children(value) != 0)
-                ? std::optional<std::vector<std::string>>(as_to_vector(value))
-                : std::nullopt;
-    } else if (g_strcmp0(key, NAMESERVERS_CONFIGURATION_STR) == 0U) {
-        name_servers_conf_ =
-            (g_variant_n_children(value) != 0)
-                ? std::optional<std::vector<std::string>>(as_to_vector(value))
-                : std::nullopt;
-    } else if (g_strcmp0(key, DOMAINS_STR) == 0U) {
-        domains_ =
-            (g_variant_n_children(value) != 0)
-                ? std::optional<std::vector<std::string>>(as_to_vector(value))
-                : std::nullopt;
-    } else if (g_strcmp0(key, TIMESERVERS_STR) == 0U) {
-        time_servers_ =
-            (g_variant_n_children(value) != 0)
-                ? std::optional<std::vector<std::string>>(as_to_vector(value))
-                : std::nullopt;
-    } else {
-        LCM_LOG("Unknown or empty property for Service: " << key << '\n');
+void ServProperties::resolveAll() const {
+    if (!source_) {
+        return;
+    }
+    for (std::size_t entry = 0; entry < static_cast<std::size_t>(Field::Count);
+         ++entry) {
+        resolve(static_cast<Field>(entry));
     }
 }
 
+void ServProperties::keep(GVariant* dict) {
+    using Descriptors = PropertyDescriptors<ServProperties>;
+    const auto in_dict = Descriptors::entries_in(dict);
+    if (!in_dict) {
+        VariantDict::forEach(dict, [this](const gchar* key, GVariant* value) {
+            update(key, value);
+        });
+        return;
+    }
+    if (source_) {
+        // Values only the previous dict has must not go away with it.
+        for (std::size_t entry = 0; entry < Descriptors::TABLE.size();
+             ++entry) {
+            if ((*in_dict & Descriptors::bit(entry)) == 0U) {
+                resolve_unlocked(static_cast<Field>(entry));
+            }
+        }
+    }
+    decoded_ &= ~*in_dict;
+    source_ = std::shared_ptr<GVariant>(g_variant_ref(dict), &g_variant_unref);
+    Descriptors::decode_scalars(*this);
+}
+
+void ServPropertiesDict::apply(ServProperties& properties, GVariant* dict,
+                               bool lazy) {
+    if (lazy) {
+        properties.keep(dict);
+        return;
+    }
+    VariantDict::forEach(dict, [&properties](const gchar* key,
+                                             GVariant* value) {
+        properties.update(key, value);
+    });
+}
+
+void Service::applyProperties(ServProperties& properties, GVariant* dict) {
+    ServPropertiesDict::apply(properties, dict, lazy_properties_);
+}
+
 auto operator<<(std::ostream& ost, const ServProperties& obj) -> std::ostream& {
+    obj.resolveAll();
     ost << "State: " << STATE_MAP.toString(obj.state_) << '\n';
     if (obj.error_ != Error::None) {
         ost << "Error: " << ERROR_MAP.toString(obj.error_) << '\n';
@@ -296,11 +559,11 @@ auto operator<<(std::ostream& ost, const ServProperties& obj) -> std::ostream& {
     ost << "Name: " << obj.name_ << '\n';
     ost << "Type: " << TYPE_MAP.toString(obj.type_) << '\n';
     ost << "Strength: " << static_cast<int>(obj.strength_) << '\n';
-    ost << "AutoConnect: " << std::boolalpha << obj.autoconnect_ << '\n';
-    ost << "mDNS: " << obj.mdns_ << '\n';
-    ost << "Favorite: " << obj.favorite_ << '\n';
-    ost << "Immutable: " << obj.immutable_ << '\n';
-    ost << "Roaming: " << obj.roaming_ << '\n';
+    ost << "AutoConnect: " << std::boolalpha << obj.isAutoconnect() << '\n';
+    ost << "mDNS: " << obj.isMDNSEnabled() << '\n';
+    ost << "Favorite: " << obj.isFavorite() << '\n';
+    ost << "Immutable: " << obj.isImmutable() << '\n';
+    ost << "Roaming: " << obj.isRoaming() << '\n';
 
     if (obj.security_) {
         ost << "Security: ";
@@ -377,9 +640,9 @@ auto operator<<(std::ostream& ost, const Ethernet& obj) -> std::ostream& {
 auto operator<<(std::ostream& ost, const IPv4& obj) -> std::ostream& {
     ost << "IPv4:\n";
     ost << "  Method: " << IPV4_METHOD_MAP.toString(obj.method_) << '\n';
-    ost << "  Address: " << obj.address_ << '\n';
-    ost << "  Netmask: " << obj.netmask_ << '\n';
-    ost << "  Gateway: " << obj.gateway_ << '\n';
+    ost << "  Address: " << obj.getAddress() << '\n';
+    ost << "  Netmask: " << obj.getNetmask() << '\n';
+    ost << "  Gateway: " << obj.getGateway() << '\n';
     return ost;
 }
 
@@ -395,8 +658,8 @@ auto operator<<(std::ostream& ost, const Provider& obj) -> std::ostream& {
 auto operator<<(std::ostream& ost, const IPv6& obj) -> std::ostream& {
     ost << "IPv6:\n";
     ost << "  Method: " << IPV6_METHOD_MAP.toString(obj.method_) << '\n';
-    ost << "  Address: " << obj.address_ << '\n';
-    ost << "  Gateway: " << obj.gateway_ << '\n';
+    ost << "  Address: " << obj.getAddress() << '\n';
+    ost << "  Gateway: " << obj.getGateway() << '\n';
     ost << "  Privacy: " << static_cast<int>(obj.privacy_) << '\n';
     ost << "  Prefix Length: " << static_cast<int>(obj.prefix_length_) << '\n';
     return ost;
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <amarula/dbus/connman/gservice.hpp>
+#include <amarula/dbus/connman/gservicetable.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace Amarula::DBus::G::Connman {
+
+/*
+ * The loops below are kept free of branches and of calls on purpose: each one
+ * reads a single dense column and writes one byte per row, which is the shape
+ * GCC and Clang turn into SIMD compares at -O2/-O3.
+ */
+
+auto ServiceTable::row(Id service_id) const -> std::optional<Row> {
+    const auto row_it = rows_.find(service_id);
+    if (row_it == rows_.end()) {
+        return std::nullopt;
+    }
+    return row_it->second;
+}
+
+auto ServiceTable::matchState(State state) const -> Mask {
+    Mask mask(states_.size());
+    const auto* column = states_.data();
+    for (std::size_t i = 0; i < mask.size(); ++i) {
+        mask[i] = static_cast<uint8_t>(column[i] == state);
+    }
+    return mask;
+}
+
+auto ServiceTable::matchType(Type type) const -> Mask {
+    Mask mask(types_.size());
+    const auto* column = types_.data();
+    for (std::size_t i = 0; i < mask.size(); ++i) {
+        mask[i] = static_cast<uint8_t>(column[i] == type);
+    }
+    return mask;
+}
+
+auto ServiceTable::matchStrengthAtLeast(uint8_t strength) const -> Mask {
+    Mask mask(strengths_.size());
+    const auto* column = strengths_.data();
+    for (std::size_t i = 0; i < mask.size(); ++i) {
+        mask[i] = static_cast<uint8_t>(column[i] >= strength);
+    }
+    return mask;
+}
+
+auto ServiceTable::matchFlags(uint8_t flag_mask) const -> Mask {
+    Mask mask(flags_.size());
+    const auto* column = flags_.data();
+    for (std::size_t i = 0; i < mask.size(); ++i) {
+        mask[i] = static_cast<uint8_t>((column[i] & flag_mask) == flag_mask);
+    }
+    return mask;
+}
+
+auto ServiceTable::all(const Mask& lhs, const Mask& rhs) -> Mask {
+    Mask mask(std::min(lhs.size(), rhs.size()));
+    for (std::size_t i = 0; i < mask.size(); ++i) {
+        mask[i] = lhs[i] & rhs[i];
+    }
+    return mask;
+}
+
+auto ServiceTable::any(const Mask& lhs, const Mask& rhs) -> Mask {
+    Mask mask(std::min(lhs.size(), rhs.size()));
+    for (std::size_t i = 0; i < mask.size(); ++i) {
+        mask[i] = lhs[i] | rhs[i];
+    }
+    return mask;
+}
+
+auto ServiceTable::count(const Mask& mask) -> std::size_t {
+    std::size_t total = 0;
+    for (const auto selected : mask) {
+        total += selected;
+    }
+    return total;
+}
+
+auto ServiceTable::select(const Mask& mask) const -> std::vector<Row> {
+    // Always write the candidate row and only advance past it when selected,
+    // so the compaction does not depend on branch prediction.
+    std::vector<Row> rows(mask.size());
+    std::size_t selected = 0;
+    for (std::size_t i = 0; i < mask.size(); ++i) {
+        rows[selected] = i;
+        selected += mask[i];
+    }
+    rows.resize(selected);
+    return rows;
+}
+
+auto ServiceTable::strongest(const Mask& mask) const -> std::optional<Row> {
+    std::optional<Row> best;
+    int best_strength = -1;
+    const auto size = std::min(mask.size(), strengths_.size());
+    for (std::size_t i = 0; i < size; ++i) {
+        const int strength = mask[i] != 0U ? strengths_[i] : -1;
+        if (strength > best_strength) {
+            best_strength = strength;
+            best = i;
+        }
+    }
+    return best;
+}
+
+void ServiceTable::clear() {
+    ids_.clear();
+    states_.clear();
+    types_.clear();
+    strengths_.clear();
+    flags_.clear();
+    rows_.clear();
+}
+
+void ServiceTable::reserve(std::size_t size) {
+    ids_.reserve(size);
+    states_.reserve(size);
+    types_.reserve(size);
+    strengths_.reserve(size);
+    flags_.reserve(size);
+    rows_.reserve(size);
+}
+
+void ServiceTable::append(Id service_id, const ServProperties& properties) {
+    rows_[service_id] = ids_.size();
+    ids_.push_back(service_id);
+    states_.push_back(properties.getState());
+    types_.push_back(properties.getType());
+    strengths_.push_back(properties.getStrength());
+    flags_.push_back(to_flags(properties));
+}
+
+void ServiceTable::update(Id service_id, const ServProperties& properties) {
+    const auto row_it = rows_.find(service_id);
+    if (row_it == rows_.end()) {
+        return;
+    }
+    const auto index = row_it->second;
+    states_[index] = properties.getState();
+    types_[index] = properties.getType();
+    strengths_[index] = properties.getStrength();
+    flags_[index] = to_flags(properties);
+}
+
+auto ServiceTable::to_flags(const ServProperties& properties) -> uint8_t {
+    uint8_t flags = 0U;
+    flags |= properties.isFavorite() ? Favorite : 0U;
+    flags |= properties.isAutoconnect() ? AutoConnect : 0U;
+    flags |= properties.isImmutable() ? Immutable : 0U;
+    flags |= properties.isRoaming() ? Roaming : 0U;
+    flags |= properties.isMDNSEnabled() ? MDNS : 0U;
+    return flags;
+}
+
+}  // namespace Amarula::DBus::G::Connman
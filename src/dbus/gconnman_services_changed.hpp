@@ -0,0 +1,166 @@
+#pragma once
+
+#include <glib.h>
+
+#include <amarula/dbus/gvariant_view.hpp>
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "gdbus_private.hpp"
+
+namespace Amarula::DBus::G::Connman {
+
+/*
+ * Decoded ServicesChanged(a(oa{sv}) changed, ao removed) signal.
+ *
+ * connman lists every service in "changed", in the new order, but sends an
+ * empty a{sv} for those whose properties did not change. Such order-only
+ * entries keep properties null, so nothing is decoded for them later.
+ *
+ * The object paths are borrowed from the signal parameters and are only valid
+ * while those are alive, that is for the duration of the signal handler. They
+ * are nul terminated, as GVariant stores its strings. The
+ * lists come from the memory resource given to the decoder, normally the
+ * SignalArena of the Manager, and live no longer than the handler either.
+ */
+struct ServicesChangedSignal {
+    struct Changed {
+        std::string_view path;
+        VariantPtr properties{nullptr, &g_variant_unref};
+    };
+
+    explicit ServicesChangedSignal(std::pmr::memory_resource* resource)
+        : changed{resource}, removed{resource} {}
+
+    std::pmr::vector<Changed> changed;
+    std::pmr::vector<std::string_view> removed;
+
+    [[nodiscard]] auto orderOnly() const -> bool {
+        for (const auto& entry : changed) {
+            if (entry.properties) {
+                return false;
+            }
+        }
+        return removed.empty();
+    }
+};
+
+inline auto decode_services_changed(
+    GVariant* parameters,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    -> ServicesChangedSignal {
+    ServicesChangedSignal signal{resource};
+
+    GVariant* changed = g_variant_get_child_value(parameters, 0);
+    GVariant* removed = g_variant_get_child_value(parameters, 1);
+
+    /*
+     * Children rather than g_variant_get() format strings, which allocate a
+     * type per call: on the tree GDBus hands over, an order-only entry then
+     * costs no allocation at all.
+     */
+    const auto changed_count = g_variant_n_children(changed);
+    signal.changed.reserve(changed_count);
+    for (gsize i = 0; i < changed_count; ++i) {
+        GVariant* item = g_variant_get_child_value(changed, i);
+        GVariant* path = g_variant_get_child_value(item, 0);
+        GVariant* properties = g_variant_get_child_value(item, 1);
+        auto& entry = signal.changed.emplace_back();
+        entry.path = g_variant_get_string(path, nullptr);
+        if (g_variant_n_children(properties) != 0U) {
+            entry.properties.reset(properties);
+        } else {
+            g_variant_unref(properties);
+        }
+        g_variant_unref(path);
+        g_variant_unref(item);
+    }
+
+    const auto removed_count = g_variant_n_children(removed);
+    signal.removed.reserve(removed_count);
+    for (gsize i = 0; i < removed_count; ++i) {
+        GVariant* path = g_variant_get_child_value(removed, i);
+        signal.removed.emplace_back(g_variant_get_string(path, nullptr));
+        g_variant_unref(path);
+    }
+
+    // parameters still owns the data the borrowed paths point into.
+    g_variant_unref(changed);
+    g_variant_unref(removed);
+    return signal;
+}
+
+/*
+ * decode_services_changed() walking the serialised parameters in place, as
+ * DBus::setFlatSignals() leaves them: the paths and the removed list cost no
+ * GVariant at all, and only the entries that carry properties get one for
+ * their a{sv}. Nothing when parameters are not a ServicesChanged, in which
+ * case decode_services_changed() is the one to use.
+ */
+inline auto decode_services_changed_in_place(
+    GVariant* parameters,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    -> std::optional<ServicesChangedSignal> {
+    if (g_variant_is_of_type(parameters, G_VARIANT_TYPE("(a(oa{sv})ao)")) ==
+        0) {
+        return std::nullopt;
+    }
+    // The elements of ao are 1 aligned, those of a(oa{sv}) 8 aligned.
+    const auto lists = VariantView::of(parameters).pair(1U);
+    if (!lists) {
+        return std::nullopt;
+    }
+    const auto changed_count = lists->first.elementCount();
+    const auto removed_count = lists->second.elementCount();
+    if (!changed_count || !removed_count) {
+        return std::nullopt;
+    }
+
+    ServicesChangedSignal signal{resource};
+    signal.changed.reserve(*changed_count);
+    VariantPtr changed{nullptr, &g_variant_unref};
+    const auto valid_changed = lists->first.forEachElement(
+        VariantView::VARIANT_ALIGNMENT, [&](VariantView service) {
+            const auto members = service.pair(VariantView::VARIANT_ALIGNMENT);
+            const auto path = members ? members->first.asString()
+                                      : std::nullopt;
+            if (!path) {
+                return false;
+            }
+            auto& entry = signal.changed.emplace_back();
+            entry.path = *path;
+            // An empty a{sv} has no data at all.
+            if (members->second.size() != 0U) {
+                if (!changed) {
+                    changed.reset(g_variant_get_child_value(parameters, 0));
+                }
+                GVariant* item = g_variant_get_child_value(
+                    changed.get(), signal.changed.size() - 1U);
+                entry.properties.reset(g_variant_get_child_value(item, 1));
+                g_variant_unref(item);
+            }
+            return true;
+        });
+    if (!valid_changed) {
+        return std::nullopt;
+    }
+
+    signal.removed.reserve(*removed_count);
+    const auto valid_removed =
+        lists->second.forEachElement(1U, [&signal](VariantView service) {
+            const auto path = service.asString();
+            if (path) {
+                signal.removed.emplace_back(*path);
+            }
+            return path.has_value();
+        });
+    if (!valid_removed) {
+        return std::nullopt;
+    }
+    return signal;
+}
+
+}  // namespace Amarula::DBus::G::Connman
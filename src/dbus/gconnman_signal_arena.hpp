@@ -0,0 +1,102 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+namespace Amarula::DBus::G::Connman {
+
+/*
+ * Memory for the temporary state of one D-Bus signal: allocations are bumps
+ * in a buffer, given back all at once after the signal has been dispatched.
+ *
+ * The buffer is kept from one signal to the next and grows to fit the largest
+ * signal seen, so a steady stream of signals stops allocating. Only the
+ * D-Bus thread uses it.
+ */
+class SignalArena {
+   public:
+    // Holds a few hundred ServicesChanged entries before growing.
+    static constexpr std::size_t INITIAL_SIZE = 16U * 1024U;
+
+    explicit SignalArena(std::size_t initial_size = INITIAL_SIZE)
+        : buffer_(initial_size) {
+        resource_.emplace(buffer_.data(), buffer_.size(), &overflow_);
+    }
+    SignalArena(const SignalArena&) = delete;
+    auto operator=(const SignalArena&) -> SignalArena& = delete;
+    SignalArena(SignalArena&&) = delete;
+    auto operator=(SignalArena&&) -> SignalArena& = delete;
+    ~SignalArena() = default;
+
+    [[nodiscard]] auto resource() -> std::pmr::memory_resource* {
+        return &*resource_;
+    }
+
+    /*
+     * Dispatch of one signal. The arena is released when the outermost scope
+     * ends, so a handler that runs a nested signal does not pull the memory
+     * from under the one it interrupted.
+     */
+    class Scope {
+       public:
+        explicit Scope(SignalArena& arena) : arena_{arena} { ++arena_.depth_; }
+        Scope(const Scope&) = delete;
+        auto operator=(const Scope&) -> Scope& = delete;
+        Scope(Scope&&) = delete;
+        auto operator=(Scope&&) -> Scope& = delete;
+        ~Scope() {
+            if (--arena_.depth_ == 0U) {
+                arena_.release();
+            }
+        }
+
+       private:
+        SignalArena& arena_;
+    };
+
+    // Bytes that did not fit in the buffer since the last release.
+    [[nodiscard]] auto overflow() const { return overflow_.bytes; }
+
+   private:
+    // Upstream of the buffer, counting what it has to hand out.
+    class Overflow : public std::pmr::memory_resource {
+       public:
+        std::size_t bytes{0U};
+
+       private:
+        auto do_allocate(std::size_t size, std::size_t alignment)
+            -> void* override {
+            bytes += size;
+            return std::pmr::new_delete_resource()->allocate(size, alignment);
+        }
+        void do_deallocate(void* ptr, std::size_t size,
+                           std::size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(ptr, size, alignment);
+        }
+        [[nodiscard]] auto do_is_equal(
+            const std::pmr::memory_resource& other) const noexcept
+            -> bool override {
+            return this == &other;
+        }
+    };
+
+    std::vector<std::byte> buffer_;
+    Overflow overflow_;
+    std::optional<std::pmr::monotonic_buffer_resource> resource_;
+    unsigned depth_{0U};
+
+    void release() {
+        resource_->release();
+        if (overflow_.bytes == 0U) {
+            return;
+        }
+        buffer_.resize(std::bit_ceil(buffer_.size() + overflow_.bytes));
+        overflow_.bytes = 0U;
+        resource_.emplace(buffer_.data(), buffer_.size(), &overflow_);
+    }
+};
+
+}  // namespace Amarula::DBus::G::Connman
@@ -5,10 +5,14 @@
 #include <amarula/dbus/gdbus.hpp>
 #include <amarula/dbus/gproxy.hpp>
 #include <amarula/log.hpp>
+#include <cstdint>
+#include <string>
 #include <utility>
 
 #include "gconnman_private.hpp"
 #include "gdbus_private.hpp"
+#include "gproperty_table.hpp"
+#include "gvariant_codec.hpp"
 
 namespace Amarula::DBus::G::Connman {
 
@@ -29,38 +33,34 @@ Technology::Technology(DBus* dbus, const gchar* obj_path)
 
 void Technology::setPowered(bool powered, PropertiesSetCallback callback) {
     auto data = prepareCallback(std::move(callback));
-    setProperty(POWERED_STR,
-                g_variant_new_boolean(static_cast<gboolean>(powered)), nullptr,
+    setProperty(POWERED_STR, to_variant(powered), nullptr,
                 &Technology::finishAsyncCall, data.release());
 }
 
 void Technology::setTethering(bool tethering, PropertiesSetCallback callback) {
     auto data = prepareCallback(std::move(callback));
-    setProperty(TETHERING_STR,
-                g_variant_new_boolean(static_cast<gboolean>(tethering)),
-                nullptr, &Technology::finishAsyncCall, data.release());
+    setProperty(TETHERING_STR, to_variant(tethering), nullptr,
+                &Technology::finishAsyncCall, data.release());
 }
 
 void Technology::setTetheringIdentifier(const std::string& identifier,
                                         PropertiesSetCallback callback) {
     auto data = prepareCallback(std::move(callback));
-    setProperty(TETHERINGIDENTIFIER_STR,
-                g_variant_new_string(identifier.c_str()), nullptr,
+    setProperty(TETHERINGIDENTIFIER_STR, to_variant(identifier), nullptr,
                 &Technology::finishAsyncCall, data.release());
 }
 
 void Technology::setTetheringPassphrase(const std::string& passphrase,
                                         PropertiesSetCallback callback) {
     auto data = prepareCallback(std::move(callback));
-    setProperty(TETHERINGPASSPHRASE_STR,
-                g_variant_new_string(passphrase.c_str()), nullptr,
+    setProperty(TETHERINGPASSPHRASE_STR, to_variant(passphrase), nullptr,
                 &Technology::finishAsyncCall, data.release());
 }
 
 void Technology::setTetheringFreq(const int frequency,
                                   PropertiesSetCallback callback) {
     auto data = prepareCallback(std::move(callback));
-    setProperty(TETHERINGFREQ_STR, g_variant_new_int32(frequency), nullptr,
+    setProperty(TETHERINGFREQ_STR, to_variant(frequency), nullptr,
                 &Technology::finishAsyncCall, data.release());
 }
 
@@ -70,26 +70,27 @@ void Technology::scan(PropertiesSetCallback callback) {
                data.release());
 }
 
+template <>
+struct PropertyDescriptors<TechProperties> {
+    using Props = TechProperties;
+    static constexpr PropertyTable TABLE{
+        "Technology",
+        std::array{
+            property<&Props::name_, Codec<std::string>>(NAME_STR),
+            property<&Props::type_, EnumCodec<TYPE_MAP>>(TYPE_STR),
+            property<&Props::powered_, Codec<bool>>(POWERED_STR),
+            property<&Props::connected_, Codec<bool>>(CONNECTED_STR),
+            property<&Props::tethering_, Codec<bool>>(TETHERING_STR),
+            property<&Props::tethering_freq_, Codec<int32_t>>(
+                TETHERINGFREQ_STR),
+            property<&Props::tethering_identifier_, Codec<std::string>>(
+                TETHERINGIDENTIFIER_STR),
+            property<&Props::tethering_passphrase_, Codec<std::string>>(
+                TETHERINGPASSPHRASE_STR)}};
+};
+
 void TechProperties::update(const gchar* key, GVariant* value) {
-    if (g_strcmp0(key, NAME_STR) == 0) {
-        name_ = g_variant_get_string(value, nullptr);
-    } else if (g_strcmp0(key, TYPE_STR) == 0U) {
-        type_ = TYPE_MAP.fromString(g_variant_get_string(value, nullptr));
-    } else if (g_strcmp0(key, POWERED_STR) == 0U) {
-        powered_ = g_variant_get_boolean(value) == 1U;
-    } else if (g_strcmp0(key, CONNECTED_STR) == 0U) {
-        connected_ = g_variant_get_boolean(value) == 1U;
-    } else if (g_strcmp0(key, TETHERING_STR) == 0U) {
-        tethering_ = g_variant_get_boolean(value) == 1U;
-    } else if (g_strcmp0(key, TETHERINGFREQ_STR) == 0U) {
-        tethering_freq_ = g_variant_get_int32(value);
-    } else if (g_strcmp0(key, TETHERINGIDENTIFIER_STR) == 0U) {
-        tethering_identifier_ = g_variant_get_string(value, nullptr);
-    } else if (g_strcmp0(key, TETHERINGPASSPHRASE_STR) == 0U) {
-        tethering_passphrase_ = g_variant_get_string(value, nullptr);
-    } else {
-        LCM_LOG("Unknown property for Technology: " << key << '\n');
-    }
+    PropertyDescriptors<TechProperties>::TABLE.update(*this, key, value);
 }
 
 auto operator<<(std::ostream& ost, const TechProperties& obj) -> std::ostream& {
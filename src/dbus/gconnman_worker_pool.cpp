@@ -0,0 +1,75 @@
+#include "gconnman_worker_pool.hpp"
+
+#include <algorithm>
+#include <amarula/dbus/connman/gagent.hpp>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace Amarula::DBus::G::Connman {
+
+WorkerPool::WorkerPool(std::size_t workers, std::size_t capacity,
+                       OverflowPolicy overflow)
+    : capacity_{std::max<std::size_t>(capacity, 1U)}, overflow_{overflow} {
+    workers = std::max<std::size_t>(workers, 1U);
+    workers_.reserve(workers);
+    for (std::size_t i = 0; i < workers; ++i) {
+        workers_.emplace_back(&WorkerPool::work, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    std::deque<Job> pending;
+    {
+        std::lock_guard<std::mutex> const lock(mtx_);
+        stopping_ = true;
+        pending.swap(queue_);
+    }
+    cv_.notify_all();
+    for (auto& job : pending) {
+        job.cancel();
+    }
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void WorkerPool::submit(Job job) {
+    Job rejected;
+    {
+        std::lock_guard<std::mutex> const lock(mtx_);
+        if (queue_.size() < capacity_) {
+            queue_.push_back(std::move(job));
+        } else if (overflow_ == OverflowPolicy::CancelOldest) {
+            rejected = std::move(queue_.front());
+            queue_.pop_front();
+            queue_.push_back(std::move(job));
+        } else {
+            rejected = std::move(job);
+        }
+    }
+    if (rejected.cancel) {
+        rejected.cancel();
+    } else {
+        cv_.notify_one();
+    }
+}
+
+void WorkerPool::work() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            job = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        job.run();
+    }
+}
+
+}  // namespace Amarula::DBus::G::Connman
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <amarula/dbus/connman/gagent.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Amarula::DBus::G::Connman {
+
+/*
+ * Fixed set of threads running the agent requests that have to wait for the
+ * application, so that a burst of RequestInput calls neither creates threads
+ * nor runs an unbounded number of them at once.
+ *
+ * Every job comes with a cancel function, called instead of run when the job
+ * does not make it to a worker: rejected by the overflow policy, or still
+ * queued when the pool is destroyed. Jobs already running are waited for.
+ */
+class WorkerPool {
+   public:
+    struct Job {
+        std::function<void()> run;
+        std::function<void()> cancel;
+    };
+
+    WorkerPool(std::size_t workers, std::size_t capacity,
+               OverflowPolicy overflow);
+    WorkerPool(const WorkerPool&) = delete;
+    auto operator=(const WorkerPool&) -> WorkerPool& = delete;
+    WorkerPool(WorkerPool&&) = delete;
+    auto operator=(WorkerPool&&) -> WorkerPool& = delete;
+    ~WorkerPool();
+
+    void submit(Job job);
+
+   private:
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<Job> queue_;
+    std::size_t capacity_;
+    OverflowPolicy overflow_;
+    bool stopping_{false};
+    std::vector<std::thread> workers_;
+
+    void work();
+};
+
+}  // namespace Amarula::DBus::G::Connman
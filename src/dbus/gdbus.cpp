@@ -4,9 +4,13 @@
 #include <glibconfig.h>
 
 #include <amarula/dbus/gdbus.hpp>
+#include <amarula/dbus/gtransport.hpp>
 #include <mutex>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace Amarula::DBus::G {
 
@@ -20,46 +24,52 @@ void DBus::onAnyAsyncDone() {
 void DBus::onAnyAsyncStart() { ++pending_calls_; }
 
 DBus::DBus(const std::string& bus_name, const std::string& object_path)
+    : DBus(bus_name, object_path, Transport::defaultKind()) {}
+
+DBus::DBus(const std::string& bus_name, const std::string& object_path,
+           TransportKind kind)
     : ctx_{g_main_context_new()} {
     GError* error = nullptr;
     g_main_context_push_thread_default(ctx_);
-    connection_ = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, &error);
-    if (connection_ == nullptr) {
-        std::string const msg = error->message;
-        g_clear_error(&error);
-        throw std::runtime_error("Failed to connect to DBus: " + msg);
-    }
-
-    GDBusProxy* proxy = g_dbus_proxy_new_sync(
-        connection_, G_DBUS_PROXY_FLAGS_NONE, nullptr, bus_name.c_str(),
-        object_path.c_str(), "org.freedesktop.DBus.Introspectable", nullptr,
-        &error);
-
-    if (proxy == nullptr) {
-        std::string const msg = error->message;
-        g_clear_error(&error);
-        throw std::runtime_error("Failed to create proxy for bus name: " + msg);
+    try {
+        transport_ = Transport::create(kind, ctx_);
+    } catch (...) {
+        g_main_context_pop_thread_default(ctx_);
+        g_main_context_unref(ctx_);
+        throw;
     }
 
-    GVariant* result =
-        g_dbus_proxy_call_sync(proxy, "Introspect", nullptr,
-                               G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &error);
-
-    g_object_unref(proxy);
+    GVariant* result = transport_->callSync(
+        bus_name.c_str(), object_path.c_str(),
+        "org.freedesktop.DBus.Introspectable", "Introspect", nullptr, &error);
 
     if (result == nullptr) {
         std::string const msg = error->message;
         g_clear_error(&error);
+        transport_.reset();
+        while (g_main_context_iteration(ctx_, FALSE) != 0) {
+        }
+        g_main_context_pop_thread_default(ctx_);
+        g_main_context_unref(ctx_);
         throw std::runtime_error(
             "Failed to introspect object path or interface: " +
             std::string(msg));
     }
 
     g_variant_unref(result);
+
     g_main_context_pop_thread_default(ctx_);
     start();
 }
 
+void DBus::setFlatSignals(std::vector<std::string> members) {
+    transport_->setFlatSignals(std::move(members));
+}
+
+auto DBus::flatSignal(std::string_view member) const -> bool {
+    return transport_->flatSignal(member);
+}
+
 void DBus::stop() {
     {
         std::lock_guard<std::mutex> const lock(mtx_);
@@ -77,10 +87,11 @@ void DBus::stop() {
 DBus::~DBus() {
     stop();
     g_main_context_push_thread_default(ctx_);
+    // Work handed to the D-Bus thread meanwhile still finds the transport.
     while (g_main_context_iteration(ctx_, FALSE) != 0) {
     }
-    if (connection_ != nullptr) {
-        g_object_unref(connection_);
+    transport_.reset();
+    while (g_main_context_iteration(ctx_, FALSE) != 0) {
     }
     g_main_context_pop_thread_default(ctx_);
     g_main_context_unref(ctx_);
@@ -1,24 +1,122 @@
-
+#pragma once
 
 #include <glib.h>
 
+#include <array>
+#include <bit>
+#include <cstdint>
 #include <memory>
-#include <stdexcept>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <utility>
-#include <vector>
 
 namespace Amarula::DBus::G {
 
+/*
+ * Perfect hash from N strings known at compile time to their position: one
+ * hash of the string and at most one comparison per lookup, and no throw for
+ * strings that are not in the table.
+ */
+template <std::size_t N>
+class StringIndex {
+   public:
+    consteval explicit StringIndex(const std::array<std::string_view, N>& keys)
+        : keys_{keys} {
+        build_slots();
+    }
+
+    [[nodiscard]] constexpr auto find(std::string_view str) const
+        -> std::optional<std::size_t> {
+        const auto entry = slots_[hash(str, seed_)];
+        if (entry != EMPTY_SLOT && keys_[entry] == str) {
+            return entry;
+        }
+        return std::nullopt;
+    }
+
+   private:
+    static_assert(N > 0U && N < UINT8_MAX);
+
+    // At most half full, so that a seed without collisions is found quickly.
+    static constexpr std::size_t SLOT_COUNT = std::bit_ceil(2U * N);
+    static constexpr unsigned SLOT_BITS = std::countr_zero(SLOT_COUNT);
+    static constexpr std::uint8_t EMPTY_SLOT = UINT8_MAX;
+    static constexpr std::uint32_t MAX_SEED = 1U << 16U;
+
+    std::array<std::string_view, N> keys_;
+    std::array<std::uint8_t, SLOT_COUNT> slots_{};
+    std::uint32_t seed_{0U};
+
+    /*
+     * Connman strings are short and mostly tell apart by length and by their
+     * first, middle and last characters, so only those are hashed: a
+     * multiply-shift of them is much cheaper than reading the whole string,
+     * and the comparison in find() rejects the rest.
+     */
+    static constexpr auto hash(std::string_view str, std::uint32_t seed)
+        -> std::size_t {
+        constexpr std::uint64_t GOLDEN = 0x9e3779b97f4a7c15U;
+        constexpr unsigned BYTE_BITS = 8U;
+        constexpr unsigned HASH_BITS = 64U;
+
+        const auto size = str.size();
+        const auto byte_at = [str, size](std::size_t pos) -> std::uint64_t {
+            return pos < size ? static_cast<unsigned char>(str[pos]) : 0U;
+        };
+        std::uint64_t key = size;
+        if (size != 0U) {
+            key = (key << BYTE_BITS) | byte_at(0U);
+            key = (key << BYTE_BITS) | byte_at(1U);
+            key = (key << BYTE_BITS) | byte_at(size / 2U);
+            key = (key << BYTE_BITS) | byte_at(size - 2U);
+            key = (key << BYTE_BITS) | byte_at(size - 1U);
+        }
+        return static_cast<std::size_t>(((key ^ seed) * GOLDEN) >>
+                                         (HASH_BITS - SLOT_BITS));
+    }
+
+    /*
+     * Fails to compile when no seed separates the strings: duplicates, or
+     * strings with the same length and the same sampled characters.
+     */
+    consteval void build_slots() {
+        for (; seed_ < MAX_SEED; ++seed_) {
+            slots_.fill(EMPTY_SLOT);
+            bool collision = false;
+            for (std::size_t i = 0; i < N && !collision; ++i) {
+                auto& slot = slots_[hash(keys_[i], seed_)];
+                collision = slot != EMPTY_SLOT;
+                slot = static_cast<std::uint8_t>(i);
+            }
+            if (!collision) {
+                return;
+            }
+        }
+        throw "StringIndex: no perfect hash seed for these strings";
+    }
+};
+
+/*
+ * Two way mapping between an enum and the strings connman uses for it.
+ *
+ * fromString() runs on the D-Bus thread for every state or type property, so
+ * it goes through a StringIndex. Strings that are not in the table, such as a
+ * state added by a newer connman, are reported as nullopt and never throw;
+ * callers map them to the Unknown value of their enum.
+ */
 template <typename Enum, std::size_t N>
 class EnumStringMap {
    public:
     using Pair = std::pair<Enum, std::string_view>;
+    using EnumType = Enum;
+
+    static constexpr std::string_view UNKNOWN_STR = "unknown";
 
-    constexpr explicit EnumStringMap(const std::array<Pair, N>& init)
-        : data_{init} {}
+    consteval explicit EnumStringMap(const std::array<Pair, N>& init)
+        : data_{init}, index_{keys_of(init)} {}
 
+    // UNKNOWN_STR for values that are not in the table.
     [[nodiscard]] constexpr auto toString(Enum enum_value) const
         -> std::string_view {
         for (auto&& [e, s] : data_) {
@@ -26,58 +124,31 @@ class EnumStringMap {
                 return s;
             }
         }
-        throw std::runtime_error("Invalid enum value");
+        return UNKNOWN_STR;
     }
 
     [[nodiscard]] constexpr auto fromString(std::string_view str) const
-        -> Enum {
-        for (auto&& [e, s] : data_) {
-            if (s == str) {
-                return e;
-            }
+        -> std::optional<Enum> {
+        if (const auto entry = index_.find(str)) {
+            return data_[*entry].first;
         }
-        throw std::runtime_error("Invalid string value");
+        return std::nullopt;
     }
 
    private:
     std::array<Pair, N> data_;
-};
+    StringIndex<N> index_;
 
-template <typename T = std::string, std::size_t N = 0>
-auto as_to_vector(GVariant* array_s, const EnumStringMap<T, N>* enum_map =
-                                         nullptr) -> std::vector<T> {
-    GVariantIter str_iter;
-    std::vector<T> container;
-    if (g_variant_is_of_type(array_s, G_VARIANT_TYPE("as")) != 0U) {
-        g_variant_iter_init(&str_iter, array_s);
-        GVariant* item = nullptr;
-        while ((item = g_variant_iter_next_value(&str_iter)) != nullptr) {
-            const gchar* item_str = g_variant_get_string(item, nullptr);
-            if constexpr (std::is_enum_v<T>) {
-                container.emplace_back(enum_map->fromString(item_str));
-            } else {
-                container.emplace_back(item_str);
-            }
-            g_variant_unref(item);
+    static consteval auto keys_of(const std::array<Pair, N>& init)
+        -> std::array<std::string_view, N> {
+        std::array<std::string_view, N> keys;
+        for (std::size_t i = 0; i < N; ++i) {
+            keys[i] = init[i].second;
         }
+        return keys;
     }
-    return container;
-}
+};
 
 using VariantPtr = std::unique_ptr<GVariant, decltype(&g_variant_unref)>;
 
-static inline auto vector_to_as(const std::vector<std::string>& vec)
-    -> VariantPtr {
-    GVariantBuilder builder;
-    g_variant_builder_init(&builder, G_VARIANT_TYPE("as"));
-
-    for (const auto& string : vec) {
-        g_variant_builder_add_value(&builder,
-                                    g_variant_new_string(string.c_str()));
-    }
-
-    GVariant* var = g_variant_builder_end(&builder);
-    return VariantPtr{g_variant_ref_sink(var), &g_variant_unref};
-}
-
 }  // namespace Amarula::DBus::G
@@ -0,0 +1,64 @@
+#include <amarula/dbus/ginterned.hpp>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+namespace Amarula::DBus::G {
+
+namespace {
+
+// Looks strings up by string_view, without building a std::string first.
+struct PoolHash {
+    using is_transparent = void;
+    auto operator()(std::string_view str) const noexcept -> std::size_t {
+        return std::hash<std::string_view>{}(str);
+    }
+};
+
+/*
+ * Nearly every lookup finds a string already there, so readers share the
+ * lock and only a new string takes it exclusively. Elements of an
+ * unordered_set do not move on rehash, so their addresses stay valid.
+ */
+class Pool {
+   public:
+    auto intern(std::string_view str) -> const std::string* {
+        {
+            const std::shared_lock lock(mtx_);
+            const auto found = strings_.find(str);
+            if (found != strings_.end()) {
+                return &*found;
+            }
+        }
+        const std::unique_lock lock(mtx_);
+        return &*strings_.emplace(str).first;
+    }
+
+    auto size() -> std::size_t {
+        const std::shared_lock lock(mtx_);
+        return strings_.size();
+    }
+
+   private:
+    std::shared_mutex mtx_;
+    std::unordered_set<std::string, PoolHash, std::equal_to<>> strings_;
+};
+
+// Never destroyed, so interned strings outlive every static that holds one.
+auto pool() -> Pool& {
+    static auto* const instance = new Pool;
+    return *instance;
+}
+
+}  // namespace
+
+InternedString::InternedString(std::string_view str)
+    : str_{str.empty() ? nullptr : pool().intern(str)} {}
+
+auto InternedString::poolSize() -> std::size_t { return pool().size(); }
+
+}  // namespace Amarula::DBus::G
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <glib.h>
+
+#include <amarula/log.hpp>
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+
+#include "gdbus_private.hpp"
+#include "gvariant_codec.hpp"
+
+namespace Amarula::DBus::G {
+
+/*
+ * Declarative D-Bus property parsing: every Properties type lists its
+ * properties once, as key, member and codec, e.g.
+ *
+ *     property<&ServProperties::name_, Codec<std::string>>(NAME_STR)
+ *
+ * and the PropertyTable built from the list dispatches a key to its decoder
+ * through a perfect hash, with no string comparison chain and no virtual
+ * call. Adding a property is adding its line to the table.
+ *
+ * A codec that does not produce the type of the member fails to compile; a
+ * value whose D-Bus type is not the signature of the codec is reported and
+ * left out.
+ */
+template <class Owner>
+struct Property {
+    std::string_view key;
+    // false when value is not of the type of the property.
+    bool (*decode)(Owner& owner, GVariant* value);
+};
+
+template <class MemberPointer>
+struct MemberOwner;
+
+template <class Owner, class Type>
+struct MemberOwner<Type Owner::*> {
+    using type = Owner;
+    using member = Type;
+};
+
+template <auto Member, class ValueCodec>
+constexpr auto property(std::string_view key) {
+    using Owner = typename MemberOwner<decltype(Member)>::type;
+    using Value = typename MemberOwner<decltype(Member)>::member;
+    static_assert(std::is_assignable_v<Value&, typename ValueCodec::Type>,
+                  "the codec does not decode to the type of the member");
+    return Property<Owner>{key, [](Owner& owner, GVariant* value) {
+                               if (!ValueCodec::SIGNATURE.matches(value)) {
+                                   return false;
+                               }
+                               owner.*Member = ValueCodec::decode(value);
+                               return true;
+                           }};
+}
+
+// Boolean property kept as Bit of the integer Member, next to other flags.
+template <auto Member, auto Bit>
+constexpr auto flag_property(std::string_view key) {
+    using Owner = typename MemberOwner<decltype(Member)>::type;
+    return Property<Owner>{key, [](Owner& owner, GVariant* value) {
+                               if (!Codec<bool>::SIGNATURE.matches(value)) {
+                                   return false;
+                               }
+                               using Flags =
+                                   std::remove_cvref_t<decltype(owner.*Member)>;
+                               auto& flags = owner.*Member;
+                               flags = Codec<bool>::decode(value)
+                                           ? static_cast<Flags>(flags | Bit)
+                                           : static_cast<Flags>(flags & ~Bit);
+                               return true;
+                           }};
+}
+
+template <class Owner, std::size_t N>
+class PropertyTable {
+   public:
+    // name is only used to report unknown keys.
+    consteval PropertyTable(std::string_view name,
+                            const std::array<Property<Owner>, N>& properties)
+        : name_{name}, properties_{properties}, index_{keys_of(properties)} {}
+
+    [[nodiscard]] static constexpr auto size() { return N; }
+
+    // Position of key in the table, for tables that track their properties.
+    [[nodiscard]] constexpr auto find(std::string_view key) const
+        -> std::optional<std::size_t> {
+        return index_.find(key);
+    }
+
+    [[nodiscard]] constexpr auto key(std::size_t entry) const {
+        return properties_[entry].key;
+    }
+
+    void decode(Owner& owner, std::size_t entry, GVariant* value) const {
+        if (!properties_[entry].decode(owner, value)) {
+            LCM_LOG("Unexpected type for " << name_ << '.' << key(entry)
+                                           << ": "
+                                           << g_variant_get_type_string(value)
+                                           << '\n');
+        }
+    }
+
+    void update(Owner& owner, std::string_view key, GVariant* value) const {
+        if (const auto entry = index_.find(key)) {
+            decode(owner, *entry, value);
+        } else {
+            LCM_LOG("Unknown property for " << name_ << ": " << key << '\n');
+        }
+    }
+
+    // Updates owner with every entry of the a{sv} dict.
+    void parse(Owner& owner, GVariant* dict) const {
+        VariantDict::forEach(dict, [&](const gchar* key, GVariant* value) {
+            update(owner, key, value);
+        });
+    }
+
+   private:
+    std::string_view name_;
+    std::array<Property<Owner>, N> properties_;
+    StringIndex<N> index_;
+
+    static consteval auto keys_of(
+        const std::array<Property<Owner>, N>& properties)
+        -> std::array<std::string_view, N> {
+        std::array<std::string_view, N> keys;
+        for (std::size_t i = 0; i < N; ++i) {
+            keys[i] = properties[i].key;
+        }
+        return keys;
+    }
+};
+
+}  // namespace Amarula::DBus::G
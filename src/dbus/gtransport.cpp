@@ -0,0 +1,42 @@
+#include <glib.h>
+
+#include <amarula/dbus/gtransport.hpp>
+#include <memory>
+#include <stdexcept>
+
+#include "gtransport_private.hpp"
+
+namespace Amarula::DBus::G {
+
+auto Transport::create(TransportKind kind, GMainContext* context)
+    -> std::unique_ptr<Transport> {
+    switch (kind) {
+        case TransportKind::GDBus:
+            return make_gdbus_transport(context);
+        case TransportKind::SdBus:
+#ifdef AMARULA_DBUS_SD_BUS
+            return make_sd_bus_transport(context);
+#else
+            break;
+#endif
+    }
+    throw std::runtime_error("D-Bus transport not built in");
+}
+
+auto Transport::available(TransportKind kind) -> bool {
+#ifdef AMARULA_DBUS_SD_BUS
+    return kind == TransportKind::GDBus || kind == TransportKind::SdBus;
+#else
+    return kind == TransportKind::GDBus;
+#endif
+}
+
+auto Transport::defaultKind() -> TransportKind {
+#ifdef AMARULA_DBUS_SD_BUS
+    return TransportKind::SdBus;
+#else
+    return TransportKind::GDBus;
+#endif
+}
+
+}  // namespace Amarula::DBus::G
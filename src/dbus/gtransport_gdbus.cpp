@@ -0,0 +1,223 @@
+#include <gio/gio.h>
+#include <glib-object.h>
+#include <glib.h>
+
+#include <amarula/dbus/gtransport.hpp>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "gtransport_private.hpp"
+
+namespace Amarula::DBus::G {
+namespace {
+
+/*
+ * GIO's GDBusConnection. Messages are parsed on the GDBus worker thread and
+ * handed to the D-Bus thread as GVariant trees.
+ */
+class GDBusTransport final : public Transport {
+    GDBusConnection* connection_{nullptr};
+    // Owned by the connection filter, which may outlive this object a bit.
+    FlatSignals* flat_signals_{nullptr};
+    guint flat_signals_filter_{0U};
+
+    struct PendingCall {
+        ReplyCallback callback;
+        gpointer user_data;
+    };
+
+    struct Handler {
+        SignalCallback callback;
+        gpointer user_data;
+    };
+
+    struct Object {
+        MethodCallback callback;
+        gpointer user_data;
+    };
+
+    static void on_reply(GObject* source, GAsyncResult* res,
+                         gpointer user_data) {
+        const std::unique_ptr<PendingCall> call(
+            static_cast<PendingCall*>(user_data));
+        GError* error = nullptr;
+        GVariant* reply = g_dbus_connection_call_finish(
+            G_DBUS_CONNECTION(source), res, &error);
+        call->callback(reply, error, call->user_data);
+        if (reply != nullptr) {
+            g_variant_unref(reply);
+        } else {
+            g_error_free(error);
+        }
+    }
+
+    static void on_signal(GDBusConnection* /*connection*/,
+                          const gchar* /*sender_name*/,
+                          const gchar* /*object_path*/,
+                          const gchar* /*interface_name*/,
+                          const gchar* signal_name, GVariant* parameters,
+                          gpointer user_data) {
+        const auto* handler = static_cast<const Handler*>(user_data);
+        handler->callback(signal_name, parameters, handler->user_data);
+    }
+
+    static void on_method_call(GDBusConnection* /*connection*/,
+                               const gchar* /*sender*/,
+                               const gchar* /*object_path*/,
+                               const gchar* /*interface_name*/,
+                               const gchar* method_name, GVariant* parameters,
+                               GDBusMethodInvocation* invocation,
+                               gpointer user_data) {
+        const auto* object = static_cast<const Object*>(user_data);
+        object->callback(method_name, parameters,
+                         reinterpret_cast<Invocation*>(invocation),
+                         object->user_data);
+    }
+
+    constexpr static const GDBusInterfaceVTable INTERFACE_VTABLE{
+        &GDBusTransport::on_method_call, nullptr, nullptr, {nullptr}};
+
+    static auto flatten_signal_bodies(GDBusConnection* /*connection*/,
+                                      GDBusMessage* message, gboolean incoming,
+                                      gpointer user_data) -> GDBusMessage* {
+        if (incoming == 0 || g_dbus_message_get_message_type(message) !=
+                                 G_DBUS_MESSAGE_TYPE_SIGNAL) {
+            return message;
+        }
+        const gchar* member = g_dbus_message_get_member(message);
+        GVariant* body = g_dbus_message_get_body(message);
+        if (member != nullptr && body != nullptr &&
+            static_cast<const FlatSignals*>(user_data)->contains(member)) {
+            // The handlers get this very GVariant, already serialised.
+            static_cast<void>(g_variant_get_data(body));
+        }
+        return message;
+    }
+
+    static auto invocation_of(Invocation* invocation)
+        -> GDBusMethodInvocation* {
+        return reinterpret_cast<GDBusMethodInvocation*>(invocation);
+    }
+
+   public:
+    // With the D-Bus context as thread default.
+    GDBusTransport() {
+        GError* error = nullptr;
+        connection_ = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, &error);
+        if (connection_ == nullptr) {
+            std::string const msg = error->message;
+            g_clear_error(&error);
+            throw std::runtime_error("Failed to connect to DBus: " + msg);
+        }
+
+        // Added with the D-Bus context as thread default, so that is where
+        // GLib frees the members once no filter call uses them any more.
+        flat_signals_ = new FlatSignals;
+        flat_signals_filter_ = g_dbus_connection_add_filter(
+            connection_, &GDBusTransport::flatten_signal_bodies, flat_signals_,
+            [](gpointer data) { delete static_cast<FlatSignals*>(data); });
+    }
+
+    GDBusTransport(const GDBusTransport&) = delete;
+    auto operator=(const GDBusTransport&) -> GDBusTransport& = delete;
+    GDBusTransport(GDBusTransport&&) = delete;
+    auto operator=(GDBusTransport&&) -> GDBusTransport& = delete;
+
+    // With the D-Bus context as thread default and its loop stopped.
+    ~GDBusTransport() override {
+        g_dbus_connection_remove_filter(connection_, flat_signals_filter_);
+        // Replies handed over before are sent, as sd-bus does on close.
+        g_dbus_connection_flush_sync(connection_, nullptr, nullptr);
+        g_object_unref(connection_);
+    }
+
+    [[nodiscard]] auto kind() const -> TransportKind override {
+        return TransportKind::GDBus;
+    }
+
+    auto callSync(const gchar* name, const gchar* path,
+                  const gchar* interface_name, const gchar* method,
+                  GVariant* parameters, GError** error) -> GVariant* override {
+        return g_dbus_connection_call_sync(
+            connection_, name, path, interface_name, method, parameters,
+            nullptr, G_DBUS_CALL_FLAGS_NONE, -1, nullptr, error);
+    }
+
+    void call(const gchar* name, const gchar* path,
+              const gchar* interface_name, const gchar* method,
+              GVariant* parameters, GCancellable* cancellable,
+              ReplyCallback callback, gpointer user_data) override {
+        g_dbus_connection_call(connection_, name, path, interface_name, method,
+                               parameters, nullptr, G_DBUS_CALL_FLAGS_NONE, -1,
+                               cancellable, &GDBusTransport::on_reply,
+                               new PendingCall{callback, user_data});
+    }
+
+    auto subscribe(const gchar* sender, const gchar* interface_name,
+                   const gchar* member, const gchar* path,
+                   SignalCallback callback, gpointer user_data)
+        -> guint override {
+        return g_dbus_connection_signal_subscribe(
+            connection_, sender, interface_name, member, path, nullptr,
+            G_DBUS_SIGNAL_FLAGS_NONE, &GDBusTransport::on_signal,
+            new Handler{callback, user_data},
+            [](gpointer data) { delete static_cast<Handler*>(data); });
+    }
+
+    void unsubscribe(guint id) override {
+        g_dbus_connection_signal_unsubscribe(connection_, id);
+    }
+
+    auto exportObject(const gchar* path, GDBusInterfaceInfo* interface,
+                      MethodCallback callback, gpointer user_data,
+                      GError** error) -> guint override {
+        // Method calls are dispatched in the thread-default context of the
+        // thread registering the object, which is the D-Bus thread.
+        return g_dbus_connection_register_object(
+            connection_, path, interface, &INTERFACE_VTABLE,
+            new Object{callback, user_data},
+            [](gpointer data) { delete static_cast<Object*>(data); }, error);
+    }
+
+    void unexportObject(guint id) override {
+        g_dbus_connection_unregister_object(connection_, id);
+    }
+
+    // Completing a GDBusMethodInvocation releases it.
+    void returnValue(Invocation* invocation, GVariant* value) override {
+        g_dbus_method_invocation_return_value(invocation_of(invocation),
+                                              value);
+    }
+
+    void returnError(Invocation* invocation, const gchar* error_name,
+                     const gchar* message) override {
+        g_dbus_method_invocation_return_dbus_error(invocation_of(invocation),
+                                                   error_name, message);
+    }
+
+    void setFlatSignals(std::vector<std::string> members) override {
+        flat_signals_->set(std::move(members));
+    }
+
+    [[nodiscard]] auto flatSignal(std::string_view member) const
+        -> bool override {
+        return flat_signals_->contains(member);
+    }
+
+    [[nodiscard]] auto connection() const -> GDBusConnection* override {
+        return connection_;
+    }
+};
+
+}  // namespace
+
+auto make_gdbus_transport(GMainContext* /*context*/)
+    -> std::unique_ptr<Transport> {
+    return std::make_unique<GDBusTransport>();
+}
+
+}  // namespace Amarula::DBus::G
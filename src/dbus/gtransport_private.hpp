@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glib.h>
+
+#include <algorithm>
+#include <amarula/dbus/gtransport.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Amarula::DBus::G {
+
+// Members of the signals whose bodies are handed over serialised.
+struct FlatSignals {
+    mutable std::mutex mtx;
+    std::vector<std::string> members;
+
+    void set(std::vector<std::string> names) {
+        std::lock_guard<std::mutex> const lock(mtx);
+        members = std::move(names);
+    }
+
+    [[nodiscard]] auto contains(std::string_view member) const -> bool {
+        std::lock_guard<std::mutex> const lock(mtx);
+        return std::ranges::find(members, member) != members.end();
+    }
+};
+
+auto make_gdbus_transport(GMainContext* context) -> std::unique_ptr<Transport>;
+#ifdef AMARULA_DBUS_SD_BUS
+auto make_sd_bus_transport(GMainContext* context)
+    -> std::unique_ptr<Transport>;
+#endif
+
+}  // namespace Amarula::DBus::G
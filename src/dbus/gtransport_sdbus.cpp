@@ -0,0 +1,894 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <systemd/sd-bus.h>
+
+#include <algorithm>
+#include <amarula/dbus/gtransport.hpp>
+#include <amarula/log.hpp>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "gtransport_private.hpp"
+
+namespace Amarula::DBus::G {
+namespace {
+
+// sd-bus' own default, the 25 s GDBus uses too.
+constexpr uint64_t DEFAULT_TIMEOUT = 0U;
+constexpr int64_t USEC_PER_MSEC = 1000;
+constexpr const char* INTROSPECTABLE = "org.freedesktop.DBus.Introspectable";
+constexpr const char* INVALID_ARGS = "org.freedesktop.DBus.Error.InvalidArgs";
+
+/*
+ * The bodies are converted between sd_bus_message and GVariant element by
+ * element. GVariant has no unix fds ("h" is only an index into the fds of a
+ * GDBusMessage) and D-Bus no maybes nor empty structs: those are rejected.
+ */
+auto read_value(sd_bus_message* message, char type, const char* contents)
+    -> GVariant*;
+
+// Reads what is left of the current container of message into builder.
+auto read_items(sd_bus_message* message, GVariantBuilder* builder) -> bool {
+    char type = 0;
+    const char* contents = nullptr;
+    int ret = 0;
+    while ((ret = sd_bus_message_peek_type(message, &type, &contents)) > 0) {
+        GVariant* item = read_value(message, type, contents);
+        if (item == nullptr) {
+            return false;
+        }
+        g_variant_builder_add_value(builder, item);
+    }
+    return ret == 0;
+}
+
+template <class T, auto Create>
+auto read_basic(sd_bus_message* message, char type) -> GVariant* {
+    T value{};
+    if (sd_bus_message_read_basic(message, type, &value) <= 0) {
+        return nullptr;
+    }
+    return Create(value);
+}
+
+// Reads an array, struct or dict entry into a GVariant of type.
+auto read_container(sd_bus_message* message, char type, const char* contents,
+                    const std::string& variant_type) -> GVariant* {
+    if (sd_bus_message_enter_container(message, type, contents) <= 0) {
+        return nullptr;
+    }
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE(variant_type.c_str()));
+    if (!read_items(message, &builder) ||
+        sd_bus_message_exit_container(message) < 0) {
+        g_variant_builder_clear(&builder);
+        return nullptr;
+    }
+    return g_variant_builder_end(&builder);
+}
+
+// Floating GVariant of the next value of message, null when it is invalid.
+auto read_value(sd_bus_message* message, char type, const char* contents)
+    -> GVariant* {
+    switch (type) {
+        case 'y':
+            return read_basic<guint8, g_variant_new_byte>(message, type);
+        case 'b': {
+            // sd-bus reads booleans into an int.
+            int value = 0;
+            if (sd_bus_message_read_basic(message, type, &value) <= 0) {
+                return nullptr;
+            }
+            return g_variant_new_boolean(static_cast<gboolean>(value != 0));
+        }
+        case 'n':
+            return read_basic<gint16, g_variant_new_int16>(message, type);
+        case 'q':
+            return read_basic<guint16, g_variant_new_uint16>(message, type);
+        case 'i':
+            return read_basic<gint32, g_variant_new_int32>(message, type);
+        case 'u':
+            return read_basic<guint32, g_variant_new_uint32>(message, type);
+        case 'x':
+            return read_basic<gint64, g_variant_new_int64>(message, type);
+        case 't':
+            return read_basic<guint64, g_variant_new_uint64>(message, type);
+        case 'd':
+            return read_basic<gdouble, g_variant_new_double>(message, type);
+        case 's':
+            return read_basic<const char*, g_variant_new_string>(message,
+                                                                 type);
+        case 'o':
+            return read_basic<const char*, g_variant_new_object_path>(message,
+                                                                      type);
+        case 'g':
+            return read_basic<const char*, g_variant_new_signature>(message,
+                                                                    type);
+        case 'v': {
+            if (sd_bus_message_enter_container(message, type, contents) <= 0) {
+                return nullptr;
+            }
+            char inner_type = 0;
+            const char* inner_contents = nullptr;
+            GVariant* inner = nullptr;
+            if (sd_bus_message_peek_type(message, &inner_type,
+                                         &inner_contents) > 0) {
+                inner = read_value(message, inner_type, inner_contents);
+            }
+            if (inner == nullptr ||
+                sd_bus_message_exit_container(message) < 0) {
+                if (inner != nullptr) {
+                    g_variant_unref(g_variant_ref_sink(inner));
+                }
+                return nullptr;
+            }
+            return g_variant_new_variant(inner);
+        }
+        case 'a': {
+            // Byte arrays, SSIDs among them, in one go.
+            if (std::string_view(contents) == "y") {
+                const void* data = nullptr;
+                size_t size = 0U;
+                if (sd_bus_message_read_array(message, 'y', &data, &size) <
+                    0) {
+                    return nullptr;
+                }
+                return size != 0U ? g_variant_new_fixed_array(
+                                        G_VARIANT_TYPE_BYTE, data, size,
+                                        sizeof(guint8))
+                                  : g_variant_new_array(G_VARIANT_TYPE_BYTE,
+                                                        nullptr, 0U);
+            }
+            return read_container(message, type, contents,
+                                  std::string("a") + contents);
+        }
+        case 'r':
+            return read_container(message, type, contents,
+                                  std::string("(") + contents + ")");
+        case 'e':
+            return read_container(message, type, contents,
+                                  std::string("{") + contents + "}");
+        default:
+            return nullptr;
+    }
+}
+
+// The body of message as the tuple GDBus would hand over, or null.
+auto read_body(sd_bus_message* message) -> GVariant* {
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_TUPLE);
+    if (!read_items(message, &builder)) {
+        g_variant_builder_clear(&builder);
+        return nullptr;
+    }
+    return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+auto append_value(sd_bus_message* message, GVariant* value) -> int;
+
+// Appends the children of value, inside a container of type and contents.
+auto append_container(sd_bus_message* message, GVariant* value, char type,
+                      const std::string& contents) -> int {
+    int ret = sd_bus_message_open_container(message, type, contents.c_str());
+    GVariantIter iter;
+    g_variant_iter_init(&iter, value);
+    GVariant* child = nullptr;
+    while (ret >= 0 && (child = g_variant_iter_next_value(&iter)) != nullptr) {
+        ret = append_value(message, child);
+        g_variant_unref(child);
+    }
+    return ret < 0 ? ret : sd_bus_message_close_container(message);
+}
+
+template <class T>
+auto append_basic(sd_bus_message* message, GVariantClass type, T value)
+    -> int {
+    return sd_bus_message_append_basic(message, static_cast<char>(type),
+                                       &value);
+}
+
+// Negative errno when value cannot be sent.
+auto append_value(sd_bus_message* message, GVariant* value) -> int {
+    const auto type = g_variant_classify(value);
+    switch (type) {
+        case G_VARIANT_CLASS_BOOLEAN:
+            return append_basic(message, type,
+                                static_cast<int>(
+                                    g_variant_get_boolean(value) != 0));
+        case G_VARIANT_CLASS_BYTE:
+            return append_basic(message, type, g_variant_get_byte(value));
+        case G_VARIANT_CLASS_INT16:
+            return append_basic(message, type, g_variant_get_int16(value));
+        case G_VARIANT_CLASS_UINT16:
+            return append_basic(message, type, g_variant_get_uint16(value));
+        case G_VARIANT_CLASS_INT32:
+            return append_basic(message, type, g_variant_get_int32(value));
+        case G_VARIANT_CLASS_UINT32:
+            return append_basic(message, type, g_variant_get_uint32(value));
+        case G_VARIANT_CLASS_INT64:
+            return append_basic(message, type, g_variant_get_int64(value));
+        case G_VARIANT_CLASS_UINT64:
+            return append_basic(message, type, g_variant_get_uint64(value));
+        case G_VARIANT_CLASS_DOUBLE:
+            return append_basic(message, type, g_variant_get_double(value));
+        case G_VARIANT_CLASS_STRING:
+        case G_VARIANT_CLASS_OBJECT_PATH:
+        case G_VARIANT_CLASS_SIGNATURE:
+            // Strings are passed themselves, not a pointer to them.
+            return sd_bus_message_append_basic(
+                message, static_cast<char>(type),
+                g_variant_get_string(value, nullptr));
+        case G_VARIANT_CLASS_VARIANT: {
+            GVariant* inner = g_variant_get_variant(value);
+            int ret = sd_bus_message_open_container(
+                message, 'v', g_variant_get_type_string(inner));
+            if (ret >= 0) {
+                ret = append_value(message, inner);
+            }
+            g_variant_unref(inner);
+            return ret < 0 ? ret : sd_bus_message_close_container(message);
+        }
+        case G_VARIANT_CLASS_ARRAY: {
+            const std::string element(g_variant_get_type_string(value) + 1);
+            if (element == "y") {
+                gsize size = 0U;
+                const auto* data =
+                    g_variant_get_fixed_array(value, &size, sizeof(guint8));
+                return sd_bus_message_append_array(message, 'y', data, size);
+            }
+            return append_container(message, value, 'a', element);
+        }
+        case G_VARIANT_CLASS_TUPLE:
+        case G_VARIANT_CLASS_DICT_ENTRY: {
+            if (g_variant_n_children(value) == 0U) {
+                return -EINVAL;
+            }
+            const std::string_view signature(g_variant_get_type_string(value));
+            return append_container(
+                message, value, type == G_VARIANT_CLASS_TUPLE ? 'r' : 'e',
+                std::string(signature.substr(1U, signature.size() - 2U)));
+        }
+        default:
+            return -EINVAL;
+    }
+}
+
+// Appends the members of the tuple parameters; parameters may be null.
+auto append_body(sd_bus_message* message, GVariant* parameters) -> int {
+    if (parameters == nullptr) {
+        return 0;
+    }
+    GVariantIter iter;
+    g_variant_iter_init(&iter, parameters);
+    GVariant* child = nullptr;
+    int ret = 0;
+    while (ret >= 0 && (child = g_variant_iter_next_value(&iter)) != nullptr) {
+        ret = append_value(message, child);
+        g_variant_unref(child);
+    }
+    return ret;
+}
+
+auto error_from(const sd_bus_error* error) -> GError* {
+    return g_dbus_error_new_for_dbus_error(
+        error->name, error->message != nullptr ? error->message : "");
+}
+
+auto error_from(int errno_value) -> GError* {
+    return g_error_new_literal(G_IO_ERROR,
+                               g_io_error_from_errno(-errno_value),
+                               g_strerror(-errno_value));
+}
+
+/*
+ * Runs the bus on a GMainContext: its fd is polled with the events sd-bus
+ * waits for and its timeout is the one of the earliest pending call.
+ */
+struct BusSource {
+    GSource source;
+    sd_bus* bus;
+    gpointer fd_tag;
+
+    static auto of(GSource* source) -> BusSource* {
+        return reinterpret_cast<BusSource*>(source);
+    }
+
+    // Milliseconds until the bus is due, -1 for never.
+    [[nodiscard]] auto timeout() const -> gint {
+        uint64_t until = 0U;
+        if (sd_bus_get_timeout(bus, &until) <= 0 || until == UINT64_MAX) {
+            return -1;
+        }
+        const auto now = static_cast<uint64_t>(g_get_monotonic_time());
+        if (until <= now) {
+            return 0;
+        }
+        return static_cast<gint>(
+            std::min<uint64_t>((until - now + USEC_PER_MSEC - 1) /
+                                   USEC_PER_MSEC,
+                               G_MAXINT));
+    }
+
+    static auto prepare(GSource* source, gint* timeout) -> gboolean {
+        auto* self = of(source);
+        const int events = sd_bus_get_events(self->bus);
+        if (events >= 0) {
+            g_source_modify_unix_fd(source, self->fd_tag,
+                                    static_cast<GIOCondition>(events));
+        }
+        *timeout = self->timeout();
+        return static_cast<gboolean>(*timeout == 0);
+    }
+
+    static auto check(GSource* source) -> gboolean {
+        auto* self = of(source);
+        return static_cast<gboolean>(
+            g_source_query_unix_fd(source, self->fd_tag) != 0 ||
+            self->timeout() == 0);
+    }
+
+    static auto dispatch(GSource* source, GSourceFunc /*callback*/,
+                         gpointer /*user_data*/) -> gboolean {
+        auto* self = of(source);
+        int ret = 0;
+        while ((ret = sd_bus_process(self->bus, nullptr)) > 0) {
+        }
+        if (ret < 0) {
+            LCM_LOG("Lost the D-Bus connection: " << g_strerror(-ret)
+                                                  << '\n');
+            return G_SOURCE_REMOVE;
+        }
+        return G_SOURCE_CONTINUE;
+    }
+
+    constexpr static GSourceFuncs FUNCS{&BusSource::prepare,
+                                        &BusSource::check,
+                                        &BusSource::dispatch,
+                                        nullptr,
+                                        nullptr,
+                                        nullptr};
+};
+
+/*
+ * systemd's sd-bus. Messages are read and converted to GVariant on the D-Bus
+ * thread itself; there is no worker thread and no GObject per message.
+ * sd-bus is not thread safe, so whatever may come from another thread is
+ * handed over to the D-Bus thread first.
+ */
+class SdBusTransport final : public Transport {
+    GMainContext* ctx_;
+    sd_bus* bus_{nullptr};
+    GSource* source_{nullptr};
+    FlatSignals flat_signals_;
+    guint next_id_{0U};
+
+    struct PendingCall {
+        SdBusTransport* transport;
+        guint id;
+        ReplyCallback callback;
+        gpointer user_data;
+        GCancellable* cancellable;
+        // Dispatched on the D-Bus thread once cancellable is cancelled.
+        GSource* cancelled{nullptr};
+    };
+
+    /*
+     * Cleared by unsubscribe() and unexportObject() from any thread, after
+     * which nothing more is dispatched to user_data. The slot itself is
+     * only freed later on the D-Bus thread.
+     */
+    struct Handler {
+        SdBusTransport* transport;
+        SignalCallback callback;
+        gpointer user_data;
+        std::atomic<bool> active{true};
+    };
+
+    struct Object {
+        GDBusInterfaceInfo* interface;
+        MethodCallback callback;
+        gpointer user_data;
+        std::atomic<bool> active{true};
+    };
+
+    // An sd-bus slot together with what its callback is given.
+    template <class Data>
+    struct Slot {
+        sd_bus_slot* slot{nullptr};
+        std::unique_ptr<Data> data;
+
+        Slot() = default;
+        Slot(sd_bus_slot* bus_slot, std::unique_ptr<Data> slot_data)
+            : slot{bus_slot}, data{std::move(slot_data)} {}
+        Slot(const Slot&) = delete;
+        auto operator=(const Slot&) -> Slot& = delete;
+        Slot(Slot&& other) noexcept
+            : slot{std::exchange(other.slot, nullptr)},
+              data{std::move(other.data)} {}
+        auto operator=(Slot&&) -> Slot& = delete;
+        ~Slot() { sd_bus_slot_unref(slot); }
+    };
+
+    // Only touched on the D-Bus thread.
+    std::unordered_map<guint, Slot<PendingCall>> calls_;
+    // Changed on the D-Bus thread, looked up from any thread under slots_mtx_.
+    std::mutex slots_mtx_;
+    std::unordered_map<guint, Slot<Handler>> subscriptions_;
+    std::unordered_map<guint, Slot<Object>> objects_;
+
+    static auto message_of(Invocation* invocation) -> sd_bus_message* {
+        return reinterpret_cast<sd_bus_message*>(invocation);
+    }
+
+    /*
+     * Runs function on the D-Bus thread without waiting for it, right away
+     * when that is this thread. Callers may hold locks a D-Bus callback is
+     * waiting for, so nothing blocks on the loop here.
+     */
+    void post_to_dbus_thread(std::function<void()> function) {
+        g_main_context_invoke_full(
+            ctx_, G_PRIORITY_HIGH,
+            [](gpointer user_data) -> gboolean {
+                (*static_cast<std::function<void()>*>(user_data))();
+                return G_SOURCE_REMOVE;
+            },
+            new std::function<void()>(std::move(function)),
+            [](gpointer user_data) {
+                delete static_cast<std::function<void()>*>(user_data);
+            });
+    }
+
+    // Deactivates slot id of slots now, and frees it on the D-Bus thread.
+    template <class Data>
+    void remove_slot(std::unordered_map<guint, Slot<Data>>& slots, guint id) {
+        {
+            std::lock_guard<std::mutex> const lock(slots_mtx_);
+            const auto slot_it = slots.find(id);
+            if (slot_it == slots.end()) {
+                return;
+            }
+            slot_it->second.data->active = false;
+        }
+        post_to_dbus_thread([this, &slots, id]() {
+            std::lock_guard<std::mutex> const lock(slots_mtx_);
+            slots.erase(id);
+        });
+    }
+
+    /*
+     * Answers call on the D-Bus thread without waiting: with body, or with
+     * error_name when that is not empty.
+     */
+    void post_reply(sd_bus_message* call, GVariant* body,
+                    std::string error_name, std::string message) {
+        struct Data {
+            sd_bus_message* call;
+            GVariant* body;
+            std::string error_name;
+            std::string message;
+        };
+
+        g_main_context_invoke_full(
+            ctx_, G_PRIORITY_DEFAULT,
+            [](gpointer user_data) -> gboolean {
+                const auto* data = static_cast<const Data*>(user_data);
+                const int ret = data->error_name.empty()
+                                    ? reply_value(data->call, data->body)
+                                    : reply_error(data->call, data->error_name,
+                                                  data->message);
+                if (ret < 0) {
+                    LCM_LOG("Failed to reply: " << g_strerror(-ret) << '\n');
+                }
+                return G_SOURCE_REMOVE;
+            },
+            new Data{call, body, std::move(error_name), std::move(message)},
+            [](gpointer user_data) {
+                const std::unique_ptr<Data> data(static_cast<Data*>(user_data));
+                sd_bus_message_unref(data->call);
+                if (data->body != nullptr) {
+                    g_variant_unref(data->body);
+                }
+            });
+    }
+
+    static auto reply_value(sd_bus_message* call, GVariant* body) -> int {
+        sd_bus_message* reply = nullptr;
+        int ret = sd_bus_message_new_method_return(call, &reply);
+        if (ret >= 0) {
+            ret = append_body(reply, body);
+        }
+        if (ret >= 0) {
+            // Sent on the bus call came from.
+            ret = sd_bus_send(nullptr, reply, nullptr);
+        }
+        sd_bus_message_unref(reply);
+        return ret;
+    }
+
+    static auto reply_error(sd_bus_message* call, const std::string& name,
+                            const std::string& message) -> int {
+        const sd_bus_error error =
+            SD_BUS_ERROR_MAKE_CONST(name.c_str(), message.c_str());
+        return sd_bus_reply_method_error(call, &error);
+    }
+
+    static auto on_reply(sd_bus_message* reply, void* user_data,
+                         sd_bus_error* /*ret_error*/) -> int {
+        auto* call = static_cast<PendingCall*>(user_data);
+        GError* error = nullptr;
+        GVariant* body = nullptr;
+        const auto* reply_error = sd_bus_message_get_error(reply);
+        if (call->cancellable != nullptr &&
+            g_cancellable_set_error_if_cancelled(call->cancellable, &error) !=
+                0) {
+            // error says so.
+        } else if (reply_error != nullptr) {
+            error = error_from(reply_error);
+        } else if ((body = read_body(reply)) == nullptr) {
+            error = g_error_new_literal(G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                        "Malformed reply");
+        }
+        call->callback(body, error, call->user_data);
+        if (body != nullptr) {
+            g_variant_unref(body);
+        } else {
+            g_error_free(error);
+        }
+        call->transport->drop_call(call->id);
+        return 0;
+    }
+
+    // Calls back right away rather than when the reply or timeout comes.
+    static auto on_cancelled(GCancellable* cancellable, gpointer user_data)
+        -> gboolean {
+        auto* call = static_cast<PendingCall*>(user_data);
+        GError* error = nullptr;
+        g_cancellable_set_error_if_cancelled(cancellable, &error);
+        call->callback(nullptr, error, call->user_data);
+        g_error_free(error);
+        call->transport->drop_call(call->id);
+        return G_SOURCE_REMOVE;
+    }
+
+    /*
+     * Forgets call id: unreferencing its slot drops it from sd-bus, so a
+     * reply still to come goes nowhere.
+     */
+    void drop_call(guint id) {
+        const auto found = calls_.find(id);
+        if (found == calls_.end()) {
+            return;
+        }
+        const auto& call = *found->second.data;
+        if (call.cancelled != nullptr) {
+            g_source_destroy(call.cancelled);
+            g_source_unref(call.cancelled);
+        }
+        if (call.cancellable != nullptr) {
+            g_object_unref(call.cancellable);
+        }
+        calls_.erase(found);
+    }
+
+    static auto on_signal(sd_bus_message* message, void* user_data,
+                          sd_bus_error* /*ret_error*/) -> int {
+        const auto* handler = static_cast<const Handler*>(user_data);
+        if (!handler->active) {
+            return 0;
+        }
+        const char* member = sd_bus_message_get_member(message);
+        GVariant* body = read_body(message);
+        if (body == nullptr) {
+            LCM_LOG("Dropping malformed signal " << member << '\n');
+            return 0;
+        }
+        if (handler->transport->flat_signals_.contains(member)) {
+            static_cast<void>(g_variant_get_data(body));
+        }
+        handler->callback(member, body, handler->user_data);
+        g_variant_unref(body);
+        return 0;
+    }
+
+    static auto on_match_added(sd_bus_message* reply, void* /*user_data*/,
+                               sd_bus_error* /*ret_error*/) -> int {
+        if (const auto* error = sd_bus_message_get_error(reply);
+            error != nullptr) {
+            LCM_LOG("Failed to add signal match: " << error->message << '\n');
+        }
+        return 0;
+    }
+
+    static auto in_signature(const GDBusMethodInfo* method) -> std::string {
+        std::string signature;
+        for (auto** arg = method->in_args; arg != nullptr && *arg != nullptr;
+             ++arg) {
+            signature += (*arg)->signature;
+        }
+        return signature;
+    }
+
+    static auto reply_introspection(sd_bus_message* call, const Object* object)
+        -> int {
+        GString* xml = g_string_new(
+            "<!DOCTYPE node PUBLIC "
+            "\"-//freedesktop//DTD D-BUS Object Introspection 1.0//EN\"\n"
+            "\"http://www.freedesktop.org/standards/dbus/1.0/"
+            "introspect.dtd\">\n<node>\n"
+            "  <interface name=\"org.freedesktop.DBus.Introspectable\">\n"
+            "    <method name=\"Introspect\">\n"
+            "      <arg type=\"s\" name=\"xml_data\" direction=\"out\"/>\n"
+            "    </method>\n"
+            "  </interface>\n");
+        g_dbus_interface_info_generate_xml(object->interface, 2, xml);
+        g_string_append(xml, "</node>\n");
+        const int ret = sd_bus_reply_method_return(call, "s", xml->str);
+        g_string_free(xml, TRUE);
+        return ret;
+    }
+
+    // Calls are checked against the interface info, as GDBus does.
+    static auto on_method_call(sd_bus_message* call, void* user_data,
+                               sd_bus_error* ret_error) -> int {
+        const auto* object = static_cast<const Object*>(user_data);
+        if (!object->active) {
+            return 0;  // sd-bus answers UnknownObject
+        }
+        const char* interface_name = sd_bus_message_get_interface(call);
+        const char* member = sd_bus_message_get_member(call);
+        if (g_strcmp0(interface_name, INTROSPECTABLE) == 0 &&
+            g_strcmp0(member, "Introspect") == 0) {
+            const int ret = reply_introspection(call, object);
+            return ret < 0 ? ret : 1;
+        }
+        if (interface_name != nullptr &&
+            g_strcmp0(interface_name, object->interface->name) != 0) {
+            return 0;  // sd-bus answers UnknownMethod
+        }
+        const auto* method =
+            g_dbus_interface_info_lookup_method(object->interface, member);
+        if (method == nullptr) {
+            return 0;
+        }
+        const char* signature = sd_bus_message_get_signature(call, 1);
+        GVariant* parameters = nullptr;
+        if (in_signature(method) != (signature != nullptr ? signature : "") ||
+            (parameters = read_body(call)) == nullptr) {
+            return sd_bus_error_setf(ret_error, INVALID_ARGS,
+                                     "Invalid arguments for %s", member);
+        }
+        object->callback(member, parameters,
+                         reinterpret_cast<Invocation*>(
+                             sd_bus_message_ref(call)),
+                         object->user_data);
+        g_variant_unref(parameters);
+        return 1;
+    }
+
+    // Makes a signal match or object id no other one has.
+    auto next_id() -> guint {
+        if (++next_id_ == 0U) {
+            ++next_id_;
+        }
+        return next_id_;
+    }
+
+   public:
+    explicit SdBusTransport(GMainContext* context)
+        : ctx_{g_main_context_ref(context)} {
+        const int ret = sd_bus_open_system(&bus_);
+        if (ret < 0) {
+            g_main_context_unref(ctx_);
+            throw std::runtime_error(
+                std::string("Failed to connect to DBus: ") + g_strerror(-ret));
+        }
+        // GLib never writes to the funcs.
+        // NOLINTNEXTLINE(*-const-cast)
+        auto* funcs = const_cast<GSourceFuncs*>(&BusSource::FUNCS);
+        source_ = g_source_new(funcs, sizeof(BusSource));
+        auto* bus_source = BusSource::of(source_);
+        bus_source->bus = bus_;
+        bus_source->fd_tag = g_source_add_unix_fd(
+            source_, sd_bus_get_fd(bus_), static_cast<GIOCondition>(0));
+        g_source_attach(source_, ctx_);
+    }
+
+    SdBusTransport(const SdBusTransport&) = delete;
+    auto operator=(const SdBusTransport&) -> SdBusTransport& = delete;
+    SdBusTransport(SdBusTransport&&) = delete;
+    auto operator=(SdBusTransport&&) -> SdBusTransport& = delete;
+
+    // With the D-Bus loop stopped; pending calls fail with G_IO_ERROR_CLOSED.
+    ~SdBusTransport() override {
+        while (!calls_.empty()) {
+            const auto& call = *calls_.begin()->second.data;
+            const auto id = call.id;
+            GError* error = g_error_new_literal(G_IO_ERROR, G_IO_ERROR_CLOSED,
+                                                "Connection closed");
+            call.callback(nullptr, error, call.user_data);
+            g_error_free(error);
+            drop_call(id);
+        }
+        subscriptions_.clear();
+        objects_.clear();
+        g_source_destroy(source_);
+        g_source_unref(source_);
+        sd_bus_flush_close_unref(bus_);
+        g_main_context_unref(ctx_);
+    }
+
+    [[nodiscard]] auto kind() const -> TransportKind override {
+        return TransportKind::SdBus;
+    }
+
+    auto callSync(const gchar* name, const gchar* path,
+                  const gchar* interface_name, const gchar* method,
+                  GVariant* parameters, GError** error) -> GVariant* override {
+        GVariant* body = parameters != nullptr ? g_variant_ref_sink(parameters)
+                                               : nullptr;
+        sd_bus_message* call = nullptr;
+        sd_bus_message* reply = nullptr;
+        sd_bus_error bus_error = SD_BUS_ERROR_NULL;
+        int ret = sd_bus_message_new_method_call(bus_, &call, name, path,
+                                                 interface_name, method);
+        if (ret >= 0) {
+            ret = append_body(call, body);
+        }
+        if (ret >= 0) {
+            ret = sd_bus_call(bus_, call, DEFAULT_TIMEOUT, &bus_error, &reply);
+        }
+
+        GVariant* result = nullptr;
+        if (ret < 0) {
+            g_propagate_error(error, sd_bus_error_is_set(&bus_error) != 0
+                                         ? error_from(&bus_error)
+                                         : error_from(ret));
+        } else if ((result = read_body(reply)) == nullptr) {
+            g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                "Malformed reply");
+        }
+        sd_bus_error_free(&bus_error);
+        sd_bus_message_unref(reply);
+        sd_bus_message_unref(call);
+        if (body != nullptr) {
+            g_variant_unref(body);
+        }
+        return result;
+    }
+
+    void call(const gchar* name, const gchar* path,
+              const gchar* interface_name, const gchar* method,
+              GVariant* parameters, GCancellable* cancellable,
+              ReplyCallback callback, gpointer user_data) override {
+        GVariant* body = parameters != nullptr ? g_variant_ref_sink(parameters)
+                                               : nullptr;
+        auto pending = std::make_unique<PendingCall>(
+            PendingCall{this, next_id(), callback, user_data,
+                        cancellable != nullptr ? static_cast<GCancellable*>(
+                                                     g_object_ref(cancellable))
+                                               : nullptr});
+
+        sd_bus_message* call = nullptr;
+        sd_bus_slot* slot = nullptr;
+        int ret = sd_bus_message_new_method_call(bus_, &call, name, path,
+                                                 interface_name, method);
+        if (ret >= 0) {
+            ret = append_body(call, body);
+        }
+        if (ret >= 0) {
+            ret = sd_bus_call_async(bus_, &slot, call,
+                                    &SdBusTransport::on_reply, pending.get(),
+                                    DEFAULT_TIMEOUT);
+        }
+        sd_bus_message_unref(call);
+        if (body != nullptr) {
+            g_variant_unref(body);
+        }
+
+        if (ret < 0) {
+            GError* error = error_from(ret);
+            callback(nullptr, error, user_data);
+            g_error_free(error);
+            if (pending->cancellable != nullptr) {
+                g_object_unref(pending->cancellable);
+            }
+            return;
+        }
+        // sd-bus only checks the timeout: cancelling is up to this source.
+        if (cancellable != nullptr) {
+            pending->cancelled = g_cancellable_source_new(cancellable);
+            g_source_set_callback(pending->cancelled,
+                                  G_SOURCE_FUNC(&SdBusTransport::on_cancelled),
+                                  pending.get(), nullptr);
+            g_source_attach(pending->cancelled, ctx_);
+        }
+        const auto id = pending->id;
+        calls_.emplace(id, Slot<PendingCall>{slot, std::move(pending)});
+    }
+
+    auto subscribe(const gchar* sender, const gchar* interface_name,
+                   const gchar* member, const gchar* path,
+                   SignalCallback callback, gpointer user_data)
+        -> guint override {
+        auto handler = std::make_unique<Handler>(this, callback, user_data);
+        sd_bus_slot* slot = nullptr;
+        const int ret = sd_bus_match_signal_async(
+            bus_, &slot, sender, path, interface_name, member,
+            &SdBusTransport::on_signal, &SdBusTransport::on_match_added,
+            handler.get());
+        if (ret < 0) {
+            LCM_LOG("Failed to subscribe to " << member << ": "
+                                              << g_strerror(-ret) << '\n');
+            return 0U;
+        }
+        const auto id = next_id();
+        std::lock_guard<std::mutex> const lock(slots_mtx_);
+        subscriptions_.emplace(id, Slot<Handler>{slot, std::move(handler)});
+        return id;
+    }
+
+    void unsubscribe(guint id) override {
+        remove_slot(subscriptions_, id);
+    }
+
+    auto exportObject(const gchar* path, GDBusInterfaceInfo* interface,
+                      MethodCallback callback, gpointer user_data,
+                      GError** error) -> guint override {
+        auto object = std::make_unique<Object>(interface, callback, user_data);
+        sd_bus_slot* slot = nullptr;
+        const int ret =
+            sd_bus_add_object(bus_, &slot, path,
+                              &SdBusTransport::on_method_call, object.get());
+        if (ret < 0) {
+            g_propagate_error(error, error_from(ret));
+            return 0U;
+        }
+        const auto id = next_id();
+        std::lock_guard<std::mutex> const lock(slots_mtx_);
+        objects_.emplace(id, Slot<Object>{slot, std::move(object)});
+        return id;
+    }
+
+    void unexportObject(guint id) override {
+        remove_slot(objects_, id);
+    }
+
+    void returnValue(Invocation* invocation, GVariant* value) override {
+        post_reply(message_of(invocation),
+                   value != nullptr ? g_variant_ref_sink(value) : nullptr, {},
+                   {});
+    }
+
+    void returnError(Invocation* invocation, const gchar* error_name,
+                     const gchar* message) override {
+        post_reply(message_of(invocation), nullptr, error_name, message);
+    }
+
+    void setFlatSignals(std::vector<std::string> members) override {
+        flat_signals_.set(std::move(members));
+    }
+
+    [[nodiscard]] auto flatSignal(std::string_view member) const
+        -> bool override {
+        return flat_signals_.contains(member);
+    }
+};
+
+}  // namespace
+
+auto make_sd_bus_transport(GMainContext* context)
+    -> std::unique_ptr<Transport> {
+    return std::make_unique<SdBusTransport>(context);
+}
+
+}  // namespace Amarula::DBus::G
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <glib.h>
+
+#include <algorithm>
+#include <amarula/dbus/ginterned.hpp>
+#include <amarula/dbus/gsmallvector.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace Amarula::DBus::G {
+
+/*
+ * GVariant type string known at compile time; container signatures are
+ * built by concatenation, e.g. Signature{"a"} + Codec<T>::SIGNATURE.
+ */
+template <std::size_t N>
+struct Signature {
+    std::array<char, N> text{};
+
+    constexpr Signature() = default;
+    // NOLINTNEXTLINE(google-explicit-constructor)
+    consteval Signature(const char (&str)[N]) {
+        std::copy_n(str, N, text.begin());
+    }
+
+    [[nodiscard]] constexpr auto view() const -> std::string_view {
+        return {text.data(), N - 1U};
+    }
+    [[nodiscard]] auto type() const -> const GVariantType* {
+        return G_VARIANT_TYPE(text.data());
+    }
+    [[nodiscard]] auto matches(GVariant* value) const -> bool {
+        return g_variant_is_of_type(value, type()) != 0;
+    }
+};
+
+template <std::size_t N, std::size_t M>
+consteval auto operator+(const Signature<N>& lhs, const Signature<M>& rhs)
+    -> Signature<N + M - 1U> {
+    Signature<N + M - 1U> result;
+    std::copy_n(lhs.text.begin(), N - 1U, result.text.begin());
+    std::copy_n(rhs.text.begin(), M, result.text.begin() + N - 1U);
+    return result;
+}
+
+/*
+ * Conversion between a C++ type and its GVariant. Every codec has
+ *
+ *     using Type = ...;                   // the C++ side
+ *     static constexpr Signature SIGNATURE;
+ *     static auto decode(GVariant*) -> Type;  // value of type SIGNATURE
+ *     static auto encode(const Type&) -> GVariant*;  // floating reference
+ *
+ * decode() does not check the type of its argument: callers reading from the
+ * bus check SIGNATURE.matches() once, see property(). Types without a codec
+ * do not compile.
+ */
+template <class T>
+struct Codec;
+
+template <class T, auto Sig, auto Create, auto Get>
+struct ScalarCodec {
+    using Type = T;
+    static constexpr auto SIGNATURE = Sig;
+
+    static auto decode(GVariant* value) -> Type {
+        return static_cast<Type>(Get(value));
+    }
+    static auto encode(const Type& value) -> GVariant* {
+        return Create(value);
+    }
+};
+
+inline auto new_boolean(bool value) -> GVariant* {
+    return g_variant_new_boolean(static_cast<gboolean>(value));
+}
+
+inline auto get_boolean(GVariant* value) -> bool {
+    return g_variant_get_boolean(value) != 0;
+}
+
+template <>
+struct Codec<bool>
+    : ScalarCodec<bool, Signature{"b"}, new_boolean, get_boolean> {};
+template <>
+struct Codec<std::uint8_t>
+    : ScalarCodec<std::uint8_t, Signature{"y"}, g_variant_new_byte,
+                  g_variant_get_byte> {};
+template <>
+struct Codec<std::uint16_t>
+    : ScalarCodec<std::uint16_t, Signature{"q"}, g_variant_new_uint16,
+                  g_variant_get_uint16> {};
+template <>
+struct Codec<std::int32_t>
+    : ScalarCodec<std::int32_t, Signature{"i"}, g_variant_new_int32,
+                  g_variant_get_int32> {};
+template <>
+struct Codec<std::uint32_t>
+    : ScalarCodec<std::uint32_t, Signature{"u"}, g_variant_new_uint32,
+                  g_variant_get_uint32> {};
+template <>
+struct Codec<std::uint64_t>
+    : ScalarCodec<std::uint64_t, Signature{"t"}, g_variant_new_uint64,
+                  g_variant_get_uint64> {};
+
+/*
+ * String codecs also build their value from a borrowed C string, which lets
+ * arrays of them iterate with "&s" instead of a GVariant per element.
+ */
+template <>
+struct Codec<std::string> {
+    using Type = std::string;
+    static constexpr Signature SIGNATURE{"s"};
+
+    static auto fromString(const gchar* str) -> Type { return str; }
+    static auto decode(GVariant* value) -> Type {
+        return fromString(g_variant_get_string(value, nullptr));
+    }
+    static auto encode(const Type& value) -> GVariant* {
+        return g_variant_new_string(value.c_str());
+    }
+};
+
+template <>
+struct Codec<InternedString> {
+    using Type = InternedString;
+    static constexpr Signature SIGNATURE{"s"};
+
+    static auto fromString(const gchar* str) -> Type {
+        return InternedString{str};
+    }
+    static auto decode(GVariant* value) -> Type {
+        return fromString(g_variant_get_string(value, nullptr));
+    }
+    static auto encode(const Type& value) -> GVariant* {
+        return g_variant_new_string(value.str().c_str());
+    }
+};
+
+// D-Bus object path held in a std::string.
+struct ObjectPath {
+    using Type = std::string;
+    static constexpr Signature SIGNATURE{"o"};
+
+    static auto decode(GVariant* value) -> Type {
+        return g_variant_get_string(value, nullptr);
+    }
+    static auto encode(const Type& value) -> GVariant* {
+        return g_variant_new_object_path(value.c_str());
+    }
+};
+
+// Raw bytes held in a std::string, such as an SSID that is not UTF-8.
+struct ByteString {
+    using Type = std::string;
+    static constexpr Signature SIGNATURE{"ay"};
+
+    static auto decode(GVariant* value) -> Type {
+        gsize size = 0U;
+        const auto* data = static_cast<const char*>(
+            g_variant_get_fixed_array(value, &size, sizeof(guchar)));
+        return {data, size};
+    }
+    static auto encode(const Type& value) -> GVariant* {
+        return g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, value.data(),
+                                         value.size(), sizeof(guchar));
+    }
+};
+
+// Enum sent as one of the strings of Map; unknown strings decode to Unknown.
+template <const auto& Map>
+struct EnumCodec {
+    using Type = typename std::remove_cvref_t<decltype(Map)>::EnumType;
+    static constexpr Signature SIGNATURE{"s"};
+
+    static auto fromString(const gchar* str) -> Type {
+        return Map.fromString(str).value_or(Type::Unknown);
+    }
+    static auto decode(GVariant* value) -> Type {
+        return fromString(g_variant_get_string(value, nullptr));
+    }
+    // The strings of Map are literals, so data() is null terminated.
+    static auto encode(const Type& value) -> GVariant* {
+        return g_variant_new_string(Map.toString(value).data());
+    }
+};
+
+template <class Element>
+concept StringElement =
+    Element::SIGNATURE.view() == "s" &&
+    requires(const gchar* str) { Element::fromString(str); };
+
+// Array of Element, sized from the array up front.
+template <class Element,
+          class Container = PropertyList<typename Element::Type>>
+struct ArrayCodec {
+    using Type = Container;
+    static constexpr auto SIGNATURE = Signature{"a"} + Element::SIGNATURE;
+
+    static auto decode(GVariant* value) -> Type {
+        Type items;
+        GVariantIter iter;
+        items.reserve(g_variant_iter_init(&iter, value));
+        if constexpr (StringElement<Element>) {
+            const gchar* str = nullptr;
+            while (g_variant_iter_next(&iter, "&s", &str) != 0) {
+                items.push_back(Element::fromString(str));
+            }
+        } else {
+            GVariant* item = nullptr;
+            while ((item = g_variant_iter_next_value(&iter)) != nullptr) {
+                items.push_back(Element::decode(item));
+                g_variant_unref(item);
+            }
+        }
+        return items;
+    }
+    static auto encode(const Type& items) -> GVariant* {
+        GVariantBuilder builder;
+        g_variant_builder_init(&builder, SIGNATURE.type());
+        for (const auto& item : items) {
+            g_variant_builder_add_value(&builder, Element::encode(item));
+        }
+        return g_variant_builder_end(&builder);
+    }
+};
+
+template <class T, std::size_t N>
+struct Codec<SmallVector<T, N>>
+    : ArrayCodec<Codec<T>, SmallVector<T, N>> {};
+template <class T>
+struct Codec<std::vector<T>> : ArrayCodec<Codec<T>, std::vector<T>> {};
+
+// Connman sends empty containers for what is not set: those are nullopt.
+template <class Inner>
+struct NonEmpty {
+    using Type = std::optional<typename Inner::Type>;
+    static constexpr auto SIGNATURE = Inner::SIGNATURE;
+
+    static auto decode(GVariant* value) -> Type {
+        if (g_variant_n_children(value) == 0U) {
+            return std::nullopt;
+        }
+        return Inner::decode(value);
+    }
+};
+
+// The a{sv} dicts of properties and agent fields.
+struct VariantDict {
+    static constexpr Signature SIGNATURE{"a{sv}"};
+
+    // visit(key, value) for every entry; both are borrowed for the call.
+    template <class Visitor>
+    static void forEach(GVariant* dict, Visitor&& visit) {
+        GVariantIter iter;
+        g_variant_iter_init(&iter, dict);
+        const gchar* key = nullptr;
+        GVariant* value = nullptr;
+        while (g_variant_iter_next(&iter, "{&sv}", &key, &value) != 0) {
+            visit(key, value);
+            g_variant_unref(value);
+        }
+    }
+
+    template <class ValueCodec>
+    static void add(GVariantBuilder* builder, const gchar* key,
+                    const typename ValueCodec::Type& value) {
+        g_variant_builder_add(builder, "{sv}", key, ValueCodec::encode(value));
+    }
+};
+
+// Floating GVariant of value, for setters and method arguments.
+template <class T>
+auto to_variant(const T& value) -> GVariant* {
+    return Codec<T>::encode(value);
+}
+
+}  // namespace Amarula::DBus::G
@@ -1,15 +1,22 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <amarula/dbus/connman/gconnman.hpp>
 #include <amarula/dbus/connman/gservice.hpp>
 #include <chrono>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "thread_bundle.hpp"
 
 using Amarula::DBus::G::Connman::Connman;
+using Amarula::DBus::G::Connman::CredentialStore;
+using Amarula::DBus::G::Connman::Manager;
 
 namespace {
 
@@ -30,6 +37,8 @@ constexpr int SERVICES_TIMEOUT_MS = 5000;
 
 constexpr const char* AGENT_INTERFACE = "net.connman.Agent";
 constexpr const char* RETRY_ERROR = "net.connman.Agent.Error.Retry";
+constexpr const char* CANCELED_ERROR = "net.connman.Agent.Error.Canceled";
+constexpr int POLL_INTERVAL_MS = 50;
 
 auto call_agent(GDBusConnection* bus, const std::string& path,
                 const gchar* method, GVariant* args, GError** error)
@@ -41,12 +50,12 @@ auto call_agent(GDBusConnection* bus, const std::string& path,
 }
 
 /*
- * The Agent constructor exports the agent object on our own bus connection
- * when the Manager is built, so these tests call it directly and never go
- * through connmand - Manager::registerAgent() is a separate step that only
- * tells connmand which path to call. Like the other connman tests they still
- * need a running connmand, because constructing a Manager does. Skip rather
- * than fail so the suite stays usable on a host without it.
+ * Manager::exportAgent() exports the agent object on our own bus connection,
+ * so these tests call it directly and never go through connmand -
+ * Manager::registerAgent() would also tell connmand to use it. Like the other
+ * connman tests they still need a running connmand, because constructing a
+ * Manager does. Skip rather than fail so the suite stays usable on a host
+ * without it.
  */
 auto connman_available(GDBusConnection* bus) -> bool {
     GVariant* reply = g_dbus_connection_call_sync(
@@ -73,6 +82,45 @@ auto system_bus_or_skip() -> GDBusConnection* {
     return connman_available(bus) ? bus : nullptr;
 }
 
+/*
+ * Polls instead of waiting on onServicesChanged(), whose callback would have
+ * to capture state outliving the Connman instance.
+ */
+auto wait_for_service_path(Manager& manager) -> std::string {
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(SERVICES_TIMEOUT_MS);
+    while (std::chrono::steady_clock::now() < deadline) {
+        const auto services = manager.services();
+        if (!services.empty()) {
+            return services.front()->objPath();
+        }
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(POLL_INTERVAL_MS));
+    }
+    return {};
+}
+
+auto request_passphrase(GDBusConnection* bus, const std::string& agent_path,
+                        const std::string& service_path, GError** error)
+    -> GVariant* {
+    GVariant* fields = g_variant_new_parsed(
+        "{'Passphrase': <{'Type': <'psk'>, 'Requirement': <'mandatory'>}>}");
+    return call_agent(bus, agent_path, "RequestInput",
+                      g_variant_new("(o@a{sv})", service_path.c_str(), fields),
+                      error);
+}
+
+auto remote_error_of(GError* error) -> std::string {
+    if (error == nullptr) {
+        return {};
+    }
+    gchar* remote_error = g_dbus_error_get_remote_error(error);
+    std::string name = remote_error != nullptr ? remote_error : "";
+    g_free(remote_error);
+    g_error_free(error);
+    return name;
+}
+
 }  // namespace
 
 TEST(ConnmanAgent, ReportErrorIsAnswered) {
@@ -84,6 +132,7 @@ TEST(ConnmanAgent, ReportErrorIsAnswered) {
     const ThreadBundle thread_bundle;
     const Connman connman;
     const auto manager = connman.manager();
+    manager->exportAgent();
 
     GError* error = nullptr;
 
@@ -121,6 +170,7 @@ TEST(ConnmanAgent, ReportErrorRequestsRetry) {
     const ThreadBundle thread_bundle;
     const Connman connman;
     const auto manager = connman.manager();
+    manager->exportAgent();
 
     manager->onServicesChanged(
         [&mtx, &services_cv, &discovered_service_path](const auto& services) {
@@ -200,6 +250,7 @@ TEST(ConnmanAgent, CancelIsAnswered) {
     const ThreadBundle thread_bundle;
     const Connman connman;
     const auto manager = connman.manager();
+    manager->exportAgent();
 
     GError* error = nullptr;
     GVariant* reply = call_agent(bus, manager->internalAgentPath(), "Cancel",
@@ -210,3 +261,303 @@ TEST(ConnmanAgent, CancelIsAnswered) {
         << "ms: " << (error != nullptr ? error->message : "");
     g_variant_unref(reply);
 }
+
+TEST(ConnmanAgent, RequestInputOverflowIsCanceled) {
+    GDBusConnection* bus = system_bus_or_skip();
+    if (bus == nullptr) {
+        GTEST_SKIP() << "connmand not available on the system bus";
+    }
+
+    // Outlive the Connman instance, see ReportErrorRequestsRetry.
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool running = false;
+    bool released = false;
+    std::vector<std::string> outcomes;
+
+    const ThreadBundle thread_bundle;
+    const Connman connman;
+    const auto manager = connman.manager();
+    manager->exportAgent();
+
+    const auto service_path = wait_for_service_path(*manager);
+    if (service_path.empty()) {
+        GTEST_SKIP() << "No connman services available";
+    }
+
+    // One worker busy with the first request, room for one more in the
+    // queue: of the two requests that follow, the later one is canceled.
+    manager->setAgentWorkers(1U, 1U);
+    manager->onRequestInputPassphrase([&](const auto& /*service*/) {
+        std::unique_lock<std::mutex> lock(mtx);
+        running = true;
+        cv.notify_all();
+        cv.wait(lock, [&released] { return released; });
+        return std::pair<bool, std::string>{true, "secret"};
+    });
+
+    const auto agent_path = manager->internalAgentPath();
+    auto request = [&]() {
+        GError* error = nullptr;
+        GVariant* reply =
+            request_passphrase(bus, agent_path, service_path, &error);
+        if (reply != nullptr) {
+            g_variant_unref(reply);
+        }
+        {
+            std::lock_guard<std::mutex> const lock(mtx);
+            outcomes.push_back(reply != nullptr ? "reply"
+                                                : remote_error_of(error));
+        }
+        cv.notify_all();
+    };
+
+    std::thread first(request);
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        ASSERT_TRUE(cv.wait_for(lock,
+                                std::chrono::milliseconds(CALL_TIMEOUT_MS),
+                                [&running] { return running; }));
+    }
+
+    std::thread second(request);
+    std::thread third(request);
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait_for(lock, std::chrono::milliseconds(CALL_TIMEOUT_MS),
+                    [&outcomes] { return !outcomes.empty(); });
+        released = true;
+    }
+    cv.notify_all();
+
+    first.join();
+    second.join();
+    third.join();
+
+    ASSERT_EQ(outcomes.size(), 3U);
+    EXPECT_EQ(outcomes.front(), CANCELED_ERROR);
+    EXPECT_EQ(std::count(outcomes.begin(), outcomes.end(), "reply"), 2);
+}
+
+TEST(ConnmanAgent, RequestInputAnsweredAsynchronously) {
+    GDBusConnection* bus = system_bus_or_skip();
+    if (bus == nullptr) {
+        GTEST_SKIP() << "connmand not available on the system bus";
+    }
+
+    // Outlive the Connman instance, see ReportErrorRequestsRetry.
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<Manager::PassphraseReply> pending;
+
+    const ThreadBundle thread_bundle;
+    const Connman connman;
+    const auto manager = connman.manager();
+    manager->exportAgent();
+
+    const auto service_path = wait_for_service_path(*manager);
+    if (service_path.empty()) {
+        GTEST_SKIP() << "No connman services available";
+    }
+
+    // Park the handle and return: the dispatch thread must not wait for it.
+    manager->onRequestInputPassphraseAsync(
+        [&mtx, &cv, &pending](const auto& /*service*/, auto reply) {
+            {
+                std::lock_guard<std::mutex> const lock(mtx);
+                pending.push_back(std::move(reply));
+            }
+            cv.notify_all();
+        });
+
+    GVariant* reply = nullptr;
+    GError* error = nullptr;
+    std::thread caller([&]() {
+        reply = request_passphrase(bus, manager->internalAgentPath(),
+                                   service_path, &error);
+    });
+
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        ASSERT_TRUE(cv.wait_for(lock,
+                                std::chrono::milliseconds(CALL_TIMEOUT_MS),
+                                [&pending] { return !pending.empty(); }));
+        ASSERT_TRUE(pending.front().pending());
+        pending.front().reply({true, "secret"});
+        EXPECT_FALSE(pending.front().pending());
+        pending.clear();
+    }
+    caller.join();
+
+    ASSERT_NE(reply, nullptr) << remote_error_of(error);
+    GVariant* fields = g_variant_get_child_value(reply, 0);
+    const gchar* passphrase = nullptr;
+    EXPECT_NE(g_variant_lookup(fields, "Passphrase", "&s", &passphrase), 0);
+    EXPECT_STREQ(passphrase, "secret");
+    g_variant_unref(fields);
+    g_variant_unref(reply);
+}
+
+TEST(ConnmanAgent, RequestInputAnsweredFromCredentialStore) {
+    GDBusConnection* bus = system_bus_or_skip();
+    if (bus == nullptr) {
+        GTEST_SKIP() << "connmand not available on the system bus";
+    }
+
+    const ThreadBundle thread_bundle;
+    const Connman connman;
+    const auto manager = connman.manager();
+    manager->exportAgent();
+
+    const auto service_path = wait_for_service_path(*manager);
+    if (service_path.empty()) {
+        GTEST_SKIP() << "No connman services available";
+    }
+
+    // No RequestInput callback at all: only the store can answer.
+    auto store = std::make_shared<CredentialStore>();
+    store->setForService(service_path, {.passphrase = "provisioned"});
+    manager->setCredentialStore(store);
+
+    GError* error = nullptr;
+    GVariant* reply = request_passphrase(bus, manager->internalAgentPath(),
+                                         service_path, &error);
+
+    ASSERT_NE(reply, nullptr) << remote_error_of(error);
+    GVariant* fields = g_variant_get_child_value(reply, 0);
+    const gchar* passphrase = nullptr;
+    EXPECT_NE(g_variant_lookup(fields, "Passphrase", "&s", &passphrase), 0);
+    EXPECT_STREQ(passphrase, "provisioned");
+    g_variant_unref(fields);
+    g_variant_unref(reply);
+}
+
+TEST(ConnmanAgent, CredentialStoreLookupOrder) {
+    CredentialStore store;
+    const std::string path =
+        "/net/connman/service/wifi_dca632010203_486f6d65_managed_psk";
+
+    EXPECT_FALSE(store.lookup(path, "Home").has_value());
+
+    store.setForSSID("Home", {.passphrase = "by-ssid"});
+    EXPECT_EQ(store.lookup(path, "").value().passphrase, "by-ssid");
+
+    store.setForName("Home", {.passphrase = "by-name"});
+    EXPECT_EQ(store.lookup(path, "Home").value().passphrase, "by-name");
+
+    store.setForService(path, {.passphrase = "by-path"});
+    EXPECT_EQ(store.lookup(path, "Home").value().passphrase, "by-path");
+
+    // Hidden networks have no SSID in their path to match against.
+    EXPECT_FALSE(
+        store
+            .lookup("/net/connman/service/wifi_dca632010203_hidden_managed_psk",
+                    "")
+            .has_value());
+}
+
+TEST(ConnmanAgent, ReportErrorRetriesAreLimited) {
+    GDBusConnection* bus = system_bus_or_skip();
+    if (bus == nullptr) {
+        GTEST_SKIP() << "connmand not available on the system bus";
+    }
+
+    const ThreadBundle thread_bundle;
+    const Connman connman;
+    const auto manager = connman.manager();
+    manager->exportAgent();
+
+    const auto service_path = wait_for_service_path(*manager);
+    if (service_path.empty()) {
+        GTEST_SKIP() << "No connman services available";
+    }
+
+    constexpr auto RETRY_DELAY = std::chrono::milliseconds(100);
+    manager->setReportErrorBackoff(RETRY_DELAY, 2 * RETRY_DELAY, 2U);
+    manager->onReportError(
+        [](const auto& /*service*/, const std::string& /*error*/) {
+            return true;
+        });
+
+    auto report_error = [&]() {
+        GError* error = nullptr;
+        GVariant* reply = call_agent(
+            bus, manager->internalAgentPath(), "ReportError",
+            g_variant_new("(os)", service_path.c_str(), "connect-failed"),
+            &error);
+        if (reply != nullptr) {
+            g_variant_unref(reply);
+            return std::string("reply");
+        }
+        return remote_error_of(error);
+    };
+
+    // Two retries, each one answered only once its delay is over.
+    for (const auto delay : {RETRY_DELAY, 2 * RETRY_DELAY}) {
+        const auto start = std::chrono::steady_clock::now();
+        EXPECT_EQ(report_error(), RETRY_ERROR);
+        EXPECT_GE(std::chrono::steady_clock::now() - start, delay);
+    }
+
+    // Out of attempts: the failure goes through, and the budget starts over.
+    EXPECT_EQ(report_error(), "reply");
+    EXPECT_EQ(report_error(), RETRY_ERROR);
+}
+
+TEST(ConnmanAgent, RequestInputTimesOut) {
+    GDBusConnection* bus = system_bus_or_skip();
+    if (bus == nullptr) {
+        GTEST_SKIP() << "connmand not available on the system bus";
+    }
+
+    // Outlive the Connman instance, see ReportErrorRequestsRetry.
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<Manager::PassphraseReply> parked;
+    std::string timed_out_service;
+
+    const ThreadBundle thread_bundle;
+    const Connman connman;
+    const auto manager = connman.manager();
+    manager->exportAgent();
+
+    const auto service_path = wait_for_service_path(*manager);
+    if (service_path.empty()) {
+        GTEST_SKIP() << "No connman services available";
+    }
+
+    constexpr auto TIMEOUT = std::chrono::milliseconds(200);
+    manager->setRequestInputTimeout(TIMEOUT);
+    // Never answered.
+    manager->onRequestInputPassphraseAsync(
+        [&mtx, &parked](const auto& /*service*/, auto reply) {
+            std::lock_guard<std::mutex> const lock(mtx);
+            parked.push_back(std::move(reply));
+        });
+    manager->onRequestInputTimeout(
+        [&mtx, &cv, &timed_out_service](const auto& service) {
+            {
+                std::lock_guard<std::mutex> const lock(mtx);
+                timed_out_service = service->objPath();
+            }
+            cv.notify_all();
+        });
+
+    const auto start = std::chrono::steady_clock::now();
+    GError* error = nullptr;
+    GVariant* reply = request_passphrase(bus, manager->internalAgentPath(),
+                                         service_path, &error);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    ASSERT_EQ(reply, nullptr);
+    EXPECT_EQ(remote_error_of(error), CANCELED_ERROR);
+    EXPECT_GE(elapsed, TIMEOUT);
+
+    // The application hears about it right after connman got its answer.
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait_for(lock, std::chrono::milliseconds(CALL_TIMEOUT_MS),
+                [&timed_out_service] { return !timed_out_service.empty(); });
+    EXPECT_EQ(timed_out_service, service_path);
+    ASSERT_EQ(parked.size(), 1U);
+    EXPECT_FALSE(parked.front().pending());
+}
@@ -0,0 +1,130 @@
+#include <glib.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "gconnman_input_fields.hpp"
+
+using namespace Amarula::DBus::G::Connman;
+
+/*
+ * Every heap allocation of the process goes through these while counting is
+ * on, GLib ones included: g_malloc() and GSlice end up in malloc(). glibc
+ * only, which is all connman runs on anyway.
+ */
+extern "C" {
+auto __libc_malloc(std::size_t size) -> void*;
+auto __libc_calloc(std::size_t count, std::size_t size) -> void*;
+auto __libc_realloc(void* ptr, std::size_t size) -> void*;
+}
+
+namespace {
+
+std::atomic<bool> counting{false};
+std::atomic<std::size_t> allocations{0U};
+
+void count_allocation() {
+    if (counting.load(std::memory_order_relaxed)) {
+        allocations.fetch_add(1U, std::memory_order_relaxed);
+    }
+}
+
+}  // namespace
+
+extern "C" {
+auto malloc(std::size_t size) -> void* {
+    count_allocation();
+    return __libc_malloc(size);
+}
+
+auto calloc(std::size_t count, std::size_t size) -> void* {
+    count_allocation();
+    return __libc_calloc(count, size);
+}
+
+auto realloc(void* ptr, std::size_t size) -> void* {
+    count_allocation();
+    return __libc_realloc(ptr, size);
+}
+}
+
+namespace {
+
+/*
+ * Fields as connman sends them, already serialised like the arguments GDBus
+ * hands to the agent.
+ */
+auto fields(const char* text) -> GVariant* {
+    GVariant* value = g_variant_ref_sink(g_variant_new_parsed(text));
+    static_cast<void>(g_variant_get_data(value));
+    return value;
+}
+
+auto classify_counting(GVariant* value, std::size_t& allocated) -> uint8_t {
+    allocations = 0U;
+    counting = true;
+    const auto found = input_fields(value);
+    counting = false;
+    allocated = allocations;
+    return found;
+}
+
+}  // namespace
+
+TEST(InputFields, ClassifiesWithoutAllocating) {
+    struct Case {
+        const char* fields;
+        uint8_t expected;
+    };
+    const Case cases[] = {
+        {"@a{sv} {}", 0U},
+        {"{'Passphrase': <{'Type': <'psk'>, 'Requirement': <'mandatory'>}>}",
+         FieldMandatoryPassphrase},
+        {"{'Passphrase': <{'Type': <'psk'>, 'Requirement': <'mandatory'>}>, "
+         "'WPS': <{'Type': <'wpspin'>, 'Requirement': <'alternate'>}>}",
+         FieldMandatoryPassphrase | FieldWPS},
+        {"{'Name': <{'Type': <'string'>, 'Requirement': <'mandatory'>, "
+         "'Alternates': <['SSID']>}>, "
+         "'SSID': <{'Type': <'ssid'>, 'Requirement': <'alternate'>}>}",
+         FieldName},
+        {"{'Identity': <{'Type': <'string'>, 'Requirement': <'mandatory'>}>, "
+         "'Passphrase': <{'Type': <'response'>, "
+         "'Requirement': <'mandatory'>}>}",
+         FieldIdentity | FieldMandatoryPassphrase | FieldPassphraseResponse},
+        {"{'Username': <{'Type': <'string'>, 'Requirement': <'mandatory'>}>, "
+         "'Password': <{'Type': <'passphrase'>, "
+         "'Requirement': <'mandatory'>, 'Previous': <uint32 5>}>}",
+         FieldUsername | FieldPassword},
+    };
+
+    for (const auto& test_case : cases) {
+        GVariant* value = fields(test_case.fields);
+        std::size_t allocated = 0U;
+        EXPECT_EQ(classify_counting(value, allocated), test_case.expected)
+            << test_case.fields;
+        EXPECT_EQ(allocated, 0U) << test_case.fields;
+        g_variant_unref(value);
+    }
+}
+
+TEST(InputFields, WideOffsets) {
+    // Over 255 bytes the framing offsets take two bytes each.
+    std::string text = "{";
+    for (int i = 0; i < 40; ++i) {
+        text += "'Optional" + std::to_string(i) +
+                "': <{'Type': <'string'>, 'Requirement': <'optional'>}>, ";
+    }
+    text += "'Username': <{'Type': <'string'>}>, 'Password': <@a{sv} {}>}";
+
+    GVariant* value = fields(text.c_str());
+    ASSERT_GT(g_variant_get_size(value), 255U);
+
+    std::size_t allocated = 0U;
+    EXPECT_EQ(classify_counting(value, allocated),
+              FieldUsername | FieldPassword);
+    EXPECT_EQ(allocated, 0U);
+    g_variant_unref(value);
+}
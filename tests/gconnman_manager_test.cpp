@@ -0,0 +1,408 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <gtest/gtest.h>
+
+#include <amarula/dbus/connman/gconnman.hpp>
+#include <amarula/dbus/connman/gmanager.hpp>
+#include <amarula/dbus/connman/gservice.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace Amarula::DBus::G::Connman;
+
+/*
+ * The Manager against a fake connmand: a connection of its own owning
+ * net.connman on a private dbus-daemon, which stands in for the system bus.
+ * It answers what the Manager asks for when it starts, and drives the agent
+ * the way connmand does.
+ */
+namespace {
+
+constexpr const char* BUS_NAME = "org.freedesktop.DBus";
+constexpr const char* BUS_PATH = "/org/freedesktop/DBus";
+constexpr const char* CONNMAN_NAME = "net.connman";
+constexpr const char* MANAGER_PATH = "/";
+constexpr const char* MANAGER_INTERFACE = "net.connman.Manager";
+constexpr const char* WIFI_PATH = "/net/connman/service/wifi_a";
+constexpr const char* PASSPHRASE_FIELDS =
+    "{'Passphrase': <{'Type': <'psk'>, 'Requirement': <'mandatory'>}>}";
+constexpr auto TIMEOUT = std::chrono::seconds(10);
+
+// Only what the Manager and the Clock call.
+constexpr const char* INTROSPECTION = R"xml(
+<node>
+  <interface name="net.connman.Manager">
+    <method name="GetProperties">
+      <arg type="a{sv}" direction="out"/>
+    </method>
+    <method name="GetTechnologies">
+      <arg type="a(oa{sv})" direction="out"/>
+    </method>
+    <method name="GetServices">
+      <arg type="a(oa{sv})" direction="out"/>
+    </method>
+    <method name="RegisterAgent">
+      <arg type="o" direction="in"/>
+    </method>
+    <method name="UnregisterAgent">
+      <arg type="o" direction="in"/>
+    </method>
+  </interface>
+  <interface name="net.connman.Clock">
+    <method name="GetProperties">
+      <arg type="a{sv}" direction="out"/>
+    </method>
+  </interface>
+  <interface name="net.connman.Service"/>
+</node>)xml";
+
+class FakeConnman {
+   public:
+    struct Agent {
+        std::string owner;
+        std::string path;
+    };
+
+    FakeConnman()
+        : ctx_{g_main_context_new()}, loop_{g_main_loop_new(ctx_, FALSE)} {
+        conn_ = g_dbus_connection_new_for_address_sync(
+            g_getenv("DBUS_SYSTEM_BUS_ADDRESS"),
+            static_cast<GDBusConnectionFlags>(
+                G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+            nullptr, nullptr, nullptr);
+        GVariant* reply = g_dbus_connection_call_sync(
+            conn_, BUS_NAME, BUS_PATH, BUS_NAME, "RequestName",
+            g_variant_new("(su)", CONNMAN_NAME, 0U), nullptr,
+            G_DBUS_CALL_FLAGS_NONE, -1, nullptr, nullptr);
+        g_variant_unref(reply);
+
+        node_ = g_dbus_node_info_new_for_xml(INTROSPECTION, nullptr);
+        static const GDBusInterfaceVTable vtable{&FakeConnman::on_method_call,
+                                                 nullptr, nullptr, {}};
+        // Method calls are dispatched to the context current when registered.
+        g_main_context_push_thread_default(ctx_);
+        for (const auto& [path, interface] :
+             {std::pair{MANAGER_PATH, 0}, std::pair{MANAGER_PATH, 1},
+              std::pair{WIFI_PATH, 2}}) {
+            registrations_.push_back(g_dbus_connection_register_object(
+                conn_, path, node_->interfaces[interface], &vtable, this,
+                nullptr, nullptr));
+        }
+        g_main_context_pop_thread_default(ctx_);
+
+        thread_ = std::thread([this]() {
+            g_main_context_push_thread_default(ctx_);
+            g_main_loop_run(loop_);
+            g_main_context_pop_thread_default(ctx_);
+        });
+    }
+
+    FakeConnman(const FakeConnman&) = delete;
+    auto operator=(const FakeConnman&) -> FakeConnman& = delete;
+    FakeConnman(FakeConnman&&) = delete;
+    auto operator=(FakeConnman&&) -> FakeConnman& = delete;
+
+    ~FakeConnman() {
+        g_main_loop_quit(loop_);
+        thread_.join();
+        for (const auto registration : registrations_) {
+            g_dbus_connection_unregister_object(conn_, registration);
+        }
+        // Gives the name up for the next test.
+        g_dbus_connection_close_sync(conn_, nullptr, nullptr);
+        g_object_unref(conn_);
+        g_dbus_node_info_unref(node_);
+        g_main_loop_unref(loop_);
+        g_main_context_unref(ctx_);
+    }
+
+    // The agent registered last, once there is one.
+    auto agent() -> Agent {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait_for(lock, TIMEOUT, [this]() { return !agent_.owner.empty(); });
+        return agent_;
+    }
+
+    /*
+     * Asks agent for a passphrase as connmand does, and returns it, or the
+     * name of the error answered instead.
+     */
+    auto requestPassphrase(const Agent& agent) -> std::string {
+        GError* error = nullptr;
+        GVariant* reply = g_dbus_connection_call_sync(
+            conn_, agent.owner.c_str(), agent.path.c_str(), "net.connman.Agent",
+            "RequestInput",
+            g_variant_new("(o@a{sv})", WIFI_PATH,
+                          g_variant_new_parsed(PASSPHRASE_FIELDS)),
+            G_VARIANT_TYPE("(a{sv})"), G_DBUS_CALL_FLAGS_NONE,
+            static_cast<gint>(std::chrono::milliseconds(TIMEOUT).count()),
+            nullptr, &error);
+        if (reply == nullptr) {
+            gchar* name = g_dbus_error_get_remote_error(error);
+            std::string answer = name != nullptr ? name : error->message;
+            g_free(name);
+            g_error_free(error);
+            return answer;
+        }
+        const gchar* passphrase = nullptr;
+        GVariant* fields = g_variant_get_child_value(reply, 0);
+        std::string answer;
+        if (g_variant_lookup(fields, "Passphrase", "&s", &passphrase) != 0) {
+            answer = passphrase;
+        }
+        g_variant_unref(fields);
+        g_variant_unref(reply);
+        return answer;
+    }
+
+    // Announces count new Wi-Fi services after the one there is.
+    void addServices(std::size_t count) {
+        GVariantBuilder changed;
+        g_variant_builder_init(&changed, G_VARIANT_TYPE("a(oa{sv})"));
+        // Known services come without properties, only for the order.
+        g_variant_builder_add_parsed(&changed, "(%o, @a{sv} {})", WIFI_PATH);
+        for (std::size_t i = 0U; i < count; ++i) {
+            const auto path =
+                std::string("/net/connman/service/wifi_") + std::to_string(i);
+            g_variant_builder_add_parsed(
+                &changed,
+                "(%o, {'Name': <%s>, 'Type': <'wifi'>, 'State': <'idle'>})",
+                path.c_str(), path.c_str());
+        }
+        servicesChanged(g_variant_builder_end(&changed),
+                        g_variant_new_parsed("@ao []"));
+    }
+
+    // Takes the Wi-Fi service out of the list, or puts it back.
+    void removeWifi() {
+        servicesChanged(g_variant_new_parsed("@a(oa{sv}) []"),
+                        g_variant_new_parsed("[%o]", WIFI_PATH));
+    }
+    void restoreWifi() {
+        servicesChanged(
+            g_variant_new_parsed("[(%o, {'Name': <'wifi_a'>, "
+                                 "'Type': <'wifi'>, 'State': <'idle'>})]",
+                                 WIFI_PATH),
+            g_variant_new_parsed("@ao []"));
+    }
+
+    void wifiChanged(const gchar* key, GVariant* value) {
+        g_dbus_connection_emit_signal(conn_, nullptr, WIFI_PATH,
+                                      "net.connman.Service", "PropertyChanged",
+                                      g_variant_new("(sv)", key, value),
+                                      nullptr);
+    }
+
+   private:
+    GMainContext* ctx_;
+    GMainLoop* loop_;
+    GDBusConnection* conn_{nullptr};
+    GDBusNodeInfo* node_{nullptr};
+    std::vector<guint> registrations_;
+    std::thread thread_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    Agent agent_;
+
+    void servicesChanged(GVariant* changed, GVariant* removed) {
+        g_dbus_connection_emit_signal(
+            conn_, nullptr, MANAGER_PATH, MANAGER_INTERFACE, "ServicesChanged",
+            g_variant_new("(@a(oa{sv})@ao)", changed, removed), nullptr);
+    }
+
+    static void on_method_call(GDBusConnection* /*connection*/,
+                               const gchar* sender, const gchar* /*path*/,
+                               const gchar* /*interface*/,
+                               const gchar* method_name, GVariant* parameters,
+                               GDBusMethodInvocation* invocation,
+                               gpointer user_data) {
+        auto* self = static_cast<FakeConnman*>(user_data);
+        const std::string method(method_name);
+        if (method == "GetServices") {
+            g_dbus_method_invocation_return_value(
+                invocation,
+                g_variant_new_parsed("([(%o, {'Name': <'wifi_a'>, "
+                                     "'Type': <'wifi'>, 'State': <'idle'>})],)",
+                                     WIFI_PATH));
+        } else if (method == "GetTechnologies") {
+            g_dbus_method_invocation_return_value(
+                invocation, g_variant_new_parsed("(@a(oa{sv}) [],)"));
+        } else if (method == "GetProperties") {
+            g_dbus_method_invocation_return_value(
+                invocation, g_variant_new_parsed("(@a{sv} {},)"));
+        } else if (method == "RegisterAgent") {
+            const gchar* path = nullptr;
+            g_variant_get(parameters, "(&o)", &path);
+            {
+                std::lock_guard<std::mutex> const lock(self->mtx_);
+                self->agent_ = Agent{.owner = sender, .path = path};
+            }
+            self->cv_.notify_all();
+            g_dbus_method_invocation_return_value(invocation, nullptr);
+        } else {
+            g_dbus_method_invocation_return_value(invocation, nullptr);
+        }
+    }
+};
+
+class ManagerTest : public ::testing::Test {
+   protected:
+    static GTestDBus* bus_;
+    std::unique_ptr<FakeConnman> connmand_;
+    std::unique_ptr<Connman> connman_;
+    std::shared_ptr<Manager> manager_;
+
+    static void SetUpTestSuite() {
+        bus_ = g_test_dbus_new(G_TEST_DBUS_NONE);
+        g_test_dbus_up(bus_);
+        g_setenv("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address(bus_),
+                 TRUE);
+    }
+
+    static void TearDownTestSuite() {
+        g_test_dbus_down(bus_);
+        g_object_unref(bus_);
+    }
+
+    void SetUp() override {
+        connmand_ = std::make_unique<FakeConnman>();
+        connman_ = std::make_unique<Connman>();
+        manager_ = connman_->manager();
+        // GetServices is answered asynchronously.
+        ASSERT_TRUE(waitForServices(1U));
+    }
+
+    void TearDown() override {
+        manager_.reset();
+        connman_.reset();
+        connmand_.reset();
+    }
+
+    // Whether the Manager lists count services before long.
+    auto waitForServices(std::size_t count) -> bool {
+        const auto deadline = std::chrono::steady_clock::now() + TIMEOUT;
+        while (manager_->services().size() != count) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return true;
+    }
+
+    // Registers the internal agent and returns it as connmand sees it.
+    auto registerAgent() -> FakeConnman::Agent {
+        manager_->registerAgent(manager_->internalAgentPath());
+        return connmand_->agent();
+    }
+};
+
+GTestDBus* ManagerTest::bus_ = nullptr;
+
+}  // namespace
+
+TEST_F(ManagerTest, DestroyedWhileRequestInputRuns) {
+    std::promise<void> entered;
+    // Long enough to live on the heap, freed with the callback.
+    const std::string passphrase(64U, 'p');
+    manager_->onRequestInputPassphrase(
+        [&entered, passphrase](const std::shared_ptr<Service>& /*service*/) {
+            entered.set_value();
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            return std::make_pair(true, passphrase);
+        });
+    const auto agent = registerAgent();
+    auto answer = std::async(std::launch::async, [this, &agent]() {
+        return connmand_->requestPassphrase(agent);
+    });
+    entered.get_future().wait();
+
+    // The callback is still running on the agent worker meanwhile.
+    manager_.reset();
+    connman_.reset();
+    EXPECT_EQ(answer.get(), "net.connman.Agent.Error.Canceled");
+}
+
+TEST_F(ManagerTest, CallbacksSurviveARemoveAndReAdd) {
+    const auto wifi = manager_->services().front();
+    std::promise<ServProperties::State> changed;
+    wifi->onPropertyChanged([&changed](const ServProperties& properties) {
+        changed.set_value(properties.getState());
+    });
+
+    connmand_->removeWifi();
+    ASSERT_TRUE(waitForServices(0U));
+    connmand_->restoreWifi();
+    ASSERT_TRUE(waitForServices(1U));
+    ASSERT_EQ(manager_->services().front(), wifi);
+
+    connmand_->wifiChanged("State", g_variant_new_string("ready"));
+    auto state = changed.get_future();
+    ASSERT_EQ(state.wait_for(TIMEOUT), std::future_status::ready);
+    EXPECT_EQ(state.get(), ServProperties::State::Ready);
+}
+
+TEST_F(ManagerTest, KeptRepliesAreCanceledWithTheManager) {
+    std::promise<Manager::PassphraseReply> kept;
+    manager_->onRequestInputPassphraseAsync(
+        [&kept](const std::shared_ptr<Service>& /*service*/,
+                Manager::PassphraseReply reply) {
+            kept.set_value(std::move(reply));
+        });
+    const auto agent = registerAgent();
+    auto answer = std::async(std::launch::async, [this, &agent]() {
+        return connmand_->requestPassphrase(agent);
+    });
+    const auto reply = kept.get_future().get();
+    EXPECT_TRUE(reply.pending());
+
+    manager_.reset();
+    connman_.reset();
+    EXPECT_EQ(answer.get(), "net.connman.Agent.Error.Canceled");
+    // The transport is gone with the Manager: too late, nothing is sent.
+    EXPECT_FALSE(reply.pending());
+    reply.reply({true, "late"});
+    reply.cancel();
+}
+
+#ifdef AMARULA_DBUS_LOCK_STATS
+TEST_F(ManagerTest, ServicesChangedHoldsTheLockBriefly) {
+    static constexpr std::size_t ADDED = 200U;
+    std::mutex mtx;
+    std::condition_variable changed;
+    std::size_t services = 0U;
+    manager_->onServicesChanged([&](const Manager::ProxyList<Service>& list) {
+        {
+            std::lock_guard<std::mutex> const lock(mtx);
+            services = list.size();
+        }
+        changed.notify_all();
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    connmand_->addServices(ADDED);
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        ASSERT_TRUE(changed.wait_for(lock, TIMEOUT, [&]() {
+            return services == ADDED + 1U;
+        }));
+    }
+    const auto window = std::chrono::steady_clock::now() - start;
+
+    // Building the new proxies takes most of the window, but is done
+    // without the lock: it is only taken to publish them.
+    const auto stats = manager_->lockStats();
+    EXPECT_GT(stats.acquisitions, 0U);
+    EXPECT_LT(stats.max_hold * 4, window);
+}
+#endif
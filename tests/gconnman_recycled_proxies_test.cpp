@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "gconnman_recycled_proxies.hpp"
+
+using Amarula::DBus::G::Connman::RecycledProxies;
+
+namespace {
+
+// What the pool needs of a Service.
+struct FakeProxy {
+    std::string path;
+    std::string name;
+    std::function<void()> on_changed;
+
+    [[nodiscard]] auto objPath() const { return path; }
+    void retire() { on_changed = nullptr; }
+    void resetProperties() { name.clear(); }
+};
+
+using Pool = RecycledProxies<FakeProxy>;
+
+constexpr std::chrono::seconds TTL{120};
+
+auto proxy(const std::string& path) -> std::shared_ptr<FakeProxy> {
+    return std::make_shared<FakeProxy>(
+        FakeProxy{path, "connmantest", []() {}});
+}
+
+}  // namespace
+
+TEST(RecycledProxies, ReusesTheSameProxyForItsPath) {
+    Pool pool(4U, TTL);
+    const auto wifi = proxy("/net/connman/service/wifi_a");
+    pool.put(wifi);
+    pool.put(proxy("/net/connman/service/wifi_b"));
+
+    EXPECT_EQ(pool.take("/net/connman/service/wifi_c"), nullptr);
+    EXPECT_EQ(pool.take("/net/connman/service/wifi_a"), wifi);
+    // Taken out for good.
+    EXPECT_EQ(pool.take("/net/connman/service/wifi_a"), nullptr);
+    EXPECT_EQ(pool.size(), 1U);
+}
+
+TEST(RecycledProxies, KeepsCallbacksAcrossRemoveAndReAdd) {
+    Pool pool(4U, TTL);
+    auto wifi = proxy("/net/connman/service/wifi_a");
+    auto token = std::make_shared<int>(0);
+    const std::weak_ptr<int> watched = token;
+    wifi->on_changed = [token = std::move(token)]() {};
+    pool.put(wifi);
+
+    EXPECT_NE(wifi->on_changed, nullptr);
+    EXPECT_FALSE(watched.expired());
+    // Properties stay until the proxy comes back, then start over.
+    EXPECT_EQ(wifi->name, "connmantest");
+    const auto back = pool.take("/net/connman/service/wifi_a");
+    ASSERT_EQ(back, wifi);
+    EXPECT_TRUE(back->name.empty());
+    EXPECT_NE(back->on_changed, nullptr);
+    EXPECT_FALSE(watched.expired());
+}
+
+TEST(RecycledProxies, RetiresEvictedProxies) {
+    Pool pool(1U, TTL);
+    const auto start = Pool::Clock::now();
+    auto wifi = proxy("/a");
+    // The callback owns something that must go with it.
+    auto token = std::make_shared<int>(0);
+    const std::weak_ptr<int> watched = token;
+    wifi->on_changed = [token = std::move(token)]() {};
+    const auto expiring = proxy("/b");
+
+    pool.put(wifi, start);
+    pool.put(expiring, start);
+    EXPECT_EQ(wifi->on_changed, nullptr);
+    EXPECT_TRUE(watched.expired());
+
+    EXPECT_NE(expiring->on_changed, nullptr);
+    EXPECT_EQ(pool.take("/c", start + TTL + std::chrono::seconds(1)),
+              nullptr);
+    EXPECT_EQ(expiring->on_changed, nullptr);
+}
+
+TEST(RecycledProxies, DropsTheOldestBeyondCapacity) {
+    Pool pool(2U, TTL);
+    pool.put(proxy("/a"));
+    pool.put(proxy("/b"));
+    pool.put(proxy("/c"));
+    EXPECT_EQ(pool.size(), 2U);
+    EXPECT_EQ(pool.take("/a"), nullptr);
+    EXPECT_NE(pool.take("/c"), nullptr);
+}
+
+TEST(RecycledProxies, ExpiresAfterTtl) {
+    Pool pool(4U, TTL);
+    const auto start = Pool::Clock::now();
+    pool.put(proxy("/a"), start);
+    pool.put(proxy("/b"), start + TTL);
+    EXPECT_EQ(pool.take("/a", start + TTL + std::chrono::seconds(1)),
+              nullptr);
+    EXPECT_NE(pool.take("/b", start + TTL + std::chrono::seconds(1)),
+              nullptr);
+}
+
+TEST(RecycledProxies, ZeroCapacityDisablesThePool) {
+    Pool pool(4U, TTL);
+    pool.put(proxy("/a"));
+    pool.configure(0U, TTL);
+    EXPECT_EQ(pool.size(), 0U);
+
+    const auto dropped = proxy("/b");
+    pool.put(dropped);
+    // Nothing keeps it for its path to come back.
+    EXPECT_EQ(dropped->on_changed, nullptr);
+    EXPECT_EQ(pool.take("/b"), nullptr);
+}
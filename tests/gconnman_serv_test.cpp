@@ -2,19 +2,27 @@
 
 #include <amarula/dbus/connman/gconnman.hpp>
 #include <amarula/dbus/connman/gservice.hpp>
+#include <amarula/dbus/connman/gservicetable.hpp>
 #include <amarula/dbus/connman/gtechnology.hpp>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <map>
+#include <optional>
 #include <string>
 #include <utility>
 
 #include "thread_bundle.hpp"
 
 using Amarula::DBus::G::Connman::Connman;
+using Amarula::DBus::G::Connman::ServiceTable;
+using Amarula::DBus::G::PropertyList;
 
 using Error = Amarula::DBus::G::Connman::ServProperties::Error;
 using State = Amarula::DBus::G::Connman::ServProperties::State;
 using Type = Amarula::DBus::G::Connman::TechProperties::Type;
 using ServType = Amarula::DBus::G::Connman::ServProperties::Type;
+using Security = Amarula::DBus::G::Connman::ServProperties::Security;
 
 TEST(Connman, getServs) {
     bool called = false;
@@ -74,6 +82,108 @@ TEST(Connman, getServs) {
     ASSERT_TRUE(called) << "TechnologiesChanged callback was never called";
 }
 
+TEST(Connman, serviceTableMatchesServices) {
+    bool called = false;
+    {
+        const ThreadBundle thread_bundle;
+        const Connman connman;
+        const auto manager = connman.manager();
+
+        // Not the shared_ptr: the Manager keeps this callback.
+        manager->onServicesChanged([&called, manager = manager.get()](
+                                       const auto& services) {
+            called = true;
+            const auto table = manager->serviceTable();
+            ASSERT_EQ(table.size(), services.size());
+            for (std::size_t row = 0; row < table.size(); ++row) {
+                const auto props = services[row]->properties();
+                EXPECT_EQ(table.id(row), services[row]->id());
+                EXPECT_EQ(table.state(row), props.getState());
+                EXPECT_EQ(table.type(row), props.getType());
+                EXPECT_EQ(table.strength(row), props.getStrength());
+                EXPECT_EQ(manager->service(table.id(row)), services[row]);
+            }
+
+            const auto mask = table.matchState(State::Idle);
+            const auto rows = table.select(mask);
+            EXPECT_EQ(rows.size(), ServiceTable::count(mask));
+            for (const auto row : rows) {
+                EXPECT_EQ(table.state(row), State::Idle);
+            }
+        });
+    }
+    ASSERT_TRUE(called) << "ServicesChanged callback was never called";
+}
+
+TEST(Connman, lazyPropertiesMatchEager) {
+    struct Seen {
+        std::string name;
+        ServType type;
+        std::optional<PropertyList<Security>> security;
+    };
+    const auto collect = [](bool lazy) {
+        std::map<std::string, Seen> seen;
+        {
+            const ThreadBundle thread_bundle;
+            const Connman connman;
+            const auto manager = connman.manager();
+            manager->setLazyServiceProperties(lazy);
+            // Dicts received from now on are kept rather than decoded.
+            manager->onServicesChanged([&seen](const auto& services) {
+                for (const auto& serv : services) {
+                    const auto props = serv->properties();
+                    seen[serv->objPath()] = {props.getName(), props.getType(),
+                                             props.getSecurity()};
+                }
+            });
+        }
+        return seen;
+    };
+
+    const auto eager = collect(false);
+    if (eager.empty()) {
+        GTEST_SKIP() << "No connman services available";
+    }
+    const auto lazy = collect(true);
+    for (const auto& [path, seen] : lazy) {
+        const auto match = eager.find(path);
+        if (match == eager.end()) {
+            continue;  // appeared in between
+        }
+        EXPECT_EQ(seen.name, match->second.name) << path;
+        EXPECT_EQ(seen.type, match->second.type) << path;
+        EXPECT_EQ(seen.security, match->second.security) << path;
+    }
+}
+
+#ifdef AMARULA_DBUS_LOCK_STATS
+TEST(Connman, lockStatsCountAcquisitions) {
+    static constexpr uint64_t CALLS = 5U;
+    bool called = false;
+    {
+        const ThreadBundle thread_bundle;
+        const Connman connman;
+        const auto manager = connman.manager();
+
+        // Not the shared_ptr: the Manager keeps this callback.
+        manager->onServicesChanged([&called, manager = manager.get()](
+                                       const auto& /*services*/) {
+            called = true;
+            const auto before = manager->lockStats();
+            for (uint64_t i = 0U; i < CALLS; ++i) {
+                static_cast<void>(manager->services());
+            }
+            const auto after = manager->lockStats();
+            // Each services() locks once; signals may add to it meanwhile.
+            EXPECT_GE(after.acquisitions - before.acquisitions, CALLS);
+            EXPECT_GE(after.total_hold, before.total_hold);
+            EXPECT_LE(after.max_hold, after.total_hold);
+        });
+    }
+    ASSERT_TRUE(called) << "ServicesChanged callback was never called";
+}
+#endif
+
 TEST(Connman, setNameServers) {
     bool called = false;
     {
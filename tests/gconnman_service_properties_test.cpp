@@ -0,0 +1,138 @@
+#include <glib.h>
+#include <gtest/gtest.h>
+
+#include <amarula/dbus/connman/gservice.hpp>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "gconnman_private.hpp"
+#include "gdbus_private.hpp"
+
+using Amarula::DBus::G::VariantPtr;
+using Amarula::DBus::G::Connman::ServProperties;
+using Amarula::DBus::G::Connman::ServPropertiesDict;
+
+/*
+ * View mode against decoding right away, on dicts shaped like the ones
+ * connman sends for a Wi-Fi service, so that no connman is needed.
+ */
+namespace {
+
+constexpr auto WIFI =
+    "{'Name': <'home'>, 'Type': <'wifi'>, 'State': <'ready'>, "
+    "'Strength': <byte 62>, 'Favorite': <true>, 'AutoConnect': <false>, "
+    "'Immutable': <false>, 'mDNS': <true>, 'Security': <['psk', 'wps']>, "
+    "'Nameservers': <['192.0.2.1', '192.0.2.2']>, "
+    "'IPv4': <{'Method': <'dhcp'>, 'Address': <'192.0.2.10'>}>}";
+
+auto parsed(const char* text) -> VariantPtr {
+    return {g_variant_ref_sink(g_variant_new_parsed(text)), &g_variant_unref};
+}
+
+auto applied(bool lazy, const char* first, const char* second = nullptr)
+    -> ServProperties {
+    ServProperties properties;
+    ServPropertiesDict::apply(properties, parsed(first).get(), lazy);
+    if (second != nullptr) {
+        ServPropertiesDict::apply(properties, parsed(second).get(), lazy);
+    }
+    return properties;
+}
+
+void expect_same(const ServProperties& lazy, const ServProperties& eager) {
+    EXPECT_EQ(lazy.getName(), eager.getName());
+    EXPECT_EQ(lazy.getType(), eager.getType());
+    EXPECT_EQ(lazy.getState(), eager.getState());
+    EXPECT_EQ(lazy.getError(), eager.getError());
+    EXPECT_EQ(lazy.getStrength(), eager.getStrength());
+    EXPECT_EQ(lazy.isFavorite(), eager.isFavorite());
+    EXPECT_EQ(lazy.isAutoconnect(), eager.isAutoconnect());
+    EXPECT_EQ(lazy.isImmutable(), eager.isImmutable());
+    EXPECT_EQ(lazy.isMDNSEnabled(), eager.isMDNSEnabled());
+    EXPECT_EQ(lazy.getSecurity(), eager.getSecurity());
+    EXPECT_EQ(lazy.getNameservers(), eager.getNameservers());
+    EXPECT_EQ(lazy.getDomains(), eager.getDomains());
+    ASSERT_EQ(lazy.getIPv4().has_value(), eager.getIPv4().has_value());
+    if (lazy.getIPv4()) {
+        EXPECT_EQ(lazy.getIPv4()->getAddress(), eager.getIPv4()->getAddress());
+        EXPECT_EQ(lazy.getIPv4()->getMethod(), eager.getIPv4()->getMethod());
+    }
+}
+
+}  // namespace
+
+TEST(ServiceProperties, ViewModeMatchesDecoding) {
+    const auto lazy = applied(true, WIFI);
+    const auto eager = applied(false, WIFI);
+    expect_same(lazy, eager);
+
+    EXPECT_EQ(lazy.getName(), "home");
+    EXPECT_EQ(lazy.getType(), ServProperties::Type::Wifi);
+    EXPECT_EQ(lazy.getState(), ServProperties::State::Ready);
+    EXPECT_EQ(lazy.getStrength(), 62U);
+    EXPECT_TRUE(lazy.isFavorite());
+    EXPECT_FALSE(lazy.isAutoconnect());
+    EXPECT_TRUE(lazy.isMDNSEnabled());
+    ASSERT_TRUE(lazy.getNameservers().has_value());
+    EXPECT_EQ(lazy.getNameservers()->size(), 2U);
+    ASSERT_TRUE(lazy.getIPv4().has_value());
+    EXPECT_EQ(lazy.getIPv4()->getAddress(), "192.0.2.10");
+}
+
+TEST(ServiceProperties, PartialDictKeepsTheRest) {
+    constexpr auto UPDATE =
+        "{'State': <'online'>, 'Strength': <byte 40>, 'Favorite': <false>}";
+    const auto lazy = applied(true, WIFI, UPDATE);
+    expect_same(lazy, applied(false, WIFI, UPDATE));
+
+    EXPECT_EQ(lazy.getName(), "home");
+    EXPECT_EQ(lazy.getState(), ServProperties::State::Online);
+    EXPECT_EQ(lazy.getStrength(), 40U);
+    EXPECT_FALSE(lazy.isFavorite());
+    EXPECT_TRUE(lazy.isMDNSEnabled());
+}
+
+TEST(ServiceProperties, CopiesDecodeOnTheirOwn) {
+    const auto lazy = applied(true, WIFI);
+    const auto copy = lazy;
+    EXPECT_EQ(copy.getName(), "home");
+    EXPECT_EQ(copy.getSecurity(), lazy.getSecurity());
+    expect_same(copy, applied(false, WIFI));
+}
+
+TEST(ServiceProperties, WrongTypesAndUnknownValuesAreSkipped) {
+    constexpr auto ODD =
+        "{'Strength': <'strong'>, 'Favorite': <byte 1>, "
+        "'State': <'portal'>, 'Type': <uint32 1>, 'Flavour': <'mint'>}";
+    const auto lazy = applied(true, WIFI, ODD);
+    expect_same(lazy, applied(false, WIFI, ODD));
+
+    // Values of the wrong type leave the previous ones in place.
+    EXPECT_EQ(lazy.getStrength(), 62U);
+    EXPECT_TRUE(lazy.isFavorite());
+    EXPECT_EQ(lazy.getType(), ServProperties::Type::Wifi);
+    // States this library does not know yet are Unknown.
+    EXPECT_EQ(lazy.getState(), ServProperties::State::Unknown);
+}
+
+TEST(ServiceProperties, TemporariesReturnValues) {
+    static_assert(std::is_same_v<
+                  decltype(std::declval<const ServProperties&>().getName()),
+                  const std::string&>);
+    static_assert(
+        std::is_same_v<decltype(std::declval<ServProperties>().getName()),
+                       std::string>);
+
+    for (const auto lazy : {true, false}) {
+        // Bound to the value itself, not into the destroyed temporary.
+        const auto& name = applied(lazy, WIFI).getName();
+        const auto& servers = applied(lazy, WIFI).getNameservers();
+        const auto& ipv4 = applied(lazy, WIFI).getIPv4();
+        EXPECT_EQ(name, "home");
+        ASSERT_TRUE(servers.has_value());
+        EXPECT_EQ(servers->front().str(), "192.0.2.1");
+        ASSERT_TRUE(ipv4.has_value());
+        EXPECT_EQ(ipv4->getAddress(), "192.0.2.10");
+    }
+}
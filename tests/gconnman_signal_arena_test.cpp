@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+#include "gconnman_signal_arena.hpp"
+
+using Amarula::DBus::G::Connman::SignalArena;
+
+namespace {
+
+constexpr std::size_t SMALL_ARENA = 256U;
+
+auto fill(SignalArena& arena, std::size_t count) -> std::pmr::vector<int> {
+    std::pmr::vector<int> values{arena.resource()};
+    values.reserve(count);
+    values.resize(count, 1);
+    return values;
+}
+
+}  // namespace
+
+TEST(SignalArena, GrowsToTheLargestSignal) {
+    SignalArena arena{SMALL_ARENA};
+    {
+        const SignalArena::Scope scope(arena);
+        const auto values = fill(arena, SMALL_ARENA);
+        EXPECT_GT(arena.overflow(), 0U);
+    }
+    EXPECT_EQ(arena.overflow(), 0U);
+    {
+        // The same signal again fits in the grown buffer.
+        const SignalArena::Scope scope(arena);
+        const auto values = fill(arena, SMALL_ARENA);
+        EXPECT_EQ(arena.overflow(), 0U);
+    }
+}
+
+TEST(SignalArena, NestedScopesShareTheArena) {
+    SignalArena arena{SMALL_ARENA};
+    {
+        const SignalArena::Scope outer(arena);
+        const auto outer_values = fill(arena, 8U);
+        {
+            const SignalArena::Scope inner(arena);
+            const auto inner_values = fill(arena, SMALL_ARENA);
+        }
+        // Only the outermost scope releases the arena.
+        EXPECT_GT(arena.overflow(), 0U);
+        EXPECT_EQ(outer_values, std::pmr::vector<int>(8U, 1));
+    }
+    EXPECT_EQ(arena.overflow(), 0U);
+}
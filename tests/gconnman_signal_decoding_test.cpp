@@ -0,0 +1,297 @@
+#include <glib.h>
+#include <gtest/gtest.h>
+
+#include <amarula/dbus/gvariant_view.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gconnman_services_changed.hpp"
+#include "gdbus_private.hpp"
+
+using Amarula::DBus::G::VariantPtr;
+using Amarula::DBus::G::VariantView;
+using Amarula::DBus::G::Connman::decode_services_changed;
+using Amarula::DBus::G::Connman::decode_services_changed_in_place;
+using Amarula::DBus::G::Connman::ServicesChangedSignal;
+
+/*
+ * The in-place decoders against the GVariant ones, on random signals shaped
+ * like connman's, then on corrupted copies of them. The seed is fixed so that
+ * a failure can be replayed.
+ */
+namespace {
+
+constexpr std::mt19937::result_type SEED = 0x5eed;
+constexpr int ROUNDS = 300;
+constexpr int CORRUPTIONS = 20;
+constexpr int MAX_DEPTH = 2;
+
+class Generator {
+   public:
+    explicit Generator(std::mt19937::result_type seed) : rng_{seed} {}
+
+    auto below(std::size_t bound) -> std::size_t {
+        return std::uniform_int_distribution<std::size_t>{0U,
+                                                          bound - 1U}(rng_);
+    }
+
+    auto string() -> std::string {
+        static constexpr std::array<const char*, 8> PIECES{
+            "a", "Z", "7", "_", " ", "-", "\xc3\xa4", "\xe2\x82\xac"};
+        std::string str;
+        for (auto count = below(24U); count > 0U; --count) {
+            str += PIECES[below(PIECES.size())];
+        }
+        return str;
+    }
+
+    auto path() -> std::string {
+        static constexpr std::string_view CHARS = "abcdef0123456789_";
+        std::string path = "/net/connman/service/wifi_";
+        for (auto count = 1U + below(48U); count > 0U; --count) {
+            path += CHARS[below(CHARS.size())];
+        }
+        return path;
+    }
+
+    // A value of one of the types connman puts in its dicts.
+    auto value(int depth) -> GVariant* {
+        switch (below(depth < MAX_DEPTH ? 11U : 10U)) {
+            case 0:
+                return g_variant_new_boolean(static_cast<gboolean>(below(2U)));
+            case 1:
+                return g_variant_new_byte(static_cast<guint8>(below(256U)));
+            case 2:
+                return g_variant_new_uint16(static_cast<guint16>(below(9000U)));
+            case 3:
+                return g_variant_new_int32(static_cast<gint32>(below(90000U)) -
+                                           45000);
+            case 4:
+                return g_variant_new_uint32(static_cast<guint32>(rng_()));
+            case 5:
+                return g_variant_new_uint64(static_cast<guint64>(rng_()) << 8U);
+            case 6:
+                return g_variant_new_string(string().c_str());
+            case 7:
+                return g_variant_new_object_path(path().c_str());
+            case 8: {
+                GVariantBuilder builder;
+                g_variant_builder_init(&builder, G_VARIANT_TYPE("as"));
+                for (auto count = below(5U); count > 0U; --count) {
+                    g_variant_builder_add(&builder, "s", string().c_str());
+                }
+                return g_variant_builder_end(&builder);
+            }
+            case 9: {
+                const auto ssid = string();
+                return g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE,
+                                                 ssid.data(), ssid.size(),
+                                                 sizeof(guchar));
+            }
+            default:
+                return dict(depth + 1);
+        }
+    }
+
+    auto dict(int depth) -> GVariant* {
+        GVariantBuilder builder;
+        g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+        for (auto count = below(9U); count > 0U; --count) {
+            g_variant_builder_add(&builder, "{sv}", string().c_str(),
+                                  value(depth));
+        }
+        return g_variant_builder_end(&builder);
+    }
+
+    // Mostly order-only entries, now and then enough to need wide offsets.
+    auto servicesChanged() -> GVariant* {
+        const auto services = below(8U) == 0U ? 300U + below(300U) : below(40U);
+        GVariantBuilder changed;
+        g_variant_builder_init(&changed, G_VARIANT_TYPE("a(oa{sv})"));
+        for (auto count = services; count > 0U; --count) {
+            GVariant* properties = below(4U) == 0U ? dict(0) : empty_dict();
+            g_variant_builder_add(&changed, "(o@a{sv})", path().c_str(),
+                                  properties);
+        }
+        GVariantBuilder removed;
+        g_variant_builder_init(&removed, G_VARIANT_TYPE("ao"));
+        for (auto count = below(12U); count > 0U; --count) {
+            g_variant_builder_add(&removed, "o", path().c_str());
+        }
+        return g_variant_new("(@a(oa{sv})@ao)",
+                             g_variant_builder_end(&changed),
+                             g_variant_builder_end(&removed));
+    }
+
+    auto propertyChanged() -> GVariant* {
+        return g_variant_new("(sv)", string().c_str(), value(0));
+    }
+
+    // A copy of the data of value with bytes changed or cut off.
+    auto corrupted(GVariant* value) -> VariantPtr {
+        std::vector<guint8> data(g_variant_get_size(value));
+        std::memcpy(data.data(), g_variant_get_data(value), data.size());
+        if (!data.empty()) {
+            for (auto count = 1U + below(4U); count > 0U; --count) {
+                data[below(data.size())] = static_cast<guint8>(rng_());
+            }
+            if (below(4U) == 0U) {
+                data.resize(below(data.size()));
+            }
+        }
+        auto* bytes = g_bytes_new(data.data(), data.size());
+        VariantPtr copy{g_variant_ref_sink(g_variant_new_from_bytes(
+                            g_variant_get_type(value), bytes, FALSE)),
+                        &g_variant_unref};
+        g_bytes_unref(bytes);
+        return copy;
+    }
+
+   private:
+    std::mt19937 rng_;
+
+    static auto empty_dict() -> GVariant* {
+        return g_variant_new_array(G_VARIANT_TYPE("{sv}"), nullptr, 0U);
+    }
+};
+
+auto owned(GVariant* value) -> VariantPtr {
+    return {g_variant_ref_sink(value), &g_variant_unref};
+}
+
+// What the signal filter does to the parameters.
+auto flatten(GVariant* value) -> GVariant* {
+    static_cast<void>(g_variant_get_data(value));
+    return value;
+}
+
+void expect_same(const ServicesChangedSignal& expected,
+                 const ServicesChangedSignal& actual) {
+    ASSERT_EQ(expected.changed.size(), actual.changed.size());
+    for (std::size_t i = 0; i < expected.changed.size(); ++i) {
+        const auto& want = expected.changed[i];
+        const auto& got = actual.changed[i];
+        EXPECT_EQ(want.path, got.path);
+        ASSERT_EQ(static_cast<bool>(want.properties),
+                  static_cast<bool>(got.properties))
+            << want.path;
+        if (want.properties) {
+            EXPECT_TRUE(g_variant_equal(want.properties.get(),
+                                        got.properties.get()) != 0)
+                << want.path;
+        }
+    }
+    EXPECT_EQ(expected.removed, actual.removed);
+}
+
+// The name and the value DBusProxy reads in place from a PropertyChanged.
+void expect_same_property_change(GVariant* parameters) {
+    const auto members =
+        VariantView::of(parameters).pair(VariantView::VARIANT_ALIGNMENT);
+    ASSERT_TRUE(members.has_value());
+    const auto key = members->first.asString();
+    const auto boxed = members->second.asVariant();
+    ASSERT_TRUE(key.has_value());
+    ASSERT_TRUE(boxed.has_value());
+
+    const gchar* expected_key = nullptr;
+    GVariant* expected_value = nullptr;
+    g_variant_get(parameters, "(&sv)", &expected_key, &expected_value);
+    const VariantPtr value{expected_value, &g_variant_unref};
+    EXPECT_EQ(*key, expected_key);
+    EXPECT_EQ(key->data()[key->size()], '\0');
+    EXPECT_EQ(boxed->type, g_variant_get_type_string(value.get()));
+    ASSERT_EQ(boxed->value.size(), g_variant_get_size(value.get()));
+    if (boxed->value.size() != 0U) {
+        EXPECT_EQ(std::memcmp(boxed->value.data(),
+                              g_variant_get_data(value.get()),
+                              boxed->value.size()),
+                  0);
+    }
+}
+
+}  // namespace
+
+TEST(SignalDecoding, ServicesChangedInPlaceMatchesGVariant) {
+    Generator generator{SEED};
+    for (int round = 0; round < ROUNDS; ++round) {
+        const auto parameters = owned(flatten(generator.servicesChanged()));
+        const auto expected = decode_services_changed(parameters.get());
+        const auto actual = decode_services_changed_in_place(parameters.get());
+        ASSERT_TRUE(actual.has_value()) << "round " << round;
+        expect_same(expected, *actual);
+    }
+}
+
+// Without the filter the parameters are still a tree, serialised on demand.
+TEST(SignalDecoding, ServicesChangedInPlaceTakesTreeParameters) {
+    Generator generator{SEED + 1U};
+    for (int round = 0; round < ROUNDS / 10; ++round) {
+        const auto parameters = owned(generator.servicesChanged());
+        const auto actual = decode_services_changed_in_place(parameters.get());
+        ASSERT_TRUE(actual.has_value()) << "round " << round;
+        expect_same(decode_services_changed(parameters.get()), *actual);
+    }
+}
+
+TEST(SignalDecoding, ServicesChangedInPlaceLeavesOtherShapesToGVariant) {
+    const auto property = owned(
+        g_variant_new("(sv)", "State", g_variant_new_string("online")));
+    EXPECT_FALSE(decode_services_changed_in_place(property.get()));
+
+    const auto technology = owned(g_variant_new(
+        "(oa{sv})", "/net/connman/technology/wifi", nullptr));
+    EXPECT_FALSE(decode_services_changed_in_place(technology.get()));
+}
+
+/*
+ * Corrupted data must never be read out of bounds (run under ASan to see
+ * that), and where it still is a valid signal both decoders must agree.
+ */
+TEST(SignalDecoding, ServicesChangedInPlaceSurvivesCorruptData) {
+    Generator generator{SEED + 2U};
+    for (int round = 0; round < ROUNDS / 3; ++round) {
+        const auto parameters = owned(flatten(generator.servicesChanged()));
+        for (int corruption = 0; corruption < CORRUPTIONS; ++corruption) {
+            const auto copy = generator.corrupted(parameters.get());
+            const auto actual = decode_services_changed_in_place(copy.get());
+            if (g_variant_is_normal_form(copy.get()) != 0) {
+                ASSERT_TRUE(actual.has_value()) << "round " << round;
+                expect_same(decode_services_changed(copy.get()), *actual);
+            }
+        }
+    }
+}
+
+TEST(SignalDecoding, PropertyChangedInPlaceMatchesGVariant) {
+    Generator generator{SEED + 3U};
+    for (int round = 0; round < ROUNDS; ++round) {
+        const auto parameters = owned(flatten(generator.propertyChanged()));
+        expect_same_property_change(parameters.get());
+    }
+}
+
+TEST(SignalDecoding, PropertyChangedInPlaceSurvivesCorruptData) {
+    Generator generator{SEED + 4U};
+    for (int round = 0; round < ROUNDS; ++round) {
+        const auto parameters = owned(flatten(generator.propertyChanged()));
+        for (int corruption = 0; corruption < CORRUPTIONS; ++corruption) {
+            const auto copy = generator.corrupted(parameters.get());
+            if (g_variant_is_normal_form(copy.get()) != 0) {
+                expect_same_property_change(copy.get());
+            } else {
+                const auto members = VariantView::of(copy.get())
+                                         .pair(VariantView::VARIANT_ALIGNMENT);
+                if (members) {
+                    static_cast<void>(members->first.asString());
+                    static_cast<void>(members->second.asVariant());
+                }
+            }
+        }
+    }
+}
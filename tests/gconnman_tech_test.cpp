@@ -39,6 +39,27 @@ TEST(Connman, getTechs) {
     ASSERT_TRUE(called) << "TechnologiesChanged callback was never called";
 }
 
+TEST(Connman, technologyByType) {
+    bool called = false;
+    {
+        const ThreadBundle thread_bundle;
+        Connman connman;
+        const auto manager = connman.manager();
+
+        // Not the shared_ptr: the Manager keeps this callback.
+        manager->onTechnologiesChanged(
+            [&called, manager = manager.get()](const auto& technologies) {
+                called = true;
+                ASSERT_FALSE(technologies.empty());
+                for (const auto& tech : technologies) {
+                    const auto type = tech->properties().getType();
+                    EXPECT_EQ(manager->technology(type), tech);
+                }
+            });
+    }
+    ASSERT_TRUE(called) << "TechnologiesChanged callback was never called";
+}
+
 TEST(Connman, PowerOnAllTechnologies) {
     bool called = false;
 
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "gdbus_private.hpp"
+
+using namespace Amarula::DBus::G;
+
+namespace {
+
+enum class State : uint8_t {
+    Idle = 0,
+    Failure,
+    Ready,
+    Online,
+    Disconnect,
+    Association,
+    Configuration,
+    Unknown
+};
+
+constexpr EnumStringMap<State, 7> STATE_MAP{
+    {{{State::Association, "association"},
+      {State::Configuration, "configuration"},
+      {State::Disconnect, "disconnect"},
+      {State::Failure, "failure"},
+      {State::Idle, "idle"},
+      {State::Online, "online"},
+      {State::Ready, "ready"}}}};
+
+enum class Privacy : uint8_t { Disabled = 0, Enabled, Preferred, Unknown };
+
+constexpr EnumStringMap<Privacy, 4> PRIVACY_MAP{
+    {{{Privacy::Disabled, "disabled"},
+      {Privacy::Enabled, "enabled"},
+      {Privacy::Preferred, "preferred"},
+      {Privacy::Preferred, "prefered"}}}};
+
+// Lookups are usable in constant expressions.
+static_assert(STATE_MAP.fromString("online") == State::Online);
+static_assert(!STATE_MAP.fromString("onlin").has_value());
+
+}  // namespace
+
+TEST(EnumStringMap, RoundTrip) {
+    constexpr std::array<State, 7> states{
+        State::Idle,       State::Failure,     State::Ready,
+        State::Online,     State::Disconnect,  State::Association,
+        State::Configuration};
+    for (const auto state : states) {
+        const auto name = STATE_MAP.toString(state);
+        EXPECT_EQ(STATE_MAP.fromString(name), state) << name;
+    }
+}
+
+TEST(EnumStringMap, UnknownStringsDoNotThrow) {
+    for (const std::string_view name :
+         {"", "Online", "online ", "0nline", "portal", "idl"}) {
+        std::optional<State> state;
+        EXPECT_NO_THROW(state = STATE_MAP.fromString(name)) << name;
+        EXPECT_FALSE(state.has_value()) << name;
+    }
+    EXPECT_EQ(STATE_MAP.fromString("portal").value_or(State::Unknown),
+              State::Unknown);
+    EXPECT_EQ(STATE_MAP.toString(State::Unknown),
+              (EnumStringMap<State, 7>::UNKNOWN_STR));
+}
+
+TEST(EnumStringMap, SeveralStringsForOneValue) {
+    EXPECT_EQ(PRIVACY_MAP.fromString("preferred"), Privacy::Preferred);
+    EXPECT_EQ(PRIVACY_MAP.fromString("prefered"), Privacy::Preferred);
+    EXPECT_EQ(PRIVACY_MAP.toString(Privacy::Preferred), "preferred");
+}
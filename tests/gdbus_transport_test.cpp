@@ -0,0 +1,430 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <gtest/gtest.h>
+
+#include <amarula/dbus/gdbus.hpp>
+#include <amarula/dbus/gproxy.hpp>
+#include <amarula/dbus/gtransport.hpp>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using Amarula::DBus::G::DBus;
+using Amarula::DBus::G::DBusProxy;
+using Amarula::DBus::G::Transport;
+using Amarula::DBus::G::TransportKind;
+
+namespace {
+
+constexpr const char* BUS_NAME = "org.freedesktop.DBus";
+constexpr const char* BUS_PATH = "/org/freedesktop/DBus";
+constexpr const char* TEST_NAME = "org.example.TransportTest";
+constexpr const char* TEST_PATH = "/org/example/TransportTest";
+constexpr const char* TEST_INTERFACE = "org.example.TransportTest";
+
+constexpr const char* TEST_XML =
+    "<node>"
+    "  <interface name='org.example.TransportTest'>"
+    "    <method name='Echo'>"
+    "      <arg type='a{sv}' name='dict' direction='in'/>"
+    "      <arg type='ay' name='bytes' direction='in'/>"
+    "      <arg type='(sobd)' name='tuple' direction='in'/>"
+    "      <arg type='a{sv}' name='dict' direction='out'/>"
+    "      <arg type='ay' name='bytes' direction='out'/>"
+    "      <arg type='(sobd)' name='tuple' direction='out'/>"
+    "    </method>"
+    "    <method name='Fail'/>"
+    "    <method name='ReplyLater'>"
+    "      <arg type='u' name='value' direction='in'/>"
+    "      <arg type='u' name='value' direction='out'/>"
+    "    </method>"
+    "    <method name='Stall'/>"
+    "  </interface>"
+    "</node>";
+
+auto owned(GVariant* value) -> std::unique_ptr<GVariant, void (*)(GVariant*)> {
+    return {value != nullptr ? g_variant_ref_sink(value) : nullptr,
+            [](GVariant* value) {
+                if (value != nullptr) {
+                    g_variant_unref(value);
+                }
+            }};
+}
+
+// What a call() got back: the reply, or the error name and message.
+struct Reply {
+    std::unique_ptr<GVariant, void (*)(GVariant*)> value{owned(nullptr)};
+    std::string error_name;
+    std::string error_message;
+    bool cancelled{false};
+};
+
+/*
+ * Every transport built in, each with a DBus of its own on a private
+ * dbus-daemon standing in for the system bus.
+ */
+class TransportTest : public ::testing::TestWithParam<TransportKind> {
+   protected:
+    static GTestDBus* bus_;
+    std::unique_ptr<DBus> dbus_;
+
+    static void SetUpTestSuite() {
+        bus_ = g_test_dbus_new(G_TEST_DBUS_NONE);
+        g_test_dbus_up(bus_);
+        g_setenv("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address(bus_),
+                 TRUE);
+    }
+
+    static void TearDownTestSuite() {
+        g_test_dbus_down(bus_);
+        g_object_unref(bus_);
+    }
+
+    void SetUp() override {
+        if (!Transport::available(GetParam())) {
+            GTEST_SKIP() << "Transport not built in";
+        }
+        dbus_ = std::make_unique<DBus>(BUS_NAME, BUS_PATH, GetParam());
+    }
+
+    void TearDown() override { dbus_.reset(); }
+
+    auto transport() -> Transport& { return dbus_->transport(); }
+
+    // Runs function on the D-Bus thread and waits for it.
+    void on_dbus_thread(const std::function<void()>& function) {
+        std::promise<void> done;
+        auto finished = done.get_future();
+        auto task = [&]() {
+            function();
+            done.set_value();
+        };
+        std::function<void()> run = task;
+        g_main_context_invoke(
+            dbus_->context(),
+            [](gpointer user_data) -> gboolean {
+                (*static_cast<std::function<void()>*>(user_data))();
+                return G_SOURCE_REMOVE;
+            },
+            &run);
+        finished.wait();
+    }
+
+    // A call() issued from the D-Bus thread, as DBusProxy does.
+    auto call(const gchar* name, const gchar* path, const gchar* interface,
+              const gchar* method, GVariant* parameters,
+              GCancellable* cancellable = nullptr) -> Reply {
+        std::promise<Reply> replied;
+        auto reply = replied.get_future();
+        on_dbus_thread([&]() {
+            transport().call(
+                name, path, interface, method, parameters, cancellable,
+                [](GVariant* value, const GError* error, gpointer user_data) {
+                    Reply reply;
+                    if (value != nullptr) {
+                        reply.value = owned(g_variant_ref(value));
+                    } else {
+                        gchar* name = g_dbus_error_get_remote_error(error);
+                        reply.error_name = name != nullptr ? name : "";
+                        reply.error_message = error->message;
+                        reply.cancelled =
+                            g_error_matches(error, G_IO_ERROR,
+                                            G_IO_ERROR_CANCELLED) != 0;
+                        g_free(name);
+                    }
+                    static_cast<std::promise<Reply>*>(user_data)->set_value(
+                        std::move(reply));
+                },
+                &replied);
+        });
+        return reply.get();
+    }
+
+    // Takes TEST_NAME for the connection of dbus_.
+    void request_name() {
+        const auto reply = call(BUS_NAME, BUS_PATH, BUS_NAME, "RequestName",
+                                g_variant_new("(su)", TEST_NAME, 0U));
+        ASSERT_NE(reply.value, nullptr) << reply.error_message;
+    }
+};
+
+GTestDBus* TransportTest::bus_ = nullptr;
+
+// A connection of its own, for the other end of the calls and signals.
+auto peer() -> std::unique_ptr<GDBusConnection, void (*)(gpointer)> {
+    GDBusConnection* connection = g_dbus_connection_new_for_address_sync(
+        g_getenv("DBUS_SYSTEM_BUS_ADDRESS"),
+        static_cast<GDBusConnectionFlags>(
+            G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+            G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+        nullptr, nullptr, nullptr);
+    return {connection, &g_object_unref};
+}
+
+/*
+ * Serves TEST_XML: Echo answers with its arguments, Fail with an error. Stall
+ * does not answer until the test does.
+ */
+struct TestObject {
+    Transport* transport;
+    GDBusNodeInfo* node{g_dbus_node_info_new_for_xml(TEST_XML, nullptr)};
+    guint id{0U};
+    Transport::Invocation* stalled{nullptr};
+    std::promise<void> stall;
+
+    TestObject(const TestObject&) = delete;
+    auto operator=(const TestObject&) -> TestObject& = delete;
+    TestObject(TestObject&&) = delete;
+    auto operator=(TestObject&&) -> TestObject& = delete;
+
+    explicit TestObject(Transport* transport) : transport{transport} {}
+    ~TestObject() { g_dbus_node_info_unref(node); }
+
+    static void on_method_call(const gchar* method_name, GVariant* parameters,
+                               Transport::Invocation* invocation,
+                               gpointer user_data) {
+        auto* object = static_cast<TestObject*>(user_data);
+        const std::string method = method_name;
+        if (method == "Echo") {
+            object->transport->returnValue(invocation, parameters);
+        } else if (method == "ReplyLater") {
+            // Answered from another thread, as the Agent does.
+            std::thread([object, invocation,
+                         value = owned(g_variant_ref(parameters))]() {
+                object->transport->returnValue(invocation, value.get());
+            }).join();
+        } else if (method == "Stall") {
+            object->stalled = invocation;
+            object->stall.set_value();
+        } else {
+            object->transport->returnError(
+                invocation, "org.example.TransportTest.Error.Failed", "Nope");
+        }
+    }
+};
+
+// Calls TEST_INTERFACE.method of dbus_ from a peer, blocking.
+auto peer_call(GDBusConnection* connection, const gchar* interface,
+               const gchar* method, GVariant* parameters, GError** error)
+    -> std::unique_ptr<GVariant, void (*)(GVariant*)> {
+    return owned(g_dbus_connection_call_sync(
+        connection, TEST_NAME, TEST_PATH, interface, method, parameters,
+        nullptr, G_DBUS_CALL_FLAGS_NONE, -1, nullptr, error));
+}
+
+// The least a proxy needs of its properties.
+struct NoProperties {
+    void update(const gchar* /*key*/, GVariant* /*value*/) {}
+};
+
+// Subscribed to PropertyChanged of TEST_PATH as long as it lives.
+class TestProxy : public DBusProxy<NoProperties> {
+   public:
+    explicit TestProxy(DBus* dbus)
+        : DBusProxy(dbus, TEST_NAME, TEST_PATH, TEST_INTERFACE) {}
+};
+
+}  // namespace
+
+TEST_P(TransportTest, Kind) { EXPECT_EQ(transport().kind(), GetParam()); }
+
+TEST_P(TransportTest, CallSucceeds) {
+    const auto reply = call(BUS_NAME, BUS_PATH, BUS_NAME, "GetId", nullptr);
+    ASSERT_NE(reply.value, nullptr) << reply.error_message;
+    EXPECT_STREQ(g_variant_get_type_string(reply.value.get()), "(s)");
+}
+
+TEST_P(TransportTest, CallFailsWithRemoteError) {
+    const auto reply =
+        call(BUS_NAME, BUS_PATH, BUS_NAME, "NoSuchMethod", nullptr);
+    EXPECT_EQ(reply.value, nullptr);
+    EXPECT_EQ(reply.error_name, "org.freedesktop.DBus.Error.UnknownMethod");
+}
+
+TEST_P(TransportTest, ExportedObjectRoundTripsBodies) {
+    TestObject object(&transport());
+    on_dbus_thread([&]() {
+        object.id = transport().exportObject(
+            TEST_PATH, object.node->interfaces[0], &TestObject::on_method_call,
+            &object, nullptr);
+    });
+    ASSERT_NE(object.id, 0U);
+    request_name();
+
+    const auto parameters = owned(g_variant_new_parsed(
+        "({'Name': <'wifi'>, 'Strength': <byte 73>, 'Nested': <@a{sv} "
+        "{'IPv4': <['10.0.0.1', '10.0.0.2']>}>}, "
+        "b'\\x00\\x01\\xff', ('ssid', objectpath '/net/connman/service/x', "
+        "true, 2.5))"));
+    auto connection = peer();
+    GError* error = nullptr;
+    const auto echoed = peer_call(connection.get(), TEST_INTERFACE, "Echo",
+                                  g_variant_ref(parameters.get()), &error);
+    ASSERT_NE(echoed, nullptr) << error->message;
+    EXPECT_TRUE(g_variant_equal(echoed.get(), parameters.get()));
+
+    const auto later = peer_call(connection.get(), TEST_INTERFACE,
+                                 "ReplyLater", g_variant_new("(u)", 7U),
+                                 &error);
+    ASSERT_NE(later, nullptr) << error->message;
+    guint32 value = 0U;
+    g_variant_get(later.get(), "(u)", &value);
+    EXPECT_EQ(value, 7U);
+
+    EXPECT_EQ(peer_call(connection.get(), TEST_INTERFACE, "Fail", nullptr,
+                        &error),
+              nullptr);
+    ASSERT_NE(error, nullptr);
+    gchar* name = g_dbus_error_get_remote_error(error);
+    EXPECT_STREQ(name, "org.example.TransportTest.Error.Failed");
+    g_free(name);
+    g_clear_error(&error);
+
+    // Checked against the interface info whatever the transport.
+    EXPECT_EQ(peer_call(connection.get(), TEST_INTERFACE, "Echo",
+                        g_variant_new("(u)", 1U), &error),
+              nullptr);
+    ASSERT_NE(error, nullptr);
+    name = g_dbus_error_get_remote_error(error);
+    EXPECT_STREQ(name, "org.freedesktop.DBus.Error.InvalidArgs");
+    g_free(name);
+    g_clear_error(&error);
+
+    const auto xml =
+        peer_call(connection.get(), "org.freedesktop.DBus.Introspectable",
+                  "Introspect", nullptr, &error);
+    ASSERT_NE(xml, nullptr) << error->message;
+    const gchar* data = nullptr;
+    g_variant_get(xml.get(), "(&s)", &data);
+    EXPECT_NE(std::string(data).find("org.example.TransportTest"),
+              std::string::npos);
+
+    transport().unexportObject(object.id);
+    EXPECT_EQ(peer_call(connection.get(), TEST_INTERFACE, "Fail", nullptr,
+                        &error),
+              nullptr);
+    g_clear_error(&error);
+}
+
+TEST_P(TransportTest, CancelledCallFailsRightAway) {
+    TestObject object(&transport());
+    on_dbus_thread([&]() {
+        object.id = transport().exportObject(
+            TEST_PATH, object.node->interfaces[0], &TestObject::on_method_call,
+            &object, nullptr);
+    });
+    ASSERT_NE(object.id, 0U);
+    request_name();
+
+    // Cancelled once Stall is being served, long before the call times out.
+    GCancellable* cancellable = g_cancellable_new();
+    auto stalled = object.stall.get_future();
+    auto cancelling = std::async(std::launch::async, [&]() {
+        stalled.wait();
+        g_cancellable_cancel(cancellable);
+    });
+    const auto start = std::chrono::steady_clock::now();
+    const auto reply = call(TEST_NAME, TEST_PATH, TEST_INTERFACE, "Stall",
+                            nullptr, cancellable);
+    EXPECT_LT(std::chrono::steady_clock::now() - start,
+              std::chrono::seconds(5));
+    EXPECT_EQ(reply.value, nullptr);
+    EXPECT_TRUE(reply.cancelled) << reply.error_message;
+    cancelling.get();
+
+    // The late answer goes nowhere, and calls go on.
+    transport().returnError(object.stalled,
+                            "org.example.TransportTest.Error.Failed", "Late");
+    EXPECT_NE(call(BUS_NAME, BUS_PATH, BUS_NAME, "GetId", nullptr).value,
+              nullptr);
+    transport().unexportObject(object.id);
+    g_object_unref(cancellable);
+}
+
+TEST_P(TransportTest, SubscribedSignalsArrive) {
+    struct Received {
+        std::promise<std::string> body;
+    } received;
+
+    transport().setFlatSignals({"PropertyChanged"});
+    EXPECT_TRUE(transport().flatSignal("PropertyChanged"));
+    EXPECT_FALSE(transport().flatSignal("ServicesChanged"));
+
+    auto connection = peer();
+    guint id = 0U;
+    on_dbus_thread([&]() {
+        id = transport().subscribe(
+            g_dbus_connection_get_unique_name(connection.get()),
+            TEST_INTERFACE, "PropertyChanged", TEST_PATH,
+            [](const gchar* /*signal_name*/, GVariant* parameters,
+               gpointer user_data) {
+                auto* received = static_cast<Received*>(user_data);
+                gchar* text = g_variant_print(parameters, FALSE);
+                received->body.set_value(text);
+                g_free(text);
+            },
+            &received);
+    });
+    EXPECT_NE(id, 0U);
+    // The match is in place once a later call is answered.
+    ASSERT_NE(call(BUS_NAME, BUS_PATH, BUS_NAME, "GetId", nullptr).value,
+              nullptr);
+
+    auto body = received.body.get_future();
+    ASSERT_NE(g_dbus_connection_emit_signal(
+                  connection.get(), nullptr, TEST_PATH, TEST_INTERFACE,
+                  "PropertyChanged",
+                  g_variant_new_parsed("('State', <'online'>)"), nullptr),
+              0);
+    g_dbus_connection_flush_sync(connection.get(), nullptr, nullptr);
+    EXPECT_EQ(body.get(), "('State', <'online'>)");
+
+    transport().unsubscribe(id);
+}
+
+TEST_P(TransportTest, DroppingAProxyDoesNotWaitForTheDBusThread) {
+    auto proxy = std::make_shared<TestProxy>(dbus_.get());
+
+    // Held by the thread dropping the proxy, as the Manager holds its list
+    // lock, while a D-Bus callback waits for it.
+    std::mutex manager_lock;
+    std::promise<void> locked;
+    std::promise<void> dbus_thread_waiting;
+    auto dropping = std::async(std::launch::async, [&]() {
+        std::lock_guard<std::mutex> const lock(manager_lock);
+        locked.set_value();
+        dbus_thread_waiting.get_future().wait();
+        proxy.reset();
+    });
+    locked.get_future().wait();
+
+    std::function<void()> wait_for_lock = [&]() {
+        dbus_thread_waiting.set_value();
+        std::lock_guard<std::mutex> const lock(manager_lock);
+    };
+    g_main_context_invoke(
+        dbus_->context(),
+        [](gpointer user_data) -> gboolean {
+            (*static_cast<std::function<void()>*>(user_data))();
+            return G_SOURCE_REMOVE;
+        },
+        &wait_for_lock);
+
+    EXPECT_EQ(dropping.wait_for(std::chrono::seconds(5)),
+              std::future_status::ready);
+    dropping.get();
+    // The D-Bus thread got the lock and goes on.
+    EXPECT_NE(call(BUS_NAME, BUS_PATH, BUS_NAME, "GetId", nullptr).value,
+              nullptr);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Transports, TransportTest,
+    ::testing::Values(TransportKind::GDBus, TransportKind::SdBus),
+    [](const ::testing::TestParamInfo<TransportKind>& info) -> std::string {
+        return info.param == TransportKind::GDBus ? "GDBus" : "SdBus";
+    });
@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+
+#include <amarula/dbus/ginterned.hpp>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Amarula::DBus::G::InternedString;
+
+TEST(InternedString, EqualStringsShareStorage) {
+    const std::string server = "8.8.8.8";
+    const InternedString first{server};
+    const InternedString second{std::string{"8.8."} + "8.8"};
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(&first.str(), &second.str());
+    EXPECT_EQ(first, "8.8.8.8");
+    EXPECT_NE(first, InternedString{"8.8.4.4"});
+}
+
+TEST(InternedString, EmptyNeedsNoPoolEntry) {
+    const auto before = InternedString::poolSize();
+    const InternedString empty{""};
+    EXPECT_TRUE(empty.empty());
+    EXPECT_EQ(empty, InternedString{});
+    EXPECT_EQ(empty.str(), "");
+    EXPECT_EQ(InternedString::poolSize(), before);
+}
+
+TEST(InternedString, ConvertsToStdString) {
+    const InternedString domain{"example.com"};
+    const std::string& str = domain;
+    EXPECT_EQ(str, "example.com");
+}
+
+TEST(InternedString, ConcurrentInterningAgrees) {
+    constexpr std::size_t THREADS = 8;
+    constexpr std::size_t VALUES = 200;
+    std::vector<std::vector<InternedString>> interned(THREADS);
+    {
+        std::vector<std::jthread> threads;
+        for (std::size_t thread = 0; thread < THREADS; ++thread) {
+            threads.emplace_back([&values = interned[thread]] {
+                for (std::size_t i = 0; i < VALUES; ++i) {
+                    values.emplace_back("ns" + std::to_string(i));
+                }
+            });
+        }
+    }
+    for (std::size_t thread = 1; thread < THREADS; ++thread) {
+        EXPECT_EQ(interned[thread], interned[0]);
+    }
+}
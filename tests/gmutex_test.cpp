@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <amarula/dbus/gmutex.hpp>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+
+using Amarula::DBus::G::ProfiledMutex;
+
+namespace {
+
+constexpr auto HOLD = std::chrono::milliseconds(20);
+
+}  // namespace
+
+TEST(ProfiledMutex, CountsEveryAcquisition) {
+    ProfiledMutex mtx;
+    for (int i = 0; i < 3; ++i) {
+        std::lock_guard<ProfiledMutex> const lock(mtx);
+    }
+    ASSERT_TRUE(mtx.try_lock());
+    mtx.unlock();
+    EXPECT_EQ(mtx.stats().acquisitions, 4U);
+}
+
+TEST(ProfiledMutex, FailedTryLockIsNotCounted) {
+    ProfiledMutex mtx;
+    std::unique_lock<ProfiledMutex> lock(mtx);
+    EXPECT_FALSE(std::async(std::launch::async, [&mtx]() {
+                     return mtx.try_lock();
+                 }).get());
+    lock.unlock();
+    EXPECT_EQ(mtx.stats().acquisitions, 1U);
+}
+
+TEST(ProfiledMutex, RecordsHoldTimes) {
+    ProfiledMutex mtx;
+    {
+        std::lock_guard<ProfiledMutex> const lock(mtx);
+        std::this_thread::sleep_for(HOLD);
+    }
+    {
+        std::lock_guard<ProfiledMutex> const lock(mtx);
+    }
+    const auto stats = mtx.stats();
+    EXPECT_EQ(stats.acquisitions, 2U);
+    EXPECT_GE(stats.max_hold, HOLD);
+    EXPECT_GE(stats.total_hold, stats.max_hold);
+    // The second, empty section adds next to nothing.
+    EXPECT_LT(stats.total_hold, stats.max_hold * 2);
+}
+
+TEST(ProfiledMutex, ResetStartsOver) {
+    ProfiledMutex mtx;
+    {
+        std::lock_guard<ProfiledMutex> const lock(mtx);
+        std::this_thread::sleep_for(HOLD);
+    }
+    mtx.resetStats();
+    auto stats = mtx.stats();
+    EXPECT_EQ(stats.acquisitions, 0U);
+    EXPECT_EQ(stats.total_hold.count(), 0);
+    EXPECT_EQ(stats.max_hold.count(), 0);
+
+    {
+        std::lock_guard<ProfiledMutex> const lock(mtx);
+    }
+    stats = mtx.stats();
+    EXPECT_EQ(stats.acquisitions, 1U);
+    EXPECT_LT(stats.max_hold, HOLD);
+}
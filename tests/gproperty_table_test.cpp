@@ -0,0 +1,108 @@
+#include <glib.h>
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "gdbus_private.hpp"
+#include "gproperty_table.hpp"
+#include "gvariant_codec.hpp"
+
+using namespace Amarula::DBus::G;
+
+namespace {
+
+// Keys of net.connman.Service, many of them alike in length and ends.
+constexpr std::array<std::string_view, 12> SERVICE_KEYS{
+    "State",       "Error",     "Name",          "Type",
+    "Security",    "Strength",  "Favorite",      "Immutable",
+    "AutoConnect", "Roaming",   "Nameservers",   "Nameservers.Configuration"};
+
+constexpr StringIndex<SERVICE_KEYS.size()> SERVICE_INDEX{SERVICE_KEYS};
+
+static_assert(SERVICE_INDEX.find("Strength") == 5U);
+static_assert(!SERVICE_INDEX.find("strength").has_value());
+
+constexpr uint8_t FAVORITE = 1U << 0U;
+constexpr uint8_t IMMUTABLE = 1U << 1U;
+
+struct Link {
+    std::string name_;
+    uint8_t strength_{0U};
+    uint8_t flags_{0U};
+};
+
+constexpr PropertyTable LINK_TABLE{
+    "Link", std::array{property<&Link::name_, Codec<std::string>>("Name"),
+                       property<&Link::strength_, Codec<uint8_t>>("Strength"),
+                       flag_property<&Link::flags_, FAVORITE>("Favorite"),
+                       flag_property<&Link::flags_, IMMUTABLE>("Immutable")}};
+
+// Sinks the floating reference of value.
+auto owned(GVariant* value) -> VariantPtr {
+    return {g_variant_ref_sink(value), &g_variant_unref};
+}
+
+}  // namespace
+
+TEST(StringIndex, FindsEveryKeyAtItsPosition) {
+    for (std::size_t i = 0; i < SERVICE_KEYS.size(); ++i) {
+        EXPECT_EQ(SERVICE_INDEX.find(SERVICE_KEYS.at(i)), i)
+            << SERVICE_KEYS.at(i);
+    }
+}
+
+TEST(StringIndex, RejectsUnknownKeys) {
+    // Same length and sampled characters as a key, or a prefix of one.
+    for (const std::string_view key :
+         {"", "S", "Stat", "Stxte", "States", "Nameservers.Configuratio",
+          "Nameservers.Cxnfiguration", "AutoConnecT", "Provider"}) {
+        EXPECT_FALSE(SERVICE_INDEX.find(key).has_value()) << key;
+    }
+}
+
+TEST(PropertyTable, DispatchesEachKeyToItsMember) {
+    static_assert(LINK_TABLE.size() == 4U);
+    EXPECT_EQ(LINK_TABLE.find("Strength"), 1U);
+    EXPECT_EQ(LINK_TABLE.key(*LINK_TABLE.find("Immutable")), "Immutable");
+
+    Link link;
+    const auto name = owned(g_variant_new_string("wifi_home"));
+    const auto strength = owned(g_variant_new_byte(73U));
+    const auto yes = owned(g_variant_new_boolean(TRUE));
+    LINK_TABLE.update(link, "Name", name.get());
+    LINK_TABLE.update(link, "Strength", strength.get());
+    LINK_TABLE.update(link, "Immutable", yes.get());
+
+    EXPECT_EQ(link.name_, "wifi_home");
+    EXPECT_EQ(link.strength_, 73U);
+    EXPECT_EQ(link.flags_, IMMUTABLE);
+}
+
+TEST(PropertyTable, FlagsSetAndClearTheirOwnBit) {
+    Link link;
+    link.flags_ = IMMUTABLE;
+    const auto dict = owned(
+        g_variant_new_parsed("{'Favorite': <true>, 'Immutable': <false>}"));
+    LINK_TABLE.parse(link, dict.get());
+    EXPECT_EQ(link.flags_, FAVORITE);
+}
+
+TEST(PropertyTable, IgnoresUnknownKeys) {
+    Link link;
+    link.name_ = "wifi_home";
+    link.strength_ = 40U;
+    const auto dict = owned(g_variant_new_parsed(
+        "{'Provider': <'vpn'>, 'name': <'other'>, 'Strengths': <byte 9>, "
+        "'Strength': <byte 41>}"));
+    LINK_TABLE.parse(link, dict.get());
+
+    EXPECT_FALSE(LINK_TABLE.find("Provider").has_value());
+    EXPECT_EQ(link.name_, "wifi_home");
+    // The known key next to the unknown ones still applies.
+    EXPECT_EQ(link.strength_, 41U);
+    EXPECT_EQ(link.flags_, 0U);
+}
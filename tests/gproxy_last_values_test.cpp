@@ -0,0 +1,241 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <gtest/gtest.h>
+
+#include <amarula/dbus/gdbus.hpp>
+#include <amarula/dbus/gproxy.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using Amarula::DBus::G::DBus;
+using Amarula::DBus::G::DBusProxy;
+
+/*
+ * PropertyChanged values that repeat the last one are dropped before they
+ * reach the properties, over a private dbus-daemon standing in for the
+ * system bus. Both ways signals are read: as GVariants and flattened.
+ */
+namespace {
+
+constexpr const char* BUS_NAME = "org.freedesktop.DBus";
+constexpr const char* BUS_PATH = "/org/freedesktop/DBus";
+constexpr const char* TEST_NAME = "org.example.LastValuesTest";
+constexpr const char* TEST_PATH = "/org/example/LastValuesTest";
+constexpr const char* TEST_INTERFACE = "org.example.LastValuesTest";
+// Sent after the values of a step, which arrive before it.
+constexpr const char* FENCE = "Fence";
+
+// Every value applied, printed, except the fences.
+struct RecordedProperties {
+    std::vector<std::string> applied;
+    uint32_t fence{0U};
+
+    void update(const gchar* key, GVariant* value) {
+        if (std::string(key) == FENCE) {
+            fence = g_variant_get_uint32(value);
+            return;
+        }
+        gchar* text = g_variant_print(value, FALSE);
+        applied.push_back(std::string(key) + '=' + text);
+        g_free(text);
+    }
+};
+
+class RecordingProxy : public DBusProxy<RecordedProperties> {
+   public:
+    explicit RecordingProxy(DBus* dbus)
+        : DBusProxy(dbus, TEST_NAME, TEST_PATH, TEST_INTERFACE) {}
+
+    // The cache is only touched on the D-Bus thread, so these run there.
+    void refresh(const char* dict) {
+        on_dbus_thread([this, dict]() {
+            GVariant* value = g_variant_ref_sink(g_variant_new_parsed(dict));
+            updateProperties(value);
+            g_variant_unref(value);
+        });
+    }
+    void reset() {
+        on_dbus_thread([this]() { resetProperties(); });
+    }
+
+   private:
+    void on_dbus_thread(const std::function<void()>& function) {
+        std::promise<void> done;
+        auto finished = done.get_future();
+        std::function<void()> run = [&]() {
+            function();
+            done.set_value();
+        };
+        g_main_context_invoke(
+            dbus()->context(),
+            [](gpointer user_data) -> gboolean {
+                (*static_cast<std::function<void()>*>(user_data))();
+                return G_SOURCE_REMOVE;
+            },
+            &run);
+        finished.wait();
+    }
+};
+
+class LastValuesTest : public ::testing::TestWithParam<bool> {
+   protected:
+    static GTestDBus* bus_;
+    std::unique_ptr<DBus> dbus_;
+    GDBusConnection* peer_{nullptr};
+    std::shared_ptr<RecordingProxy> proxy_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    uint32_t fence_{0U};
+
+    static void SetUpTestSuite() {
+        bus_ = g_test_dbus_new(G_TEST_DBUS_NONE);
+        g_test_dbus_up(bus_);
+        g_setenv("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address(bus_),
+                 TRUE);
+    }
+
+    static void TearDownTestSuite() {
+        g_test_dbus_down(bus_);
+        g_object_unref(bus_);
+    }
+
+    void SetUp() override {
+        dbus_ = std::make_unique<DBus>(BUS_NAME, BUS_PATH);
+        if (GetParam()) {
+            dbus_->setFlatSignals({"PropertyChanged"});
+        }
+        // The signals come from TEST_NAME, owned by a connection of its own.
+        peer_ = g_dbus_connection_new_for_address_sync(
+            g_getenv("DBUS_SYSTEM_BUS_ADDRESS"),
+            static_cast<GDBusConnectionFlags>(
+                G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+            nullptr, nullptr, nullptr);
+        ASSERT_NE(peer_, nullptr);
+        GVariant* reply = g_dbus_connection_call_sync(
+            peer_, BUS_NAME, BUS_PATH, BUS_NAME, "RequestName",
+            g_variant_new("(su)", TEST_NAME, 0U), nullptr,
+            G_DBUS_CALL_FLAGS_NONE, -1, nullptr, nullptr);
+        ASSERT_NE(reply, nullptr);
+        g_variant_unref(reply);
+
+        proxy_ = std::make_shared<RecordingProxy>(dbus_.get());
+        // The bus has the match rule of the proxy once it answers after it.
+        reply = g_dbus_connection_call_sync(
+            dbus_->connection(), BUS_NAME, BUS_PATH, BUS_NAME, "GetId",
+            nullptr, nullptr, G_DBUS_CALL_FLAGS_NONE, -1, nullptr, nullptr);
+        ASSERT_NE(reply, nullptr);
+        g_variant_unref(reply);
+        proxy_->onPropertyChanged([this](const RecordedProperties& props) {
+            {
+                std::lock_guard<std::mutex> const lock(mtx_);
+                fence_ = props.fence;
+            }
+            cv_.notify_all();
+        });
+    }
+
+    void TearDown() override {
+        proxy_.reset();
+        dbus_.reset();
+        if (peer_ != nullptr) {
+            g_object_unref(peer_);
+        }
+    }
+
+    void emit(const gchar* key, GVariant* value) {
+        g_dbus_connection_emit_signal(peer_, nullptr, TEST_PATH,
+                                      TEST_INTERFACE, "PropertyChanged",
+                                      g_variant_new("(sv)", key, value),
+                                      nullptr);
+    }
+
+    // What the signals sent since the last call applied, in order.
+    auto applied() -> std::vector<std::string> {
+        const auto fence = ++fence_sent_;
+        emit(FENCE, g_variant_new_uint32(fence));
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this, fence]() { return fence_ == fence; });
+        }
+        auto all = proxy_->properties().applied;
+        std::vector<std::string> since(all.begin() + seen_, all.end());
+        seen_ = all.size();
+        return since;
+    }
+
+    // After refresh() or reset(), which apply their own values or none.
+    void forget_applied() { seen_ = proxy_->properties().applied.size(); }
+
+   private:
+    uint32_t fence_sent_{0U};
+    std::size_t seen_{0U};
+};
+
+GTestDBus* LastValuesTest::bus_ = nullptr;
+
+using Applied = std::vector<std::string>;
+
+}  // namespace
+
+TEST_P(LastValuesTest, DropsRepeatedValues) {
+    emit("Strength", g_variant_new_byte(70U));
+    emit("Strength", g_variant_new_byte(70U));
+    emit("State", g_variant_new_string("ready"));
+    emit("Strength", g_variant_new_byte(70U));
+    emit("State", g_variant_new_string("ready"));
+    EXPECT_EQ(applied(), (Applied{"Strength=0x46", "State='ready'"}));
+}
+
+TEST_P(LastValuesTest, AppliesChangedValues) {
+    emit("Strength", g_variant_new_byte(70U));
+    emit("Strength", g_variant_new_byte(50U));
+    emit("Strength", g_variant_new_byte(70U));
+    EXPECT_EQ(applied(),
+              (Applied{"Strength=0x46", "Strength=0x32", "Strength=0x46"}));
+}
+
+TEST_P(LastValuesTest, ComparesWholeDicts) {
+    constexpr auto DHCP = "{'Method': <'dhcp'>, 'Address': <'192.0.2.10'>}";
+    constexpr auto MOVED = "{'Method': <'dhcp'>, 'Address': <'192.0.2.11'>}";
+    emit("IPv4", g_variant_new_parsed(DHCP));
+    emit("IPv4", g_variant_new_parsed(DHCP));
+    emit("IPv4", g_variant_new_parsed(MOVED));
+    emit("IPv4", g_variant_new_parsed(MOVED));
+    const auto dicts = applied();
+    ASSERT_EQ(dicts.size(), 2U);
+    EXPECT_NE(dicts.front().find("192.0.2.10"), std::string::npos);
+    EXPECT_NE(dicts.back().find("192.0.2.11"), std::string::npos);
+}
+
+TEST_P(LastValuesTest, UpdatePropertiesForgetsLastValues) {
+    emit("Strength", g_variant_new_byte(70U));
+    EXPECT_EQ(applied().size(), 1U);
+
+    proxy_->refresh("{'State': <'online'>}");
+    forget_applied();
+    emit("Strength", g_variant_new_byte(70U));
+    EXPECT_EQ(applied(), (Applied{"Strength=0x46"}));
+}
+
+TEST_P(LastValuesTest, ResetPropertiesForgetsLastValues) {
+    emit("State", g_variant_new_string("ready"));
+    EXPECT_EQ(applied().size(), 1U);
+
+    proxy_->reset();
+    forget_applied();
+    emit("State", g_variant_new_string("ready"));
+    EXPECT_EQ(applied(), (Applied{"State='ready'"}));
+}
+
+INSTANTIATE_TEST_SUITE_P(Signals, LastValuesTest, ::testing::Bool(),
+                         [](const auto& info) {
+                             return info.param ? "Flat" : "Tree";
+                         });
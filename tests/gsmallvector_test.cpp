@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include <amarula/dbus/gsmallvector.hpp>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using Amarula::DBus::G::SmallVector;
+
+namespace {
+
+using Strings = SmallVector<std::string, 2>;
+
+// Longer than the small string buffer, so a leak or double free shows.
+const std::string LONG_STR(64, 'x');
+
+// Throws on the copy made once copies_left runs out.
+struct Fragile {
+    static inline int copies_left = 0;
+
+    std::string value{LONG_STR};
+
+    Fragile() = default;
+    Fragile(const Fragile& other) : value{other.value} {
+        if (copies_left-- == 0) {
+            throw std::runtime_error("copy");
+        }
+    }
+    Fragile(Fragile&&) = default;
+    auto operator=(const Fragile&) -> Fragile& = default;
+    auto operator=(Fragile&&) -> Fragile& = default;
+    ~Fragile() = default;
+};
+
+}  // namespace
+
+TEST(SmallVector, StaysInlineUpToCapacity) {
+    Strings strings;
+    strings.push_back("8.8.8.8");
+    strings.emplace_back(LONG_STR);
+    EXPECT_TRUE(strings.isInline());
+    EXPECT_EQ(strings.size(), 2U);
+    EXPECT_EQ(strings.front(), "8.8.8.8");
+    EXPECT_EQ(strings.back(), LONG_STR);
+}
+
+TEST(SmallVector, GrowsToTheHeap) {
+    Strings strings;
+    for (int i = 0; i < 5; ++i) {
+        strings.push_back(LONG_STR + std::to_string(i));
+    }
+    EXPECT_FALSE(strings.isInline());
+    ASSERT_EQ(strings.size(), 5U);
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(strings[i], LONG_STR + std::to_string(i));
+    }
+    EXPECT_THROW((void)strings.at(5), std::out_of_range);
+}
+
+TEST(SmallVector, ReserveAllocatesOnlyBeyondCapacity) {
+    Strings strings;
+    strings.reserve(2);
+    EXPECT_TRUE(strings.isInline());
+    strings.reserve(3);
+    EXPECT_FALSE(strings.isInline());
+    EXPECT_EQ(strings.capacity(), 3U);
+}
+
+TEST(SmallVector, CopyAndMove) {
+    const Strings inline_strings{"a", LONG_STR};
+    const Strings heap_strings{"a", "b", LONG_STR};
+
+    for (const auto& source : {inline_strings, heap_strings}) {
+        Strings copy{source};
+        EXPECT_EQ(copy, source);
+
+        Strings moved{std::move(copy)};
+        EXPECT_EQ(moved, source);
+        EXPECT_TRUE(copy.empty());  // NOLINT(bugprone-use-after-move)
+
+        Strings assigned{"z"};
+        assigned = std::move(moved);
+        EXPECT_EQ(assigned, source);
+
+        assigned = inline_strings;
+        EXPECT_EQ(assigned, inline_strings);
+    }
+}
+
+TEST(SmallVector, PushBackOfItsOwnElementWhenFull) {
+    Strings strings{LONG_STR + "0", LONG_STR + "1"};
+    strings.push_back(strings[0]);
+    strings.push_back(strings[2]);
+    strings.push_back(strings.back());
+    ASSERT_EQ(strings.size(), 5U);
+    EXPECT_FALSE(strings.isInline());
+    for (const auto i : {0U, 2U, 3U, 4U}) {
+        EXPECT_EQ(strings[i], LONG_STR + "0");
+    }
+}
+
+TEST(SmallVector, ThrowingCopiesLeaveNothingBehind) {
+    SmallVector<Fragile, 1> source;
+    for (int i = 0; i < 3; ++i) {
+        source.emplace_back();
+    }
+
+    // Leaks, double frees and use after free show under ASan.
+    Fragile::copies_left = 2;
+    EXPECT_THROW((SmallVector<Fragile, 1>{source}), std::runtime_error);
+
+    SmallVector<Fragile, 1> full;
+    full.emplace_back();
+    Fragile::copies_left = 0;
+    EXPECT_THROW(full.push_back(full[0]), std::runtime_error);
+    EXPECT_EQ(full.size(), 1U);
+    EXPECT_TRUE(full.isInline());
+    EXPECT_EQ(full[0].value, LONG_STR);
+}
+
+TEST(SmallVector, ConvertsToStdVector) {
+    const Strings strings{"a", "b", LONG_STR};
+    const std::vector<std::string> copy = strings;
+    EXPECT_EQ(copy, (std::vector<std::string>{"a", "b", LONG_STR}));
+    const std::vector<std::string_view> views = strings;
+    EXPECT_EQ(views.back(), LONG_STR);
+}
@@ -0,0 +1,115 @@
+#include <glib.h>
+#include <gtest/gtest.h>
+
+#include <amarula/dbus/ginterned.hpp>
+#include <amarula/dbus/gsmallvector.hpp>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "gdbus_private.hpp"
+#include "gproperty_table.hpp"
+#include "gvariant_codec.hpp"
+
+using namespace Amarula::DBus::G;
+
+namespace {
+
+enum class Mode : uint8_t { Manual, Auto, Unknown };
+
+constexpr EnumStringMap<Mode, 2> MODE_MAP{
+    {{{Mode::Manual, "manual"}, {Mode::Auto, "auto"}}}};
+
+static_assert(Codec<bool>::SIGNATURE.view() == "b");
+static_assert(Codec<uint64_t>::SIGNATURE.view() == "t");
+static_assert(Codec<PropertyList<std::string>>::SIGNATURE.view() == "as");
+static_assert(Codec<std::vector<std::vector<int32_t>>>::SIGNATURE.view() ==
+              "aai");
+static_assert(ArrayCodec<EnumCodec<MODE_MAP>>::SIGNATURE.view() == "as");
+static_assert(VariantDict::SIGNATURE.view() == "a{sv}");
+
+// Sinks the floating reference encode() returns.
+auto owned(GVariant* value) -> VariantPtr {
+    return {g_variant_ref_sink(value), &g_variant_unref};
+}
+
+template <class T>
+auto round_trip(const T& value) -> T {
+    const auto variant = owned(to_variant(value));
+    EXPECT_TRUE(Codec<T>::SIGNATURE.matches(variant.get()));
+    return Codec<T>::decode(variant.get());
+}
+
+struct Settings {
+    Mode mode_{Mode::Unknown};
+    uint32_t count_{0U};
+    std::optional<PropertyList<InternedString>> names_;
+};
+
+constexpr PropertyTable SETTINGS_TABLE{
+    "Settings",
+    std::array{property<&Settings::mode_, EnumCodec<MODE_MAP>>("Mode"),
+               property<&Settings::count_, Codec<uint32_t>>("Count"),
+               property<&Settings::names_,
+                        NonEmpty<Codec<PropertyList<InternedString>>>>(
+                   "Names")}};
+
+}  // namespace
+
+TEST(GVariantCodec, ScalarsRoundTrip) {
+    EXPECT_TRUE(round_trip(true));
+    EXPECT_EQ(round_trip(uint8_t{200}), 200);
+    EXPECT_EQ(round_trip(uint16_t{1500}), 1500);
+    EXPECT_EQ(round_trip(int32_t{-5}), -5);
+    EXPECT_EQ(round_trip(uint64_t{1U} << 40U), uint64_t{1U} << 40U);
+    EXPECT_EQ(round_trip(std::string{"wlan0"}), "wlan0");
+}
+
+TEST(GVariantCodec, ContainersRoundTrip) {
+    const std::vector<std::string> servers{"a.example", "b.example"};
+    EXPECT_EQ(round_trip(servers), servers);
+
+    const PropertyList<InternedString> names{InternedString{"x"},
+                                             InternedString{"y"}};
+    EXPECT_EQ(round_trip(names), names);
+
+    const std::vector<std::vector<int32_t>> nested{{1, 2}, {}, {3}};
+    EXPECT_EQ(round_trip(nested), nested);
+}
+
+TEST(GVariantCodec, EnumsUseTheirStrings) {
+    const auto variant = owned(EnumCodec<MODE_MAP>::encode(Mode::Auto));
+    EXPECT_STREQ(g_variant_get_string(variant.get(), nullptr), "auto");
+
+    const auto unknown = owned(g_variant_new_string("later"));
+    EXPECT_EQ(EnumCodec<MODE_MAP>::decode(unknown.get()), Mode::Unknown);
+}
+
+TEST(GVariantCodec, ByteStringKeepsRawBytes) {
+    const std::string ssid{"\xff\x00net", 5};
+    const auto variant = owned(ByteString::encode(ssid));
+    EXPECT_TRUE(ByteString::SIGNATURE.matches(variant.get()));
+    EXPECT_EQ(ByteString::decode(variant.get()), ssid);
+}
+
+TEST(GVariantCodec, TableSkipsValuesOfTheWrongType) {
+    const auto dict = owned(g_variant_new_parsed(
+        "{'Mode': <'manual'>, 'Count': <'three'>, 'Names': <@as []>}"));
+    Settings settings;
+    settings.count_ = 7U;
+    SETTINGS_TABLE.parse(settings, dict.get());
+
+    EXPECT_EQ(settings.mode_, Mode::Manual);
+    EXPECT_EQ(settings.count_, 7U);
+    EXPECT_FALSE(settings.names_.has_value());
+
+    const auto update = owned(g_variant_new_parsed(
+        "{'Count': <uint32 3>, 'Names': <['eth0', 'eth0']>}"));
+    SETTINGS_TABLE.parse(settings, update.get());
+    EXPECT_EQ(settings.count_, 3U);
+    ASSERT_TRUE(settings.names_.has_value());
+    EXPECT_EQ(settings.names_->size(), 2U);
+    EXPECT_EQ(settings.names_->front(), settings.names_->back());
+}